@@ -133,7 +133,8 @@ kernelOptions arch = Options {
             optCxxLibDep = [],
             optDefines = (optDefines (options arch)) ++ [ Str "-DIN_KERNEL",
                 Str ("-DCONFIG_SCHEDULER_" ++ (show Config.scheduler)),
-                Str ("-DCONFIG_TIMESLICE=" ++ (show Config.timeslice)) ],
+                Str ("-DCONFIG_TIMESLICE=" ++ (show Config.timeslice)),
+                Str ("-DCONFIG_WAKEUP_SLACK=" ++ (show Config.wakeup_slack)) ],
             optIncludes = kernelIncludes arch,
             optDependencies =
                 [ Dep InstallTree arch "/include/errors/errno.h",
@@ -610,13 +610,15 @@ static inline errval_t
 invoke_dispatcher_properties(struct capref dispatcher,
                              enum task_type type, unsigned long deadline,
                              unsigned long wcet, unsigned long period,
-                             unsigned long release, unsigned short weight)
+                             unsigned long release, unsigned short weight,
+                             bool gang)
 {
     uint8_t invoke_bits = get_cap_valid_bits(dispatcher);
     capaddr_t invoke_cptr = get_cap_addr(dispatcher) >> (CPTR_BITS - invoke_bits);
 
     return syscall7((invoke_bits << 16) | (DispatcherCmd_Properties << 8) | SYSCALL_INVOKE,
-                    invoke_cptr, (type << 16) | weight, deadline, wcet, period, release).error;
+                    invoke_cptr, (gang << 24) | (type << 16) | weight, deadline,
+                    wcet, period, release).error;
 }
 
 static inline errval_t invoke_perfmon_activate(struct capref perfmon_cap,
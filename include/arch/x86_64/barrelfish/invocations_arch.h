@@ -20,6 +20,8 @@
 #include <barrelfish/caddr.h>
 #include <barrelfish_kpi/paging_arch.h>
 #include <barrelfish_kpi/lmp.h>
+#include <barrelfish_kpi/vnode_batch.h>
+#include <barrelfish_kpi/cnode_batch.h>
 
 static inline struct sysret cap_invoke(struct capref to, uintptr_t arg1,
                                        uintptr_t arg2, uintptr_t arg3,
@@ -97,6 +99,48 @@ static inline errval_t invoke_cnode_retype(struct capref root, capaddr_t src_csp
                        ((uint64_t)to_cspace << 32) | (uint64_t)to, slot, to_level).error;
 }
 
+/**
+ * \brief Perform a batch of retypes with a single invocation
+ *
+ * \param root    Root CNode of the caller's cspace
+ * \param entries Retype operations, cspace addresses are in the caller's cspace
+ * \param count   Number of entries, at most CNODE_BATCH_MAX
+ * \param done    Returns the number of entries that were performed, which on
+ *                error is the index of the failing entry
+ */
+static inline errval_t invoke_cnode_retype_batch(struct capref root,
+                                                 struct cnode_retype_batch_entry *entries,
+                                                 size_t count, size_t *done)
+{
+    struct sysret sr = cap_invoke3(root, CNodeCmd_RetypeBatch,
+                                   (uintptr_t)entries, count);
+    if (done) {
+        *done = sr.value;
+    }
+    return sr.error;
+}
+
+/**
+ * \brief Perform a batch of copies with a single invocation
+ *
+ * \param root    Root CNode of the caller's cspace
+ * \param entries Copy operations, cspace addresses are in the caller's cspace
+ * \param count   Number of entries, at most CNODE_BATCH_MAX
+ * \param done    Returns the number of entries that were performed, which on
+ *                error is the index of the failing entry
+ */
+static inline errval_t invoke_cnode_copy_batch(struct capref root,
+                                               struct cnode_copy_batch_entry *entries,
+                                               size_t count, size_t *done)
+{
+    struct sysret sr = cap_invoke3(root, CNodeCmd_CopyBatch,
+                                   (uintptr_t)entries, count);
+    if (done) {
+        *done = sr.value;
+    }
+    return sr.error;
+}
+
 static inline errval_t invoke_vnode_map(struct capref ptable, capaddr_t slot,
                                         capaddr_t src_root, capaddr_t src,
                                         enum cnode_type srclevel, size_t
@@ -111,6 +155,69 @@ static inline errval_t invoke_vnode_map(struct capref ptable, capaddr_t slot,
                         mcnlevel, mapping_slot).error;
 }
 
+/**
+ * \brief Perform a batch of map operations with a single invocation
+ *
+ * \param root    Any root page table (PML4) cap, used to invoke the kernel
+ * \param entries Map operations, page tables must be in the caller's cspace
+ * \param count   Number of entries, at most VNODE_BATCH_MAX
+ * \param done    Returns the number of entries that were performed, which on
+ *                error is the index of the failing entry
+ */
+static inline errval_t invoke_vnode_map_batch(struct capref root,
+                                              struct vnode_map_batch_entry *entries,
+                                              size_t count, size_t *done)
+{
+    struct sysret sr = cap_invoke3(root, VNodeCmd_MapBatch,
+                                   (uintptr_t)entries, count);
+    if (done) {
+        *done = sr.value;
+    }
+    return sr.error;
+}
+
+/**
+ * \brief Perform a batch of unmap operations with a single invocation
+ *
+ * \param root    Any root page table (PML4) cap, used to invoke the kernel
+ * \param entries Unmap operations, all caps must be in the caller's cspace
+ * \param count   Number of entries, at most VNODE_BATCH_MAX
+ * \param done    Returns the number of entries that were performed, which on
+ *                error is the index of the failing entry
+ */
+static inline errval_t invoke_vnode_unmap_batch(struct capref root,
+                                                struct vnode_unmap_batch_entry *entries,
+                                                size_t count, size_t *done)
+{
+    struct sysret sr = cap_invoke3(root, VNodeCmd_UnmapBatch,
+                                   (uintptr_t)entries, count);
+    if (done) {
+        *done = sr.value;
+    }
+    return sr.error;
+}
+
+/**
+ * \brief Modify the flags of a batch of mappings with a single invocation
+ *
+ * \param root    Any root page table (PML4) cap, used to invoke the kernel
+ * \param entries Modify operations, mapping caps must be in the caller's cspace
+ * \param count   Number of entries, at most VNODE_BATCH_MAX
+ * \param done    Returns the number of entries that were performed, which on
+ *                error is the index of the failing entry
+ */
+static inline errval_t invoke_vnode_modify_flags_batch(struct capref root,
+                                                       struct vnode_modify_flags_batch_entry *entries,
+                                                       size_t count, size_t *done)
+{
+    struct sysret sr = cap_invoke3(root, VNodeCmd_ModifyFlagsBatch,
+                                   (uintptr_t)entries, count);
+    if (done) {
+        *done = sr.value;
+    }
+    return sr.error;
+}
+
 static inline errval_t invoke_iocap_in(struct capref iocap, enum io_cmd cmd,
                                        uint16_t port, uint32_t *data)
 {
@@ -47,6 +47,13 @@ errval_t root_cnode_resize(struct capref cn, struct capref ret);
 
 errval_t cap_retype(struct capref dest_start, struct capref src, gensize_t offset,
                     enum objtype new_type, gensize_t objsize, size_t count);
+errval_t cap_retype_slots(struct capref *dest, size_t count, struct capref src,
+                          gensize_t offset, enum objtype new_type,
+                          gensize_t objsize);
+errval_t cap_retype_alloc(struct capref *ret, size_t count, struct capref src,
+                          gensize_t offset, enum objtype new_type,
+                          gensize_t objsize);
+errval_t cap_copy_slots(struct capref *dest, struct capref *src, size_t count);
 errval_t cap_create(struct capref dest, enum objtype type, size_t bytes);
 errval_t cap_delete(struct capref cap);
 errval_t cap_revoke(struct capref cap);
@@ -55,6 +55,9 @@ struct ram_alloc_state {
     uint64_t default_maxlimit;
     int base_capnum;
     int earlycn_capnum;
+    struct capref page_cache[RAM_ALLOC_PAGE_BATCH]; ///< Page-sized RAM caps
+    int page_cache_count;
+    bool page_cache_refilling;
 };
 
 struct skb_state {
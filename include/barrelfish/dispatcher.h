@@ -71,8 +71,11 @@ struct dispatcher_generic {
     /// Per core dispatcher state
     struct core_state_arch core_state;
 
-    /// Tracing buffer
-    struct trace_buffer *trace_buf;
+    /// Trace ring of this dispatcher, allocated on its first event
+    struct trace_ring *trace_ring;
+
+    /// Don't allocate a trace ring, the dispatcher doesn't trace
+    bool trace_disabled;
 
     struct thread *cleanupthread;
     struct thread_mutex cleanupthread_lock;
@@ -0,0 +1,46 @@
+/**
+ * \file
+ * \brief Cache of ready, zeroed frames refilled in the background
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef LIBBARRELFISH_FRAME_CACHE_H
+#define LIBBARRELFISH_FRAME_CACHE_H
+
+#include <sys/cdefs.h>
+#include <barrelfish/thread_sync.h>
+#include <barrelfish/pool_refill.h>
+
+__BEGIN_DECLS
+
+/// Maximum number of frames created by one retype during a refill
+#define FRAME_CACHE_REFILL_BATCH 16
+
+struct frame_cache {
+    size_t frame_bytes;         ///< Size of each frame, a power of two
+    struct capref *frames;      ///< Ring of ready frames
+    size_t capacity;            ///< Size of the ring
+    size_t head;                ///< Index of the oldest frame in the ring
+    size_t count;               ///< Number of frames in the ring
+    struct thread_mutex mutex;  ///< Protects the ring
+    uint64_t hits;              ///< Allocations served from the ring
+    struct pool_refill refill;  ///< Background refill state
+};
+
+errval_t frame_cache_init(struct frame_cache *fc, size_t frame_bytes,
+                          size_t low, size_t high);
+void frame_cache_set_waitset(struct frame_cache *fc, struct waitset *ws);
+errval_t frame_cache_alloc(struct frame_cache *fc, struct capref *ret);
+errval_t frame_cache_destroy(struct frame_cache *fc);
+
+__END_DECLS
+
+#endif // LIBBARRELFISH_FRAME_CACHE_H
@@ -24,6 +24,8 @@ typedef enum idc_control {
     IDC_CONTROL_TEARDOWN,   ///< Initiate connection teardown
     IDC_CONTROL_SET_SYNC,   ///< Enable synchronous optimisations
     IDC_CONTROL_CLEAR_SYNC, ///< Disable synchronous optimisations
+    IDC_CONTROL_SET_ADAPTIVE,   ///< Stop polling an idle receive channel (UMP)
+    IDC_CONTROL_CLEAR_ADAPTIVE, ///< Always poll the receive channel (UMP)
 } idc_control_t;
 
 /// Flags on an IDC export/service
@@ -44,6 +46,18 @@ typedef enum idc_bind_flags {
 
     // request a multi-hop channel
     IDC_BIND_FLAG_MULTIHOP = 1 << 2,
+
+    /// use a small message ring (stays L1-resident), for latency-sensitive
+    /// channels with few messages in flight
+    IDC_BIND_FLAG_UMP_SMALL_BUF = 1 << 3,
+    /// use a large message ring, for bulk or bursty channels
+    IDC_BIND_FLAG_UMP_LARGE_BUF = 1 << 4,
+    /// set up a side channel for large string and buffer arguments even on
+    /// a small message ring (UMP only, see ump_chan_bulklen())
+    IDC_BIND_FLAG_UMP_BULK = 1 << 5,
+    /// do not set up a side channel, saving 2 * DEFAULT_UMP_BULKLEN bytes
+    /// of shared memory per binding (UMP only)
+    IDC_BIND_FLAG_UMP_NO_BULK = 1 << 6,
 } idc_bind_flags_t;
 
 #define IDC_BIND_FLAGS_DEFAULT 0
@@ -430,10 +430,12 @@ static inline errval_t
 invoke_dispatcher_properties(struct capref dispatcher,
                              enum task_type type, unsigned long deadline,
                              unsigned long wcet, unsigned long period,
-                             unsigned long release, unsigned short weight)
+                             unsigned long release, unsigned short weight,
+                             bool gang)
 {
     return cap_invoke7(dispatcher, DispatcherCmd_Properties, type, deadline,
-                       wcet, period, release, weight).error;
+                       wcet, period, release,
+                       ((uintptr_t)gang << 16) | weight).error;
 }
 
 
@@ -77,7 +77,13 @@ errval_t lmp_endpoint_recv(struct lmp_endpoint *ep, struct lmp_recv_buf *buf,
                            struct capref *cap);
 errval_t lmp_endpoint_register(struct lmp_endpoint *ep, struct waitset *ws,
                                struct event_closure closure);
+errval_t lmp_endpoint_register_disabled(struct lmp_endpoint *ep,
+                                        struct waitset *ws,
+                                        struct event_closure closure,
+                                        dispatcher_handle_t handle);
 errval_t lmp_endpoint_deregister(struct lmp_endpoint *ep);
+errval_t lmp_endpoint_deregister_disabled(struct lmp_endpoint *ep,
+                                          dispatcher_handle_t handle);
 void lmp_endpoint_migrate(struct lmp_endpoint *ep, struct waitset *ws);
 void lmp_endpoint_store_lrpc_disabled(struct lmp_endpoint *ep, uint32_t bufpos,
                                       uintptr_t arg1, uintptr_t arg2,
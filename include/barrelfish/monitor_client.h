@@ -54,6 +54,9 @@ errval_t monitor_debug_print_cababilities(void);
 
 errval_t monitor_cap_identify_remote(struct capref cap, struct capability *ret);
 
+errval_t monitor_first_related_cap(struct capref cnode, uint32_t count,
+                                   uint32_t *ret_index);
+
 __END_DECLS
 
 #endif // BARRELFISH_MONITOR_CLIENT_H
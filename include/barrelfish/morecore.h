@@ -20,9 +20,15 @@
 
 __BEGIN_DECLS
 
+/// Page size for morecore_init() that picks large or huge pages when possible
+#define MORECORE_PAGESIZE_AUTO 0
+
+struct vspace_mmu_aware_stats;
+
 errval_t morecore_init(size_t alignment);
 void morecore_use_optimal(void);
 errval_t morecore_reinit(void);
+void morecore_get_stats(struct vspace_mmu_aware_stats *stats);
 
 __END_DECLS
 
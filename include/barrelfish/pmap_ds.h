@@ -63,6 +63,23 @@ struct pmap_vnode_mgmt {
     uint8_t ptslab_buffer[INIT_PTSLAB_BUFFER_SIZE];
 };
 
+#elif defined(PMAP_TREE)
+
+typedef struct vnode pmap_ds_child_t;
+
+struct pmap_ds_meta {
+    struct vnode *left;  ///< Left child in AVL tree of siblings
+    struct vnode *right; ///< Right child in AVL tree of siblings
+    uint8_t height;      ///< Height of the subtree rooted here
+};
+
+struct pmap_vnode_mgmt {
+    struct slab_allocator slab;     ///< Slab allocator for the shadow page table entries
+    struct vregion vregion;         ///< Vregion used to reserve virtual address for metadata
+    genvaddr_t vregion_offset;      ///< Offset into amount of reserved virtual address used
+    uint8_t slab_buffer[INIT_SLAB_BUFFER_SIZE];
+};
+
 #else
 #error Unknown Pmap datastructure.
 #endif
@@ -0,0 +1,66 @@
+/**
+ * \file
+ * \brief Watermark-driven deferred refill of allocator pools
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef LIBBARRELFISH_POOL_REFILL_H
+#define LIBBARRELFISH_POOL_REFILL_H
+
+#include <sys/cdefs.h>
+#include <barrelfish/thread_sync.h>
+#include <barrelfish/waitset.h>
+
+__BEGIN_DECLS
+
+/// Returns the number of free objects currently in the pool
+typedef size_t (*pool_level_func_t)(void *st);
+
+/// Refills the pool so that it holds at least \c target free objects
+typedef errval_t (*pool_refill_func_t)(void *st, size_t target);
+
+/**
+ * \brief A pool (slab allocator, slot allocator, ...) kept above a watermark
+ *
+ * Allocation paths call #pool_refill_check() after taking an object from the
+ * pool. If the pool has dropped below \c low, an event is queued on the
+ * pool's waitset, and the pool is refilled up to \c high the next time that
+ * waitset is dispatched. The allocation path keeps its own synchronous refill
+ * as a fallback for when the deferred refill has not caught up.
+ */
+struct pool_refill {
+    struct waitset_chanstate chan; ///< Event used to run the refill
+    struct waitset *ws;         ///< Waitset the refill runs on (NULL: inline)
+    struct thread_mutex mutex;  ///< Held while the pool is being refilled
+    const char *name;           ///< Name, for debugging
+    pool_level_func_t level;    ///< Returns current fill level
+    pool_refill_func_t refill;  ///< Refills the pool
+    void *st;                   ///< Argument to level and refill
+    size_t low;                 ///< Low watermark; refill when below
+    size_t high;                ///< High watermark; refill up to this
+
+    uint64_t kicks;             ///< Number of refills queued
+    uint64_t refills;           ///< Number of successful refills
+    uint64_t failures;          ///< Number of failed refills
+};
+
+void pool_refill_init(struct pool_refill *pool, const char *name,
+                      pool_level_func_t level, pool_refill_func_t refill,
+                      void *st, size_t low, size_t high);
+void pool_refill_set_waitset(struct pool_refill *pool, struct waitset *ws);
+void pool_refill_set_watermarks(struct pool_refill *pool, size_t low,
+                                size_t high);
+void pool_refill_check(struct pool_refill *pool);
+errval_t pool_refill_now(struct pool_refill *pool);
+
+__END_DECLS
+
+#endif // LIBBARRELFISH_POOL_REFILL_H
@@ -16,6 +16,7 @@
 #ifndef BARRELFISH_RAM_ALLOC_H
 #define BARRELFISH_RAM_ALLOC_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <errors/errno.h>
 #include <sys/cdefs.h>
@@ -24,13 +25,29 @@ __BEGIN_DECLS
 
 struct capref;
 
+/// Maximum number of caps in one ram_alloc_batch() or ram_free_batch()
+#define RAM_ALLOC_BATCH_MAX     256
+
+/// Number of page-sized RAM caps that ram_alloc() fetches at once
+#define RAM_ALLOC_PAGE_BATCH    16
+
 typedef errval_t (* ram_alloc_func_t)(struct capref *ret, uint8_t size_bits,
                                       uint64_t minbase, uint64_t maxlimit);
 
 errval_t ram_alloc_fixed(struct capref *ret, uint8_t size_bits,
                          uint64_t minbase, uint64_t maxlimit);
 errval_t ram_alloc(struct capref *retcap, uint8_t size_bits);
+errval_t ram_alloc_batch(struct capref *ret, const uint8_t *size_bits,
+                         size_t count);
+errval_t ram_free_batch(struct capref *caps, size_t count);
 errval_t ram_available(genpaddr_t *available, genpaddr_t *total);
+errval_t ram_alloc_node(struct capref *ret, uint8_t size_bits, uint32_t node);
+errval_t ram_alloc_interleaved(struct capref *ret, uint8_t size_bits,
+                               uint8_t chunk_bits, uint64_t nodemask);
+errval_t ram_available_node(uint32_t node, genpaddr_t *available,
+                            genpaddr_t *total);
+errval_t ram_add_node_range(struct capref physaddr, uint32_t node,
+                            genpaddr_t base, genpaddr_t limit);
 errval_t ram_alloc_set(ram_alloc_func_t local_allocator);
 void ram_set_affinity(uint64_t minbase, uint64_t maxlimit);
 void ram_get_affinity(uint64_t *minbase, uint64_t *maxlimit);
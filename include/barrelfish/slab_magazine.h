@@ -0,0 +1,79 @@
+/**
+ * \file
+ * \brief Per-thread magazine caches in front of a slab allocator
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef LIBBARRELFISH_SLAB_MAGAZINE_H
+#define LIBBARRELFISH_SLAB_MAGAZINE_H
+
+#include <sys/cdefs.h>
+#include <barrelfish/slab.h>
+#include <barrelfish_kpi/spinlocks_arch.h>
+
+__BEGIN_DECLS
+
+/// Number of blocks held by a full magazine
+#define SLAB_MAGAZINE_ROUNDS 15
+
+/// A fixed-size stack of free blocks
+struct slab_magazine {
+    struct slab_magazine *next;         ///< Next magazine in depot list
+    uint32_t rounds;                    ///< Number of blocks in the magazine
+    void *blocks[SLAB_MAGAZINE_ROUNDS]; ///< The blocks
+};
+
+/**
+ * \brief Shared depot of magazines for one slab allocator
+ *
+ * The depot owns the backing slab allocator; all accesses to it go through
+ * the depot lock. Threads allocate and free through their own #slab_cache and
+ * only take the lock to exchange whole magazines with the depot. The lock is
+ * a spinlock, so that threads which must not block (such as the inter-
+ * dispatcher message handler) can use the depot.
+ */
+struct slab_depot {
+    spinlock_t lock;                    ///< Protects everything below
+    struct slab_allocator *slabs;       ///< Backing slab allocator
+    struct slab_allocator magazines;    ///< Allocator for magazine structs
+    struct slab_magazine *full;         ///< List of full magazines
+    struct slab_magazine *empty;        ///< List of empty magazines
+
+    uint64_t exchanges;                 ///< Magazines exchanged with caches
+    uint64_t slab_allocs;               ///< Blocks allocated from the slabs
+    uint64_t slab_frees;                ///< Blocks freed to the slabs
+};
+
+/**
+ * \brief Per-thread (or per-dispatcher) front-end to a #slab_depot
+ *
+ * A cache must only be used by one thread at a time. A cache that could not
+ * get its magazines still works, but goes to the depot on every call.
+ */
+struct slab_cache {
+    struct slab_depot *depot;           ///< Depot backing this cache
+    struct slab_magazine *loaded;       ///< Magazine allocated/freed from
+    struct slab_magazine *previous;     ///< Full or empty spare magazine
+
+    uint64_t allocs;                    ///< Number of allocations
+    uint64_t frees;                     ///< Number of frees
+    uint64_t hits;                      ///< Operations served without the depot
+};
+
+void slab_depot_init(struct slab_depot *depot, struct slab_allocator *slabs);
+errval_t slab_cache_init(struct slab_cache *cache, struct slab_depot *depot);
+void slab_cache_flush(struct slab_cache *cache);
+void *slab_cache_alloc(struct slab_cache *cache);
+void slab_cache_free(struct slab_cache *cache, void *block);
+
+__END_DECLS
+
+#endif // LIBBARRELFISH_SLAB_MAGAZINE_H
@@ -50,6 +50,17 @@ errval_t sys_debug_create_irq_src_cap(struct capref cap, uint64_t start, uint64_
 errval_t sys_debug_get_mdb_size(size_t *size);
 errval_t sys_debug_print_mdb_counters(void);
 
+/// Kernel wakeup statistics of the current core
+struct wakeup_stats {
+    uint64_t set;               ///< Wakeups requested
+    uint64_t coalesced;         ///< Wakeups delayed to fire with another
+    uint64_t fired;             ///< Dispatchers woken up
+    uint64_t checks;            ///< Timer interrupts that checked for wakeups
+    uint64_t idle_entries;      ///< Times the core went idle without a tick
+    uint64_t ticks_skipped;     ///< Ticks not taken while idle
+};
+errval_t sys_debug_get_wakeup_stats(struct wakeup_stats *stats);
+
 #ifdef ENABLE_FEIGN_FRAME_CAP
 errval_t sys_debug_feign_frame_cap(struct capref slot, lpaddr_t base,
                                    uint8_t bits);
@@ -38,12 +38,38 @@ struct ump_bind_continuation {
     void *st;
 };
 
+/// Default size of each direction of the side channel of a UMP binding
+#define DEFAULT_UMP_BULKLEN     (4 * BASE_PAGE_SIZE)
+
+/// Smallest side channel set up from the spare space of a channel frame
+#define UMP_BULK_MIN_BYTES      BASE_PAGE_SIZE
+
+/**
+ * \brief One direction of the side channel for large message payloads
+ *
+ * Channels set up by ump_chan_bind() with a non-zero bulk length allocate a
+ * frame larger than the two message rings (see ump_chan_bulklen()).
+ * The spare space holds a payload area for each direction,
+ * which the sender fills as a byte ring, and a counter with which the
+ * receiver hands consumed space back. Both ends derive the layout from the
+ * frame size, so no negotiation is needed, and a frame without spare space
+ * simply has no side channel.
+ */
+struct ump_bulk {
+    volatile uint8_t *data;         ///< Payload area, NULL if none
+    volatile uintptr_t *consumed;   ///< Bytes released by the receiver
+    size_t size;                    ///< Size of data, a power of two
+    uintptr_t pos;                  ///< Bytes reserved (send) or released (receive)
+};
+
 /// A bidirectional UMP channel
 struct ump_chan {
     struct monitor_cap_handlers cap_handlers;   /* XXX: must be first */
 
     struct ump_chan_state send_chan;       ///< Outgoing UMP channel state
     struct ump_endpoint endpoint;          ///< Incoming UMP endpoint
+    struct ump_bulk bulk_send;             ///< Outgoing side channel
+    struct ump_bulk bulk_recv;             ///< Incoming side channel
     struct waitset_chanstate send_waitset;
     struct ump_chan *next, *prev;
     
@@ -78,7 +104,7 @@ errval_t ump_chan_init(struct ump_chan *uc,
 errval_t ump_chan_bind(struct ump_chan *uc, struct ump_bind_continuation cont,
                        struct event_queue_node *qnode,  iref_t iref,
                        struct monitor_binding *monitor_binding,
-                       size_t inchanlen, size_t outchanlen,
+                       size_t inchanlen, size_t outchanlen, size_t bulklen,
                        struct capref notify_cap);
 errval_t ump_chan_accept(struct ump_chan *uc, uintptr_t mon_id,
                          struct capref frame, size_t inchanlen, size_t outchanlen);
@@ -89,6 +115,8 @@ void ump_chan_send_bind_reply(struct monitor_binding *mb,
                               struct ump_chan *uc, errval_t err,
                               uintptr_t monitor_id, struct capref notify_cap);
 void ump_chan_destroy(struct ump_chan *uc);
+size_t ump_chan_buflen(uint32_t bind_flags);
+size_t ump_chan_bulklen(uint32_t bind_flags);
 void ump_init(void);
 
 /**
@@ -139,6 +167,52 @@ static inline volatile struct ump_message *ump_chan_get_next(
     return ump_impl_get_next(&uc->send_chan, ctrl);
 }
 
+/**
+ * \brief Reserve up to 'n' consecutive outgoing message slots
+ *
+ * The reserved slots must be filled in and then published, in order, with
+ * ump_chan_publish_batch().
+ *
+ * \return Number of slots reserved
+ */
+static inline size_t ump_chan_get_next_batch(struct ump_chan *uc,
+                                             volatile struct ump_message **msgs,
+                                             struct ump_control *ctrl, size_t n)
+{
+    return ump_impl_get_next_batch(&uc->send_chan, msgs, ctrl, n);
+}
+
+/**
+ * \brief Make a batch of messages reserved with ump_chan_get_next_batch()
+ * visible to the receiver with a single release
+ */
+static inline void ump_chan_publish_batch(struct ump_chan *uc,
+                                          volatile struct ump_message **msgs,
+                                          struct ump_control *ctrl, size_t n)
+{
+    ump_impl_publish_batch(msgs, ctrl, n);
+}
+
+/**
+ * \brief Retrieve a run of up to 'n' ready messages in one poll
+ *
+ * \return Number of messages retrieved
+ */
+static inline size_t ump_chan_recv_batch(struct ump_chan *uc,
+                                         volatile struct ump_message **msgs,
+                                         size_t n)
+{
+    assert(msgs != NULL);
+    assert(uc != NULL);
+    return ump_endpoint_recv_batch(&uc->endpoint, msgs, n);
+}
+
+static inline void ump_chan_free_batch(volatile struct ump_message **msgs,
+                                       size_t n)
+{
+    ump_impl_free_batch(msgs, n);
+}
+
 static inline bool ump_chan_can_send(struct ump_chan *uc)
 {
     assert(uc != NULL);
@@ -150,6 +224,45 @@ static inline void ump_chan_free_message(volatile struct ump_message *msg)
     ump_impl_free_message(msg);
 }
 
+/**
+ * \brief Enable poll-then-block receive on a channel
+ *
+ * See ump_endpoint_set_adaptive(). Without a notification endpoint set with
+ * ump_chan_set_notify(), the channel only parks while no thread waits on it.
+ *
+ * \param uc UMP channel
+ * \param spin_budget Number of empty polls before parking, or 0 to always poll
+ */
+static inline void ump_chan_set_adaptive(struct ump_chan *uc,
+                                         uint32_t spin_budget)
+{
+    ump_endpoint_set_adaptive(&uc->endpoint, spin_budget);
+}
+
+/**
+ * \brief Set the notification endpoint that resumes a parked channel
+ *
+ * See ump_endpoint_set_notify().
+ */
+static inline void ump_chan_set_notify(struct ump_chan *uc,
+                                       struct lmp_endpoint *notify_ep)
+{
+    ump_endpoint_set_notify(&uc->endpoint, notify_ep);
+}
+
+/**
+ * \brief Resume receiving on a channel parked by adaptive polling
+ */
+static inline void ump_chan_wakeup(struct ump_chan *uc)
+{
+    ump_endpoint_wakeup(&uc->endpoint);
+}
+
+static inline struct ump_endpoint_stats ump_chan_get_stats(struct ump_chan *uc)
+{
+    return ump_endpoint_get_stats(&uc->endpoint);
+}
+
 /**
  * \brief Migrate an event registration made with
  * ump_chan_register_recv() to a new waitset
@@ -22,10 +22,26 @@
 
 __BEGIN_DECLS
 
+/// Default number of empty polls before an adaptive endpoint stops polling
+#define UMP_DEFAULT_SPIN_BUDGET 1000
+
+/// Counters on how messages were noticed on a UMP endpoint
+struct ump_endpoint_stats {
+    uint64_t polls;         ///< Number of times the endpoint was polled
+    uint64_t poll_hits;     ///< Polls that found a message
+    uint64_t parks;         ///< Times the spin budget ran out and polling stopped
+    uint64_t wakeups;       ///< Notifications that resumed a parked endpoint
+};
+
 /// Incoming UMP endpoint
 struct ump_endpoint {
     struct waitset_chanstate waitset_state; ///< Waitset per-channel state
     struct ump_chan_state    chan;          ///< Incoming UMP channel state to poll
+
+    uint32_t spin_budget;   ///< Empty polls before parking (0: always poll)
+    uint32_t spins;         ///< Consecutive empty polls
+    struct lmp_endpoint *notify_ep; ///< Resumes the endpoint when parked (or NULL)
+    struct ump_endpoint_stats stats;
 };
 
 errval_t ump_endpoint_init(struct ump_endpoint *ep, volatile void *buf,
@@ -35,6 +51,13 @@ errval_t ump_endpoint_register(struct ump_endpoint *ep, struct waitset *ws,
                                 struct event_closure closure);
 errval_t ump_endpoint_deregister(struct ump_endpoint *ep);
 void ump_endpoint_migrate(struct ump_endpoint *ep, struct waitset *ws);
+void ump_endpoint_set_adaptive(struct ump_endpoint *ep, uint32_t spin_budget);
+void ump_endpoint_set_notify(struct ump_endpoint *ep,
+                             struct lmp_endpoint *notify_ep);
+void ump_endpoint_wakeup(struct ump_endpoint *ep);
+bool ump_endpoint_poll_adaptive(struct waitset_chanstate *channel,
+                                bool waited_on, bool *park, bool *notify,
+                                dispatcher_handle_t handle);
 
 /**
  * \brief Returns true if there is a message pending on the given UMP endpoint
@@ -64,6 +87,22 @@ static inline errval_t ump_endpoint_recv(struct ump_endpoint *ep,
     }
 }
 
+/**
+ * \brief Retrieve a run of up to 'n' messages from the given UMP endpoint
+ *
+ * Non-blocking, returns the number of messages retrieved, which may be zero.
+ *
+ * \param ep UMP endpoint
+ * \param msgs Storage for pointers to incoming messages
+ * \param n Maximum number of messages to retrieve
+ */
+static inline size_t ump_endpoint_recv_batch(struct ump_endpoint *ep,
+                                             volatile struct ump_message **msgs,
+                                             size_t n)
+{
+    return ump_impl_recv_batch(&ep->chan, msgs, n);
+}
+
 /**
  * \brief Return true if there's a message available
  *
@@ -78,6 +117,15 @@ static inline bool ump_endpoint_poll(struct waitset_chanstate *channel)
 }
 
 
+/**
+ * \brief Return the polling/notification counters of a UMP endpoint
+ */
+static inline struct ump_endpoint_stats
+ump_endpoint_get_stats(struct ump_endpoint *ep)
+{
+    return ep->stats;
+}
+
 __END_DECLS
 
 #endif // LIBBARRELFISH_UMP_ENDPOINT_H
@@ -52,6 +52,12 @@ __BEGIN_DECLS
 /// Default size of a unidirectional UMP message buffer, in bytes
 #define DEFAULT_UMP_BUFLEN  (BASE_PAGE_SIZE / 2 / UMP_MSG_BYTES * UMP_MSG_BYTES)
 
+/// Size of a small unidirectional UMP message buffer, in bytes
+#define SMALL_UMP_BUFLEN    (8 * UMP_MSG_BYTES)
+
+/// Size of a large unidirectional UMP message buffer, in bytes
+#define LARGE_UMP_BUFLEN    (8 * BASE_PAGE_SIZE / UMP_MSG_BYTES * UMP_MSG_BYTES)
+
 // control word is 32-bit, because it must be possible to atomically write it
 typedef uint32_t ump_control_t;
 #define UMP_USED_BITS  1
@@ -78,6 +84,13 @@ typedef uint16_t ump_index_t;
 #define UMP_INDEX_BITS         (sizeof(ump_index_t) * NBBY)
 #define UMP_INDEX_MASK         ((((uintptr_t)1) << UMP_INDEX_BITS) - 1)
 
+/// Maximum size of a unidirectional UMP message buffer, in bytes
+#define MAX_UMP_BUFLEN         (UMP_INDEX_MASK * UMP_MSG_BYTES)
+
+/// Minimum size of a unidirectional UMP message buffer, in bytes: one slot
+/// for messages and one kept free for flounder's cap acks
+#define MIN_UMP_BUFLEN         (2 * UMP_MSG_BYTES)
+
 /**
  * UMP direction
  */
@@ -108,6 +121,7 @@ struct ump_chan_state {
  * \param       c       Pointer to channel-state structure to initialize.
  * \param       buf     Pointer to ring buffer for the channel. Must be aligned to a cacheline.
  * \param       size    Size (in bytes) of buffer. Must be multiple of #UMP_MSG_BYTES
+ *                      and at most #MAX_UMP_BUFLEN
  * \param       dir     Channel direction.
  */
 static inline errval_t ump_chan_state_init(struct ump_chan_state *c,
@@ -115,7 +129,7 @@ static inline errval_t ump_chan_state_init(struct ump_chan_state *c,
                                            size_t size, enum ump_direction dir)
 {
     // check alignment and size of buffer.
-    if (size == 0 || (size % UMP_MSG_BYTES) != 0) {
+    if (size == 0 || (size % UMP_MSG_BYTES) != 0 || size > MAX_UMP_BUFLEN) {
         return LIB_ERR_UMP_BUFSIZE_INVALID;
     }
 
@@ -221,11 +235,172 @@ static inline volatile bool ump_impl_can_send(struct ump_chan_state *c)
     return !msg->header.control.used;
 }
 
+/**
+ * \brief Count the free outgoing message slots on 'c', up to 'max'
+ *
+ * The receiver frees slots in ring order, so the free slots are the ones
+ * from the current send position up to the first slot still in use.
+ */
+static inline size_t ump_impl_free_slots(struct ump_chan_state *c, size_t max)
+{
+    assert(c->dir == UMP_OUTGOING);
+
+    if (max > c->bufmsgs) {
+        max = c->bufmsgs;
+    }
+
+    size_t count;
+    ump_index_t pos = c->pos;
+    for (count = 0; count < max; count++) {
+        if (c->buf[pos].header.control.used) {
+            break;
+        }
+        if (++pos == c->bufmsgs) {
+            pos = 0;
+        }
+    }
+    return count;
+}
+
 static inline void ump_impl_free_message(volatile struct ump_message *msg)
 {
     msg->header.control.used = 0;
 }
 
+/**
+ * \brief Memory barrier needed between writing UMP payloads and publishing
+ *   the control word that makes them visible to the receiver.
+ */
+static inline void ump_impl_release_barrier(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    /* stores are not reordered with other stores on x86, so we only need to
+     * stop the compiler from reordering them */
+    __asm volatile ("" : : : "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
+/**
+ * \brief Reserve up to 'n' consecutive outgoing message slots on 'c'.
+ *
+ * Slots are reserved in ring order, starting at the current send position,
+ * until either 'n' slots are reserved or a slot is found still in use by the
+ * receiver. The send position is advanced past all reserved slots. The caller
+ * must fill in the payloads and then publish them with
+ * ump_impl_publish_batch().
+ *
+ * \param c     Pointer to UMP channel-state structure.
+ * \param msgs  Array of at least 'n' entries, filled with the reserved slots.
+ * \param ctrl  Array of at least 'n' control words, to be filled in.
+ * \param n     Maximum number of slots to reserve.
+ *
+ * \return Number of slots reserved (may be zero).
+ */
+static inline size_t ump_impl_get_next_batch(struct ump_chan_state *c,
+                                             volatile struct ump_message **msgs,
+                                             struct ump_control *ctrl, size_t n)
+{
+    assert(c->dir == UMP_OUTGOING);
+
+    if (n > c->bufmsgs) {
+        n = c->bufmsgs;
+    }
+
+    size_t count;
+    ump_index_t pos = c->pos;
+    for (count = 0; count < n; count++) {
+        volatile struct ump_message *msg = &c->buf[pos];
+        if (msg->header.control.used) {
+            break;
+        }
+        msgs[count] = msg;
+        ctrl[count].used = 1;
+        ctrl[count].token = 0;
+        if (++pos == c->bufmsgs) {
+            pos = 0;
+        }
+    }
+
+    c->pos = pos;
+    return count;
+}
+
+/**
+ * \brief Publish a batch of messages previously reserved with
+ *   ump_impl_get_next_batch().
+ *
+ * The control words of all but the first message are written before a single
+ * release barrier, after which the control word of the first message is
+ * written. Since the receiver consumes slots strictly in ring order, it cannot
+ * observe any message of the batch before the first one, so one barrier and
+ * one cache-line handoff of the head slot suffice for the whole batch.
+ *
+ * \param msgs  Reserved message slots, in ring order.
+ * \param ctrl  Control words for the messages (the used bit must be set).
+ * \param n     Number of messages to publish.
+ */
+static inline void ump_impl_publish_batch(volatile struct ump_message **msgs,
+                                          struct ump_control *ctrl, size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    ump_impl_release_barrier();
+    for (size_t i = 1; i < n; i++) {
+        assert(ctrl[i].used);
+        msgs[i]->header.control = ctrl[i];
+    }
+    ump_impl_release_barrier();
+    assert(ctrl[0].used);
+    msgs[0]->header.control = ctrl[0];
+}
+
+/**
+ * \brief Retrieve a run of up to 'n' outstanding messages on 'c' and advance
+ *   the receive pointer past them.
+ *
+ * \param c     Pointer to UMP channel-state structure.
+ * \param msgs  Array of at least 'n' entries, filled with the ready messages.
+ * \param n     Maximum number of messages to retrieve.
+ *
+ * \return Number of messages retrieved (may be zero).
+ */
+static inline size_t ump_impl_recv_batch(struct ump_chan_state *c,
+                                         volatile struct ump_message **msgs,
+                                         size_t n)
+{
+    assert(c->dir == UMP_INCOMING);
+
+    if (n > c->bufmsgs) {
+        n = c->bufmsgs;
+    }
+
+    size_t count;
+    for (count = 0; count < n; count++) {
+        volatile struct ump_message *msg = ump_impl_recv(c);
+        if (msg == NULL) {
+            break;
+        }
+        msgs[count] = msg;
+    }
+
+    return count;
+}
+
+/**
+ * \brief Release a batch of received message slots back to the sender.
+ */
+static inline void ump_impl_free_batch(volatile struct ump_message **msgs,
+                                       size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        ump_impl_free_message(msgs[i]);
+    }
+}
+
 __END_DECLS
 
 #endif // UMP_IMPL_H
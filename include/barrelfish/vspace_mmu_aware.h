@@ -26,12 +26,22 @@ struct vspace_mmu_vregion_list {
     struct vspace_mmu_vregion_list *next;
 };
 
+/// Page sizes picked by automatic page promotion
+struct vspace_mmu_aware_stats {
+    size_t huge;        ///< Frames mapped with 1G pages
+    size_t large;       ///< Frames mapped with 2M pages
+    size_t base;        ///< Frames mapped with base pages
+    size_t fallbacks;   ///< Frame allocations retried with a smaller page size
+};
+
 /// Struct to support mmu_aware memory management
 struct vspace_mmu_aware {
     size_t size;
     size_t alignment;
     size_t pagesize;
     size_t consumed;
+    bool promote;       ///< Pick the largest page size that fits each mapping
+    struct vspace_mmu_aware_stats stats;
     struct slot_allocator *slot_alloc; ///< slot allocator
     struct vregion vregion;           ///< Needs just one vregion
     struct memobj_anon memobj;        ///< Needs just one memobj
@@ -46,6 +56,8 @@ errval_t vspace_mmu_aware_init_aligned(struct vspace_mmu_aware *state,
                                        struct slot_allocator *slot_alloc,
                                        size_t size, size_t alignment,
                                        vregion_flags_t flags);
+void vspace_mmu_aware_set_promote(struct vspace_mmu_aware *state,
+                                  bool promote);
 errval_t vspace_mmu_aware_reset(struct vspace_mmu_aware *state,
                                 struct capref frame, size_t size);
 errval_t vspace_mmu_aware_map(struct vspace_mmu_aware *state, size_t req_size,
@@ -67,6 +67,23 @@ enum ws_chanstate {
     CHAN_WAITING        ///< There's no registered event handler (for now)
 };
 
+/// Dispatch priority class of a channel
+enum ws_priority {
+    WS_PRIO_LOW,        ///< Bulk/background traffic (eg. tracing, logging)
+    WS_PRIO_NORMAL,     ///< Default
+    WS_PRIO_HIGH,       ///< Control-plane traffic
+    WS_PRIO_COUNT
+};
+
+/// How pending events of different priority classes are interleaved
+enum ws_policy {
+    WS_POLICY_STRICT,   ///< Always dispatch the highest-priority event first
+    WS_POLICY_WEIGHTED, ///< Let a lower class through after 'weight' bypasses
+};
+
+/// Default number of bypasses of a lower class under #WS_POLICY_WEIGHTED
+#define WS_DEFAULT_WEIGHT 8
+
 /**
  * \brief Per-channel state belonging to waitset
  *
@@ -85,6 +102,9 @@ struct waitset_chanstate {
     struct waitset_chanstate *polled_next, *polled_prev;    ///< Dispatcher's polled queue
     struct thread *wait_for;                ///< Thread waiting for this event
     struct waitset_chanstate *trigger;      ///< Chanstate that triggers this chanstate 
+    enum ws_priority priority;              ///< Dispatch priority class
+    bool parked;                            ///< Polled channel left idle until its waitset is waited on
+    bool park_notify;                       ///< Parked channel is resumed by an armed notification
 };
 
 /**
@@ -101,11 +121,27 @@ struct waitset {
 
     /// Queue of threads blocked on this waitset (when no events are pending)
     struct thread *waiting_threads;
+
+    uint32_t nparked;       ///< Parked channels on the idle queue
+
+    enum ws_policy policy;  ///< Dispatch policy between priority classes
+    uint32_t weight;        ///< Bypasses allowed under #WS_POLICY_WEIGHTED
+    /// Per class: number of channels in the pending queue
+    uint32_t npending[WS_PRIO_COUNT];
+    /// Per class: consecutive dispatches of a higher class while it was pending
+    uint32_t bypassed[WS_PRIO_COUNT];
+    /// Per class: number of times its pending events were bypassed by a higher class
+    uint64_t starved[WS_PRIO_COUNT];
 };
 
 void poll_channels_disabled(dispatcher_handle_t handle);
 
 void waitset_init(struct waitset *ws);
+void waitset_set_policy(struct waitset *ws, enum ws_policy policy,
+                        uint32_t weight);
+uint64_t waitset_get_starved(struct waitset *ws, enum ws_priority priority);
+void waitset_chanstate_set_priority(struct waitset_chanstate *chan,
+                                    enum ws_priority priority);
 errval_t waitset_destroy(struct waitset *ws);
 
 errval_t get_next_event(struct waitset *ws, struct event_closure *retclosure);
@@ -118,6 +154,7 @@ errval_t wait_for_channel(struct waitset *ws, struct waitset_chanstate *channel,
 errval_t event_dispatch_disabled(struct waitset *ws, dispatcher_handle_t handle);
 errval_t event_dispatch_debug(struct waitset *ws);
 errval_t event_dispatch_non_block(struct waitset *ws);
+errval_t event_dispatch_bulk(struct waitset *ws, size_t max, size_t *retcount);
 
 __END_DECLS
 
@@ -36,6 +36,10 @@ errval_t waitset_chan_trigger_closure(struct waitset *ws,
 errval_t waitset_chan_deregister(struct waitset_chanstate *chan);
 errval_t waitset_chan_register(struct waitset *ws, struct waitset_chanstate *chan,
                                struct event_closure closure);
+errval_t waitset_chan_register_prio(struct waitset *ws,
+                                    struct waitset_chanstate *chan,
+                                    struct event_closure closure,
+                                    enum ws_priority priority);
 errval_t waitset_chan_register_polled(struct waitset *ws,
                                       struct waitset_chanstate *chan,
                                       struct event_closure closure);
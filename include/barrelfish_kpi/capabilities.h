@@ -448,7 +448,9 @@ enum cnode_cmd {
     CNodeCmd_GetState,  ///< Get distcap state for capability
     CNodeCmd_GetSize,   ///< Get Size of CNode, only applicable for L1 Cnode
     CNodeCmd_Resize,    ///< Resize CNode, only applicable for L1 Cnode
-    CNodeCmd_CapIdentify ///< Identify capability
+    CNodeCmd_CapIdentify, ///< Identify capability
+    CNodeCmd_RetypeBatch, ///< Perform a batch of retypes
+    CNodeCmd_CopyBatch,   ///< Perform a batch of copies
 };
 
 enum vnode_cmd {
@@ -458,6 +460,9 @@ enum vnode_cmd {
     VNodeCmd_CleanDirtyBits, ///< Cleans all dirty bit in the table
     VNodeCmd_CopyRemap,      ///< Copy and remap page table for copy-on-write
     VNodeCmd_Inherit,        ///< Clone page table
+    VNodeCmd_MapBatch,       ///< Multiple maps, see vnode_batch.h
+    VNodeCmd_UnmapBatch,     ///< Multiple unmaps, see vnode_batch.h
+    VNodeCmd_ModifyFlagsBatch, ///< Multiple flag changes, see vnode_batch.h
 };
 
 /**
@@ -509,6 +514,8 @@ enum kernel_cmd {
     KernelCmd_Suspend_kcb_sched,  ///< suspend/resume kcb scheduler
     KernelCmd_Get_platform,       ///< Get architecture platform
     KernelCmd_ReclaimRAM,         ///< Retrieve stored ram caps from KCB
+    KernelCmd_Mdb_add_memory,     ///< Give RAM to the mapping database
+    KernelCmd_Mdb_free_nodes,     ///< Free nodes of the mapping database
     KernelCmd_Count
 };
 
@@ -0,0 +1,55 @@
+/**
+ * \file
+ * \brief Arguments for batched CNode operations
+ *
+ * The CNodeCmd_*Batch invocations take a pointer to an array of these
+ * entries in the caller's address space, and perform each entry as if it
+ * had been invoked separately on the caller's root CNode, in order, stopping
+ * at the first error. The kernel copies the array before performing the
+ * first entry. On an error, the entries before the failing one stay
+ * performed, and the invocation returns the index of the failing entry.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef BARRELFISH_KPI_CNODE_BATCH_H
+#define BARRELFISH_KPI_CNODE_BATCH_H
+
+#include <barrelfish_kpi/types.h>
+
+/// Maximum number of entries in a single batch invocation
+#define CNODE_BATCH_MAX 32
+
+/// One CNodeCmd_Retype
+struct cnode_retype_batch_entry {
+    capaddr_t src_root;         ///< Source cspace, in the caller's cspace
+    capaddr_t src;              ///< Cap to retype, in the source cspace
+    uint64_t  offset;           ///< Offset into source cap
+    uint64_t  objsize;          ///< Size of created objects
+    uint64_t  count;            ///< Number of objects to create
+    uint32_t  type;             ///< Type of created objects
+    capaddr_t dest_root;        ///< Destination cspace, in the caller's cspace
+    capaddr_t dest_cnode;       ///< CNode to place new caps in
+    cslot_t   dest_slot;        ///< First slot to place new caps in
+    uint8_t   dest_level;       ///< Level of dest_cnode address
+};
+
+/// One CNodeCmd_Copy
+struct cnode_copy_batch_entry {
+    capaddr_t dest_root;        ///< Destination cspace, in the caller's cspace
+    capaddr_t dest_cnode;       ///< CNode to place the copy in
+    cslot_t   dest_slot;        ///< Slot to place the copy in
+    capaddr_t src_root;         ///< Source cspace, in the caller's cspace
+    capaddr_t src;              ///< Cap to copy, in the source cspace
+    uint8_t   dest_level;       ///< Level of dest_cnode address
+    uint8_t   src_level;        ///< Level of src address
+};
+
+#endif // BARRELFISH_KPI_CNODE_BATCH_H
@@ -38,6 +38,18 @@ enum debug_message {
     DEBUG_CREATE_IRQ_SRC_CAP,
     DEBUG_GET_MDB_SIZE,
     DEBUG_PRINT_MDB_COUNTERS,
+    DEBUG_GET_WAKEUP_STAT,
+};
+
+/// Kernel wakeup statistics, as returned by DEBUG_GET_WAKEUP_STAT
+enum wakeup_stat {
+    WAKEUP_STAT_SET,            ///< Wakeups requested
+    WAKEUP_STAT_COALESCED,      ///< Wakeups delayed to fire with another
+    WAKEUP_STAT_FIRED,          ///< Dispatchers woken up
+    WAKEUP_STAT_CHECKS,         ///< Timer interrupts that checked for wakeups
+    WAKEUP_STAT_IDLE_ENTRIES,   ///< Times the core went idle without a tick
+    WAKEUP_STAT_TICKS_SKIPPED,  ///< Ticks not taken while idle
+    WAKEUP_STAT_COUNT
 };
 
 #endif //BARRELFISH_KPI_SYS_DEBUG_H
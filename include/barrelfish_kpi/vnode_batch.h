@@ -0,0 +1,66 @@
+/**
+ * \file
+ * \brief Arguments for batched page table operations
+ *
+ * The VNodeCmd_*Batch invocations take a pointer to an array of these
+ * entries in the caller's address space, and perform each entry as if it
+ * had been invoked separately, in order, stopping at the first error. The
+ * kernel copies the array before performing the first entry, so an entry may
+ * unmap the page holding the array. On an error, the entries before the
+ * failing one stay performed, and the invocation returns the index of the
+ * failing entry.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef BARRELFISH_KPI_VNODE_BATCH_H
+#define BARRELFISH_KPI_VNODE_BATCH_H
+
+#include <barrelfish_kpi/types.h>
+
+/// Maximum number of entries in a single batch invocation
+#define VNODE_BATCH_MAX 32
+
+/// One VNodeCmd_Map, on a page table in the caller's cspace
+struct vnode_map_batch_entry {
+    capaddr_t ptable;           ///< Page table to map into
+    uint8_t   ptable_level;     ///< Level of ptable address
+    uint8_t   src_level;        ///< Level of source address
+    uint8_t   mcn_level;        ///< Level of mapping cnode address
+    cslot_t   slot;             ///< First page table entry to map
+    capaddr_t src_root;         ///< Root cnode of source cap
+    capaddr_t src;              ///< Frame or page table to map
+    capaddr_t mcn_root;         ///< Root cnode of mapping cnode
+    capaddr_t mcn;              ///< Cnode for the mapping cap
+    cslot_t   mapping_slot;     ///< Slot for the mapping cap
+    uint64_t  flags;            ///< Architecture-specific mapping flags
+    uint64_t  offset;           ///< Offset into source
+    uint64_t  pte_count;        ///< Number of page table entries to map
+};
+
+/// One VNodeCmd_Unmap, on a page table in the caller's cspace
+struct vnode_unmap_batch_entry {
+    capaddr_t ptable;           ///< Page table to unmap from
+    capaddr_t mapping;          ///< Mapping cap of the region to unmap
+    uint8_t   ptable_level;     ///< Level of ptable address
+    uint8_t   mapping_level;    ///< Level of mapping address
+};
+
+/// One MappingCmd_Modify, on a mapping cap in the caller's cspace
+struct vnode_modify_flags_batch_entry {
+    capaddr_t  mapping;         ///< Mapping cap of the region to modify
+    uint8_t    mapping_level;   ///< Level of mapping address
+    uint64_t   offset;          ///< First page to modify, in pages from mapping start
+    uint64_t   pages;           ///< Number of pages to modify
+    uint64_t   flags;           ///< New architecture-specific flags
+    genvaddr_t va_hint;         ///< Virtual address hint for TLB flush
+};
+
+#endif // BARRELFISH_KPI_VNODE_BATCH_H
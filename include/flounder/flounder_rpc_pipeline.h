@@ -0,0 +1,71 @@
+/**
+ * \file
+ * \brief Pipelined RPC calls of Flounder-generated stubs
+ *
+ * The blocking RPC stubs (rpc_tx_vtbl) allow one call in flight per thread.
+ * Once <ifn>_rpc_pipeline_init() has been called on a binding, the
+ * generated <ifn>_<rpc>__rpc_async() functions send a call and return as
+ * soon as it is handed to the channel, and the response is delivered to a
+ * completion handler. Many calls can thus be in flight on one binding.
+ *
+ * Every call is sent with its own odd token, which the server echoes with
+ * the lowest bit cleared in its response. Responses are matched to calls
+ * by this token only, so this needs a backend that carries tokens (LMP,
+ * UMP). A response whose token matches no call is reported to the
+ * binding's error handler as FLOUNDER_ERR_RPC_MISMATCH.
+ *
+ * A server that answers a call after its handler returned must save the
+ * token with <ifn>_rpc_call_token() in the handler, and send the response
+ * with <ifn>_<rpc>__reply(), which restores it. Otherwise the response
+ * carries the token of the last message received.
+ *
+ * <ifn>_rpc_pipeline_init() replaces the rx_vtbl handlers of all RPC
+ * responses of the binding; handlers set there before or after are lost or
+ * break the pipeline. A binding used for pipelined calls must not also be
+ * used for blocking RPCs.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef __FLOUNDER_RPC_PIPELINE_H
+#define __FLOUNDER_RPC_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errors/errno.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/// Calls in flight per binding, if the user doesn't choose
+#define FLOUNDER_RPC_PIPELINE_DEPTH     32
+
+struct flounder_rpc_pipeline;
+struct waitset;
+
+errval_t flounder_rpc_pipeline_create(size_t depth,
+                                      struct flounder_rpc_pipeline **retp);
+void flounder_rpc_pipeline_destroy(struct flounder_rpc_pipeline *p);
+errval_t flounder_rpc_pipeline_push(struct flounder_rpc_pipeline *p,
+                                    int msgnum, void *handler, void *st,
+                                    uint32_t *rettoken);
+void flounder_rpc_pipeline_cancel(struct flounder_rpc_pipeline *p,
+                                  uint32_t token);
+errval_t flounder_rpc_pipeline_complete(struct flounder_rpc_pipeline *p,
+                                        int msgnum, uint32_t token,
+                                        void **rethandler, void **retst);
+size_t flounder_rpc_pipeline_pending(struct flounder_rpc_pipeline *p);
+errval_t flounder_rpc_pipeline_wait(struct waitset *ws,
+                                    struct flounder_rpc_pipeline *p,
+                                    size_t max_pending);
+
+__END_DECLS
+
+#endif // __FLOUNDER_RPC_PIPELINE_H
@@ -0,0 +1,158 @@
+/**
+ * \file
+ * \brief Per-binding message statistics of Flounder-generated stubs
+ *
+ * When built with CONFIG_FLOUNDER_STATS (hake option flounder_stats), every
+ * binding counts the messages it sends and receives, per message type, and
+ * keeps a histogram of the send and receive latencies:
+ *
+ *  - send latency: from the call of the send function to the last fragment
+ *    of the message being handed to the channel. This includes waiting for
+ *    space in the channel.
+ *  - receive latency: from the arrival of the first fragment of a message to
+ *    its handler returning. This includes the time spent in the handler.
+ *    A message that arrives while the handler of another one dispatches
+ *    events ends the measurement of the outer one, which is only counted.
+ *
+ * The statistics of all bindings of a domain are kept on a list, which can
+ * be walked with flounder_stats_iterate() or printed with
+ * flounder_stats_dump().
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef __FLOUNDER_STATS_H
+#define __FLOUNDER_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <barrelfish/systime.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/**
+ * Number of buckets of a latency histogram. Bucket 0 counts latencies of
+ * 0 ticks, bucket i latencies in [2^(i-1), 2^i) ticks, and the last bucket
+ * everything above.
+ */
+#define FLOUNDER_STATS_BUCKETS  32
+
+/// Statistics of one message type of a binding
+struct flounder_msg_stats {
+    uint64_t  tx_count;                         ///< Messages sent
+    uint64_t  rx_count;                         ///< Messages received
+    systime_t tx_time;                          ///< Sum of the send latencies
+    systime_t rx_time;                          ///< Sum of the receive latencies
+    uint32_t  tx_hist[FLOUNDER_STATS_BUCKETS];  ///< Send latency histogram
+    uint32_t  rx_hist[FLOUNDER_STATS_BUCKETS];  ///< Receive latency histogram
+};
+
+/// Returns the name of a message number of an interface
+typedef const char *(*flounder_msg_name_fn_t)(int msgnum);
+
+/// Statistics of a binding
+struct flounder_binding_stats {
+    struct flounder_binding_stats *next;    ///< Next binding of the domain
+    const void *binding;                    ///< Binding the statistics are of
+    const char *ifname;                     ///< Name of the interface
+    const char *backend;                    ///< Name of the backend
+    flounder_msg_name_fn_t msg_name;        ///< Names the message numbers
+    systime_t tx_start;                     ///< Start of the current send
+    systime_t rx_start;                     ///< Start of the current receive
+    int num_msgs;                           ///< Entries in msgs
+    struct flounder_msg_stats msgs[];       ///< Indexed by message number
+};
+
+/// Callback of flounder_stats_iterate()
+typedef void (*flounder_stats_iter_fn_t)(struct flounder_binding_stats *stats,
+                                         void *arg);
+
+struct flounder_binding_stats *
+flounder_stats_create(const void *binding, const char *ifname,
+                      const char *backend, flounder_msg_name_fn_t msg_name,
+                      int num_msgs);
+void flounder_stats_destroy(struct flounder_binding_stats *stats);
+void flounder_stats_reset(struct flounder_binding_stats *stats);
+void flounder_stats_iterate(flounder_stats_iter_fn_t fn, void *arg);
+systime_t flounder_stats_percentile(const uint32_t *hist, unsigned percent);
+void flounder_stats_dump_binding(struct flounder_binding_stats *stats);
+void flounder_stats_dump(void);
+
+/// Histogram bucket of a latency
+static inline int flounder_stats_bucket(systime_t ticks)
+{
+    if (ticks == 0) {
+        return 0;
+    }
+    int bucket = 64 - __builtin_clzll(ticks);
+    return bucket < FLOUNDER_STATS_BUCKETS ? bucket
+                                           : FLOUNDER_STATS_BUCKETS - 1;
+}
+
+/// A message is handed to the send function of a binding
+static inline void flounder_stats_tx_start(struct flounder_binding_stats *st)
+{
+    if (st != NULL) {
+        st->tx_start = systime_now();
+    }
+}
+
+/// The last fragment of message msgnum has been sent
+static inline void flounder_stats_tx_done(struct flounder_binding_stats *st,
+                                          int msgnum)
+{
+    if (st == NULL || msgnum < 0 || msgnum >= st->num_msgs) {
+        return;
+    }
+
+    struct flounder_msg_stats *m = &st->msgs[msgnum];
+    m->tx_count++;
+
+    // Internal messages, e.g. the bind reply, don't go through the send
+    // function and have no start time.
+    if (st->tx_start != 0) {
+        systime_t ticks = systime_now() - st->tx_start;
+        m->tx_time += ticks;
+        m->tx_hist[flounder_stats_bucket(ticks)]++;
+        st->tx_start = 0;
+    }
+}
+
+/// The first fragment of a message has been received
+static inline void flounder_stats_rx_start(struct flounder_binding_stats *st)
+{
+    if (st != NULL) {
+        st->rx_start = systime_now();
+    }
+}
+
+/// Message msgnum has been received and its handler has returned
+static inline void flounder_stats_rx_done(struct flounder_binding_stats *st,
+                                          int msgnum)
+{
+    if (st == NULL || msgnum < 0 || msgnum >= st->num_msgs) {
+        return;
+    }
+
+    struct flounder_msg_stats *m = &st->msgs[msgnum];
+    m->rx_count++;
+
+    if (st->rx_start != 0) {
+        systime_t ticks = systime_now() - st->rx_start;
+        m->rx_time += ticks;
+        m->rx_hist[flounder_stats_bucket(ticks)]++;
+        st->rx_start = 0;
+    }
+}
+
+__END_DECLS
+
+#endif // __FLOUNDER_STATS_H
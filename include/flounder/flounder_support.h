@@ -16,6 +16,7 @@
 #define __FLOUNDER_SUPPORT_H
 
 #include <flounder/flounder.h>
+#include <flounder/flounder_rpc_pipeline.h>
 #include <sys/cdefs.h>
 
 __BEGIN_DECLS
@@ -64,6 +65,34 @@ void flounder_support_migrate_notify(struct waitset_chanstate *chan,
 # define FL_DEBUG(msg...) ((void)0)
 #endif
 
+/*
+ * Hooks for the per-binding message statistics, see flounder_stats.h.
+ * The argument b is a pointer to the generic binding structure.
+ */
+struct flounder_binding_stats;
+
+#if defined(CONFIG_FLOUNDER_STATS)
+# include <flounder/flounder_stats.h>
+# define FL_STATS_INIT(b, ifn, drv, namefn) \
+    ((b)->stats = flounder_stats_create((b), (ifn), (drv), (namefn), \
+                        sizeof((b)->message_chanstate) \
+                        / sizeof((b)->message_chanstate[0])))
+// The receive hook runs after the handler, which may destroy the binding
+# define FL_STATS_DESTROY(b) \
+    (flounder_stats_destroy((b)->stats), (b)->stats = NULL)
+# define FL_STATS_TX_START(b)       flounder_stats_tx_start((b)->stats)
+# define FL_STATS_TX_DONE(b, num)   flounder_stats_tx_done((b)->stats, (num))
+# define FL_STATS_RX_START(b)       flounder_stats_rx_start((b)->stats)
+# define FL_STATS_RX_DONE(b, num)   flounder_stats_rx_done((b)->stats, (num))
+#else
+# define FL_STATS_INIT(b, ifn, drv, namefn) ((b)->stats = NULL)
+# define FL_STATS_DESTROY(b)        ((void)0)
+# define FL_STATS_TX_START(b)       ((void)0)
+# define FL_STATS_TX_DONE(b, num)   ((void)0)
+# define FL_STATS_RX_START(b)       ((void)0)
+# define FL_STATS_RX_DONE(b, num)   ((void)0)
+#endif
+
 __END_DECLS
 
 #endif // __FLOUNDER_SUPPORT_H
@@ -33,6 +33,24 @@ enum flounder_ump_msgtype {
     FL_UMP_CAP_ACK = (1 << FL_UMP_MSGTYPE_BITS) - 1,
 };
 
+/**
+ * Strings and buffers of at least this many bytes are sent through the side
+ * channel of the UMP channel, if it has one and it has space, instead of
+ * being copied word by word into message fragments.
+ *
+ * The side channel is not zero-copy: the sender copies the payload into the
+ * shared area with memcpy(), and the receiver copies it out into the buffer
+ * it hands to the receive handler. That is the same two copies the fragment
+ * path makes, but done in bulk, with one fragment instead of one per
+ * UMP_PAYLOAD_BYTES and no per-fragment barriers or polling. Below this
+ * threshold the fragment path is as cheap and keeps the payload in the
+ * cache lines the receiver is already polling.
+ */
+#define FL_UMP_BULK_THRESHOLD   (8 * UMP_PAYLOAD_BYTES)
+
+/// Flags the length word of a buffer sent through the side channel
+#define FL_UMP_BULK_FLAG        ((uintptr_t)1 << (sizeof(uintptr_t) * 8 - 1))
+
 struct flounder_ump_state {
     struct ump_chan chan;
 
@@ -46,7 +64,8 @@ errval_t flounder_stub_ump_send_string(struct flounder_ump_state *s,
                                        int msgnum, const char *str,
                                        size_t *pos, size_t *len);
 
-errval_t flounder_stub_ump_recv_string(volatile struct ump_message *msg,
+errval_t flounder_stub_ump_recv_string(struct flounder_ump_state *s,
+                                       volatile struct ump_message *msg,
                                        char *str, size_t *pos, size_t *len,
                                        size_t maxsize);
 
@@ -54,7 +73,8 @@ errval_t flounder_stub_ump_send_buf(struct flounder_ump_state *s,
                                        int msgnum, const void *buf,
                                        size_t len, size_t *pos);
 
-errval_t flounder_stub_ump_recv_buf(volatile struct ump_message *msg,
+errval_t flounder_stub_ump_recv_buf(struct flounder_ump_state *s,
+                                    volatile struct ump_message *msg,
                                     void *buf, size_t *len, size_t *pos,
                                     size_t maxsize);
 
@@ -89,19 +109,51 @@ static inline int flounder_stub_ump_control_process(struct flounder_ump_state *s
 /// Emit memory barrier needed between writing UMP payload and header
 static inline void flounder_stub_ump_barrier(void)
 {
-#if defined(__i386__) || defined(__x86_64__)
-    /* the x86 memory model ensures ordering of stores, so all we need to do
-     * is prevent the compiler from reordering the instructions */
-    __asm volatile ("" : : : "memory");
-#else
-    /* use conservative GCC intrinsic */
-    __sync_synchronize();
-#endif
+    ump_impl_release_barrier();
+}
+
+/**
+ * Number of outgoing message slots that message fragments leave free. A cap
+ * ack is sent from the receive path, where it cannot wait for the peer to
+ * drain the ring, so a slot must always be available for it. At most one cap
+ * ack is outstanding, as the peer waits for it before sending more caps.
+ */
+#define FL_UMP_CAP_ACK_SLOTS    1
+
+/// Get the next outgoing slot for a message fragment, or NULL if the ring is
+/// full (not counting the slot kept for a cap ack)
+static inline volatile struct ump_message *
+flounder_stub_ump_get_next(struct flounder_ump_state *s,
+                           struct ump_control *ctrl)
+{
+    if (ump_impl_free_slots(&s->chan.send_chan, 1 + FL_UMP_CAP_ACK_SLOTS)
+        <= FL_UMP_CAP_ACK_SLOTS) {
+        return NULL;
+    }
+    return ump_chan_get_next(&s->chan, ctrl);
+}
+
+/// Reserve up to 'n' outgoing slots for message fragments, leaving the slot
+/// kept for a cap ack free
+static inline size_t
+flounder_stub_ump_get_next_batch(struct flounder_ump_state *s,
+                                 volatile struct ump_message **msgs,
+                                 struct ump_control *ctrl, size_t n)
+{
+    size_t nfree = ump_impl_free_slots(&s->chan.send_chan,
+                                       n + FL_UMP_CAP_ACK_SLOTS);
+    if (nfree <= FL_UMP_CAP_ACK_SLOTS) {
+        return 0;
+    }
+    nfree -= FL_UMP_CAP_ACK_SLOTS;
+    return ump_chan_get_next_batch(&s->chan, msgs, ctrl, n < nfree ? n : nfree);
 }
 
 /// Send a cap ACK (message that we are ready to receive caps)
 static inline void flounder_stub_ump_send_cap_ack(struct flounder_ump_state *s)
 {
+    // message fragments always leave a slot free for this
+
     struct ump_control ctrl;
     volatile struct ump_message *msg = ump_chan_get_next(&s->chan, &ctrl);
     assert(msg);
@@ -38,7 +38,15 @@ struct cte;
     /* The left child of a node must be earlier in the ordering*/\
     f(MDB_INVARIANT_LEFT_SMALLER) \
     /* The right child of a node must be later in the ordering*/\
-    f(MDB_INVARIANT_RIGHT_GREATER)
+    f(MDB_INVARIANT_RIGHT_GREATER) \
+    /* B-tree: nodes other than the root must be at least half full*/\
+    f(MDB_INVARIANT_NODE_FILL) \
+    /* B-tree: cached keys must match the ctes and first keys of children*/\
+    f(MDB_INVARIANT_NODE_KEY) \
+    /* B-tree: all leaves must be at the same depth*/\
+    f(MDB_INVARIANT_LEAF_DEPTH) \
+    /* B-tree: leaves must be linked in order*/\
+    f(MDB_INVARIANT_LEAF_LINKS)
 
 #define f_enum(x) x,
 enum mdb_invariant {
@@ -68,6 +76,16 @@ enum {
     MDB_RANGE_FOUND_PARTIAL = 3,
 };
 
+struct mdb_bnode;
+
+/// Node memory of the B-tree mapping database, kept in the KCB
+struct mdb_node_pool {
+    struct mdb_bnode *free;     ///< Free nodes
+    size_t free_count;          ///< Number of free nodes
+    lvaddr_t brk;               ///< Start of the unused part of the chunk
+    lvaddr_t limit;             ///< End of the current chunk
+};
+
 #if IN_KERNEL
 // kcb defined else-where
 struct kcb;
@@ -83,6 +101,14 @@ struct kcb {
 // ensures: mdb_check_invariants() && mdb_is_sane()
 errval_t mdb_init(struct kcb *k);
 
+// Give the mdb memory for its nodes. The memory must stay valid as long as
+// the tree exists.
+errval_t mdb_add_memory(lvaddr_t base, size_t bytes);
+// Number of nodes the mdb can still allocate, SIZE_MAX if it needs none
+size_t mdb_free_nodes(void);
+// Bytes of node memory a new tree should start with
+size_t mdb_boot_memory(void);
+
 // Print the specified subtree
 void mdb_dump(struct cte *cte, int indent);
 // Print the complete tree
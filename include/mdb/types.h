@@ -24,7 +24,7 @@ struct mdbnode {
     mdb_root_t end_root;
     mdb_level_t level;
     bool remote_copies:1, remote_ancs:1, remote_descs:1;
-    bool locked:1, in_delete:1;
+    bool locked:1, in_delete:1, pinned:1;
     coreid_t owner;
 };
 
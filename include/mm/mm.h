@@ -34,6 +34,9 @@ enum nodetype {
 struct mmnode {
     enum nodetype type;     ///< Type of this node
     uint8_t childbits;      ///< Number of children (in bits / power of two)
+    uint8_t sizebits;       ///< Size of this region (valid for Free regions)
+    genpaddr_t base;        ///< Base of this region (valid for Free regions)
+    struct mmnode *free_next, *free_prev; ///< Free list of this size
     struct capref cap;    ///< Cap to this region (invalid for Dummy regions)
     struct mmnode *children[0];///< Child node pointers
 };
@@ -42,6 +45,9 @@ struct mmnode {
 #define MM_NODE_SIZE(maxchildbits) \
     (sizeof(struct mmnode) + sizeof(struct mmnode *) * (1UL << (maxchildbits)))
 
+/// Number of free lists, one per power-of-two region size
+#define MM_FREE_LISTS   64
+
 /**
  * \brief Memory manager instance data
  *
@@ -59,6 +65,8 @@ struct mm {
     uint8_t sizebits;            ///< Size of root node (in bits)
     uint8_t maxchildbits;        ///< Maximum number of children of every node (in bits)
     bool delete_chunked;         ///< Delete chunked capabilities if true
+    bool smallest_fit;           ///< mm_alloc() uses the free lists if true
+    struct mmnode *free_lists[MM_FREE_LISTS]; ///< Free nodes, by size in bits
 };
 
 void mm_debug_print(struct mmnode *mmnode, int space);
@@ -68,6 +76,7 @@ errval_t mm_init(struct mm *mm, enum objtype objtype, genpaddr_t base,
                  slot_alloc_t slot_alloc_func, slot_refill_t slot_refill_func,
                  void *slot_alloc_inst, bool delete_chunked);
 void mm_destroy(struct mm *mm);
+void mm_set_smallest_fit(struct mm *mm, bool smallest_fit);
 errval_t mm_add(struct mm *mm, struct capref cap, uint8_t sizebits,
                 genpaddr_t base);
 errval_t mm_add_multi(struct mm *mm, struct capref cap, gensize_t size,
@@ -33,6 +33,7 @@ errval_t oct_parse_names(char* input, char*** names, size_t*);
 void oct_free_names(char**, size_t);
 
 errval_t oct_get(char**, const char*, ...);
+errval_t oct_get_records(char**, char* const*, size_t);
 errval_t oct_set(const char*, ...);
 errval_t oct_get_with_idcap(char**, struct capref);
 errval_t oct_set_with_idcap(struct capref, const char*, ...);
@@ -32,5 +32,6 @@ struct octopus_binding;
 
 struct octopus_thc_client_binding_t* oct_get_thc_client(void);
 struct octopus_binding* oct_get_event_binding(void);
+errval_t oct_get_pipeline_binding(struct octopus_binding**);
 
 #endif /* OCTOPUS_INIT_H_ */
@@ -53,6 +53,9 @@ struct oct_reply_state {
     struct capref cap;
     char* retkey;
 
+    // Token of the call, for replies sent after the handler returned
+    uint32_t token;
+
     struct oct_reply_state *next;
 };
 
@@ -72,26 +72,18 @@
 
 #define TRACE_EVENT(s,e,a) ((uint64_t)(s)<<48|(uint64_t)(e)<<32|(a))
 
-/* XXX: this is a temp kludge. The tracing code wants to allocate a fixed buffer
- * for every possible core ID, but this is now too large for sanity, so I've
- * limited it here. -AB 20111229
- */
-
 struct trace_buffer;
 
-#define TRACE_COREID_LIMIT        32
 #define TRACE_EVENT_SIZE          16
-#define TRACE_MAX_EVENTS          20000        // max number of events
+#define TRACE_SLOT_SIZE           (TRACE_EVENT_SIZE + sizeof(uintptr_t))
+#define TRACE_DEFAULT_RING_EVENTS 32768        // default events per ring
 #define TRACE_MAX_APPLICATIONS    128
-//#define TRACE_PERCORE_BUF_SIZE    0x1ff00
-#define TRACE_PERCORE_BUF_SIZE    (TRACE_EVENT_SIZE * TRACE_MAX_EVENTS + (sizeof (struct trace_buffer)))
-
-#define TRACE_BUF_SIZE (TRACE_COREID_LIMIT*TRACE_PERCORE_BUF_SIZE)    // Size of all trace buffers
-
-// Size of the array storing which subsystems are enabled
-#define TRACE_SUBSYS_ENABLED_BUF_SIZE (TRACE_NUM_SUBSYSTEMS * sizeof(bool))
+#define TRACE_ALIGN               64           // alignment of arena allocations
 
-#define TRACE_ALLOC_SIZE (TRACE_BUF_SIZE + TRACE_SUBSYS_ENABLED_BUF_SIZE)
+// Default size of the trace buffer shared by all cores, holding the per-core
+// state and the trace rings of all dispatchers and kernels. With the default
+// ring size, it fits about 85 rings; init's trace_size= argument sets it.
+#define TRACE_ALLOC_SIZE          (64UL << 20)
 
 #define TRACE_MAX_BOOT_APPLICATIONS 16
 
@@ -142,6 +134,12 @@ static inline bool trace_cas(volatile uintptr_t *address, uintptr_t old,
     return res;
 }
 
+/// Order the store of an event before the store of its commit word. Stores
+/// are not reordered on x86, so keeping the compiler from it is enough.
+static inline void trace_wmb(void)
+{
+    __asm volatile("" ::: "memory");
+}
 
 #elif defined(__i386__) || defined(__arm__) || defined(__aarch64__)
 
@@ -151,6 +149,11 @@ static inline bool trace_cas(volatile uintptr_t *address, uintptr_t old,
     return false;
 }
 
+static inline void trace_wmb(void)
+{
+    __sync_synchronize();
+}
+
 #define TRACE_TIMESTAMP() 0
 
 #else
@@ -184,31 +187,161 @@ struct trace_application {
     uint64_t dcb; ///< DCB address of the application
 };
 
-/// Trace buffer
-struct trace_buffer {
-    volatile uintptr_t head_index;
-    volatile uintptr_t tail_index;
+/// What to do with new events when a trace ring is full
+enum trace_overflow {
+    TRACE_OVERFLOW_STOP,        ///< Drop the new event
+    TRACE_OVERFLOW_OVERWRITE,   ///< Overwrite the oldest event
+};
 
+/**
+ * \brief Trace ring of one dispatcher, or of the kernel on one core
+ *
+ * head and tail count the events written and consumed so far; slot i is
+ * events[i % size]. Only the owner of the ring writes head, only the reader
+ * writes tail.
+ *
+ * A writer claims slot i by moving head before it writes the event, and
+ * then sets the commit word of the slot, which follows the events (see
+ * trace_ring_commits), to i + 1. Readers stop at the first slot whose
+ * commit word is older, as its event is still being written.
+ */
+struct trace_ring {
+    volatile uintptr_t head;          // Events written so far
+    volatile uintptr_t tail;          // Events consumed so far
+    volatile uintptr_t dropped;       // Events lost because the ring was full
+    uintptr_t          size;          // Number of slots, a power of two
+    uintptr_t          next;          // Offset of the next ring on the core
+    uint8_t            overflow;      // enum trace_overflow
+    volatile uint8_t   unused;        // Dispatcher exited, ring may be reused
+    char               name[8];       // Name of the dispatcher
+
+    struct trace_event events[];
+    // followed by uintptr_t commits[size]
+};
+
+/// Bytes of a trace ring with the given number of slots
+#define TRACE_RING_BYTES(events) \
+    (sizeof(struct trace_ring) + (events) * TRACE_SLOT_SIZE)
+
+/// Commit words of the slots of a ring, following its events
+static inline volatile uintptr_t *trace_ring_commits(struct trace_ring *ring,
+                                                     uintptr_t size)
+{
+    return (volatile uintptr_t *)&ring->events[size];
+}
+
+/// Per-core trace state, allocated on first use of tracing on the core
+struct trace_core {
+    uintptr_t          next;          // Offset of the next core, 0 if last
+    coreid_t           core_id;
+    int64_t            t_offset;      // Time offset relative to core 0
+
+    // ... configuration of new rings, set by trace_setup_on_core ...
+    uintptr_t          ring_events;
+    uint8_t            overflow;
+
+    uintptr_t          kernel_ring;   // Offset of the kernel's ring, 0 if none
+    volatile uintptr_t rings;         // Offset of the first dispatcher ring
+
+    // ... applications ...
+    volatile uintptr_t num_applications;
+    struct trace_application applications[TRACE_MAX_APPLICATIONS];
+};
+
+/**
+ * \brief Trace buffer shared by all cores
+ *
+ * This control structure is at the start of the trace frame. The rest of
+ * the frame is an arena from which the per-core state and the trace rings
+ * are allocated. As every domain maps the frame at a different address,
+ * links within it are offsets from the start of the frame.
+ */
+struct trace_buffer {
     // ... flags...
-    struct trace_buffer *master;       // Pointer to the trace master
     volatile bool     running;
     volatile bool     autoflush;       // Are we flushing automatically?
     volatile uint64_t start_trigger;
     volatile uint64_t stop_trigger;
     volatile uint64_t stop_time;
-    int64_t           t_offset;           // Time offset relative to core 0
     uint64_t          t0;              // Start time of trace
     uint64_t          duration;        // Max trace duration
     uint64_t          event_counter;        // Max number of events in trace
 
-    // ... events ...
-    struct trace_event events[TRACE_MAX_EVENTS];
+    // ... arena ...
+    uintptr_t          size;           // Size of the trace frame
+    volatile uintptr_t used;           // Bytes allocated from the frame
+    volatile uintptr_t cores;          // Offset of the first core, 0 if none
 
-    // ... applications ...
-    volatile uint8_t num_applications;
-    struct trace_application applications[TRACE_MAX_APPLICATIONS];
+    // Which subsystems are enabled
+    bool subsys_enabled[TRACE_NUM_SUBSYSTEMS];
 };
 
+/// Convert an offset in the trace buffer to a pointer
+static inline void *trace_offset_to_ptr(struct trace_buffer *master,
+                                        uintptr_t offset)
+{
+    return offset == 0 ? NULL : (uint8_t *)master + offset;
+}
+
+/// Iterate over the rings of a core, the kernel's ring first
+static inline struct trace_ring *trace_next_ring(struct trace_buffer *master,
+                                                 struct trace_core *core,
+                                                 struct trace_ring *prev)
+{
+    struct trace_ring *kernel = trace_offset_to_ptr(master, core->kernel_ring);
+    if (prev == NULL && kernel != NULL) {
+        return kernel;
+    } else if (prev == NULL || prev == kernel) {
+        return trace_offset_to_ptr(master, core->rings);
+    } else {
+        return trace_offset_to_ptr(master, prev->next);
+    }
+}
+
+/// First event of a ring that was neither consumed nor overwritten
+static inline uintptr_t trace_ring_first(struct trace_ring *ring,
+                                         uintptr_t head)
+{
+    uintptr_t tail = ring->tail;
+    if (head - tail > ring->size) {
+        return head - ring->size;
+    }
+    return tail;
+}
+
+/**
+ * \brief End of the events from pos on that are completely written
+ *
+ * Returns the first position before head whose slot was claimed but not yet
+ * written, or head. Events before it may be read after this returns.
+ */
+static inline uintptr_t trace_ring_committed(struct trace_ring *ring,
+                                             uintptr_t pos, uintptr_t head)
+{
+    uintptr_t size = ring->size;
+    volatile uintptr_t *commits = trace_ring_commits(ring, size);
+    for (; pos != head; pos++) {
+        // An unwritten slot still holds the commit word of an older lap,
+        // an overwritten one that of a newer lap
+        if ((intptr_t)(commits[pos & (size - 1)] - (pos + 1)) < 0) {
+            break;
+        }
+    }
+    __sync_synchronize();
+    return pos;
+}
+
+/// Find the trace state of a core, or NULL if tracing is not set up there
+static inline struct trace_core *trace_get_core(struct trace_buffer *master,
+                                                coreid_t core_id)
+{
+    struct trace_core *core = trace_offset_to_ptr(master, master->cores);
+    while (core != NULL && core->core_id != core_id) {
+        core = trace_offset_to_ptr(master, core->next);
+    }
+    return core;
+}
+
 typedef errval_t (* trace_conditional_termination_t)(bool forced);
 
 static __attribute__((unused)) trace_conditional_termination_t
@@ -217,14 +350,19 @@ static __attribute__((unused)) trace_conditional_termination_t
 #ifndef IN_KERNEL
 
 extern lvaddr_t trace_buffer_master;
-extern lvaddr_t trace_buffer_va;
 struct cnoderef;
 
-errval_t trace_init(void);
+errval_t trace_init(size_t bytes);
 errval_t trace_disable_domain(void);
 void trace_reset_buffer(void);
 void trace_reset_all(void);
-errval_t trace_setup_on_core(struct capref *retcap);
+errval_t trace_setup_on_core(struct capref *retcap, size_t ring_events,
+                             enum trace_overflow overflow);
+errval_t trace_core_setup(coreid_t core_id, struct trace_core **retcore);
+errval_t trace_core_configure(struct trace_core *core, size_t ring_events,
+                              enum trace_overflow overflow);
+errval_t trace_disp_setup(void);
+void trace_disp_release(void);
 errval_t trace_setup_child(struct cnoderef taskcn,
                            dispatcher_handle_t handle);
 errval_t trace_control(uint64_t start_trigger,
@@ -234,8 +372,10 @@ errval_t trace_control_fixed_events_counter(uint64_t start_trigger,
                        uint64_t stop_trigger,
                        uint64_t duration,
                        uint64_t event_counter);
+errval_t trace_start(void);
 errval_t trace_wait(void);
 size_t trace_get_event_count(coreid_t specified_core);
+size_t trace_get_dropped_count(coreid_t specified_core);
 errval_t trace_conditional_termination(bool forced);
 size_t trace_dump(char *buf, size_t buflen, int *number_of_events);
 size_t trace_dump_core(char *buf, size_t buflen, size_t *usedBytes,
@@ -245,30 +385,21 @@ void trace_flush(struct event_closure callback);
 void trace_set_autoflush(bool enabled);
 errval_t trace_prepare(struct event_closure callback);
 errval_t trace_my_setup(void);
+errval_t trace_map_buffer(void);
 
 errval_t trace_set_subsys_enabled(uint16_t subsys, bool enabled);
 errval_t trace_set_all_subsys_enabled(bool enabled);
 
+/// Callback to write out a chunk of the binary trace stream
+typedef errval_t (*trace_stream_write_fn_t)(void *arg, const uint8_t *buf,
+                                            size_t len);
+struct trace_stream;
 
+errval_t trace_stream_create(trace_stream_write_fn_t write, void *arg,
+                             struct trace_stream **retstream);
+errval_t trace_stream_drain(struct trace_stream *stream, size_t *retevents);
+void trace_stream_destroy(struct trace_stream *stream);
 
-/**
- * \brief Compute fixed trace buffer address according to
- * given core_id
- *
- * Each core gets its own top-level page table entry, so to use a
- * fixed address need to compute it as an offset from core id.
- *
- * Once we've computed this for a domain, we store it in
- * the dispatcher.
- *
- */
-static inline lvaddr_t compute_trace_buf_addr(uint8_t core_id)
-{
-    assert(core_id < TRACE_COREID_LIMIT);
-    lvaddr_t addr = trace_buffer_master + (core_id * TRACE_PERCORE_BUF_SIZE);
-
-    return addr;
-}
 
 
 static inline void set_cond_termination(trace_conditional_termination_t f_ptr)
@@ -280,38 +411,59 @@ static inline void set_cond_termination(trace_conditional_termination_t f_ptr)
 
 void trace_init_disp(void);
 
+/// Count an event that was lost because a ring was full
+static inline void trace_ring_count_drop(struct trace_ring *ring)
+{
+    uintptr_t d;
+    do {
+        d = ring->dropped;
+    } while (!trace_cas(&ring->dropped, d, d + 1));
+}
+
 /**
- * \brief Reserve a slot in the trace buffer and write the event.
+ * \brief Reserve a slot in a trace ring of the given size and write the event.
  *
- * Returns the slot index that was written.
- * Lock-free implementation.
+ * Returns false if the event was dropped because the ring was full.
+ * Lock-free implementation: all writers of a ring are on the same core.
  *
+ * The size is passed by the caller, so that a writer that does not trust the
+ * ring (the kernel) can use a size it checked against the trace buffer.
  */
-static inline uintptr_t
-trace_reserve_and_fill_slot(struct trace_event *ev,
-                            struct trace_buffer *buf)
+static inline bool trace_ring_write_size(struct trace_ring *ring,
+                                         uintptr_t size,
+                                         struct trace_event *ev)
 {
-    uintptr_t i, nw;
-    struct trace_event *slot;
+    uintptr_t i;
 
     do {
-        i = buf->head_index;
+        i = ring->head;
 
-        if (buf->tail_index - buf->head_index == 1 ||
-                (buf->tail_index == 0 && (buf->head_index == TRACE_MAX_EVENTS-1))) {
-            // Buffer is full, overwrite last event
-            break;
+        if (i - ring->tail >= size &&
+                ring->overflow == TRACE_OVERFLOW_STOP) {
+            trace_ring_count_drop(ring);
+            return false;
         }
 
-        nw = (i + 1) % TRACE_MAX_EVENTS;
+    } while (!trace_cas(&ring->head, i, i + 1));
 
-    } while (!trace_cas(&buf->head_index, i, nw));
+    if (i - ring->tail >= size) {
+        // Overwriting the oldest event, which was not consumed
+        trace_ring_count_drop(ring);
+    }
 
-    // Write the event
-    slot = &buf->events[i];
-    *slot = *ev;
+    // Write the event, then publish it to readers
+    ring->events[i & (size - 1)] = *ev;
+    trace_wmb();
+    trace_ring_commits(ring, size)[i & (size - 1)] = i + 1;
 
-    return i;
+    return true;
+}
+
+/// Reserve a slot in a trace ring and write the event
+static inline bool trace_ring_write(struct trace_ring *ring,
+                                    struct trace_event *ev)
+{
+    return trace_ring_write_size(ring, ring->size, ev);
 }
 
 /**
@@ -345,13 +497,74 @@ static inline coreid_t get_my_core_id(void)
     return my_core_id;
 }
 
+/**
+ * \brief Check that bytes at offset lie in the arena of the trace buffer
+ *
+ * The trace buffer is writable by user space, so the kernel checks every
+ * offset it follows.
+ */
+static inline bool trace_kernel_in_buf(uintptr_t offset, size_t bytes)
+{
+    return offset >= sizeof(struct trace_buffer) &&
+           offset <= kernel_trace_size &&
+           bytes <= kernel_trace_size - offset;
+}
+
+/**
+ * \brief Point the kernel at the trace buffer
+ *
+ * The monitor has set up the state of this core, including the kernel's
+ * ring, with trace_setup_on_core before handing the buffer to the kernel.
+ */
+static inline errval_t trace_setup_kernel(lvaddr_t buf, size_t size)
+{
+    kernel_trace_buf = 0;
+    kernel_trace_core = 0;
+    if (size < sizeof(struct trace_buffer)) {
+        return TRACE_ERR_NO_BUFFER;
+    }
+    kernel_trace_size = size;
+
+    // Find this core, without following a link out of the buffer or around
+    // a cycle
+    struct trace_buffer *master = (struct trace_buffer *)buf;
+    uintptr_t offset = master->cores;
+    for (size_t n = 0; n < size / sizeof(struct trace_core); n++) {
+        if (!trace_kernel_in_buf(offset, sizeof(struct trace_core))) {
+            break;
+        }
+        struct trace_core *core = trace_offset_to_ptr(master, offset);
+        if (core->core_id == my_core_id) {
+            kernel_trace_core = (lvaddr_t)core;
+            break;
+        }
+        offset = core->next;
+    }
+
+    kernel_trace_buf = buf;
+    return SYS_ERR_OK;
+}
+
 // Kernel-version: uses the global trace buffer variable
 static inline errval_t trace_write_event(struct trace_event *ev)
 {
 #ifdef TRACING_EXISTS
     struct trace_buffer *master = (struct trace_buffer *)kernel_trace_buf;
+    struct trace_core *core = (struct trace_core *)kernel_trace_core;
 
-    if (kernel_trace_buf == 0 || my_core_id >= TRACE_COREID_LIMIT) {
+    if (kernel_trace_buf == 0 || core == NULL) {
+        return TRACE_ERR_NO_BUFFER;
+    }
+
+    // The ring must lie in the buffer, whatever user space wrote there
+    uintptr_t offset = core->kernel_ring;
+    if (!trace_kernel_in_buf(offset, sizeof(struct trace_ring))) {
+        return TRACE_ERR_NO_BUFFER;
+    }
+    struct trace_ring *ring = trace_offset_to_ptr(master, offset);
+    uintptr_t size = ring->size;
+    if (size == 0 || size > (kernel_trace_size - offset -
+                             sizeof(struct trace_ring)) / TRACE_SLOT_SIZE) {
         return TRACE_ERR_NO_BUFFER;
     }
 
@@ -366,9 +579,7 @@ static inline errval_t trace_write_event(struct trace_event *ev)
             return SYS_ERR_OK;
         }
     }
-    struct trace_buffer *trace_buf = (struct trace_buffer*) (kernel_trace_buf
-            + my_core_id * TRACE_PERCORE_BUF_SIZE);
-    (void) trace_reserve_and_fill_slot(ev, trace_buf);
+    (void) trace_ring_write_size(ring, size, ev);
 
     if (ev->u.raw == master->stop_trigger ||
             (ev->timestamp>>63 == 0 &&  // Not a DCB event
@@ -385,28 +596,38 @@ static inline errval_t trace_write_event(struct trace_event *ev)
 static inline errval_t trace_new_application(char *new_application_name, uintptr_t dcb)
 {
 #ifdef TRACING_EXISTS
+    struct trace_core *core = (struct trace_core *)kernel_trace_core;
 
-    if (kernel_trace_buf == 0 || my_core_id >= TRACE_COREID_LIMIT) {
+    if (kernel_trace_buf == 0 || core == NULL) {
         return TRACE_ERR_NO_BUFFER;
     }
 
-    struct trace_buffer *trace_buf = (struct trace_buffer*) (kernel_trace_buf
-            + my_core_id * TRACE_PERCORE_BUF_SIZE);
+    // The counter is writable by user space, so check it, and the slot it
+    // selects, against the buffer before writing
+    uintptr_t offset = kernel_trace_core - kernel_trace_buf;
+    if (!trace_kernel_in_buf(offset, sizeof(struct trace_core))) {
+        return TRACE_ERR_NO_BUFFER;
+    }
 
-    int i;
-    int new_value;
+    uintptr_t i;
+    uintptr_t new_value;
     do {
-        i = trace_buf->num_applications;
+        i = core->num_applications;
 
-        if (i == TRACE_MAX_APPLICATIONS)
-            return -1; // TODO error code
+        if (i >= TRACE_MAX_APPLICATIONS) {
+            return TRACE_ERR_BUF_FULL;
+        }
 
         new_value = i + 1;
 
-    } while (!trace_cas((uintptr_t*)&trace_buf->num_applications, i, new_value));
+    } while (!trace_cas(&core->num_applications, i, new_value));
 
-    trace_buf->applications[i].dcb = (uint64_t) dcb;
-    memcpy(&trace_buf->applications[i].name, new_application_name, 8);
+    struct trace_application *app = &core->applications[i];
+    if (!trace_kernel_in_buf((lvaddr_t)app - kernel_trace_buf, sizeof(*app))) {
+        return TRACE_ERR_NO_BUFFER;
+    }
+    app->dcb = (uint64_t) dcb;
+    memcpy(&app->name, new_application_name, 8);
 
 #endif // TRACING_EXISTS
     return SYS_ERR_OK;
@@ -461,16 +682,20 @@ static inline errval_t trace_write_event(struct trace_event *ev)
         return TRACE_ERR_NO_BUFFER;
     }
 
-    struct trace_buffer *trace_buf = disp->trace_buf;
-
-    if (trace_buf == NULL) {
+    struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
+    if (master == NULL || disp->trace_disabled) {
         return TRACE_ERR_NO_BUFFER;
     }
 
-    struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
-    //struct trace_buffer *master = trace_buf->master;
-    if (master == NULL) {
-        return TRACE_ERR_NO_BUFFER;
+    // Dispatchers get their ring on their first event, so that those which
+    // never trace take no space in the buffer
+    struct trace_ring *ring = disp->trace_ring;
+    if (ring == NULL) {
+        errval_t err = trace_disp_setup();
+        if (err_is_fail(err)) {
+            return err;
+        }
+        ring = disp->trace_ring;
     }
 
     if (!master->running) {
@@ -483,14 +708,14 @@ static inline errval_t trace_write_event(struct trace_event *ev)
             master->running = true;
 
             // Make sure the trigger event is first in the buffer
-            (void) trace_reserve_and_fill_slot(ev, trace_buf);
+            (void) trace_ring_write(ring, ev);
             return SYS_ERR_OK;
 
         } else {
             return SYS_ERR_OK;
         }
     }
-    (void) trace_reserve_and_fill_slot(ev, trace_buf);
+    (void) trace_ring_write(ring, ev);
 
     if (ev->u.raw == master->stop_trigger ||
             ev->timestamp > master->stop_time) {
@@ -540,21 +765,19 @@ static inline bool trace_is_subsys_enabled(uint16_t subsys)
 #ifdef CONFIG_TRACE
     assert(subsys < TRACE_NUM_SUBSYSTEMS);
 
-    uint8_t* base_pointer;
+    struct trace_buffer *master;
 #ifdef IN_KERNEL
-    base_pointer = (uint8_t*) kernel_trace_buf;
+    master = (struct trace_buffer *) kernel_trace_buf;
 #else // !IN_KERNEL
-    base_pointer = (uint8_t*) trace_buffer_master;
+    master = (struct trace_buffer *) trace_buffer_master;
 #endif // !IN_KERNEL
 
-    if (base_pointer == NULL) {
+    if (master == NULL) {
         // The trace buffer is not even mapped.
         return false;
     }
 
-    bool* subsystem_states = (bool*) (base_pointer + TRACE_BUF_SIZE);
-
-    return subsystem_states[subsys];
+    return master->subsys_enabled[subsys];
 #else // !CONFIG_TRACE
     return false;
 #endif // !CONFIG_TRACE
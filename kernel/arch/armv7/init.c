@@ -68,6 +68,7 @@ static struct cmdarg cmdargs[] = {
     { "loglevel",    ArgType_Int,  { .integer  = &kernel_loglevel }},
     { "logmask",     ArgType_Int,  { .integer  = &kernel_log_subsystem_mask }},
     { "timeslice",   ArgType_UInt,  { .uinteger = &config_timeslice }},
+    { "wakeup_slack", ArgType_UInt, { .uinteger = &config_wakeup_slack }},
     { "periphclk",   ArgType_UInt, { .uinteger = &periphclk }},
     { "periphbase",  ArgType_UInt, { .uinteger = &periphbase }},
     { "timerirq"  ,  ArgType_UInt, { .uinteger = &timerirq }},
@@ -90,11 +90,13 @@ handle_dispatcher_properties(
 
     struct registers_arm_syscall_args* sa = &context->syscall_args;
 
-    enum task_type type = (enum task_type)(sa->arg3 >> 16);
+    bool gang = sa->arg3 >> 24;
+    enum task_type type = (enum task_type)((sa->arg3 >> 16) & 0xff);
     uint16_t weight = sa->arg3 & 0xffff;
 
     return sys_dispatcher_properties(to, type, sa->arg4,
-                                     sa->arg5, sa->arg6, sa->arg7, weight);
+                                     sa->arg5, sa->arg6, sa->arg7, weight,
+                                     gang);
 }
 
 static struct sysret
@@ -476,14 +478,15 @@ INVOCATION_HANDLER(monitor_handle_delete_foreigns)
 
 INVOCATION_HANDLER(monitor_handle_revoke_mark_tgt)
 {
-    INVOCATION_PRELUDE(6);
+    INVOCATION_PRELUDE(7);
     capaddr_t root_caddr   = sa->arg2;
     uint8_t root_level     = sa->arg3;
     capaddr_t target_caddr = sa->arg4;
     uint8_t target_level   = sa->arg5;
+    bool local_only        = sa->arg6;
 
     return sys_monitor_revoke_mark_tgt(root_caddr, root_level,
-                                       target_caddr, target_level);
+                                       target_caddr, target_level, local_only);
 }
 
 INVOCATION_HANDLER(monitor_handle_revoke_mark_rels)
@@ -500,22 +503,26 @@ INVOCATION_HANDLER(monitor_handle_revoke_mark_rels)
 
 INVOCATION_HANDLER(monitor_handle_delete_step)
 {
-    INVOCATION_PRELUDE(5);
+    INVOCATION_PRELUDE(6);
     capaddr_t ret_cn_addr  = sa->arg2;
     capaddr_t ret_cn_level = sa->arg3;
     capaddr_t ret_slot     = sa->arg4;
+    size_t max_steps       = sa->arg5;
 
-    return sys_monitor_delete_step(ret_cn_addr, ret_cn_level, ret_slot);
+    return sys_monitor_delete_step(ret_cn_addr, ret_cn_level, ret_slot,
+                                   max_steps);
 }
 
 INVOCATION_HANDLER(monitor_handle_clear_step)
 {
-    INVOCATION_PRELUDE(5);
+    INVOCATION_PRELUDE(6);
     capaddr_t ret_cn_addr  = sa->arg2;
     capaddr_t ret_cn_level = sa->arg3;
     capaddr_t ret_slot     = sa->arg4;
+    size_t max_steps       = sa->arg5;
 
-    return sys_monitor_clear_step(ret_cn_addr, ret_cn_level, ret_slot);
+    return sys_monitor_clear_step(ret_cn_addr, ret_cn_level, ret_slot,
+                                  max_steps);
 }
 
 
@@ -729,6 +736,22 @@ INVOCATION_HANDLER(monitor_reclaim_ram)
     return sys_monitor_reclaim_ram(ret_cn_addr, ret_cn_level, ret_slot);
 }
 
+INVOCATION_HANDLER(monitor_mdb_add_memory)
+{
+    INVOCATION_PRELUDE(4);
+    capaddr_t cptr  = sa->arg2;
+    uint8_t   level = sa->arg3;
+
+    return sys_monitor_mdb_add_memory(cptr, level);
+}
+
+INVOCATION_HANDLER(monitor_mdb_free_nodes)
+{
+    INVOCATION_PRELUDE(2);
+
+    return sys_monitor_mdb_free_nodes();
+}
+
 /**
  * \brief Spawn a new core and create a kernel cap for it.
  */
@@ -1137,6 +1160,8 @@ static invocation_t invocations[ObjType_Num][CAP_MAX_CMD] = {
         [KernelCmd_Unlock_cap]        = monitor_unlock_cap,
         [KernelCmd_Get_platform]      = monitor_get_platform,
         [KernelCmd_ReclaimRAM]        = monitor_reclaim_ram,
+        [KernelCmd_Mdb_add_memory]    = monitor_mdb_add_memory,
+        [KernelCmd_Mdb_free_nodes]    = monitor_mdb_free_nodes,
     },
     [ObjType_IPI] = {
         [IPICmd_Send_Start]  = monitor_spawn_core,
@@ -57,6 +57,7 @@ static struct cmdarg cmdargs[] = {
     {"logmask", ArgType_Int, { .integer = &kernel_log_subsystem_mask }},
     {"ticks", ArgType_Bool, { .boolean = &kernel_ticks_enabled }},
     {"timeslice", ArgType_UInt, { .uinteger = &config_timeslice }},
+    {"wakeup_slack", ArgType_UInt, { .uinteger = &config_wakeup_slack }},
     {"serial", ArgType_ULong, { .ulonginteger = &platform_uart_base[0] }},
     {NULL, 0, {NULL}}
 };
@@ -433,6 +433,7 @@ static struct cmdarg cmdargs[] = {
     {"logmask", ArgType_Int, { .integer = &kernel_log_subsystem_mask }},
     {"ticks", ArgType_Bool, { .boolean = &kernel_ticks_enabled }},
     {"timeslice", ArgType_UInt, { .uinteger = &config_timeslice }},
+    {"wakeup_slack", ArgType_UInt, { .uinteger = &config_wakeup_slack }},
     {"serial", ArgType_Int, { .integer = &serial_portbase }},
     {"bsp_coreid", ArgType_Int, { .integer = &bsp_coreid }},
     {NULL, 0, {NULL}}
@@ -56,7 +56,8 @@ static struct sysret handle_dispatcher_setup(struct capability *to,
 static struct sysret handle_dispatcher_properties(struct capability *to,
                                                   int cmd, uintptr_t *args)
 {
-    enum task_type type = args[0] >> 16;
+    bool gang = args[0] >> 24;
+    enum task_type type = (args[0] >> 16) & 0xff;
     unsigned short weight = args[0] & 0xffff;
     unsigned long deadline = args[1];
     unsigned long wcet = args[2];
@@ -64,7 +65,7 @@ static struct sysret handle_dispatcher_properties(struct capability *to,
     unsigned long release = args[4];
 
     return sys_dispatcher_properties(to, type, deadline, wcet, period,
-                                     release, weight);
+                                     release, weight, gang);
 }
 
 // XXX: FIXME: cleanup and handle errors!
@@ -339,9 +340,10 @@ static struct sysret monitor_handle_revoke_mark_tgt(struct capability *kernel_ca
     uint8_t root_vbits = args[1];
     capaddr_t target_caddr = args[2];
     uint8_t target_vbits = args[3];
+    bool local_only = args[4];
 
     return sys_monitor_revoke_mark_tgt(root_caddr, root_vbits,
-                                       target_caddr, target_vbits);
+                                       target_caddr, target_vbits, local_only);
 }
 
 static struct sysret monitor_handle_revoke_mark_rels(struct capability *kernel_cap,
@@ -362,7 +364,9 @@ static struct sysret monitor_handle_delete_step(struct capability *kernel_cap,
     capaddr_t ret_cn_addr = args[0];
     capaddr_t ret_cn_bits = args[1];
     capaddr_t ret_slot = args[2];
-    return sys_monitor_delete_step(ret_cn_addr, ret_cn_bits, ret_slot);
+    size_t max_steps = args[3];
+    return sys_monitor_delete_step(ret_cn_addr, ret_cn_bits, ret_slot,
+                                   max_steps);
 }
 
 static struct sysret monitor_handle_clear_step(struct capability *kernel_cap,
@@ -371,7 +375,9 @@ static struct sysret monitor_handle_clear_step(struct capability *kernel_cap,
     capaddr_t ret_cn_addr = args[0];
     capaddr_t ret_cn_bits = args[1];
     capaddr_t ret_slot = args[2];
-    return sys_monitor_clear_step(ret_cn_addr, ret_cn_bits, ret_slot);
+    size_t max_steps = args[3];
+    return sys_monitor_clear_step(ret_cn_addr, ret_cn_bits, ret_slot,
+                                  max_steps);
 }
 
 
@@ -618,8 +624,15 @@ static struct sysret handle_trace_setup(struct capability *cap,
         return SYSRET(err);
     }
 
+    if (frame->type != ObjType_Frame) {
+        return SYSRET(SYS_ERR_INVALID_SOURCE_TYPE);
+    }
+
     lpaddr_t lpaddr = gen_phys_to_local_phys(frame->u.frame.base);
-    kernel_trace_buf = local_phys_to_mem(lpaddr);
+    err = trace_setup_kernel(local_phys_to_mem(lpaddr), frame->u.frame.bytes);
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
     //printf("kernel.%u: handle_trace_setup at %lx\n", apic_id, kernel_trace_buf);
 
     // Copy boot applications.
@@ -24,6 +24,7 @@
 #include <paging_generic.h>
 #include <exec.h>
 #include <systime.h>
+#include <wakeup.h>
 #include <arch/x86/x86.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/global.h>
@@ -36,6 +37,8 @@
 #include <barrelfish_kpi/lmp.h>
 #include <barrelfish_kpi/dispatcher_shared_target.h>
 #include <barrelfish_kpi/platform.h>
+#include <barrelfish_kpi/vnode_batch.h>
+#include <barrelfish_kpi/cnode_batch.h>
 #include <trace/trace.h>
 #include <useraccess.h>
 #ifndef __k1om__
@@ -78,11 +81,12 @@ static struct sysret handle_dispatcher_properties(struct capability *to,
     unsigned long wcet = args[2];
     unsigned long period = args[3];
     unsigned long release = args[4];
-    unsigned short weight = args[5];
+    unsigned short weight = args[5] & 0xffff;
+    bool gang = args[5] >> 16;
 
     TRACE(KERNEL, SC_DISP_PROPS, 0);
     struct sysret sr = sys_dispatcher_properties(to, type, deadline, wcet, period,
-                                                 release, weight);
+                                                 release, weight, gang);
     TRACE(KERNEL, SC_DISP_PROPS, 1);
     return sr;
 }
@@ -310,6 +314,239 @@ static struct sysret handle_mapping_modify(struct capability *mapping,
     };
 }
 
+/**
+ * \brief Look up a page table for a batched operation in the caller's cspace
+ */
+static errval_t lookup_batch_ptable(capaddr_t cptr, uint8_t level,
+                                    struct capability **ret)
+{
+    errval_t err = caps_lookup_cap(&dcb_current->cspace.cap, cptr, level, ret,
+                                   CAPRIGHTS_READ_WRITE);
+    if (err_is_fail(err)) {
+        return err_push(err, SYS_ERR_CAP_NOT_FOUND);
+    }
+    if (!type_is_vnode((*ret)->type)) {
+        return SYS_ERR_VNODE_TYPE;
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Copy a batch of operations supplied by user space into the kernel
+ *
+ * The whole array is checked and copied before the first operation runs. An
+ * operation may unmap or change the page holding the array, and reading the
+ * array from user space afterwards would fault in the kernel.
+ */
+static errval_t copy_batch(void *dst, lvaddr_t entries, size_t count,
+                           size_t entrysize, size_t max, errval_t size_err)
+{
+    if (count > max) {
+        return size_err;
+    }
+    if (!access_ok(ACCESS_READ, entries, count * entrysize)) {
+        return SYS_ERR_INVALID_USER_BUFFER;
+    }
+    memcpy(dst, (void *)entries, count * entrysize);
+    return SYS_ERR_OK;
+}
+
+/*
+ * Batched page table operations. These take an array of operations in the
+ * caller's address space, see barrelfish_kpi/vnode_batch.h. They are invoked
+ * on a root page table only to reach the kernel; every page table and mapping
+ * cap is looked up in the caller's cspace, like the unbatched invocations on
+ * those caps. The array is copied into the kernel first.
+ *
+ * The operations are performed in order, and processing stops at the first
+ * one which fails. The operations before it stay performed, and the value
+ * returned is the index of the failing operation, i.e. the number of
+ * operations that succeeded.
+ */
+
+static struct sysret handle_map_batch(struct capability *to,
+                                      int cmd, uintptr_t *args)
+{
+    lvaddr_t entries = args[0];
+    size_t   count   = args[1];
+    struct vnode_map_batch_entry batch[VNODE_BATCH_MAX];
+
+    errval_t err = copy_batch(batch, entries, count, sizeof(batch[0]),
+                     VNODE_BATCH_MAX, SYS_ERR_VNODE_BATCH_SIZE);
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
+
+    TRACE(KERNEL, SC_MAP, 0);
+    size_t i;
+    for (i = 0; i < count; i++) {
+        struct vnode_map_batch_entry *e = &batch[i];
+
+        struct capability *ptable;
+        err = lookup_batch_ptable(e->ptable, e->ptable_level, &ptable);
+        if (err_is_fail(err)) {
+            break;
+        }
+        err = sys_map(ptable, e->slot, e->src_root, e->src, e->src_level,
+                      e->flags, e->offset, e->pte_count, e->mcn_root, e->mcn,
+                      e->mcn_level, e->mapping_slot).error;
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+    TRACE(KERNEL, SC_MAP, 1);
+
+    return (struct sysret) { .error = err, .value = i };
+}
+
+static struct sysret handle_unmap_batch(struct capability *to,
+                                        int cmd, uintptr_t *args)
+{
+    lvaddr_t entries = args[0];
+    size_t   count   = args[1];
+    struct vnode_unmap_batch_entry batch[VNODE_BATCH_MAX];
+
+    errval_t err = copy_batch(batch, entries, count, sizeof(batch[0]),
+                     VNODE_BATCH_MAX, SYS_ERR_VNODE_BATCH_SIZE);
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
+
+    TRACE(KERNEL, SC_UNMAP, 0);
+    size_t i;
+    for (i = 0; i < count; i++) {
+        struct vnode_unmap_batch_entry *e = &batch[i];
+
+        struct capability *pgtable;
+        err = lookup_batch_ptable(e->ptable, e->ptable_level, &pgtable);
+        if (err_is_fail(err)) {
+            break;
+        }
+        struct cte *mapping;
+        err = caps_lookup_slot(&dcb_current->cspace.cap, e->mapping,
+                               e->mapping_level, &mapping, CAPRIGHTS_READ_WRITE);
+        if (err_is_fail(err)) {
+            err = err_push(err, SYS_ERR_CAP_NOT_FOUND);
+            break;
+        }
+        err = page_mappings_unmap(pgtable, mapping);
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+    TRACE(KERNEL, SC_UNMAP, 1);
+
+    return (struct sysret) { .error = err, .value = i };
+}
+
+static struct sysret handle_modify_flags_batch(struct capability *to,
+                                               int cmd, uintptr_t *args)
+{
+    lvaddr_t entries = args[0];
+    size_t   count   = args[1];
+    struct vnode_modify_flags_batch_entry batch[VNODE_BATCH_MAX];
+
+    errval_t err = copy_batch(batch, entries, count, sizeof(batch[0]),
+                     VNODE_BATCH_MAX, SYS_ERR_VNODE_BATCH_SIZE);
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
+
+    size_t i;
+    for (i = 0; i < count; i++) {
+        struct vnode_modify_flags_batch_entry *e = &batch[i];
+
+        struct capability *mapping;
+        err = caps_lookup_cap(&dcb_current->cspace.cap, e->mapping,
+                              e->mapping_level, &mapping, CAPRIGHTS_READ_WRITE);
+        if (err_is_fail(err)) {
+            err = err_push(err, SYS_ERR_CAP_NOT_FOUND);
+            break;
+        }
+        if (!type_is_mapping(mapping->type)) {
+            err = SYS_ERR_WRONG_MAPPING;
+            break;
+        }
+        err = page_mappings_modify_flags(mapping, e->offset, e->pages,
+                                         e->flags, e->va_hint);
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+
+    return (struct sysret) { .error = err, .value = i };
+}
+
+/*
+ * Batched CNode operations. These are invoked on the caller's root CNode and
+ * take an array of operations in the caller's address space, see
+ * barrelfish_kpi/cnode_batch.h. As with the page table batches, the array is
+ * copied into the kernel first, processing stops at the first failing
+ * operation, and the value returned is the number of operations that
+ * succeeded.
+ */
+
+static struct sysret handle_retype_batch(struct capability *root,
+                                         int cmd, uintptr_t *args)
+{
+    lvaddr_t entries = args[0];
+    size_t   count   = args[1];
+    struct cnode_retype_batch_entry batch[CNODE_BATCH_MAX];
+
+    errval_t err = copy_batch(batch, entries, count, sizeof(batch[0]),
+                     CNODE_BATCH_MAX, SYS_ERR_CNODE_BATCH_SIZE);
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
+
+    TRACE(KERNEL, SC_RETYPE, 0);
+    size_t i;
+    for (i = 0; i < count; i++) {
+        struct cnode_retype_batch_entry *e = &batch[i];
+
+        err = sys_retype(root, e->src_root, e->src, e->offset, e->type,
+                         e->objsize, e->count, e->dest_root, e->dest_cnode,
+                         e->dest_level, e->dest_slot, false).error;
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+    TRACE(KERNEL, SC_RETYPE, 1);
+
+    return (struct sysret) { .error = err, .value = i };
+}
+
+static struct sysret handle_copy_batch(struct capability *root,
+                                       int cmd, uintptr_t *args)
+{
+    lvaddr_t entries = args[0];
+    size_t   count   = args[1];
+    struct cnode_copy_batch_entry batch[CNODE_BATCH_MAX];
+
+    errval_t err = copy_batch(batch, entries, count, sizeof(batch[0]),
+                     CNODE_BATCH_MAX, SYS_ERR_CNODE_BATCH_SIZE);
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
+
+    TRACE(KERNEL, SC_COPY_OR_MINT, 0);
+    size_t i;
+    for (i = 0; i < count; i++) {
+        struct cnode_copy_batch_entry *e = &batch[i];
+
+        err = sys_copy_or_mint(root, e->dest_root, e->dest_cnode,
+                               e->dest_slot, e->src_root, e->src,
+                               e->dest_level, e->src_level, 0, 0,
+                               false).error;
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+    TRACE(KERNEL, SC_COPY_OR_MINT, 1);
+
+    return (struct sysret) { .error = err, .value = i };
+}
+
 static struct sysret handle_vnode_copy_remap(struct capability *ptable,
                                              int cmd, uintptr_t *args)
 {
@@ -522,9 +759,10 @@ static struct sysret monitor_handle_revoke_mark_tgt(struct capability *kernel_ca
     uint8_t root_level     = args[1];
     capaddr_t target_caddr = args[2];
     uint8_t target_level   = args[3];
+    bool local_only        = args[4];
 
     return sys_monitor_revoke_mark_tgt(root_caddr, root_level,
-                                       target_caddr, target_level);
+                                       target_caddr, target_level, local_only);
 }
 
 static struct sysret monitor_handle_revoke_mark_rels(struct capability *kernel_cap,
@@ -541,8 +779,10 @@ static struct sysret monitor_handle_delete_step(struct capability *kernel_cap,
     capaddr_t ret_cn_addr  = args[0];
     capaddr_t ret_cn_level = args[1];
     capaddr_t ret_slot     = args[2];
+    size_t max_steps       = args[3];
 
-    return sys_monitor_delete_step(ret_cn_addr, ret_cn_level, ret_slot);
+    return sys_monitor_delete_step(ret_cn_addr, ret_cn_level, ret_slot,
+                                   max_steps);
 }
 
 static struct sysret monitor_handle_clear_step(struct capability *kernel_cap,
@@ -551,8 +791,10 @@ static struct sysret monitor_handle_clear_step(struct capability *kernel_cap,
     capaddr_t ret_cn_addr  = args[0];
     capaddr_t ret_cn_level = args[1];
     capaddr_t ret_slot     = args[2];
+    size_t max_steps       = args[3];
 
-    return sys_monitor_clear_step(ret_cn_addr, ret_cn_level, ret_slot);
+    return sys_monitor_clear_step(ret_cn_addr, ret_cn_level, ret_slot,
+                                  max_steps);
 }
 
 static struct sysret monitor_handle_register(struct capability *kernel_cap,
@@ -727,6 +969,20 @@ static struct sysret monitor_reclaim_ram(struct capability *kern_cap,
     return sys_monitor_reclaim_ram(retcn_addr, retcn_level, ret_slot);
 }
 
+static struct sysret monitor_mdb_add_memory(struct capability *kern_cap,
+                                            int cmd, uintptr_t *args)
+{
+    capaddr_t cptr = (capaddr_t)args[0];
+    uint8_t level  = (uint8_t)  args[1];
+    return sys_monitor_mdb_add_memory(cptr, level);
+}
+
+static struct sysret monitor_mdb_free_nodes(struct capability *kern_cap,
+                                            int cmd, uintptr_t *args)
+{
+    return sys_monitor_mdb_free_nodes();
+}
+
 static struct sysret handle_clean_dirty_bits(struct capability *to,
                                              int cmd, uintptr_t *args)
 {
@@ -1005,8 +1261,15 @@ static struct sysret handle_trace_setup(struct capability *cap,
         return SYSRET(err);
     }
 
+    if (frame->type != ObjType_Frame) {
+        return SYSRET(SYS_ERR_INVALID_SOURCE_TYPE);
+    }
+
     lpaddr_t lpaddr = gen_phys_to_local_phys(frame->u.frame.base);
-    kernel_trace_buf = local_phys_to_mem(lpaddr);
+    err = trace_setup_kernel(local_phys_to_mem(lpaddr), frame->u.frame.bytes);
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
     //printf("kernel.%u: handle_trace_setup at %lx\n", apic_id, kernel_trace_buf);
 
     // Copy boot applications.
@@ -1362,6 +1625,8 @@ static invocation_handler_t invocations[ObjType_Num][CAP_MAX_CMD] = {
         [CNodeCmd_GetSize] = handle_get_size,
         [CNodeCmd_Resize] = handle_resize,
         [CNodeCmd_CapIdentify] = handle_cap_identify,
+        [CNodeCmd_RetypeBatch] = handle_retype_batch,
+        [CNodeCmd_CopyBatch] = handle_copy_batch,
     },
     [ObjType_L2CNode] = {
         [CNodeCmd_Copy]   = handle_copy,
@@ -1395,6 +1660,9 @@ static invocation_handler_t invocations[ObjType_Num][CAP_MAX_CMD] = {
         [VNodeCmd_ModifyFlags] = handle_vnode_modify_flags,
         [VNodeCmd_CopyRemap] = handle_vnode_copy_remap,
         [VNodeCmd_Inherit] = handle_inherit,
+        [VNodeCmd_MapBatch] = handle_map_batch,
+        [VNodeCmd_UnmapBatch] = handle_unmap_batch,
+        [VNodeCmd_ModifyFlagsBatch] = handle_modify_flags_batch,
     },
     [ObjType_VNode_x86_64_pdpt] = {
         [VNodeCmd_Map]   = handle_map,
@@ -1506,6 +1774,8 @@ static invocation_handler_t invocations[ObjType_Num][CAP_MAX_CMD] = {
         [KernelCmd_Suspend_kcb_sched]   = kernel_suspend_kcb_sched,
         [KernelCmd_Get_platform] = monitor_get_platform,
         [KernelCmd_ReclaimRAM] = monitor_reclaim_ram,
+        [KernelCmd_Mdb_add_memory] = monitor_mdb_add_memory,
+        [KernelCmd_Mdb_free_nodes] = monitor_mdb_free_nodes,
     },
     [ObjType_IPI] = {
         [IPICmd_Send_Start] = kernel_send_start_ipi,
@@ -1839,6 +2109,10 @@ struct sysret sys_vmcall(uint64_t syscall, uint64_t arg0, uint64_t arg1,
             retval.error = debug_print_mdb_counters();
             break;
 
+        case DEBUG_GET_WAKEUP_STAT:
+            retval.error = wakeup_get_stat(arg1, &retval.value);
+            break;
+
         default:
             printk(LOG_ERR, "invalid sys_debug msg type\n");
         }
@@ -438,6 +438,11 @@ static void caps_mark_revoke_generic(struct cte *cte)
     if (distcap_is_in_delete(cte)) {
         return;
     }
+    if (cte->mdbnode.pinned) {
+        // holds memory of the mapping database, see
+        // sys_monitor_mdb_add_memory(); it stays until the KCB goes away
+        return;
+    }
 
     TRACE_CAP_MSG("marking for revoke", cte);
 
@@ -644,6 +649,51 @@ errval_t caps_mark_revoke(struct capability *base, struct cte *revoked)
     return SYS_ERR_OK;
 }
 
+static bool revoke_cte_is_local(struct cte *cte)
+{
+    return cte->mdbnode.owner == my_core_id
+        && !cte->mdbnode.locked
+        && !cte->mdbnode.remote_copies
+        && !cte->mdbnode.remote_descs;
+}
+
+/**
+ * \brief Check whether the copies and descendants of a capability on this
+ *        core are all owned here and have never been shared with another core.
+ * \param base The data for the capability being revoked
+ *
+ * If this holds for a locally owned capability, no other core can hold a copy
+ * or descendant of it, and a revoke does not need a cross core agreement.
+ */
+bool caps_revoke_is_local(struct capability *base)
+{
+    struct cte *first = mdb_find_greater(base, true), *next;
+    if (!first || !(is_copy(base, &first->cap)
+               || is_ancestor(&first->cap, base)))
+    {
+        return true;
+    }
+
+    for (next = mdb_predecessor(first);
+         next && is_copy(base, &next->cap);
+         next = mdb_predecessor(next))
+    {
+        if (!revoke_cte_is_local(next)) {
+            return false;
+        }
+    }
+    for (next = first;
+         next && (is_copy(base, &next->cap) || is_ancestor(&next->cap, base));
+         next = mdb_successor(next))
+    {
+        if (!revoke_cte_is_local(next)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 /*
  * Sweep phase
  */
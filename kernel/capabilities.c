@@ -1400,7 +1400,11 @@ errval_t caps_create_from_existing(struct capability *root, capaddr_t cnode_cptr
     dest->mdbnode.owner = owner;
 
     err = mdb_insert(dest);
-    assert(err_is_ok(err));
+    if (err_is_fail(err)) {
+        // the mdb has no nodes left, leave the slot empty
+        memset(dest, 0, sizeof(*dest));
+        return err;
+    }
 
     struct cte *neighbour = NULL;
     if (!neighbour
@@ -1900,7 +1904,18 @@ errval_t caps_retype(enum objtype type, gensize_t objsize, size_t count,
     TRACE(KERNEL_CAPOPS, RETYPE_MDB_INSERT, retype_seqnum);
     /* Handle mapping */
     for (size_t i = 0; i < count; i++) {
-        mdb_insert(&dest_cte[i]);
+        err = mdb_insert(&dest_cte[i]);
+        if (err_is_fail(err)) {
+            // the mdb has no nodes left, take out the caps inserted so far
+            // and clear all new slots
+            for (size_t j = 0; j < i; j++) {
+                errval_t err2 = mdb_remove(&dest_cte[j]);
+                assert(err_is_ok(err2));
+            }
+            memset(dest_cte, 0, count * sizeof(*dest_cte));
+            TRACE(KERNEL_CAPOPS, RETYPE_DONE, retype_seqnum);
+            return err;
+        }
     }
     TRACE(KERNEL_CAPOPS, RETYPE_MDB_INSERT_DONE, retype_seqnum);
 
@@ -2011,8 +2026,12 @@ errval_t caps_copy_to_cte(struct cte *dest_cte, struct cte *src_cte, bool mint,
         // Handle mapping here only for non-mint operations
         // (mint can change eq fields which would make the early insertion
         // invalid in some cases)
-        mdb_insert(dest_cte);
-        return SYS_ERR_OK;
+        err = mdb_insert(dest_cte);
+        if (err_is_fail(err)) {
+            // the mdb has no nodes left, leave the slot empty
+            memset(dest_cte, 0, sizeof(*dest_cte));
+        }
+        return err;
     }
     else {
         TRACE_CAP_MSG("minting to", dest_cte);
@@ -2062,9 +2081,13 @@ errval_t caps_copy_to_cte(struct cte *dest_cte, struct cte *src_cte, bool mint,
     }
 
     // Insert after doing minting operation
-    mdb_insert(dest_cte);
+    err = mdb_insert(dest_cte);
+    if (err_is_fail(err)) {
+        // the mdb has no nodes left, leave the slot empty
+        memset(dest_cte, 0, sizeof(*dest_cte));
+    }
 
-    return SYS_ERR_OK;
+    return err;
 }
 
 STATIC_ASSERT(68 == ObjType_Num, "Knowledge of all cap types");
@@ -63,9 +63,16 @@ void __attribute__ ((noreturn)) dispatch(struct dcb *dcb)
     // If we have nothing to do we should call something other than dispatch
     if (dcb == NULL) {
         dcb_current = NULL;
+#ifndef CONFIG_ONESHOT_TIMER
+        wakeup_idle_enter();
+#endif
         wait_for_interrupt();
     }
 
+#ifndef CONFIG_ONESHOT_TIMER
+    wakeup_idle_exit();
+#endif
+
     // Don't context switch if we are current already
     if (dcb_current != dcb) {
 
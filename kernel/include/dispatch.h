@@ -53,12 +53,17 @@ struct dcb {
 
     struct dcb          *next;          ///< Next DCB in schedule
     struct dcb          *prev;          ///< Previous DCB in schedule
-                                        /// (only valid iff CONFIG_SCHEDULER_RR)
 #if defined(CONFIG_SCHEDULER_RBED)
     systime_t          release_time, etime, last_dispatch;
     systime_t          wcet, period, deadline;
     unsigned short      weight;
     enum task_type      type;
+    /// Run queue tree links and cached subtree values
+    struct dcb          *rq_parent, *rq_left, *rq_right;
+    uint32_t            rq_prio;
+    systime_t           rq_min_release, rq_max_release, rq_max_deadline;
+    systime_t           rq_min_gang_release;
+    bool                gang;           ///< Gang scheduled (hard real-time only)
 #endif
 };
 
@@ -71,6 +76,13 @@ static inline const char *get_disp_name(struct dcb *dcb)
 
 void context_switch(struct dcb *dcb);
 
+#if defined(CONFIG_SCHEDULER_RBED)
+/// Whether 'dcb' can be scheduled with the given real-time properties
+bool scheduler_admissible(struct dcb *dcb, enum task_type type,
+                          systime_t deadline, systime_t wcet,
+                          systime_t period, systime_t release, bool gang);
+#endif
+
 /// The currently running dispatcher
 extern struct dcb *dcb_current;
 
@@ -47,6 +47,8 @@ struct kcb {
 
     /// mdb root node
     lvaddr_t mdb_root;
+    /// memory for mdb nodes, if the mdb needs any
+    struct mdb_node_pool mdb_nodes;
     // XXX: need memory for a rootcn here because we can't have it static in
     // the kernel data section anymore
     struct cte init_rootcn;
@@ -57,6 +59,7 @@ struct kcb {
     struct dcb *ring_current;
     /// RBED scheduler state
     struct dcb *queue_head, *queue_tail;
+    struct dcb *queue_root;     ///< Root of the run queue tree
     unsigned int u_hrt, u_srt, w_be, n_be;
     /// current time since kernel start in timeslices. This is necessary to
     /// make the scheduler work correctly
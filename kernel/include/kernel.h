@@ -121,6 +121,11 @@ extern systime_t kernel_timeslice;
  */
 extern unsigned int config_timeslice;
 
+/**
+ * command-line option for the wakeup coalescing slack in microseconds
+ */
+extern unsigned int config_wakeup_slack;
+
 /**
  * variable for gating timer interrupts.
  */
@@ -128,6 +133,8 @@ extern bool kernel_ticks_enabled;
 
 
 extern lvaddr_t kernel_trace_buf;
+extern lvaddr_t kernel_trace_core;
+extern size_t kernel_trace_size;
 
 extern struct capability monitor_ep;
 
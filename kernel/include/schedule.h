@@ -42,6 +42,9 @@ void scheduler_remove(struct dcb *dcb);
 /* Yield. */
 void scheduler_yield(struct dcb *dcb);
 
+/* Earliest time at which a queued task is released after now, or TIMER_INF. */
+systime_t scheduler_next_release(void);
+
 /* Coreboot stuff from here on. */
 
 /* Kernel has rebooted, start scheduling from scratch. */
@@ -31,7 +31,8 @@ struct sysret
 sys_dispatcher_properties(struct capability *to,
                           enum task_type type, unsigned long deadline,
                           unsigned long wcet, unsigned long period,
-                          unsigned long release, unsigned short weight);
+                          unsigned long release, unsigned short weight,
+                          bool gang);
 struct sysret
 sys_retype(struct capability *root, capaddr_t source_croot, capaddr_t source_cptr,
            gensize_t offset, enum objtype type, gensize_t objsize, size_t count,
@@ -124,15 +125,20 @@ struct sysret sys_monitor_delete_foreigns(capaddr_t cptr, uint8_t bits);
 struct sysret sys_monitor_revoke_mark_tgt(capaddr_t root_addr,
                                           uint8_t root_bits,
                                           capaddr_t target_addr,
-                                          uint8_t target_bits);
+                                          uint8_t target_bits,
+                                          bool local_only);
 struct sysret sys_monitor_revoke_mark_rels(struct capability *base);
 struct sysret sys_monitor_delete_step(capaddr_t ret_cn_addr,
                                       uint8_t ret_cn_bits,
-                                      cslot_t ret_slot);
+                                      cslot_t ret_slot,
+                                      size_t max_steps);
 struct sysret sys_monitor_clear_step(capaddr_t ret_cn_addr,
                                      uint8_t ret_cn_bits,
-                                     cslot_t ret_slot);
+                                     cslot_t ret_slot,
+                                     size_t max_steps);
 struct sysret sys_monitor_reclaim_ram(capaddr_t retcn_addr,
                                       uint8_t retcn_level,
                                       cslot_t ret_slot);
+struct sysret sys_monitor_mdb_add_memory(capaddr_t cptr, uint8_t level);
+struct sysret sys_monitor_mdb_free_nodes(void);
 #endif
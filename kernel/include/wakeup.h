@@ -16,5 +16,8 @@ void wakeup_remove(struct dcb *dcb);
 void wakeup_set(struct dcb *dcb, systime_t waketime);
 void wakeup_check(systime_t now);
 bool wakeup_is_pending(void);
+void wakeup_idle_enter(void);
+void wakeup_idle_exit(void);
+errval_t wakeup_get_stat(unsigned int stat, uint64_t *retval);
 
 #endif
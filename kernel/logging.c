@@ -94,6 +94,16 @@ void __assert(const char *func, const char *file, int line, const char *exp)
  */
 lvaddr_t kernel_trace_buf = 0;
 
+/**
+ * Trace state of this core in the kernel trace buffer
+ */
+lvaddr_t kernel_trace_core = 0;
+
+/**
+ * Size of the kernel trace buffer
+ */
+size_t kernel_trace_size = 0;
+
 struct trace_application kernel_trace_boot_applications[TRACE_MAX_BOOT_APPLICATIONS];
 
 int kernel_trace_num_boot_applications = 0;
@@ -425,8 +425,17 @@ struct sysret sys_monitor_delete_foreigns(capaddr_t cptr, uint8_t level)
     return SYSRET(caps_delete_foreigns(cte));
 }
 
+/**
+ * \brief Mark the copies and descendants of a revoke target for deletion
+ *
+ * \param local_only Only mark if no copy or descendant of the target has
+ *        been shared with another core, and fail with
+ *        SYS_ERR_REVOKE_NOT_LOCAL otherwise. The check and the marking
+ *        happen in the same kernel entry.
+ */
 struct sysret sys_monitor_revoke_mark_tgt(capaddr_t root_addr, uint8_t root_level,
-                                          capaddr_t target_addr, uint8_t target_level)
+                                          capaddr_t target_addr, uint8_t target_level,
+                                          bool local_only)
 {
     errval_t err;
 
@@ -437,6 +446,10 @@ struct sysret sys_monitor_revoke_mark_tgt(capaddr_t root_addr, uint8_t root_leve
         return SYSRET(err);
     }
 
+    if (local_only && !caps_revoke_is_local(&target->cap)) {
+        return SYSRET(SYS_ERR_REVOKE_NOT_LOCAL);
+    }
+
     return SYSRET(caps_mark_revoke(&target->cap, target));
 }
 
@@ -476,9 +489,17 @@ static errval_t sys_retslot_lookup(capaddr_t cnptr, uint8_t cnlevel,
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Perform up to max_steps delete steps.
+ *
+ * Stops early at the first step that does not simply succeed, as the monitor
+ * has to act on its result (e.g. a RAM cap in the return slot, or a last
+ * owned copy that needs a distributed delete).
+ */
 struct sysret sys_monitor_delete_step(capaddr_t ret_cn_addr,
                                      uint8_t ret_cn_level,
-                                     cslot_t ret_slot)
+                                     cslot_t ret_slot,
+                                     size_t max_steps)
 {
     errval_t err;
 
@@ -488,12 +509,22 @@ struct sysret sys_monitor_delete_step(capaddr_t ret_cn_addr,
         return SYSRET(err);
     }
 
-    return SYSRET(caps_delete_step(retslot));
+    size_t steps = 0;
+    do {
+        err = caps_delete_step(retslot);
+        steps++;
+    } while (err == SYS_ERR_OK && steps < max_steps);
+
+    return SYSRET(err);
 }
 
+/**
+ * \brief Perform up to max_steps clear steps, see sys_monitor_delete_step().
+ */
 struct sysret sys_monitor_clear_step(capaddr_t ret_cn_addr,
                                      uint8_t ret_cn_level,
-                                     cslot_t ret_slot)
+                                     cslot_t ret_slot,
+                                     size_t max_steps)
 {
     errval_t err;
 
@@ -503,7 +534,13 @@ struct sysret sys_monitor_clear_step(capaddr_t ret_cn_addr,
         return SYSRET(err);
     }
 
-    return SYSRET(caps_clear_step(retslot));
+    size_t steps = 0;
+    do {
+        err = caps_clear_step(retslot);
+        steps++;
+    } while (err == SYS_ERR_OK && steps < max_steps);
+
+    return SYSRET(err);
 }
 
 struct sysret sys_monitor_reclaim_ram(capaddr_t retcn_addr,
@@ -520,3 +557,72 @@ struct sysret sys_monitor_reclaim_ram(capaddr_t retcn_addr,
 
     return SYSRET(caps_reclaim_ram(retslot));
 }
+
+/*
+ * Memory for mapping database nodes
+ */
+
+/**
+ * \brief Give the memory of a RAM cap to the mapping database
+ *
+ * Nobody may be able to map or retype the memory, so the cap must have no
+ * copies or descendants. The cap is moved into the start of the memory,
+ * where no domain can delete it, and pinned: revoking one of its ancestors
+ * skips it, so the memory is never returned or retyped again.
+ */
+struct sysret sys_monitor_mdb_add_memory(capaddr_t cptr, uint8_t level)
+{
+    errval_t err;
+
+    if (mdb_free_nodes() == SIZE_MAX) {
+        // the mapping database does not allocate nodes
+        return SYSRET(SYS_ERR_ILLEGAL_INVOCATION);
+    }
+
+    struct cte *cte;
+    err = caps_lookup_slot(&dcb_current->cspace.cap, cptr, level, &cte,
+                           CAPRIGHTS_ALLRIGHTS);
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
+    if (cte->cap.type != ObjType_RAM) {
+        return SYSRET(SYS_ERR_INVALID_SOURCE_TYPE);
+    }
+    if (distcap_is_in_delete(cte) || cte->mdbnode.locked) {
+        return SYSRET(SYS_ERR_CAP_LOCKED);
+    }
+    if (has_copies(cte) || has_descendants(cte) ||
+        cte->mdbnode.remote_copies || cte->mdbnode.remote_descs) {
+        return SYSRET(SYS_ERR_REVOKE_FIRST);
+    }
+
+    gensize_t bytes = cte->cap.u.ram.bytes;
+    if (bytes < 2 * sizeof(struct cte)) {
+        return SYSRET(SYS_ERR_INVALID_SIZE);
+    }
+    lvaddr_t base = local_phys_to_mem(gen_phys_to_local_phys(cte->cap.u.ram.base));
+
+    struct cte *keep = (struct cte *)base;
+    memset(keep, 0, sizeof(*keep));
+    err = mdb_add_memory(base + sizeof(*keep), bytes - sizeof(*keep));
+    if (err_is_fail(err)) {
+        return SYSRET(err);
+    }
+
+    // keep is empty and the mdb has nodes now, this can't fail
+    err = caps_copy_to_cte(keep, cte, false, 0, 0);
+    assert(err_is_ok(err));
+    keep->mdbnode.pinned = true;
+    return SYSRET(caps_delete(cte));
+}
+
+/**
+ * \brief Return the number of nodes the mapping database can still allocate
+ */
+struct sysret sys_monitor_mdb_free_nodes(void)
+{
+    return (struct sysret) {
+        .error = SYS_ERR_OK,
+        .value = mdb_free_nodes(),
+    };
+}
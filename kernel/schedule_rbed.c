@@ -108,15 +108,264 @@ static inline systime_t deadline(struct dcb *dcb)
     return dcb->release_time + dcb->deadline;
 }
 
-static void queue_insert(struct dcb *dcb)
+/**
+ * \brief Returns whether 'dcb' is gang scheduled.
+ *
+ * Gang scheduled tasks are hard real-time tasks, usually without laxity
+ * (their relative deadline equals their WCET), released at the same time on
+ * all cores of the gang. They have to run as soon as they are released.
+ * Gang membership is requested explicitly with the task's properties; a
+ * hard real-time task without laxity is not a gang task by itself.
+ */
+static inline bool is_gang(struct dcb *dcb)
 {
-    // Empty queue case
-    if(kcb_current->queue_head == NULL) {
-        assert(kcb_current->queue_tail == NULL);
-        kcb_current->queue_head = kcb_current->queue_tail = queue_tail = dcb;
-        return;
+    return dcb->gang;
+}
+
+/// Greatest common divisor of 'a' and 'b'
+static systime_t gcd(systime_t a, systime_t b)
+{
+    while(b != 0) {
+        systime_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * \brief Returns whether the slices of two gang scheduled tasks never overlap.
+ *
+ * The slices start at r1 + k * p1 and r2 + j * p2. The differences of these
+ * start times are exactly r2 - r1 + n * gcd(p1, p2), so the slices are
+ * disjoint iff the offset of r2 from r1 modulo gcd(p1, p2) leaves room for
+ * both WCETs.
+ */
+static bool gang_disjoint(systime_t r1, systime_t w1, systime_t p1,
+                          systime_t r2, systime_t w2, systime_t p2)
+{
+    systime_t g = gcd(p1, p2);
+    systime_t d = r2 >= r1 ? (r2 - r1) % g : (g - (r1 - r2) % g) % g;
+
+    return d >= w1 && g - d >= w2;
+}
+
+/// Upper bound of the time a gang task takes within any 'window' of time
+static inline systime_t gang_demand(systime_t wcet, systime_t period,
+                                    systime_t window)
+{
+    return wcet * ((window + period - 1) / period);
+}
+
+/*
+ * The run queue is a sequence of tasks. It is kept as a doubly linked list
+ * (->next and ->prev), which is what the rest of the kernel and the fast
+ * path in assembly look at, and indexed by a treap whose in-order traversal
+ * is the same sequence. Every tree node caches the minimum and maximum
+ * release time, the maximum deadline and the minimum release time of a gang
+ * scheduled task in its subtree, so that the scheduler can find the first
+ * released (gang) task and queue_insert() can find its insertion point
+ * without walking the list.
+ *
+ * The tree only indexes the list: its shape never changes the order of the
+ * tasks, so the queue behaves exactly like the sorted list it replaced.
+ * Whenever the release time or deadline of a queued task is changed in
+ * place, queue_update() must be called to fix up the cached values.
+ */
+
+/// State of the generator for tree node priorities
+static uint32_t queue_prio_state = 2463534242U;
+
+/// Return a priority for a new tree node (xorshift32)
+static inline uint32_t queue_prio(void)
+{
+    uint32_t x = queue_prio_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return queue_prio_state = x;
+}
+
+/// Recompute the cached subtree values of a single tree node
+static void queue_fixup(struct dcb *n)
+{
+    n->rq_min_release = n->rq_max_release = n->release_time;
+    n->rq_max_deadline = deadline(n);
+    n->rq_min_gang_release = is_gang(n) ? n->release_time : (systime_t)-1;
+
+    struct dcb *children[2] = { n->rq_left, n->rq_right };
+    for (int i = 0; i < 2; i++) {
+        struct dcb *c = children[i];
+        if (c == NULL) {
+            continue;
+        }
+        n->rq_min_release = MIN(n->rq_min_release, c->rq_min_release);
+        n->rq_max_release = MAX(n->rq_max_release, c->rq_max_release);
+        n->rq_max_deadline = MAX(n->rq_max_deadline, c->rq_max_deadline);
+        n->rq_min_gang_release = MIN(n->rq_min_gang_release,
+                                     c->rq_min_gang_release);
+    }
+}
+
+/**
+ * \brief Update the run queue after the times of 'dcb' have changed.
+ *
+ * Recomputes the cached subtree values from 'dcb' up to the root. Does not
+ * move 'dcb' in the queue.
+ */
+static void queue_update(struct dcb *dcb)
+{
+    for (struct dcb *n = dcb; n != NULL; n = n->rq_parent) {
+        queue_fixup(n);
+    }
+}
+
+/// Replace 'old' by 'new' as the child of 'parent', or as the root
+static inline void queue_replace_child(struct dcb *parent, struct dcb *old,
+                                       struct dcb *new)
+{
+    if (parent == NULL) {
+        kcb_current->queue_root = new;
+    } else if (parent->rq_left == old) {
+        parent->rq_left = new;
+    } else {
+        parent->rq_right = new;
+    }
+    if (new != NULL) {
+        new->rq_parent = parent;
+    }
+}
+
+/// Rotate tree node 'n' above its parent, keeping the in-order sequence
+static void queue_rotate_up(struct dcb *n)
+{
+    struct dcb *p = n->rq_parent;
+    assert(p != NULL);
+
+    queue_replace_child(p->rq_parent, p, n);
+    if (p->rq_left == n) {
+        p->rq_left = n->rq_right;
+        if (p->rq_left != NULL) {
+            p->rq_left->rq_parent = p;
+        }
+        n->rq_right = p;
+    } else {
+        p->rq_right = n->rq_left;
+        if (p->rq_right != NULL) {
+            p->rq_right->rq_parent = p;
+        }
+        n->rq_left = p;
+    }
+    p->rq_parent = n;
+
+    queue_fixup(p);
+    queue_fixup(n);
+}
+
+/**
+ * \brief Return the first task in the queue with release time <= 'now'.
+ */
+static struct dcb *queue_first_released(systime_t now)
+{
+    struct dcb *n = kcb_current->queue_root;
+
+    while (n != NULL && n->rq_min_release <= now) {
+        if (n->rq_left != NULL && n->rq_left->rq_min_release <= now) {
+            n = n->rq_left;
+        } else if (n->release_time <= now) {
+            return n;
+        } else {
+            n = n->rq_right;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Return the first gang scheduled task with release time <= 'now'.
+ */
+static struct dcb *queue_first_gang(systime_t now)
+{
+    struct dcb *n = kcb_current->queue_root;
+
+    while (n != NULL && n->rq_min_gang_release <= now) {
+        if (n->rq_left != NULL && n->rq_left->rq_min_gang_release <= now) {
+            n = n->rq_left;
+        } else if (is_gang(n) && n->release_time <= now) {
+            return n;
+        } else {
+            n = n->rq_right;
+        }
     }
 
+    return NULL;
+}
+
+/**
+ * \brief Return the first task in subtree 'n' with a deadline after 'd'.
+ */
+static struct dcb *queue_find_deadline(struct dcb *n, systime_t d)
+{
+    while (n != NULL && n->rq_max_deadline > d) {
+        if (n->rq_left != NULL && n->rq_left->rq_max_deadline > d) {
+            n = n->rq_left;
+        } else if (deadline(n) > d) {
+            return n;
+        } else {
+            n = n->rq_right;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Return the first task in subtree 'n' with a release time after 'r'
+ * and a deadline after 'd'.
+ *
+ * Best-effort tasks are inserted with a release time of now, so this only
+ * descends into subtrees that hold tasks released in the future.
+ */
+static struct dcb *queue_find_release_deadline(struct dcb *n, systime_t r,
+                                               systime_t d)
+{
+    if (n == NULL || n->rq_max_release <= r || n->rq_max_deadline <= d) {
+        return NULL;
+    }
+
+    struct dcb *i = queue_find_release_deadline(n->rq_left, r, d);
+    if (i != NULL) {
+        return i;
+    }
+    if (n->release_time > r && deadline(n) > d) {
+        return n;
+    }
+    return queue_find_release_deadline(n->rq_right, r, d);
+}
+
+/**
+ * \brief Return the earliest release time after 'now' in subtree 'n'.
+ *
+ * \return The release time, or TIMER_INF if no task is released after 'now'.
+ */
+static systime_t queue_next_release(struct dcb *n, systime_t now)
+{
+    if (n == NULL || n->rq_max_release <= now) {
+        return TIMER_INF;
+    }
+    if (n->rq_min_release > now) {
+        return n->rq_min_release;
+    }
+
+    systime_t next = n->release_time > now ? n->release_time : TIMER_INF;
+    next = MIN(next, queue_next_release(n->rq_left, now));
+    next = MIN(next, queue_next_release(n->rq_right, now));
+    return next;
+}
+
+static void queue_insert(struct dcb *dcb)
+{
     /* Insert into priority queue (this is doing EDF). We insert at
      * the tail of a train of tasks with equal deadlines, as well as
      * equal release times for best-effort tasks, so that trains of
@@ -127,32 +376,118 @@ static void queue_insert(struct dcb *dcb)
      * when another task blocks), this might otherwise cause a wrong
      * yielding behavior when old deadlines are encountered.
      */
-    struct dcb *prev = NULL;
-    for(struct dcb *i = kcb_current->queue_head; i != NULL; prev = i, i = i->next) {
-        // Skip over equal, smaller release times if best-effort
-        if(dcb->type == TASK_TYPE_BEST_EFFORT &&
-           dcb->release_time >= i->release_time) {
-            continue;
+    struct dcb *before;
+    if(dcb->type == TASK_TYPE_BEST_EFFORT) {
+        before = queue_find_release_deadline(kcb_current->queue_root,
+                                             dcb->release_time, deadline(dcb));
+    } else {
+        before = queue_find_deadline(kcb_current->queue_root, deadline(dcb));
+    }
+
+    // Link into the list, before 'before' or after the queue tail
+    if(before != NULL) {
+        dcb->next = before;
+        dcb->prev = before->prev;
+        before->prev = dcb;
+    } else {
+        dcb->next = NULL;
+        dcb->prev = kcb_current->queue_tail;
+        kcb_current->queue_tail = queue_tail = dcb;
+    }
+    if(dcb->prev != NULL) {
+        dcb->prev->next = dcb;
+    } else {
+        kcb_current->queue_head = dcb;
+    }
+
+    // Link into the tree as the in-order predecessor of 'before'
+    struct dcb *parent;
+    dcb->rq_left = dcb->rq_right = NULL;
+    dcb->rq_prio = queue_prio();
+    if(kcb_current->queue_root == NULL) {
+        parent = NULL;
+        kcb_current->queue_root = dcb;
+    } else if(before != NULL && before->rq_left == NULL) {
+        parent = before;
+        parent->rq_left = dcb;
+    } else {
+        parent = before != NULL ? before->rq_left : kcb_current->queue_root;
+        while(parent->rq_right != NULL) {
+            parent = parent->rq_right;
         }
+        parent->rq_right = dcb;
+    }
+    dcb->rq_parent = parent;
+    queue_update(dcb);
 
-        // Skip over equal deadlines
-        if(deadline(dcb) >= deadline(i)) {
+    // Restore the heap order on priorities
+    while(dcb->rq_parent != NULL && dcb->rq_prio > dcb->rq_parent->rq_prio) {
+        queue_rotate_up(dcb);
+    }
+}
+
+/**
+ * \brief Returns whether 'dcb' can be scheduled with the given properties.
+ *
+ * Hard real-time tasks may use at most SPECTRUM - BETA in total. A gang
+ * scheduled task runs ahead of EDF as soon as it is released. So its slices
+ * must not overlap those of the other gang scheduled tasks, and the other
+ * hard real-time tasks need enough laxity to absorb the gang slices within
+ * their deadline. Otherwise, one of them would miss a hard deadline. Only
+ * hard real-time tasks can be gang scheduled.
+ *
+ * Must be called before the properties are set on 'dcb'.
+ */
+bool scheduler_admissible(struct dcb *dcb, enum task_type type,
+                          systime_t deadline, systime_t wcet,
+                          systime_t period, systime_t release, bool gang)
+{
+    if(type != TASK_TYPE_HARD_REALTIME) {
+        return !gang;
+    }
+    if(wcet == 0 || period == 0 || wcet > deadline || wcet > period) {
+        return false;
+    }
+
+    unsigned int u_hrt = kcb_current->u_hrt;
+    if(in_queue(dcb) && dcb->type == TASK_TYPE_HARD_REALTIME) {
+        u_hrt -= u_target(dcb);
+    }
+    if(u_hrt + (wcet * SPECTRUM) / period + kcb_current->u_srt + BETA >
+       SPECTRUM) {
+        return false;
+    }
+
+    systime_t interference = 0;
+    for(struct dcb *i = kcb_current->queue_head; i != NULL; i = i->next) {
+        if(i == dcb || i->type != TASK_TYPE_HARD_REALTIME) {
             continue;
         }
 
-        dcb->next = i;
-        if(prev == NULL) {      // Insert before head
-            kcb_current->queue_head = dcb;
-        } else {                // Insert inside queue
-            prev->next = dcb;
+        if(is_gang(i)) {
+            if(gang && !gang_disjoint(i->release_time, i->wcet, i->period,
+                                      release, wcet, period)) {
+                return false;
+            }
+            interference += gang_demand(i->wcet, i->period, deadline);
+        } else if(gang) {
+            // the new slices must leave the EDF task 'i' enough laxity
+            systime_t demand = gang_demand(wcet, period, i->deadline);
+            for(struct dcb *j = kcb_current->queue_head; j != NULL;
+                j = j->next) {
+                if(j != dcb && j->type == TASK_TYPE_HARD_REALTIME &&
+                   is_gang(j)) {
+                    demand += gang_demand(j->wcet, j->period, i->deadline);
+                }
+            }
+            if(i->deadline - i->wcet < demand) {
+                return false;
+            }
         }
-
-        return;
     }
 
-    // Insert after queue tail
-    kcb_current->queue_tail->next = dcb;
-    kcb_current->queue_tail = queue_tail = dcb;
+    // an EDF task must itself have room for the gang slices
+    return gang || deadline - wcet >= interference;
 }
 
 /**
@@ -171,27 +506,32 @@ static void queue_remove(struct dcb *dcb)
         return;
     }
 
-    if(dcb == kcb_current->queue_head) {
+    // Unlink from the list
+    if(dcb->prev != NULL) {
+        dcb->prev->next = dcb->next;
+    } else {
         kcb_current->queue_head = dcb->next;
-        if(kcb_current->queue_head == NULL) {
-            kcb_current->queue_tail = queue_tail =  NULL;
-        }
-
-        goto out;
     }
+    if(dcb->next != NULL) {
+        dcb->next->prev = dcb->prev;
+    } else {
+        kcb_current->queue_tail = queue_tail = dcb->prev;
+    }
+    dcb->next = dcb->prev = NULL;
 
-    for(struct dcb *i = kcb_current->queue_head; i != NULL; i = i->next) {
-        if(i->next == dcb) {
-            i->next = i->next->next;
-            if(kcb_current->queue_tail == dcb) {
-                kcb_current->queue_tail = queue_tail = i;
-            }
-            break;
+    // Rotate down to at most one child, then splice out of the tree
+    while(dcb->rq_left != NULL && dcb->rq_right != NULL) {
+        if(dcb->rq_left->rq_prio > dcb->rq_right->rq_prio) {
+            queue_rotate_up(dcb->rq_left);
+        } else {
+            queue_rotate_up(dcb->rq_right);
         }
     }
-
- out:
-    dcb->next = NULL;
+    struct dcb *parent = dcb->rq_parent;
+    queue_replace_child(parent,  dcb,
+                        dcb->rq_left != NULL ? dcb->rq_left : dcb->rq_right);
+    queue_update(parent);
+    dcb->rq_parent = dcb->rq_left = dcb->rq_right = NULL;
 }
 
 #if 0
@@ -310,7 +650,6 @@ struct dcb *schedule(void)
     }
 
  start_over:
-    todisp = kcb_current->queue_head;
 
 #ifndef SCHEDULER_SIMULATOR
 #define PRINT_NAME(d) \
@@ -328,12 +667,17 @@ struct dcb *schedule(void)
 #define PRINT_NAME(d) do{}while(0)
 #endif
 
-    // Skip over all tasks released in the future, they're technically not
-    // in the schedule yet. We just have them to reduce book-keeping.
-    while(todisp != NULL && todisp->release_time > now) {
-        PRINT_NAME(todisp);
-        todisp = todisp->next;
+    // Released gang scheduled tasks come first: they have no laxity, so
+    // their slices only line up across cores if they start on release.
+    todisp = queue_first_gang(now);
+
+    // Otherwise, skip over all tasks released in the future, they're
+    // technically not in the schedule yet. We just have them to reduce
+    // book-keeping.
+    if(todisp == NULL) {
+        todisp = queue_first_released(now);
     }
+    PRINT_NAME(todisp);
 #undef PRINT_NAME
 
     // nothing to dispatch
@@ -342,6 +686,9 @@ struct dcb *schedule(void)
         debug(SUBSYS_DISPATCH, "schedule: no dcb runnable\n");
 #endif
         lastdisp = NULL;
+#ifdef CONFIG_ONESHOT_TIMER
+        update_sched_timer(queue_next_release(kcb_current->queue_root, now));
+#endif
         return NULL;
     }
 
@@ -356,6 +703,7 @@ struct dcb *schedule(void)
         if(deadline(todisp) < now) {
             todisp->release_time = now;
         }
+        queue_update(todisp);
     }
 
     // Assert we never miss a hard deadline
@@ -372,6 +720,16 @@ struct dcb *schedule(void)
     if(todisp->etime < todisp->wcet) {
         todisp->last_dispatch = now;
 
+#ifdef CONFIG_ONESHOT_TIMER
+        // Run until the budget is used up, or until the next task is
+        // released, which may have an earlier deadline. The latter starts
+        // real-time (e.g. gang scheduled) slices on time, not at the next
+        // budget expiry.
+        update_sched_timer(MIN(now + (todisp->wcet - todisp->etime),
+                               queue_next_release(kcb_current->queue_root,
+                                                  now)));
+#endif
+
         // If nothing changed, run whatever ran last (task might have
         // yielded to another), unless it is blocked
         if(lastdisp == todisp && dcb_current != NULL && in_queue(dcb_current)) {
@@ -385,11 +743,6 @@ struct dcb *schedule(void)
 
         // Remember who we run next
         lastdisp = todisp;
-        #ifdef CONFIG_ONESHOT_TIMER
-        // we might be able to do better than that...
-        // (e.g., check if there is only one task in the queue)
-        update_sched_timer(now + (todisp->wcet - todisp->etime));
-        #endif
         return todisp;
     }
 
@@ -430,6 +783,9 @@ void schedule_now(struct dcb *dcb)
         dcb->release_time = now;
     }
     dcb->deadline = 1;
+    if (in_queue(dcb)) {
+        queue_update(dcb);
+    }
 }
 
 void make_runnable(struct dcb *dcb)
@@ -458,6 +814,7 @@ void make_runnable(struct dcb *dcb)
         }
         kcb_current->w_be += dcb->weight;
         kcb_current->n_be++;
+        dcb->gang = false;
         dcb->deadline = dcb->period = kcb_current->n_be * kernel_timeslice;
         dcb->release_time = now;
         /* queue_sort(); */
@@ -531,6 +888,19 @@ void scheduler_remove(struct dcb *dcb)
     }
 }
 
+/**
+ * \brief Returns the earliest release time of a queued task after now.
+ *
+ * Used to program the timer of an idle core.
+ *
+ * \return The release time, or TIMER_INF if no queued task is released in
+ * the future.
+ */
+systime_t scheduler_next_release(void)
+{
+    return queue_next_release(kcb_current->queue_root, systime_now());
+}
+
 /**
  * \brief Yield 'dcb' for the rest of the current timeslice.
  *
@@ -581,6 +951,7 @@ void scheduler_reset_time(void)
             i->release_time = 0;
             i->etime = 0;
             i->last_dispatch = 0;
+            queue_update(i);
         }
         k = k->next;
     }while(k && k!=kcb_current);
@@ -605,6 +976,8 @@ void scheduler_convert(void)
             printf("kcb_current->ring_current: %p\n", kcb_current->ring_current);
             printf("kcb_current->ring_current->prev: %p\n", kcb_current->ring_current->prev);
             struct dcb *i = kcb_current->ring_current;
+            kcb_current->queue_head = kcb_current->queue_tail = NULL;
+            kcb_current->queue_root = queue_tail = NULL;
             do {
                 printf("converting %p\n", i);
                 i->type = TASK_TYPE_BEST_EFFORT;
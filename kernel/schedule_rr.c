@@ -117,6 +117,12 @@ void scheduler_yield(struct dcb *dcb)
     // No-op for the round-robin scheduler
 }
 
+systime_t scheduler_next_release(void)
+{
+    // Tasks in the ring are always released
+    return TIMER_INF;
+}
+
 void scheduler_reset_time(void)
 {
     // No-Op in RR scheduler
@@ -148,6 +148,14 @@ struct dcb *spawn_module(struct spawn_state *st,
 #error invalid scheduler
 #endif
 
+    // mdb nodes can't live in the kernel's data section either
+    size_t mdb_bytes = mdb_boot_memory();
+    if (mdb_bytes > 0) {
+        err = mdb_add_memory(local_phys_to_mem(alloc_phys(mdb_bytes)),
+                             mdb_bytes);
+        assert(err_is_ok(err));
+    }
+
     /* create root cnode */
     err = caps_create_new(ObjType_L1CNode, alloc_phys(OBJSIZE_L2CNODE),
                           OBJSIZE_L2CNODE, OBJSIZE_L2CNODE, my_core_id,
@@ -188,7 +188,8 @@ struct sysret
 sys_dispatcher_properties(struct capability *to,
                           enum task_type type, unsigned long deadline,
                           unsigned long wcet, unsigned long period,
-                          unsigned long release, unsigned short weight)
+                          unsigned long release, unsigned short weight,
+                          bool gang)
 {
     assert(to->type == ObjType_Dispatcher);
 
@@ -200,6 +201,12 @@ sys_dispatcher_properties(struct capability *to,
     assert(wcet <= period);
     assert(type != TASK_TYPE_BEST_EFFORT || weight > 0);
 
+    systime_t release_time = (release == 0) ? systime_now() : release;
+    if (!scheduler_admissible(dcb, type, deadline, wcet, period,
+                              release_time, gang)) {
+        return SYSRET(SYS_ERR_SCHED_NOT_ADMISSIBLE);
+    }
+
     trace_event(TRACE_SUBSYS_KERNEL, TRACE_EVENT_KERNEL_SCHED_REMOVE,
                 152);
     scheduler_remove(dcb);
@@ -209,8 +216,9 @@ sys_dispatcher_properties(struct capability *to,
     dcb->deadline = deadline;
     dcb->wcet = wcet;
     dcb->period = period;
-    dcb->release_time = (release == 0) ? systime_now() : release;
+    dcb->release_time = release_time;
     dcb->weight = weight;
+    dcb->gang = gang;
 
     make_runnable(dcb);
 #endif
@@ -1,6 +1,12 @@
 /**
  * \file
  * \brief DCB wakeup queue management
+ *
+ * Wakeups that are close together are coalesced: a wakeup that is due at
+ * most config_wakeup_slack microseconds before one already queued is
+ * delayed to fire together with it. A core with nothing to run stops its
+ * periodic tick and programs its timer for the next wakeup or task release
+ * instead (tickless idle).
  */
 
 /*
@@ -18,6 +24,17 @@
 #include <timer.h> // update_wakeup_timer()
 #include <wakeup.h>
 #include <systime.h>
+#include <schedule.h> // scheduler_next_release()
+#include <barrelfish_kpi/sys_debug.h> // enum wakeup_stat
+
+/// command-line option for the wakeup coalescing slack in microseconds
+unsigned int config_wakeup_slack = CONFIG_WAKEUP_SLACK;
+
+/// Wakeup statistics, indexed by enum wakeup_stat
+static uint64_t wakeup_stats[WAKEUP_STAT_COUNT];
+
+/// Time at which the core went idle without a tick, or 0 if it is ticking
+static systime_t tickless_since;
 
 /* wrapper to change the head, and update the next wakeup tick */
 void wakeup_set_queue_head(struct dcb *h)
@@ -63,10 +80,25 @@ void wakeup_set(struct dcb *dcb, systime_t waketime)
     // if we're already enqueued, remove first
     wakeup_remove(dcb);
 
-    dcb->wakeup_time = waketime;
+    wakeup_stats[WAKEUP_STAT_SET]++;
+    // The wakeup may be delayed up to the slack past the requested time, but
+    // no further: bound against the requested time, not a coalesced one
+    systime_t latest = waketime +
+        ns_to_systime((uint64_t)config_wakeup_slack * 1000);
+    bool coalesced = false;
 
     for (struct dcb *d = kcb_current->wakeup_queue_head, *p = NULL; ; p = d, d = d->wakeup_next) {
         if (d == NULL || d->wakeup_time > waketime) {
+            // Fire together with the next wakeup, if it is close enough
+            if (d != NULL && d->wakeup_time <= latest) {
+                waketime = d->wakeup_time;
+                if (!coalesced) {
+                    wakeup_stats[WAKEUP_STAT_COALESCED]++;
+                    coalesced = true;
+                }
+                continue;
+            }
+            dcb->wakeup_time = waketime;
             if (p == NULL) { // insert at head
                 assert(d == kcb_current->wakeup_queue_head);
                 dcb->wakeup_prev = NULL;
@@ -98,7 +130,9 @@ void wakeup_check(systime_t now)
         d->wakeup_prev = d->wakeup_next = NULL;
         make_runnable(d);
         schedule_now(d);
+        wakeup_stats[WAKEUP_STAT_FIRED]++;
     }
+    wakeup_stats[WAKEUP_STAT_CHECKS]++;
     if (d != NULL) {
         d->wakeup_prev = NULL;
     }
@@ -109,3 +143,68 @@ bool wakeup_is_pending(void)
 {
     return kcb_current->wakeup_queue_head != NULL;
 }
+
+#ifndef CONFIG_ONESHOT_TIMER
+/**
+ * \brief Stop the periodic tick before the core idles
+ *
+ * Programs the timer for the next event that needs the core: the first
+ * wakeup, or the next release of a scheduled task. Does nothing if other
+ * KCBs share the core, as they are switched on ticks.
+ */
+void wakeup_idle_enter(void)
+{
+    if (!kernel_ticks_enabled || kcb_current->next != NULL) {
+        return;
+    }
+
+    systime_t now = systime_now();
+    systime_t next = scheduler_next_release();
+    struct dcb *h = kcb_current->wakeup_queue_head;
+    if (h != NULL) {
+        // wakeup times are in KCB time
+        next = MIN(next, h->wakeup_time - kcb_current->kernel_off);
+    }
+    if (next <= now + kernel_timeslice) {
+        // The next tick is not far off, keep it
+        return;
+    }
+
+    if (tickless_since == 0) {
+        tickless_since = now;
+        wakeup_stats[WAKEUP_STAT_IDLE_ENTRIES]++;
+    }
+    systime_set_timeout(next);
+}
+
+/**
+ * \brief Restart the periodic tick, if the core was idle without it
+ */
+void wakeup_idle_exit(void)
+{
+    if (tickless_since == 0) {
+        return;
+    }
+
+    systime_t now = systime_now();
+    wakeup_stats[WAKEUP_STAT_TICKS_SKIPPED] +=
+        (now - tickless_since) / kernel_timeslice;
+    tickless_since = 0;
+    systime_set_timeout(now + kernel_timeslice);
+}
+#endif
+
+/**
+ * \brief Return a wakeup statistics counter
+ *
+ * \param stat   Counter to return, one of enum wakeup_stat
+ * \param retval Returns the counter value
+ */
+errval_t wakeup_get_stat(unsigned int stat, uint64_t *retval)
+{
+    if (stat >= WAKEUP_STAT_COUNT) {
+        return SYS_ERR_INVARGS_SYSCALL;
+    }
+    *retval = wakeup_stats[stat];
+    return SYS_ERR_OK;
+}
@@ -344,6 +344,16 @@ errval_t pmap_x86_measure_res(struct pmap *pmap, struct pmap_res_info *buf)
     }
     buf->vnode_used = used_slabs * pmap->m.slab.blocksize;
     buf->vnode_free = free_slabs * pmap->m.slab.blocksize;
+#ifdef PMAP_ARRAY
+    // Add the children arrays of the page tables
+    free_slabs = used_slabs = 0;
+    for (struct slab_head *sh = pmap->m.ptslab.slabs; sh != NULL; sh = sh->next) {
+        free_slabs += sh->free;
+        used_slabs += sh->total - sh->free;
+    }
+    buf->vnode_used += used_slabs * pmap->m.ptslab.blocksize;
+    buf->vnode_free += free_slabs * pmap->m.ptslab.blocksize;
+#endif
 
     // Report capability slots in use by pmap
     buf->slots_used = x86->used_cap_slots;
@@ -259,10 +259,108 @@ size_t ALL_THE_VNODES_MAX_ENTRIES = (15*4096);
 struct vnode **ALL_THE_VNODES = NULL;
 size_t all_the_vnodes_cnt = 0;
 
+/**
+ * \brief Page table operations queued by a map, unmap or modify_flags call
+ *
+ * Operations that span multiple leaf page tables issue one invocation per
+ * leaf. Instead, they queue them here and issue them with a single batched
+ * invocation on the root page table, see barrelfish_kpi/vnode_batch.h. Only
+ * operations whose caps are all in our own cspace can be batched.
+ */
+struct pmap_batch {
+    size_t count;                                   ///< Queued operations
+    struct vnode *ptables[VNODE_BATCH_MAX];         ///< Page table of each op
+    struct vnode *pages[VNODE_BATCH_MAX];           ///< Leaf vnode of each op
+    union {
+        struct vnode_map_batch_entry map[VNODE_BATCH_MAX];
+        struct vnode_unmap_batch_entry unmap[VNODE_BATCH_MAX];
+        struct vnode_modify_flags_batch_entry modify[VNODE_BATCH_MAX];
+    } e;
+};
+
+static inline bool cap_in_own_cspace(struct capref cap)
+{
+    return get_croot_addr(cap) == CPTR_ROOTCN;
+}
+
+static errval_t pmap_batch_flush_map(struct pmap_x86 *pmap,
+                                     struct pmap_batch *batch)
+{
+    errval_t err;
+    size_t count = batch->count;
+    batch->count = 0;
+
+    if (count == 0) {
+        return SYS_ERR_OK;
+    } else if (count == 1) {
+        // not worth it to let the kernel copy a batch
+        struct vnode_map_batch_entry *e = &batch->e.map[0];
+        err = invoke_vnode_map(batch->ptables[0]->v.u.vnode.invokable, e->slot,
+                               e->src_root, e->src, e->src_level, e->flags,
+                               e->offset, e->pte_count, e->mcn_root, e->mcn,
+                               e->mcn_level, e->mapping_slot);
+    } else {
+        err = invoke_vnode_map_batch(pmap->root.v.u.vnode.invokable,
+                                     batch->e.map, count, NULL);
+    }
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_VNODE_MAP);
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Map `pte_count` entries of `frame` into `ptable`, either right away,
+ * or as part of `batch` if it is non-NULL.
+ */
+static errval_t pmap_batch_map(struct pmap_x86 *pmap, struct pmap_batch *batch,
+                               struct vnode *ptable, struct vnode *page,
+                               size_t table_base, struct capref frame,
+                               paging_x86_64_flags_t pmap_flags, size_t offset,
+                               size_t pte_count)
+{
+    errval_t err;
+    if (batch == NULL) {
+        err = vnode_map(ptable->v.u.vnode.invokable, frame, table_base,
+                        pmap_flags, offset, pte_count, page->v.mapping);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_VNODE_MAP);
+        }
+        return SYS_ERR_OK;
+    }
+
+    if (batch->count == VNODE_BATCH_MAX) {
+        err = pmap_batch_flush_map(pmap, batch);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    assert(cap_in_own_cspace(ptable->v.u.vnode.invokable));
+    batch->ptables[batch->count] = ptable;
+    batch->pages[batch->count] = page;
+    batch->e.map[batch->count++] = (struct vnode_map_batch_entry) {
+        .ptable       = get_cap_addr(ptable->v.u.vnode.invokable),
+        .ptable_level = get_cap_level(ptable->v.u.vnode.invokable),
+        .slot         = table_base,
+        .src_root     = get_croot_addr(frame),
+        .src          = get_cap_addr(frame),
+        .src_level    = get_cap_level(frame),
+        .mcn_root     = get_croot_addr(page->v.mapping),
+        .mcn          = get_cnode_addr(page->v.mapping),
+        .mcn_level    = get_cnode_level(page->v.mapping),
+        .mapping_slot = page->v.mapping.slot,
+        .flags        = pmap_flags,
+        .offset       = offset,
+        .pte_count    = pte_count,
+    };
+    return SYS_ERR_OK;
+}
+
 static errval_t do_single_map(struct pmap_x86 *pmap, genvaddr_t vaddr,
                               genvaddr_t vend, struct capref frame,
                               size_t offset, size_t pte_count,
-                              vregion_flags_t flags)
+                              vregion_flags_t flags, struct pmap_batch *batch)
 {
     if (pte_count == 0) {
         debug_printf("do_single_map: pte_count == 0, called from %p\n",
@@ -336,13 +434,8 @@ static errval_t do_single_map(struct pmap_x86 *pmap, genvaddr_t vaddr,
     // do map
     assert(!capref_is_null(ptable->v.u.vnode.invokable));
     assert(!capref_is_null(page->v.mapping));
-    err = vnode_map(ptable->v.u.vnode.invokable, frame, table_base,
-                    pmap_flags, offset, pte_count, page->v.mapping);
-    if (err_is_fail(err)) {
-        return err_push(err, LIB_ERR_VNODE_MAP);
-    }
-
-    return SYS_ERR_OK;
+    return pmap_batch_map(pmap, batch, ptable, page, table_base, frame,
+                          pmap_flags, offset, pte_count);
 }
 
 /**
@@ -392,6 +485,8 @@ errval_t do_map(struct pmap *pmap_gen, genvaddr_t vaddr,
         table_base = X86_64_PDIR_BASE(vaddr);
         map_bits   = X86_64_LARGE_PAGE_BITS + X86_64_PTABLE_BITS;
         debug_out  = false;
+        // remove huge flag, if the frame is only good for large pages
+        flags     &= ~VREGION_FLAGS_HUGE;
     } else {
         // remove large/huge flags
         flags &= ~(VREGION_FLAGS_LARGE|VREGION_FLAGS_HUGE);
@@ -428,20 +523,30 @@ errval_t do_map(struct pmap *pmap_gen, genvaddr_t vaddr,
         if (debug_out) {
             debug_printf("  do_map: fast path: %zd\n", pte_count);
         }
-        err = do_single_map(pmap, vaddr, vend, frame, offset, pte_count, flags);
+        err = do_single_map(pmap, vaddr, vend, frame, offset, pte_count, flags,
+                            NULL);
         if (err_is_fail(err)) {
             trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_DO_MAP, 1);
             return err_push(err, LIB_ERR_PMAP_DO_MAP);
         }
     }
     else { // multiple leaf page tables
+        // map all leaves with one invocation, if possible
+        struct pmap_batch batch_store;
+        struct pmap_batch *batch = NULL;
+        if (cap_in_own_cspace(pmap->root.v.u.vnode.invokable)) {
+            batch = &batch_store;
+            batch->count = 0;
+        }
+
         // first leaf
         uint32_t c = X86_64_PTABLE_SIZE - table_base;
         if (debug_out) {
             debug_printf("  do_map: slow path: first leaf %"PRIu32"\n", c);
         }
         genvaddr_t temp_end = vaddr + c * page_size;
-        err = do_single_map(pmap, vaddr, temp_end, frame, offset, c, flags);
+        err = do_single_map(pmap, vaddr, temp_end, frame, offset, c, flags,
+                            batch);
         if (err_is_fail(err)) {
             trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_DO_MAP, 1);
             return err_push(err, LIB_ERR_PMAP_DO_MAP);
@@ -462,8 +567,12 @@ errval_t do_map(struct pmap *pmap_gen, genvaddr_t vaddr,
                 debug_printf("  do_map: slow path: full leaf\n");
             }
             err = do_single_map(pmap, vaddr, temp_end, frame, offset,
-                    X86_64_PTABLE_SIZE, flags);
+                    X86_64_PTABLE_SIZE, flags, batch);
             if (err_is_fail(err)) {
+                if (batch) {
+                    // leave the leaves before the failing one mapped
+                    pmap_batch_flush_map(pmap, batch);
+                }
                 trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_DO_MAP, 1);
                 return err_push(err, LIB_ERR_PMAP_DO_MAP);
             }
@@ -482,7 +591,19 @@ errval_t do_map(struct pmap *pmap_gen, genvaddr_t vaddr,
             if (debug_out) {
                 debug_printf("do_map: slow path: last leaf %"PRIu32"\n", c);
             }
-            err = do_single_map(pmap, temp_end, vend, frame, offset, c, flags);
+            err = do_single_map(pmap, temp_end, vend, frame, offset, c, flags,
+                                batch);
+            if (err_is_fail(err)) {
+                if (batch) {
+                    pmap_batch_flush_map(pmap, batch);
+                }
+                trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_DO_MAP, 1);
+                return err_push(err, LIB_ERR_PMAP_DO_MAP);
+            }
+        }
+
+        if (batch) {
+            err = pmap_batch_flush_map(pmap, batch);
             if (err_is_fail(err)) {
                 trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_DO_MAP, 1);
                 return err_push(err, LIB_ERR_PMAP_DO_MAP);
@@ -569,6 +690,7 @@ static errval_t map(struct pmap *pmap, genvaddr_t vaddr, struct capref frame,
     if ((flags & VREGION_FLAGS_LARGE) &&
         (vaddr & X86_64_LARGE_PAGE_MASK) == 0 &&
         (fi.base & X86_64_LARGE_PAGE_MASK) == 0 &&
+        fi.bytes >= X86_64_LARGE_PAGE_SIZE &&
         fi.bytes >= offset+size) {
         //case large pages (2MB)
         size   += LARGE_PAGE_OFFSET(offset);
@@ -578,6 +700,7 @@ static errval_t map(struct pmap *pmap, genvaddr_t vaddr, struct capref frame,
     } else if ((flags & VREGION_FLAGS_HUGE) &&
                (vaddr & X86_64_HUGE_PAGE_MASK) == 0 &&
                (fi.base & X86_64_HUGE_PAGE_MASK) == 0 &&
+               fi.bytes >= X86_64_HUGE_PAGE_SIZE &&
                fi.bytes >= offset+size) {
         // case huge pages (1GB)
         size   += HUGE_PAGE_OFFSET(offset);
@@ -669,8 +792,67 @@ static bool find_mapping(struct pmap_x86 *pmap, genvaddr_t vaddr,
     }
 }
 
+/**
+ * \brief Release the mapping cap and metadata of an unmapped leaf
+ */
+static errval_t unmap_cleanup(struct pmap_x86 *pmap, struct vnode *ptable,
+                              struct vnode *page)
+{
+    errval_t err;
+
+    // delete&free page->v.mapping after doing vnode_unmap()
+    err = cap_delete(page->v.mapping);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_CAP_DELETE);
+    }
+#ifndef GLOBAL_MCN
+    err = pmap->p.slot_alloc->free(pmap->p.slot_alloc, page->v.mapping);
+    if (err_is_fail(err)) {
+        debug_printf("remove_empty_vnodes: slot_free (mapping): %s\n",
+                err_getstring(err));
+    }
+#endif
+    assert(pmap->used_cap_slots > 0);
+    pmap->used_cap_slots --;
+    // Free up the resources
+    pmap_remove_vnode(ptable, page);
+    slab_free(&pmap->p.m.slab, page);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Issue the unmaps queued in `batch`, and clean up after the ones
+ * that succeeded.
+ */
+static errval_t pmap_batch_flush_unmap(struct pmap_x86 *pmap,
+                                       struct pmap_batch *batch)
+{
+    errval_t err, cleanup_err = SYS_ERR_OK;
+    size_t count = batch->count, done = 0;
+    batch->count = 0;
+
+    if (count == 0) {
+        return SYS_ERR_OK;
+    }
+    err = invoke_vnode_unmap_batch(pmap->root.v.u.vnode.invokable,
+                                   batch->e.unmap, count, &done);
+    for (size_t i = 0; i < done; i++) {
+        errval_t e = unmap_cleanup(pmap, batch->ptables[i], batch->pages[i]);
+        if (err_is_fail(e) && err_is_ok(cleanup_err)) {
+            cleanup_err = e;
+        }
+    }
+    if (err_is_fail(err)) {
+        debug_printf("vnode_unmap_batch returned error: %s (%d)\n",
+                err_getstring(err), err_no(err));
+        return err_push(err, LIB_ERR_VNODE_UNMAP);
+    }
+    return cleanup_err;
+}
+
 static errval_t do_single_unmap(struct pmap_x86 *pmap, genvaddr_t vaddr,
-                                size_t pte_count)
+                                size_t pte_count, struct pmap_batch *batch)
 {
     errval_t err;
     struct find_mapping_info info;
@@ -681,6 +863,25 @@ static errval_t do_single_unmap(struct pmap_x86 *pmap, genvaddr_t vaddr,
     assert(info.page_table && info.page_table->v.is_vnode && info.page && !info.page->v.is_vnode);
 
     if (info.page->v.u.frame.pte_count == pte_count) {
+        if (batch && cap_in_own_cspace(info.page->v.mapping)) {
+            if (batch->count == VNODE_BATCH_MAX) {
+                err = pmap_batch_flush_unmap(pmap, batch);
+                if (err_is_fail(err)) {
+                    return err;
+                }
+            }
+            struct capref pt = info.page_table->v.u.vnode.invokable;
+            batch->ptables[batch->count] = info.page_table;
+            batch->pages[batch->count] = info.page;
+            batch->e.unmap[batch->count++] = (struct vnode_unmap_batch_entry) {
+                .ptable        = get_cap_addr(pt),
+                .ptable_level  = get_cap_level(pt),
+                .mapping       = get_cap_addr(info.page->v.mapping),
+                .mapping_level = get_cap_level(info.page->v.mapping),
+            };
+            return SYS_ERR_OK;
+        }
+
         err = vnode_unmap(info.page_table->v.cap, info.page->v.mapping);
         if (err_is_fail(err)) {
             debug_printf("vnode_unmap returned error: %s (%d)\n",
@@ -688,23 +889,7 @@ static errval_t do_single_unmap(struct pmap_x86 *pmap, genvaddr_t vaddr,
             return err_push(err, LIB_ERR_VNODE_UNMAP);
         }
 
-        // delete&free page->v.mapping after doing vnode_unmap()
-        err = cap_delete(info.page->v.mapping);
-        if (err_is_fail(err)) {
-            return err_push(err, LIB_ERR_CAP_DELETE);
-        }
-#ifndef GLOBAL_MCN
-        err = pmap->p.slot_alloc->free(pmap->p.slot_alloc, info.page->v.mapping);
-        if (err_is_fail(err)) {
-            debug_printf("remove_empty_vnodes: slot_free (mapping): %s\n",
-                    err_getstring(err));
-        }
-#endif
-        assert(pmap->used_cap_slots > 0);
-        pmap->used_cap_slots --;
-        // Free up the resources
-        pmap_remove_vnode(info.page_table, info.page);
-        slab_free(&pmap->p.m.slab, info.page);
+        return unmap_cleanup(pmap, info.page_table, info.page);
     }
 
     return SYS_ERR_OK;
@@ -753,7 +938,7 @@ static errval_t unmap(struct pmap *pmap, genvaddr_t vaddr, size_t size,
         (is_same_pml4(vaddr, vend) && is_huge_page(info.page)))
     {
         // fast path
-        err = do_single_unmap(x86, vaddr, size / info.page_size);
+        err = do_single_unmap(x86, vaddr, size / info.page_size, NULL);
         if (err_is_fail(err) && err_no(err) != LIB_ERR_PMAP_FIND_VNODE) {
             printf("error fast path\n");
             trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_UNMAP, 1);
@@ -761,10 +946,18 @@ static errval_t unmap(struct pmap *pmap, genvaddr_t vaddr, size_t size,
         }
     }
     else { // slow path
+        // unmap all leaves with one invocation, if possible
+        struct pmap_batch batch_store;
+        struct pmap_batch *batch = NULL;
+        if (cap_in_own_cspace(x86->root.v.u.vnode.invokable)) {
+            batch = &batch_store;
+            batch->count = 0;
+        }
+
         // unmap first leaf
         uint32_t c = X86_64_PTABLE_SIZE - info.table_base;
 
-        err = do_single_unmap(x86, vaddr, c);
+        err = do_single_unmap(x86, vaddr, c, batch);
         if (err_is_fail(err) && err_no(err) != LIB_ERR_PMAP_FIND_VNODE) {
             printf("error first leaf\n");
             trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_UNMAP, 1);
@@ -775,9 +968,12 @@ static errval_t unmap(struct pmap *pmap, genvaddr_t vaddr, size_t size,
         vaddr += c * info.page_size;
         while (get_addr_prefix(vaddr, info.map_bits) < get_addr_prefix(vend, info.map_bits)) {
             c = X86_64_PTABLE_SIZE;
-            err = do_single_unmap(x86, vaddr, X86_64_PTABLE_SIZE);
+            err = do_single_unmap(x86, vaddr, X86_64_PTABLE_SIZE, batch);
             if (err_is_fail(err) && err_no(err) != LIB_ERR_PMAP_FIND_VNODE) {
                 printf("error while loop\n");
+                if (batch) {
+                    pmap_batch_flush_unmap(x86, batch);
+                }
                 trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_UNMAP, 1);
                 return err_push(err, LIB_ERR_PMAP_UNMAP);
             }
@@ -791,9 +987,21 @@ static errval_t unmap(struct pmap *pmap, genvaddr_t vaddr, size_t size,
             get_addr_prefix(vaddr, info.map_bits - X86_64_PTABLE_BITS);
         assert(c < X86_64_PTABLE_SIZE);
         if (c) {
-            err = do_single_unmap(x86, vaddr, c);
+            err = do_single_unmap(x86, vaddr, c, batch);
             if (err_is_fail(err) && err_no(err) != LIB_ERR_PMAP_FIND_VNODE) {
                 printf("error remaining part\n");
+                if (batch) {
+                    pmap_batch_flush_unmap(x86, batch);
+                }
+                trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_UNMAP, 1);
+                return err_push(err, LIB_ERR_PMAP_UNMAP);
+            }
+        }
+
+        if (batch) {
+            err = pmap_batch_flush_unmap(x86, batch);
+            if (err_is_fail(err)) {
+                printf("error batch\n");
                 trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_UNMAP, 1);
                 return err_push(err, LIB_ERR_PMAP_UNMAP);
             }
@@ -809,9 +1017,23 @@ static errval_t unmap(struct pmap *pmap, genvaddr_t vaddr, size_t size,
     return ret;
 }
 
+static errval_t pmap_batch_flush_modify_flags(struct pmap_x86 *pmap,
+                                              struct pmap_batch *batch)
+{
+    size_t count = batch->count;
+    batch->count = 0;
+
+    if (count == 0) {
+        return SYS_ERR_OK;
+    }
+    return invoke_vnode_modify_flags_batch(pmap->root.v.u.vnode.invokable,
+                                           batch->e.modify, count, NULL);
+}
+
 int pmap_selective_flush = 0;
 static errval_t do_single_modify_flags(struct pmap_x86 *pmap, genvaddr_t vaddr,
-                                       size_t pages, vregion_flags_t flags)
+                                       size_t pages, vregion_flags_t flags,
+                                       struct pmap_batch *batch)
 {
     errval_t err = SYS_ERR_OK;
 
@@ -852,6 +1074,24 @@ static errval_t do_single_modify_flags(struct pmap_x86 *pmap, genvaddr_t vaddr,
                 va_hint = vaddr & ~(info.page_size - 1);
             }
         }
+        if (batch && cap_in_own_cspace(info.page->v.mapping)) {
+            if (batch->count == VNODE_BATCH_MAX) {
+                err = pmap_batch_flush_modify_flags(pmap, batch);
+                if (err_is_fail(err)) {
+                    return err;
+                }
+            }
+            batch->e.modify[batch->count++] =
+                (struct vnode_modify_flags_batch_entry) {
+                .mapping       = get_cap_addr(info.page->v.mapping),
+                .mapping_level = get_cap_level(info.page->v.mapping),
+                .offset        = off,
+                .pages         = pages,
+                .flags         = pmap_flags,
+                .va_hint       = va_hint,
+            };
+            return SYS_ERR_OK;
+        }
         err = invoke_mapping_modify_flags(info.page->v.mapping, off, pages,
                                           pmap_flags, va_hint);
         return err;
@@ -906,17 +1146,25 @@ static errval_t modify_flags(struct pmap *pmap, genvaddr_t vaddr, size_t size,
         (is_same_pml4(vaddr, vend) && is_huge_page(info.page))) {
         // fast path
         assert(pages <= PTABLE_SIZE);
-        err = do_single_modify_flags(x86, vaddr, pages, flags);
+        err = do_single_modify_flags(x86, vaddr, pages, flags, NULL);
         if (err_is_fail(err)) {
             trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_MODIFY, 1);
             return err_push(err, LIB_ERR_PMAP_MODIFY_FLAGS);
         }
     }
     else { // slow path
+        // modify all leaves with one invocation, if possible
+        struct pmap_batch batch_store;
+        struct pmap_batch *batch = NULL;
+        if (cap_in_own_cspace(x86->root.v.u.vnode.invokable)) {
+            batch = &batch_store;
+            batch->count = 0;
+        }
+
         // modify first part
         uint32_t c = X86_64_PTABLE_SIZE - info.table_base;
         assert(c <= PTABLE_SIZE);
-        err = do_single_modify_flags(x86, vaddr, c, flags);
+        err = do_single_modify_flags(x86, vaddr, c, flags, batch);
         if (err_is_fail(err)) {
             trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_MODIFY, 1);
             return err_push(err, LIB_ERR_PMAP_MODIFY_FLAGS);
@@ -926,8 +1174,12 @@ static errval_t modify_flags(struct pmap *pmap, genvaddr_t vaddr, size_t size,
         vaddr += c * info.page_size;
         while (get_addr_prefix(vaddr, info.map_bits) < get_addr_prefix(vend, info.map_bits)) {
             c = X86_64_PTABLE_SIZE;
-            err = do_single_modify_flags(x86, vaddr, X86_64_PTABLE_SIZE, flags);
+            err = do_single_modify_flags(x86, vaddr, X86_64_PTABLE_SIZE, flags,
+                                         batch);
             if (err_is_fail(err)) {
+                if (batch) {
+                    pmap_batch_flush_modify_flags(x86, batch);
+                }
                 trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_MODIFY, 1);
                 return err_push(err, LIB_ERR_PMAP_MODIFY_FLAGS);
             }
@@ -939,7 +1191,18 @@ static errval_t modify_flags(struct pmap *pmap, genvaddr_t vaddr, size_t size,
                 get_addr_prefix(vaddr, info.map_bits - X86_64_PTABLE_BITS);
         if (c) {
             assert(c <= PTABLE_SIZE);
-            err = do_single_modify_flags(x86, vaddr, c, flags);
+            err = do_single_modify_flags(x86, vaddr, c, flags, batch);
+            if (err_is_fail(err)) {
+                if (batch) {
+                    pmap_batch_flush_modify_flags(x86, batch);
+                }
+                trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_MODIFY, 1);
+                return err_push(err, LIB_ERR_PMAP_MODIFY_FLAGS);
+            }
+        }
+
+        if (batch) {
+            err = pmap_batch_flush_modify_flags(x86, batch);
             if (err_is_fail(err)) {
                 trace_event(TRACE_SUBSYS_MEMORY, TRACE_EVENT_MEMORY_MODIFY, 1);
                 return err_push(err, LIB_ERR_PMAP_MODIFY_FLAGS);
@@ -1092,6 +1355,48 @@ static errval_t dump(struct pmap *pmap, struct pmap_dump_info *buf, size_t bufle
     }
     return SYS_ERR_OK;
 }
+#elif defined(PMAP_TREE)
+static errval_t dump(struct pmap *pmap, struct pmap_dump_info *buf, size_t buflen, size_t *items_written)
+{
+    struct pmap_x86 *x86 = (struct pmap_x86 *)pmap;
+    struct pmap_dump_info *buf_ = buf;
+
+    struct vnode *pml4 = &x86->root;
+    struct vnode *pdpt, *pdir, *pt, *frame;
+    assert(pml4 != NULL);
+
+    *items_written = 0;
+
+    // iterate over PML4 entries; children are visited in order of entry
+    int pml4_i, pdpt_i, pdir_i, pt_i;
+    for (pml4_i = pmap_next_child(pml4, 0, &pdpt); pdpt;
+         pml4_i = pmap_next_child(pml4, pml4_i, &pdpt)) {
+        // iterate over pdpt entries
+        for (pdpt_i = pmap_next_child(pdpt, 0, &pdir); pdir;
+             pdpt_i = pmap_next_child(pdpt, pdpt_i, &pdir)) {
+            // iterate over pdir entries
+            for (pdir_i = pmap_next_child(pdir, 0, &pt); pt;
+                 pdir_i = pmap_next_child(pdir, pdir_i, &pt)) {
+                // iterate over pt entries
+                for (pt_i = pmap_next_child(pt, 0, &frame); frame;
+                     pt_i = pmap_next_child(pt, pt_i, &frame)) {
+                    if (*items_written < buflen) {
+                        buf_->pml4_index = pdpt->v.entry;
+                        buf_->pdpt_index = pdir->v.entry;
+                        buf_->pdir_index = pt->v.entry;
+                        buf_->pt_index = frame->v.entry;
+                        buf_->cap = frame->v.cap;
+                        buf_->offset = frame->v.u.frame.offset;
+                        buf_->flags = frame->v.u.frame.flags;
+                        buf_++;
+                        (*items_written)++;
+                    }
+                }
+            }
+        }
+    }
+    return SYS_ERR_OK;
+}
 #else
 #error Invalid pmap datastructure
 #endif
@@ -1277,6 +1582,13 @@ static errval_t determine_addr_raw(struct pmap *pmap, size_t size,
             break;
         }
     }
+#elif defined(PMAP_TREE)
+    genvaddr_t first_free = 16;
+    for (; first_free < X86_64_PTABLE_SIZE; first_free++) {
+        if (!pmap_find_vnode(&x86->root, first_free)) {
+            break;
+        }
+    }
 #else
 #error Invalid pmap datastructure
 #endif
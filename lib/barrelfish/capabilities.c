@@ -338,6 +338,236 @@ errval_t cap_retype(struct capref dest_start, struct capref src, gensize_t offse
 }
 
 
+/**
+ * \brief Returns the number of slots, starting at dest[0], that are
+ *        consecutive slots of the same CNode
+ */
+static size_t slot_run_length(struct capref *dest, size_t count)
+{
+    size_t n = 1;
+    while (n < count && cnodecmp(dest[n].cnode, dest[0].cnode) &&
+           dest[n].slot == dest[0].slot + n) {
+        n++;
+    }
+    return n;
+}
+
+#ifdef __x86_64__
+/**
+ * \brief Perform the retypes of cap_retype_slots() with batched invocations
+ *
+ * \param created Number of objects already created, updated as we go
+ *
+ * Returns SYS_ERR_RETRY_THROUGH_MONITOR if the source cap has remote
+ * relations, in which case the caller has to perform the remaining retypes
+ * through the monitor.
+ */
+static errval_t cap_retype_slots_batched(struct capref *dest, size_t count,
+                                         struct capref src, gensize_t offset,
+                                         enum objtype new_type,
+                                         gensize_t objsize, size_t *created)
+{
+    struct cnode_retype_batch_entry batch[CNODE_BATCH_MAX];
+    capaddr_t scp_root = get_croot_addr(src);
+    capaddr_t scp_addr = get_cap_addr(src);
+
+    while (*created < count) {
+        // one entry per run of consecutive slots
+        size_t nentries = 0;
+        size_t queued = *created;
+        while (nentries < CNODE_BATCH_MAX && queued < count) {
+            size_t run = slot_run_length(dest + queued, count - queued);
+            batch[nentries++] = (struct cnode_retype_batch_entry) {
+                .src_root   = scp_root,
+                .src        = scp_addr,
+                .offset     = offset + queued * objsize,
+                .objsize    = objsize,
+                .count      = run,
+                .type       = new_type,
+                .dest_root  = get_croot_addr(dest[queued]),
+                .dest_cnode = get_cnode_addr(dest[queued]),
+                .dest_slot  = dest[queued].slot,
+                .dest_level = get_cnode_level(dest[queued]),
+            };
+            queued += run;
+        }
+
+        size_t done;
+        errval_t err = invoke_cnode_retype_batch(cap_root, batch, nentries,
+                                                 &done);
+        for (size_t i = 0; i < done; i++) {
+            *created += batch[i].count;
+        }
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+#endif
+
+/**
+ * \brief Retype (part of) a capability into objects placed in given slots
+ *
+ * \param dest      Array of `count` destination slots, which must be empty
+ * \param count     The number of new objects to create
+ * \param src       Source capability to retype
+ * \param offset    Offset into source capability of the first object
+ * \param new_type  Kernel object type to retype to.
+ * \param objsize   Size of created objects in bytes
+ *
+ * Like cap_retype(), except that the new capabilities need not lie in
+ * consecutive slots of one CNode: the i-th object, at `offset + i * objsize`
+ * in the source, is placed in `dest[i]`. Runs of consecutive slots are
+ * retyped with a single operation, and where supported, many such runs are
+ * performed per kernel entry.
+ *
+ * Either all or none of the objects are created: if a retype fails, the
+ * capabilities created until then are deleted again.
+ */
+errval_t cap_retype_slots(struct capref *dest, size_t count, struct capref src,
+                          gensize_t offset, enum objtype new_type,
+                          gensize_t objsize)
+{
+    errval_t err = SYS_ERR_OK;
+    size_t created = 0;
+
+#ifdef __x86_64__
+    err = cap_retype_slots_batched(dest, count, src, offset, new_type,
+                                   objsize, &created);
+    if (err_no(err) == SYS_ERR_RETRY_THROUGH_MONITOR) {
+        // continue with single retypes, which go through the monitor
+        err = SYS_ERR_OK;
+    }
+#endif
+
+    while (err_is_ok(err) && created < count) {
+        size_t run = slot_run_length(dest + created, count - created);
+        err = cap_retype(dest[created], src, offset + created * objsize,
+                         new_type, objsize, run);
+        if (err_is_ok(err)) {
+            created += run;
+        }
+    }
+
+    if (err_is_fail(err)) {
+        for (size_t i = 0; i < created; i++) {
+            errval_t err2 = cap_delete(dest[i]);
+            if (err_is_fail(err2)) {
+                DEBUG_ERR(err2, "deleting partially retyped cap");
+            }
+        }
+        return err;
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Retype (part of) a capability into newly allocated slots
+ *
+ * \param ret       Array filled in with the `count` new capabilities
+ * \param count     The number of new objects to create
+ * \param src       Source capability to retype
+ * \param offset    Offset into source capability of the first object
+ * \param new_type  Kernel object type to retype to.
+ * \param objsize   Size of created objects in bytes
+ *
+ * Allocates a slot for each new object with slot_alloc(), which may span
+ * several CNodes, and then retypes into them with cap_retype_slots().
+ */
+errval_t cap_retype_alloc(struct capref *ret, size_t count, struct capref src,
+                          gensize_t offset, enum objtype new_type,
+                          gensize_t objsize)
+{
+    errval_t err = SYS_ERR_OK;
+    size_t nslots;
+
+    for (nslots = 0; nslots < count; nslots++) {
+        err = slot_alloc(&ret[nslots]);
+        if (err_is_fail(err)) {
+            err = err_push(err, LIB_ERR_SLOT_ALLOC);
+            goto out;
+        }
+    }
+
+    err = cap_retype_slots(ret, count, src, offset, new_type, objsize);
+
+out:
+    if (err_is_fail(err)) {
+        for (size_t i = 0; i < nslots; i++) {
+            slot_free(ret[i]);
+        }
+    }
+    return err;
+}
+
+/**
+ * \brief Copy a number of capabilities
+ *
+ * \param dest  Array of `count` destination slots, which must be empty
+ * \param src   Array of `count` source capabilities
+ * \param count Number of capabilities to copy
+ *
+ * Copies `src[i]` to `dest[i]` for each i, performing many copies per kernel
+ * entry where supported. Either all or none of the copies are made.
+ */
+errval_t cap_copy_slots(struct capref *dest, struct capref *src, size_t count)
+{
+    errval_t err = SYS_ERR_OK;
+    size_t copied = 0;
+
+#ifdef __x86_64__
+    struct cnode_copy_batch_entry batch[CNODE_BATCH_MAX];
+
+    while (copied < count) {
+        size_t nentries = count - copied;
+        if (nentries > CNODE_BATCH_MAX) {
+            nentries = CNODE_BATCH_MAX;
+        }
+        for (size_t i = 0; i < nentries; i++) {
+            struct capref d = dest[copied + i], s = src[copied + i];
+            batch[i] = (struct cnode_copy_batch_entry) {
+                .dest_root  = get_croot_addr(d),
+                .dest_cnode = get_cnode_addr(d),
+                .dest_slot  = d.slot,
+                .src_root   = get_croot_addr(s),
+                .src        = get_cap_addr(s),
+                .dest_level = get_cnode_level(d),
+                .src_level  = get_cap_level(s),
+            };
+        }
+
+        size_t done;
+        err = invoke_cnode_copy_batch(cap_root, batch, nentries, &done);
+        copied += done;
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+#else
+    for (; copied < count; copied++) {
+        err = cap_copy(dest[copied], src[copied]);
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+#endif
+
+    if (err_is_fail(err)) {
+        for (size_t i = 0; i < copied; i++) {
+            errval_t err2 = cap_delete(dest[i]);
+            if (err_is_fail(err2)) {
+                DEBUG_ERR(err2, "deleting partial copy");
+            }
+        }
+        return err;
+    }
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief Create a capability
  *
@@ -0,0 +1,231 @@
+/**
+ * \file
+ * \brief Pipelined RPC calls of Flounder-generated stubs
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdlib.h>
+#include <barrelfish/barrelfish.h>
+#include <flounder/flounder_rpc_pipeline.h>
+
+/// A call in flight
+struct flounder_rpc_call {
+    struct flounder_rpc_call *next; ///< Next call in sending order, or free
+    uint32_t token;                 ///< Token the call was sent with
+    int msgnum;                     ///< Message number of the response
+    void *handler;                  ///< Completion handler (interface-specific)
+    void *st;                       ///< Argument of the handler
+};
+
+/// Calls in flight on a binding
+struct flounder_rpc_pipeline {
+    struct thread_mutex mutex;
+    struct flounder_rpc_call *head;     ///< Oldest call in flight
+    struct flounder_rpc_call *tail;     ///< Newest call in flight
+    struct flounder_rpc_call *free;     ///< Unused entries
+    size_t pending;                     ///< Calls in flight
+    uint32_t next_id;                   ///< Number of the next call
+    struct flounder_rpc_call calls[];   ///< All entries
+};
+
+/**
+ * \brief Allocate the state of a pipeline
+ *
+ * \param depth  Maximum number of calls in flight,
+ *               0 for FLOUNDER_RPC_PIPELINE_DEPTH
+ * \param retp   Returns the pipeline
+ */
+errval_t flounder_rpc_pipeline_create(size_t depth,
+                                      struct flounder_rpc_pipeline **retp)
+{
+    if (depth == 0) {
+        depth = FLOUNDER_RPC_PIPELINE_DEPTH;
+    }
+
+    struct flounder_rpc_pipeline *p;
+    p = calloc(1, sizeof(*p) + depth * sizeof(struct flounder_rpc_call));
+    if (p == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    thread_mutex_init(&p->mutex);
+    for (size_t i = 0; i < depth; i++) {
+        p->calls[i].next = p->free;
+        p->free = &p->calls[i];
+    }
+
+    *retp = p;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Free the state of a pipeline. Calls in flight are dropped.
+ */
+void flounder_rpc_pipeline_destroy(struct flounder_rpc_pipeline *p)
+{
+    free(p);
+}
+
+/**
+ * \brief Record a call about to be sent
+ *
+ * The call is recorded before it is sent, as the response may be received
+ * while the send blocks.
+ *
+ * \param p         Pipeline
+ * \param msgnum    Message number of the response
+ * \param handler   Completion handler
+ * \param st        Argument of the handler
+ * \param rettoken  Returns the token to send the call with
+ *
+ * \returns FLOUNDER_ERR_TX_BUSY if the pipeline is full
+ */
+errval_t flounder_rpc_pipeline_push(struct flounder_rpc_pipeline *p,
+                                    int msgnum, void *handler, void *st,
+                                    uint32_t *rettoken)
+{
+    thread_mutex_lock(&p->mutex);
+
+    struct flounder_rpc_call *c = p->free;
+    if (c == NULL) {
+        thread_mutex_unlock(&p->mutex);
+        return FLOUNDER_ERR_TX_BUSY;
+    }
+    p->free = c->next;
+
+    // requests carry odd tokens, responses the same token with bit 0 clear.
+    // Skip token 1, as its response token 0 is that of untagged messages.
+    if ((uint32_t)(p->next_id << 1) == 0) {
+        p->next_id = 1;
+    }
+    c->token = (p->next_id++ << 1) | 1;
+    c->msgnum = msgnum;
+    c->handler = handler;
+    c->st = st;
+    c->next = NULL;
+
+    if (p->tail == NULL) {
+        p->head = c;
+    } else {
+        p->tail->next = c;
+    }
+    p->tail = c;
+    p->pending++;
+    *rettoken = c->token;
+
+    thread_mutex_unlock(&p->mutex);
+    return SYS_ERR_OK;
+}
+
+/// Unlink a call from the list of calls in flight and free its entry
+static void remove_call(struct flounder_rpc_pipeline *p,
+                        struct flounder_rpc_call *prev,
+                        struct flounder_rpc_call *c)
+{
+    if (prev == NULL) {
+        p->head = c->next;
+    } else {
+        prev->next = c->next;
+    }
+    if (p->tail == c) {
+        p->tail = prev;
+    }
+    p->pending--;
+
+    c->next = p->free;
+    p->free = c;
+}
+
+/**
+ * \brief Forget a call that could not be sent
+ *
+ * Does nothing if the call already completed.
+ */
+void flounder_rpc_pipeline_cancel(struct flounder_rpc_pipeline *p,
+                                  uint32_t token)
+{
+    thread_mutex_lock(&p->mutex);
+    for (struct flounder_rpc_call *prev = NULL, *c = p->head; c != NULL;
+         prev = c, c = c->next) {
+        if (c->token == token) {
+            remove_call(p, prev, c);
+            break;
+        }
+    }
+    thread_mutex_unlock(&p->mutex);
+}
+
+/**
+ * \brief Find and remove the call a response belongs to
+ *
+ * \param p           Pipeline
+ * \param msgnum      Message number of the response
+ * \param token       Token the response was received with
+ * \param rethandler  Returns the completion handler of the call
+ * \param retst       Returns the argument of the handler
+ *
+ * \returns FLOUNDER_ERR_RPC_MISMATCH if no call expects the response
+ */
+errval_t flounder_rpc_pipeline_complete(struct flounder_rpc_pipeline *p,
+                                        int msgnum, uint32_t token,
+                                        void **rethandler, void **retst)
+{
+    struct flounder_rpc_call *c, *prev;
+
+    thread_mutex_lock(&p->mutex);
+    for (prev = NULL, c = p->head; c != NULL; prev = c, c = c->next) {
+        if (c->msgnum == msgnum && (c->token & ~1) == token) {
+            break;
+        }
+    }
+
+    if (c == NULL) {
+        thread_mutex_unlock(&p->mutex);
+        return FLOUNDER_ERR_RPC_MISMATCH;
+    }
+
+    *rethandler = c->handler;
+    *retst = c->st;
+    remove_call(p, prev, c);
+    thread_mutex_unlock(&p->mutex);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Number of calls in flight
+ */
+size_t flounder_rpc_pipeline_pending(struct flounder_rpc_pipeline *p)
+{
+    return p->pending;
+}
+
+/**
+ * \brief Dispatch events until at most max_pending calls are in flight
+ *
+ * With max_pending 0, this waits for all calls to complete.
+ *
+ * \param ws           Waitset of the binding
+ * \param p            Pipeline of the binding
+ * \param max_pending  Number of calls that may remain in flight
+ */
+errval_t flounder_rpc_pipeline_wait(struct waitset *ws,
+                                    struct flounder_rpc_pipeline *p,
+                                    size_t max_pending)
+{
+    while (p->pending > max_pending) {
+        errval_t err = event_dispatch(ws);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_EVENT_DISPATCH);
+        }
+    }
+    return SYS_ERR_OK;
+}
@@ -0,0 +1,180 @@
+/**
+ * \file
+ * \brief Per-binding message statistics of Flounder-generated stubs
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/systime.h>
+#include <flounder/flounder_stats.h>
+
+/// Statistics of all bindings of this domain
+static struct flounder_binding_stats *stats_list;
+static struct thread_mutex stats_mutex = THREAD_MUTEX_INITIALIZER;
+
+/**
+ * \brief Allocate the statistics of a binding and add them to the domain's list
+ *
+ * \param binding   Binding the statistics are of
+ * \param ifname    Name of the interface
+ * \param backend   Name of the backend
+ * \param msg_name  Function naming the message numbers of the interface
+ * \param num_msgs  Number of message numbers of the interface
+ *
+ * \returns the statistics, or NULL if out of memory. The stubs don't count
+ *          anything for a binding without statistics.
+ */
+struct flounder_binding_stats *
+flounder_stats_create(const void *binding, const char *ifname,
+                      const char *backend, flounder_msg_name_fn_t msg_name,
+                      int num_msgs)
+{
+    struct flounder_binding_stats *st;
+    st = calloc(1, sizeof(*st) + num_msgs * sizeof(struct flounder_msg_stats));
+    if (st == NULL) {
+        return NULL;
+    }
+
+    st->binding = binding;
+    st->ifname = ifname;
+    st->backend = backend;
+    st->msg_name = msg_name;
+    st->num_msgs = num_msgs;
+
+    thread_mutex_lock(&stats_mutex);
+    st->next = stats_list;
+    stats_list = st;
+    thread_mutex_unlock(&stats_mutex);
+
+    return st;
+}
+
+/**
+ * \brief Remove the statistics of a binding from the domain's list and free them
+ */
+void flounder_stats_destroy(struct flounder_binding_stats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    thread_mutex_lock(&stats_mutex);
+    for (struct flounder_binding_stats **p = &stats_list; *p != NULL;
+         p = &(*p)->next) {
+        if (*p == stats) {
+            *p = stats->next;
+            break;
+        }
+    }
+    thread_mutex_unlock(&stats_mutex);
+
+    free(stats);
+}
+
+/**
+ * \brief Zero the counters and histograms of a binding
+ */
+void flounder_stats_reset(struct flounder_binding_stats *stats)
+{
+    if (stats != NULL) {
+        memset(stats->msgs, 0, stats->num_msgs * sizeof(stats->msgs[0]));
+    }
+}
+
+/**
+ * \brief Call fn on the statistics of every binding of this domain
+ *
+ * fn must not create or destroy bindings.
+ */
+void flounder_stats_iterate(flounder_stats_iter_fn_t fn, void *arg)
+{
+    thread_mutex_lock(&stats_mutex);
+    for (struct flounder_binding_stats *st = stats_list; st != NULL;
+         st = st->next) {
+        fn(st, arg);
+    }
+    thread_mutex_unlock(&stats_mutex);
+}
+
+/**
+ * \brief Estimate a percentile of a latency histogram
+ *
+ * \returns the upper bound in ticks of the bucket containing the percentile,
+ *          or 0 if the histogram is empty.
+ */
+systime_t flounder_stats_percentile(const uint32_t *hist, unsigned percent)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < FLOUNDER_STATS_BUCKETS; i++) {
+        total += hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (total * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < FLOUNDER_STATS_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= rank && hist[i] != 0) {
+            return i == 0 ? 0 : (systime_t)1 << i;
+        }
+    }
+    return (systime_t)1 << (FLOUNDER_STATS_BUCKETS - 1);
+}
+
+static uint64_t avg_ns(systime_t total, uint64_t count)
+{
+    return count == 0 ? 0 : systime_to_ns(total / count);
+}
+
+/**
+ * \brief Print the statistics of a binding, one line per message type used
+ *
+ * Latencies are in nanoseconds, percentiles are bucket upper bounds.
+ */
+void flounder_stats_dump_binding(struct flounder_binding_stats *stats)
+{
+    debug_printf("flounder stats: %s %s binding %p\n", stats->ifname,
+                 stats->backend, stats->binding);
+    debug_printf("  %-24s %10s %10s %10s %10s %10s %10s\n", "message",
+                 "tx", "tx avg", "tx p99", "rx", "rx avg", "rx p99");
+
+    for (int i = 0; i < stats->num_msgs; i++) {
+        struct flounder_msg_stats *m = &stats->msgs[i];
+        if (m->tx_count == 0 && m->rx_count == 0) {
+            continue;
+        }
+
+        debug_printf("  %-24s %10"PRIu64" %10"PRIu64" %10"PRIu64
+                     " %10"PRIu64" %10"PRIu64" %10"PRIu64"\n",
+                     stats->msg_name(i),
+                     m->tx_count, avg_ns(m->tx_time, m->tx_count),
+                     systime_to_ns(flounder_stats_percentile(m->tx_hist, 99)),
+                     m->rx_count, avg_ns(m->rx_time, m->rx_count),
+                     systime_to_ns(flounder_stats_percentile(m->rx_hist, 99)));
+    }
+}
+
+static void dump_one(struct flounder_binding_stats *stats, void *arg)
+{
+    flounder_stats_dump_binding(stats);
+}
+
+/**
+ * \brief Print the statistics of all bindings of this domain
+ */
+void flounder_stats_dump(void)
+{
+    flounder_stats_iterate(dump_one, NULL);
+}
@@ -392,38 +392,189 @@ void flounder_stub_ump_state_init(struct flounder_ump_state *s, void *binding)
     flounder_stub_cap_state_init(&s->capst, binding);
 }
 
+/// Maximum number of buffer fragments published with a single release
+#define UMP_SEND_BUF_BATCH  8
+
+/// Number of UMP fragments still needed to send 'len' bytes from 'pos'
+static size_t ump_buf_fragments(size_t len, size_t pos)
+{
+    const size_t fragbytes = UMP_PAYLOAD_WORDS * sizeof(uintptr_t);
+    size_t frags = 0;
+
+    if (pos == 0) {
+        // first fragment also carries the length word
+        size_t firstbytes = fragbytes - sizeof(uint64_t);
+        if (len <= firstbytes) {
+            return 1;
+        }
+        frags = 1;
+        pos = firstbytes;
+    }
+
+    return frags + DIVIDE_ROUND_UP(len - pos, fragbytes);
+}
+
+/**
+ * \brief Reserve space for a payload in the outgoing side channel
+ *
+ * A payload is stored contiguously. If it doesn't fit before the end of the
+ * area, it starts again at the beginning, and the receiver skips the rest.
+ *
+ * \returns true and the position of the payload in retstart if there is
+ *          space, false otherwise. The space is only taken once the caller
+ *          advances bk->pos.
+ */
+static bool ump_bulk_reserve(struct ump_bulk *bk, size_t len,
+                             uintptr_t *retstart)
+{
+    if (bk->data == NULL || len > bk->size) {
+        return false;
+    }
+
+    uintptr_t start = bk->pos;
+    size_t offset = start & (bk->size - 1);
+    if (offset + len > bk->size) {
+        start += bk->size - offset;
+    }
+
+    // has the receiver released enough space?
+    if (start + len - *bk->consumed > bk->size) {
+        return false;
+    }
+
+    *retstart = start;
+    return true;
+}
+
+/**
+ * \brief Send a buffer through the side channel
+ *
+ * Copies the buffer to the space reserved at start in the side channel, and
+ * sends a single fragment with its length, flagged with FL_UMP_BULK_FLAG,
+ * and its offset.
+ *
+ * \returns SYS_ERR_OK if the buffer was sent, or
+ *          FLOUNDER_ERR_BUF_SEND_MORE if the channel is full.
+ */
+static errval_t ump_send_buf_bulk(struct flounder_ump_state *s, int msgnum,
+                                  const void *buf, size_t len,
+                                  uintptr_t start)
+{
+    struct ump_bulk *bk = &s->chan.bulk_send;
+    volatile struct ump_message *msg;
+    struct ump_control ctrl;
+
+    if (flounder_stub_ump_get_next_batch(s, &msg, &ctrl, 1) == 0) {
+        return FLOUNDER_ERR_BUF_SEND_MORE;
+    }
+
+    uintptr_t offset = start & (bk->size - 1);
+    memcpy((uint8_t *)bk->data + offset, buf, len);
+    bk->pos = start + len;
+
+    flounder_stub_ump_control_fill(s, &ctrl, msgnum);
+    msg->data[0] = len | FL_UMP_BULK_FLAG;
+    // XXX: skip as many words as the largest word size
+    msg->data[sizeof(uint64_t) / sizeof(uintptr_t)] = offset;
+
+    // the release barrier also orders the copy before the fragment
+    ump_chan_publish_batch(&s->chan, &msg, &ctrl, 1);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Receive a buffer sent through the side channel
+ *
+ * Copies the buffer out of the side channel and hands its space back to
+ * the sender.
+ *
+ * \returns FLOUNDER_ERR_INVALID_STATE if the channel has no side channel or
+ *          the payload is not where the receiver expects it, or
+ *          FLOUNDER_ERR_RX_INVALID_LENGTH if it lies outside the side channel.
+ */
+static errval_t ump_recv_buf_bulk(struct flounder_ump_state *s,
+                                  volatile struct ump_message *msg,
+                                  void *buf, size_t len)
+{
+    struct ump_bulk *bk = &s->chan.bulk_recv;
+    if (bk->data == NULL) {
+        return FLOUNDER_ERR_INVALID_STATE;
+    }
+
+    uintptr_t offset = msg->data[sizeof(uint64_t) / sizeof(uintptr_t)];
+    if (offset >= bk->size || len > bk->size - offset) {
+        return FLOUNDER_ERR_RX_INVALID_LENGTH;
+    }
+
+    // did the sender skip the end of the area?
+    uintptr_t start = bk->pos;
+    if ((start & (bk->size - 1)) != offset) {
+        start += bk->size - (start & (bk->size - 1));
+    }
+    if ((start & (bk->size - 1)) != offset) {
+        return FLOUNDER_ERR_INVALID_STATE;
+    }
+
+    memcpy(buf, (uint8_t *)bk->data + offset, len);
+    bk->pos = start + len;
+
+    // finish the copy before handing the space back
+    ump_impl_release_barrier();
+    *bk->consumed = bk->pos;
+
+    return SYS_ERR_OK;
+}
+
 errval_t flounder_stub_ump_send_buf(struct flounder_ump_state *s,
                                        int msgnum, const void *bufp,
                                        size_t len, size_t *pos)
 {
-    volatile struct ump_message *msg;
+    volatile struct ump_message *msgs[UMP_SEND_BUF_BATCH];
+    struct ump_control ctrl[UMP_SEND_BUF_BATCH];
     const uint8_t *buf = bufp;
-    struct ump_control ctrl;
     int msgpos;
 
+    // large buffers go through the side channel, if it has space
+    uintptr_t start;
+    if (*pos == 0 && len >= FL_UMP_BULK_THRESHOLD
+        && ump_bulk_reserve(&s->chan.bulk_send, len, &start)) {
+        return ump_send_buf_bulk(s, msgnum, bufp, len, start);
+    }
+
+    // reserve as many slots as we can, fill them, and publish them together
     do {
-        msg = ump_chan_get_next(&s->chan, &ctrl);
-        if (!msg)
-            return FLOUNDER_ERR_BUF_SEND_MORE;
-        flounder_stub_ump_control_fill(s, &ctrl, msgnum);
+        size_t want = ump_buf_fragments(len, *pos);
+        if (want > UMP_SEND_BUF_BATCH) {
+            want = UMP_SEND_BUF_BATCH;
+        }
 
-        // is this the start of the buffer?
-        if (*pos == 0) {
-            // if so, send the length in the first word
-            msg->data[0] = len;
-            // XXX: skip as many words as the largest word size
-            msgpos = (sizeof(uint64_t) / sizeof(uintptr_t));
-        } else {
-            // otherwise use it for payload
-            msgpos = 0;
+        size_t n = flounder_stub_ump_get_next_batch(s, msgs, ctrl, want);
+        if (n == 0) {
+            return FLOUNDER_ERR_BUF_SEND_MORE;
         }
 
-        for (; msgpos < UMP_PAYLOAD_WORDS && *pos < len; msgpos++) {
-            msg->data[msgpos] = getword(buf, pos, len);
+        for (size_t i = 0; i < n; i++) {
+            volatile struct ump_message *msg = msgs[i];
+            flounder_stub_ump_control_fill(s, &ctrl[i], msgnum);
+
+            // is this the start of the buffer?
+            if (*pos == 0) {
+                // if so, send the length in the first word
+                msg->data[0] = len;
+                // XXX: skip as many words as the largest word size
+                msgpos = (sizeof(uint64_t) / sizeof(uintptr_t));
+            } else {
+                // otherwise use it for payload
+                msgpos = 0;
+            }
+
+            for (; msgpos < UMP_PAYLOAD_WORDS && *pos < len; msgpos++) {
+                msg->data[msgpos] = getword(buf, pos, len);
+            }
         }
 
-        flounder_stub_ump_barrier();
-        msg->header.control = ctrl;
+        ump_chan_publish_batch(&s->chan, msgs, ctrl, n);
     } while (*pos < len);
 
     // we're done. zero out our state for the next buffer
@@ -433,7 +584,8 @@ errval_t flounder_stub_ump_send_buf(struct flounder_ump_state *s,
     return SYS_ERR_OK;
 }
 
-errval_t flounder_stub_ump_recv_buf(volatile struct ump_message *msg,
+errval_t flounder_stub_ump_recv_buf(struct flounder_ump_state *s,
+                                    volatile struct ump_message *msg,
                                     void *buf, size_t *len, size_t *pos,
                                     size_t maxsize)
 {
@@ -445,7 +597,24 @@ errval_t flounder_stub_ump_recv_buf(volatile struct ump_message *msg,
     // if so, unmarshall the length and allocate a buffer
     if (*pos == 0) {
         *len = msg->data[0];
-        assert(*len <= maxsize);
+
+        // was the buffer sent through the side channel?
+        if (*len & FL_UMP_BULK_FLAG) {
+            *len &= ~FL_UMP_BULK_FLAG;
+            errval_t err = FLOUNDER_ERR_RX_INVALID_LENGTH;
+            if (*len <= maxsize) {
+                err = ump_recv_buf_bulk(s, msg, buf, *len);
+            }
+            if (err_is_fail(err)) {
+                *len = 0;
+            }
+            return err;
+        }
+
+        if (*len > maxsize) {
+            *len = 0;
+            return FLOUNDER_ERR_RX_INVALID_LENGTH;
+        }
         // XXX: skip as many words as the largest word size
         msgpos = (sizeof(uint64_t) / sizeof(uintptr_t));
     } else {
@@ -484,13 +653,14 @@ errval_t flounder_stub_ump_send_string(struct flounder_ump_state *s,
     return flounder_stub_ump_send_buf(s, msgnum, str, *len, pos);
 }
 
-errval_t flounder_stub_ump_recv_string(volatile struct ump_message *msg,
+errval_t flounder_stub_ump_recv_string(struct flounder_ump_state *s,
+                                       volatile struct ump_message *msg,
                                        char *str, size_t *pos, size_t *len,
                                        size_t maxsize)
 {
     errval_t err;
 
-    err = flounder_stub_ump_recv_buf(msg, (void *)str, len, pos, maxsize);
+    err = flounder_stub_ump_recv_buf(s, msg, (void *)str, len, pos, maxsize);
     if (*len == 0) {
         str[0] = '\0';
     }
@@ -0,0 +1,190 @@
+/**
+ * \file
+ * \brief Cache of ready, zeroed frames refilled in the background.
+ *
+ * The kernel zeroes the memory of a new Frame while retyping it from RAM, so
+ * allocating a large frame costs a kernel entry that is proportional to its
+ * size. A frame cache moves that cost off the allocation path: it keeps a
+ * number of frames of a fixed size ready, and when it runs low, refills
+ * itself from its waitset. A refill retypes one RAM cap into several frames
+ * with a single cap_retype_alloc(), so the zeroing of the whole chunk happens
+ * in one kernel entry that nobody is waiting for.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/frame_cache.h>
+#include <bitmacros.h>
+
+static size_t frame_cache_level(void *st)
+{
+    struct frame_cache *fc = st;
+    return fc->count;
+}
+
+static void frame_cache_push(struct frame_cache *fc, struct capref *frames,
+                             size_t n)
+{
+    thread_mutex_lock(&fc->mutex);
+    for (size_t i = 0; i < n; i++) {
+        assert(fc->count < fc->capacity);
+        size_t tail = (fc->head + fc->count) % fc->capacity;
+        fc->frames[tail] = frames[i];
+        fc->count++;
+    }
+    thread_mutex_unlock(&fc->mutex);
+}
+
+static errval_t frame_cache_refill(void *st, size_t target)
+{
+    struct frame_cache *fc = st;
+    struct capref frames[FRAME_CACHE_REFILL_BATCH];
+    errval_t err;
+
+    if (target > fc->capacity) {
+        target = fc->capacity;
+    }
+
+    // Only one refill runs at a time, and allocations only take frames out,
+    // so the ring cannot fill up under us while we retype outside the lock.
+    size_t count;
+    while ((count = frame_cache_level(fc)) < target) {
+        // RAM comes in powers of two, so refill in power of two chunks
+        size_t want = target - count;
+        if (want > FRAME_CACHE_REFILL_BATCH) {
+            want = FRAME_CACHE_REFILL_BATCH;
+        }
+        uint8_t nbits = log2floor(want);
+        size_t n = 1UL << nbits;
+
+        struct capref ram;
+        err = ram_alloc(&ram, log2floor(fc->frame_bytes) + nbits);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_RAM_ALLOC);
+        }
+
+        err = cap_retype_alloc(frames, n, ram, 0, ObjType_Frame,
+                               fc->frame_bytes);
+        if (err_is_fail(err)) {
+            cap_destroy(ram);
+            return err;
+        }
+
+        err = cap_destroy(ram);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_CAP_DESTROY);
+        }
+
+        frame_cache_push(fc, frames, n);
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Initialise a frame cache
+ *
+ * \param fc          Frame cache to initialise
+ * \param frame_bytes Size of the frames, a power of two of at least a page
+ * \param low         Refill when fewer than this many frames are ready
+ * \param high        Refill up to this many frames
+ *
+ * The cache starts out empty, and is refilled in the background once a
+ * waitset has been set with #frame_cache_set_waitset().
+ */
+errval_t frame_cache_init(struct frame_cache *fc, size_t frame_bytes,
+                          size_t low, size_t high)
+{
+    assert(frame_bytes >= BASE_PAGE_SIZE);
+    assert((frame_bytes & (frame_bytes - 1)) == 0);
+    assert(high > 0);
+
+    fc->frames = malloc(high * sizeof(struct capref));
+    if (fc->frames == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    fc->frame_bytes = frame_bytes;
+    fc->capacity = high;
+    fc->head = 0;
+    fc->count = 0;
+    thread_mutex_init(&fc->mutex);
+
+    pool_refill_init(&fc->refill, "zeroed frames", frame_cache_level,
+                     frame_cache_refill, fc, low, high);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Set the waitset on which the frame cache is refilled
+ *
+ * \param fc Frame cache
+ * \param ws Waitset, or NULL to disable background refill
+ */
+void frame_cache_set_waitset(struct frame_cache *fc, struct waitset *ws)
+{
+    pool_refill_set_waitset(&fc->refill, ws);
+    pool_refill_check(&fc->refill);
+}
+
+/**
+ * \brief Allocate a zeroed frame of the cache's frame size
+ *
+ * \param fc  Frame cache
+ * \param ret Returns the frame capability
+ *
+ * If no frame is ready, falls back to frame_alloc(), which zeroes the frame
+ * synchronously.
+ */
+errval_t frame_cache_alloc(struct frame_cache *fc, struct capref *ret)
+{
+    thread_mutex_lock(&fc->mutex);
+    if (fc->count == 0) {
+        thread_mutex_unlock(&fc->mutex);
+        pool_refill_check(&fc->refill);
+        return frame_alloc(ret, fc->frame_bytes, NULL);
+    }
+
+    *ret = fc->frames[fc->head];
+    fc->head = (fc->head + 1) % fc->capacity;
+    fc->count--;
+    fc->hits++;
+    thread_mutex_unlock(&fc->mutex);
+
+    pool_refill_check(&fc->refill);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Destroy all frames held by a frame cache, and free its ring
+ *
+ * Must not be called while a refill is queued.
+ */
+errval_t frame_cache_destroy(struct frame_cache *fc)
+{
+    errval_t err = SYS_ERR_OK;
+
+    while (fc->count > 0) {
+        errval_t err2 = cap_destroy(fc->frames[fc->head]);
+        if (err_is_fail(err2)) {
+            err = err_push(err2, LIB_ERR_CAP_DESTROY);
+        }
+        fc->head = (fc->head + 1) % fc->capacity;
+        fc->count--;
+    }
+
+    free(fc->frames);
+    fc->frames = NULL;
+    fc->capacity = 0;
+
+    return err;
+}
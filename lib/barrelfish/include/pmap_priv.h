@@ -29,6 +29,12 @@ errval_t pmap_slab_refill(struct pmap *pmap, struct slab_allocator *slab,
 
 errval_t pmap_vnode_mgmt_current_init(struct pmap *pmap);
 
+/**
+ * \brief queue a background refill of the current pmap's metadata slabs if
+ * they have dropped below their low watermark.
+ */
+void pmap_slab_refill_check(struct pmap *pmap);
+
 static inline void
 set_mapping_cap(struct pmap *pmap, struct vnode *vnode,
                 struct vnode *root, uint16_t entry)
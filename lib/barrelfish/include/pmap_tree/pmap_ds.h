@@ -0,0 +1,37 @@
+/**
+ * \file
+ * \brief pmap datastructure header for tree pmap. This file is
+ * included by selecting the right include dir in lib/barrelfish/Hakefile
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef LIBBF_INCLUDE_PMAP_DS_H
+#define LIBBF_INCLUDE_PMAP_DS_H
+
+/**
+ * \brief find the child of `root` with the lowest entry that is >= i.
+ * \returns the index from which to continue searching for the next child.
+ */
+int pmap_next_child(struct vnode *root, int i, struct vnode **n);
+
+/**
+ * \brief a macro that provides a datastructure-independent way of iterating
+ * through the children of the vnode `root` in order of their entries.
+ *
+ * The iteration does not touch `iter` after the loop body, so the body may
+ * remove and free `iter`.
+ *
+ * Note: this macro requires both root and iter to be 'struct vnode *'.
+ */
+#define pmap_foreach_child(root, iter) \
+    for (int i = pmap_next_child(root, 0, &iter); iter; i = pmap_next_child(root, i, &iter))
+
+#endif // LIBBF_INCLUDE_PMAP_DS_H
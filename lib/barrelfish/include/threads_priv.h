@@ -12,6 +12,7 @@
 
 #include <barrelfish/dispatcher_arch.h>
 #include <barrelfish/except.h>
+#include <barrelfish/slab_magazine.h>
 
 /// Maximum number of thread-local storage keys
 #define MAX_TLS         16
@@ -70,6 +71,7 @@ struct thread {
     uint16_t            thread_seg_selector; ///< Segment selector for TCB
 #endif
     void                *slab;              ///< Base of slab block containing this TCB
+    struct slab_cache   slab_cache;         ///< Magazines of free TCBs, see threads.c
     uintptr_t           id;                 ///< User-defined thread identifier
 
     uint32_t            token_number;	    ///< RPC next token
@@ -91,6 +91,10 @@ void libc_exit(int status)
         }
     }
 
+#ifdef CONFIG_TRACE
+    trace_disp_release();
+#endif
+
     thread_exit(status);
     // If we're not dead by now, we wait
     while (1) {}
@@ -131,7 +135,10 @@ static void hyper_bind_cont(void *st, errval_t err, struct hyper_binding *b);
 #endif
 
 #ifdef CONFIG_TRACE
-errval_t trace_my_setup(void)
+/**
+ * \brief Map the trace buffer, unless the domain has already mapped it
+ */
+errval_t trace_map_buffer(void)
 {
 #ifndef TRACING_EXISTS
     return SYS_ERR_OK;
@@ -143,12 +150,18 @@ errval_t trace_my_setup(void)
         .slot   = TASKCN_SLOT_TRACEBUF
     };
 
-    if (disp_get_core_id() >= TRACE_COREID_LIMIT) {
-        // can't support tracing on this core. sorry :(
-        return TRACE_ERR_UNAVAIL;
+    // Dispatchers of a spanned domain share the mapping
+    if (trace_buffer_master != 0) {
+        return SYS_ERR_OK;
     }
 
-    err = vspace_map_one_frame((void**)&trace_buffer_master, TRACE_ALLOC_SIZE,
+    struct frame_identity id;
+    err = frame_identify(cap, &id);
+    if (err_is_fail(err)) {
+        return err_push(err, TRACE_ERR_MAP_BUF);
+    }
+
+    err = vspace_map_one_frame((void**)&trace_buffer_master, id.bytes,
                                cap, NULL, NULL);
     if (err_is_fail(err)) {
         DEBUG_ERR(err, "vspace_map_one_frame for master trace buffer failed");
@@ -156,15 +169,19 @@ errval_t trace_my_setup(void)
     }
     assert(trace_buffer_master != 0);
 
-    trace_buffer_va = trace_buffer_master +
-        (disp_get_core_id() * TRACE_PERCORE_BUF_SIZE);
-
-    dispatcher_handle_t handle = curdispatcher();
-    struct dispatcher_generic *disp = get_dispatcher_generic(handle);
-    // Update pointer to trace buffer in child's dispatcher
-    disp->trace_buf = (struct trace_buffer *)trace_buffer_va;
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
+    master->size = id.bytes;
+    return SYS_ERR_OK;
+#endif
+}
 
+errval_t trace_my_setup(void)
+{
+#ifndef TRACING_EXISTS
     return SYS_ERR_OK;
+#else
+    // The dispatcher gets its ring on its first event
+    return trace_map_buffer();
 #endif
 }
 #endif
@@ -181,17 +198,33 @@ static bool parse_argv(struct spawn_domain_params *params, size_t *morecore_alig
     for (; i < params->argc; i++) {
         if (!found) {
             if (!strncmp(params->argv[i], "morecore=", 9)) {
-                morecore_pagesize = strtol(params->argv[i]+9, NULL, 0);
+                const char *value = params->argv[i] + 9;
+                char *end;
+                bool valid = true;
+                if (!strcmp(value, "auto")) {
+                    morecore_pagesize = MORECORE_PAGESIZE_AUTO;
+                } else {
+                    morecore_pagesize = strtol(value, &end, 0);
+                    // a number that strtol could not parse would be 0, auto
+                    valid = end != value && *end == '\0' &&
+                            morecore_pagesize != MORECORE_PAGESIZE_AUTO;
+                }
                 // check for valid page size
                 switch (morecore_pagesize) {
 #ifdef __x86_64__
                     case HUGE_PAGE_SIZE:
+                    case MORECORE_PAGESIZE_AUTO:
 #endif
                     case BASE_PAGE_SIZE:
                     case LARGE_PAGE_SIZE:
                         break;
                     default:
-                        morecore_pagesize = MORECORE_PAGESIZE;
+                        valid = false;
+                }
+                if (!valid) {
+                    debug_printf("Warning: ignoring invalid %s, using the "
+                                 "default page size\n", params->argv[i]);
+                    morecore_pagesize = MORECORE_PAGESIZE;
                 }
                 found = true;
             }
@@ -352,10 +385,7 @@ errval_t barrelfish_init_onthread(struct spawn_domain_params *params)
 
 #ifdef CONFIG_TRACE
     err = trace_my_setup();
-    if (err_no(err) == TRACE_ERR_UNAVAIL) {
-        debug_printf("Tracing not available for core %d, consider increasing TRACE_COREID_LIMIT\n",
-                disp_get_core_id());
-    } else if (err_is_fail(err)) {
+    if (err_is_fail(err)) {
         DEBUG_ERR(err, "trace_my_setup failed");
         return err;
     }
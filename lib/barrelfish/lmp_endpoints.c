@@ -301,9 +301,29 @@ void lmp_endpoints_poll_disabled(dispatcher_handle_t handle)
 errval_t lmp_endpoint_register(struct lmp_endpoint *ep, struct waitset *ws,
                                struct event_closure closure)
 {
-    errval_t err;
-
     dispatcher_handle_t handle = disp_disable();
+    errval_t err = lmp_endpoint_register_disabled(ep, ws, closure, handle);
+    disp_enable(handle);
+
+    return err;
+}
+
+/**
+ * \brief Register an event handler, while disabled
+ *
+ * As lmp_endpoint_register(), for callers that are already disabled.
+ *
+ * \param ep LMP endpoint
+ * \param ws Waitset
+ * \param closure Event handler
+ * \param handle Dispatcher's handle
+ */
+errval_t lmp_endpoint_register_disabled(struct lmp_endpoint *ep,
+                                        struct waitset *ws,
+                                        struct event_closure closure,
+                                        dispatcher_handle_t handle)
+{
+    errval_t err;
     struct dispatcher_generic *dp = get_dispatcher_generic(handle);
 
     // update seen count before checking for any new messages
@@ -328,8 +348,6 @@ errval_t lmp_endpoint_register(struct lmp_endpoint *ep, struct waitset *ws,
         }
     }
 
-    disp_enable(handle);
-
     return err;
 }
 
@@ -342,10 +360,28 @@ errval_t lmp_endpoint_deregister(struct lmp_endpoint *ep)
 {
     assert(ep != NULL);
     dispatcher_handle_t handle = disp_disable();
+    errval_t err = lmp_endpoint_deregister_disabled(ep, handle);
+    disp_enable(handle);
+
+    return err;
+}
+
+/**
+ * \brief Cancel an event registration, while disabled
+ *
+ * \param ep LMP Endpoint
+ * \param handle Dispatcher's handle
+ */
+errval_t lmp_endpoint_deregister_disabled(struct lmp_endpoint *ep,
+                                          dispatcher_handle_t handle)
+{
     struct dispatcher_generic *dp = get_dispatcher_generic(handle);
 
+    // only idle endpoints are on the poll list, triggered ones already left it
+    bool polled = (ep->waitset_state.state == CHAN_IDLE);
+
     errval_t err = waitset_chan_deregister_disabled(&ep->waitset_state, handle);
-    if (err_is_ok(err)) {
+    if (err_is_ok(err) && polled) {
         /* dequeue from poll list */
         if (ep->next == ep) {
             assert(ep->prev == ep);
@@ -360,8 +396,6 @@ errval_t lmp_endpoint_deregister(struct lmp_endpoint *ep)
         }
     }
 
-    disp_enable(handle);
-
     return err;
 }
 
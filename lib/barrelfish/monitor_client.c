@@ -441,6 +441,31 @@ errval_t monitor_cap_identify_remote(struct capref cap, struct capability *ret)
     return msgerr;
 }
 
+/**
+ * \brief Find the first cap in a CNode that has a copy or an ancestor
+ *
+ * \param cnode      L2 CNode holding the caps in slots 0..count-1
+ * \param count      Number of caps to check
+ * \param ret_index  Returns the slot of the first cap with a copy or an
+ *                   ancestor, on this or another core, or count if none has
+ */
+errval_t monitor_first_related_cap(struct capref cnode, uint32_t count,
+                                   uint32_t *ret_index)
+{
+    errval_t err, msgerr;
+
+    struct monitor_blocking_binding *r = get_monitor_blocking_binding();
+    if (!r) {
+        return LIB_ERR_MONITOR_RPC_NULL;
+    }
+    err = r->rpc_tx_vtbl.first_related_cap(r, cnode, count, &msgerr,
+                                           ret_index);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    return msgerr;
+}
+
 
 
 errval_t monitor_client_prepare_new_binding(struct capref ep, bool create,
@@ -116,6 +116,9 @@ errval_t morecore_init(size_t pagesize)
     vregion_flags_t morecore_flags = VREGION_FLAGS_READ_WRITE;
 #if __x86_64__
     morecore_flags |= (pagesize == HUGE_PAGE_SIZE ? VREGION_FLAGS_HUGE : 0);
+    // automatic: allow both, vspace_mmu_aware picks one for every frame
+    morecore_flags |= (pagesize == MORECORE_PAGESIZE_AUTO ?
+                       VREGION_FLAGS_LARGE | VREGION_FLAGS_HUGE : 0);
 #endif
     morecore_flags |= (pagesize == LARGE_PAGE_SIZE ? VREGION_FLAGS_LARGE : 0);
 
@@ -130,6 +133,11 @@ errval_t morecore_init(size_t pagesize)
     /* overwrite alignment field in vspace_mmu_aware state */
     state->mmu_state.alignment = heap_alignment;
 
+#if __x86_64__
+    vspace_mmu_aware_set_promote(&state->mmu_state,
+                                 pagesize == MORECORE_PAGESIZE_AUTO);
+#endif
+
     sys_morecore_alloc = morecore_alloc;
     sys_morecore_free = morecore_free;
 
@@ -155,6 +163,11 @@ errval_t morecore_reinit(void)
 
     size_t mapoffset = state->mmu_state.mapoffset;
     size_t remapsize = ROUND_UP(mapoffset, state->mmu_state.alignment);
+    if (state->mmu_state.promote) {
+        // only promote what was mapped with base pages before we had a
+        // connection to the memory server
+        remapsize = ROUND_UP(mapoffset, LARGE_PAGE_SIZE);
+    }
     if (remapsize <= mapoffset) {
         // don't need to do anything if we only recreate the exact same
         // mapping
@@ -167,7 +180,24 @@ errval_t morecore_reinit(void)
     size_t retsize;
     err = frame_alloc(&frame, remapsize, &retsize);
     if (err_is_fail(err)) {
+        if (state->mmu_state.promote) {
+            // keep the base pages
+            state->mmu_state.stats.fallbacks++;
+            return SYS_ERR_OK;
+        }
         return err;
     }
-    return vspace_mmu_aware_reset(&state->mmu_state, frame, remapsize);
+    err = vspace_mmu_aware_reset(&state->mmu_state, frame, remapsize);
+    if (err_is_ok(err) && state->mmu_state.promote) {
+        state->mmu_state.stats.large++;
+    }
+    return err;
+}
+
+/**
+ * \brief Return the page sizes used for the malloc heap so far
+ */
+void morecore_get_stats(struct vspace_mmu_aware_stats *stats)
+{
+    *stats = get_morecore_state()->mmu_state.stats;
 }
@@ -139,5 +139,6 @@ errval_t pmap_refill_slabs(struct pmap *pmap, size_t max_slabs)
     if (err_is_fail(err)) {
         return err;
     }
+    pmap_slab_refill_check(pmap);
     return SYS_ERR_OK;
 }
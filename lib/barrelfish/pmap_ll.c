@@ -127,5 +127,10 @@ void pmap_vnode_free(struct pmap *pmap, struct vnode *n)
 
 errval_t pmap_refill_slabs(struct pmap *pmap, size_t max_slabs)
 {
-    return pmap_slab_refill(pmap, &pmap->m.slab, max_slabs);
+    errval_t err = pmap_slab_refill(pmap, &pmap->m.slab, max_slabs);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    pmap_slab_refill_check(pmap);
+    return SYS_ERR_OK;
 }
@@ -14,6 +14,7 @@
 
 
 #include <barrelfish/barrelfish.h>
+#include <barrelfish/pool_refill.h>
 #include <pmap_priv.h>
 #include <pmap_ds.h>
 
@@ -29,6 +30,19 @@
 #define META_DATA_RESERVED_SIZE (BASE_PAGE_SIZE * 256000)
 // increased above value from 128 for pandaboard port
 
+// Watermarks for the deferred refill of the current pmap's slabs. The low
+// watermark is chosen so that common mappings never have to refill by
+// themselves; see #pmap_slab_refill_check().
+#define PMAP_SLAB_LOW_WATERMARK  INIT_SLAB_COUNT
+#define PMAP_SLAB_HIGH_WATERMARK (4 * INIT_SLAB_COUNT)
+
+/// Deferred refill state for the current pmap's vnode slabs
+static struct pool_refill vnode_slab_pool;
+#ifdef PMAP_ARRAY
+/// Deferred refill state for the current pmap's page table children slabs
+static struct pool_refill ptslab_pool;
+#endif
+
 /**
  * \brief Refill slabs using pages from fixed allocator, used if we need to
  * refill the slab allocator before we've established a connection to
@@ -201,6 +215,54 @@ errval_t pmap_slab_refill(struct pmap *pmap, struct slab_allocator *slab,
     return SYS_ERR_OK;
 }
 
+static size_t vnode_slab_level(void *st)
+{
+    struct pmap *pmap = st;
+    return slab_freecount(&pmap->m.slab);
+}
+
+static errval_t vnode_slab_refill(void *st, size_t target)
+{
+    struct pmap *pmap = st;
+    return pmap_slab_refill(pmap, &pmap->m.slab, target);
+}
+
+#ifdef PMAP_ARRAY
+static size_t ptslab_level(void *st)
+{
+    struct pmap *pmap = st;
+    return slab_freecount(&pmap->m.ptslab);
+}
+
+static errval_t ptslab_refill(void *st, size_t target)
+{
+    struct pmap *pmap = st;
+    return pmap_slab_refill(pmap, &pmap->m.ptslab, target);
+}
+#endif
+
+/**
+ * \brief Queue a refill of the metadata slabs if they run low
+ *
+ * \param pmap The pmap which just used its slabs
+ *
+ * Called after the synchronous refill in the mapping path, which only tops
+ * the slabs up to what the current mapping needs. The slabs are refilled to
+ * the high watermark from the default waitset, before the next mapping runs
+ * dry. Only the current pmap is refilled this way; foreign pmaps grow their
+ * slabs from the heap.
+ */
+void pmap_slab_refill_check(struct pmap *pmap)
+{
+    if (pmap != get_current_pmap()) {
+        return;
+    }
+    pool_refill_check(&vnode_slab_pool);
+#ifdef PMAP_ARRAY
+    pool_refill_check(&ptslab_pool);
+#endif
+}
+
 errval_t pmap_vnode_mgmt_current_init(struct pmap *pmap)
 {
     // To reserve a block of virtual address space,
@@ -221,5 +283,16 @@ errval_t pmap_vnode_mgmt_current_init(struct pmap *pmap)
 
     pmap->m.vregion_offset = pmap->m.vregion.base;
 
+    pool_refill_init(&vnode_slab_pool, "pmap vnode slabs", vnode_slab_level,
+                     vnode_slab_refill, pmap, PMAP_SLAB_LOW_WATERMARK,
+                     PMAP_SLAB_HIGH_WATERMARK);
+    pool_refill_set_waitset(&vnode_slab_pool, get_default_waitset());
+#ifdef PMAP_ARRAY
+    pool_refill_init(&ptslab_pool, "pmap ptable slabs", ptslab_level,
+                     ptslab_refill, pmap, PMAP_SLAB_LOW_WATERMARK,
+                     PMAP_SLAB_HIGH_WATERMARK);
+    pool_refill_set_waitset(&ptslab_pool, get_default_waitset());
+#endif
+
     return SYS_ERR_OK;
 }
@@ -0,0 +1,285 @@
+/**
+ * \file
+ * \brief architecture-independent shadow page table traversal code for
+ *        tree pmap implementation.
+ *
+ * The children of each page table are kept in an AVL tree ordered by their
+ * entry. Leaf mappings are extents covering `pte_count` entries, and extents
+ * never overlap, so the only candidate for a lookup of entry `e` is the child
+ * with the largest entry <= `e`. This gives O(log n) lookups, like the array
+ * pmap, while only costing two pointers and a height per mapping, like the
+ * linked-list pmap.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/pmap_target.h>
+
+#include <pmap_ds.h>
+#include <pmap_priv.h>
+
+static inline uint8_t tree_height(struct vnode *n)
+{
+    return n ? n->v.meta.height : 0;
+}
+
+static inline void tree_update_height(struct vnode *n)
+{
+    uint8_t hl = tree_height(n->v.meta.left);
+    uint8_t hr = tree_height(n->v.meta.right);
+    n->v.meta.height = 1 + (hl > hr ? hl : hr);
+}
+
+static struct vnode *tree_rotate_right(struct vnode *y)
+{
+    struct vnode *x = y->v.meta.left;
+    y->v.meta.left = x->v.meta.right;
+    x->v.meta.right = y;
+    tree_update_height(y);
+    tree_update_height(x);
+    return x;
+}
+
+static struct vnode *tree_rotate_left(struct vnode *x)
+{
+    struct vnode *y = x->v.meta.right;
+    x->v.meta.right = y->v.meta.left;
+    y->v.meta.left = x;
+    tree_update_height(x);
+    tree_update_height(y);
+    return y;
+}
+
+/**
+ * \brief Restore the AVL invariant at `n`, returns the new subtree root
+ */
+static struct vnode *tree_rebalance(struct vnode *n)
+{
+    tree_update_height(n);
+    int balance = tree_height(n->v.meta.left) - tree_height(n->v.meta.right);
+    if (balance > 1) {
+        struct vnode *l = n->v.meta.left;
+        if (tree_height(l->v.meta.left) < tree_height(l->v.meta.right)) {
+            n->v.meta.left = tree_rotate_left(l);
+        }
+        return tree_rotate_right(n);
+    }
+    if (balance < -1) {
+        struct vnode *r = n->v.meta.right;
+        if (tree_height(r->v.meta.right) < tree_height(r->v.meta.left)) {
+            n->v.meta.right = tree_rotate_right(r);
+        }
+        return tree_rotate_left(n);
+    }
+    return n;
+}
+
+static struct vnode *tree_insert(struct vnode *t, struct vnode *n)
+{
+    if (t == NULL) {
+        return n;
+    }
+    assert(n->v.entry != t->v.entry);
+    if (n->v.entry < t->v.entry) {
+        t->v.meta.left = tree_insert(t->v.meta.left, n);
+    } else {
+        t->v.meta.right = tree_insert(t->v.meta.right, n);
+    }
+    return tree_rebalance(t);
+}
+
+static struct vnode *tree_remove_min(struct vnode *t, struct vnode **min)
+{
+    if (t->v.meta.left == NULL) {
+        *min = t;
+        return t->v.meta.right;
+    }
+    t->v.meta.left = tree_remove_min(t->v.meta.left, min);
+    return tree_rebalance(t);
+}
+
+static struct vnode *tree_remove(struct vnode *t, struct vnode *item,
+                                 bool *found)
+{
+    if (t == NULL) {
+        return NULL;
+    }
+    if (item->v.entry < t->v.entry) {
+        t->v.meta.left = tree_remove(t->v.meta.left, item, found);
+    } else if (item->v.entry > t->v.entry) {
+        t->v.meta.right = tree_remove(t->v.meta.right, item, found);
+    } else {
+        assert(t == item);
+        *found = true;
+        if (t->v.meta.left == NULL) {
+            return t->v.meta.right;
+        }
+        if (t->v.meta.right == NULL) {
+            return t->v.meta.left;
+        }
+        struct vnode *min;
+        struct vnode *right = tree_remove_min(t->v.meta.right, &min);
+        min->v.meta.left = t->v.meta.left;
+        min->v.meta.right = right;
+        return tree_rebalance(min);
+    }
+    return tree_rebalance(t);
+}
+
+/**
+ * \brief Return the child with the largest entry <= `entry`, or NULL
+ */
+static struct vnode *tree_floor(struct vnode *t, uint16_t entry)
+{
+    struct vnode *best = NULL;
+    while (t != NULL) {
+        if (t->v.entry == entry) {
+            return t;
+        } else if (t->v.entry < entry) {
+            best = t;
+            t = t->v.meta.right;
+        } else {
+            t = t->v.meta.left;
+        }
+    }
+    return best;
+}
+
+/**
+ * \brief Return the child with the smallest entry >= `entry`, or NULL
+ */
+static struct vnode *tree_ceil(struct vnode *t, uint16_t entry)
+{
+    struct vnode *best = NULL;
+    while (t != NULL) {
+        if (t->v.entry == entry) {
+            return t;
+        } else if (t->v.entry > entry) {
+            best = t;
+            t = t->v.meta.left;
+        } else {
+            t = t->v.meta.right;
+        }
+    }
+    return best;
+}
+
+int pmap_next_child(struct vnode *root, int i, struct vnode **n)
+{
+    assert(n);
+    assert(root->v.is_vnode);
+    if (i >= PTABLE_ENTRIES) {
+        *n = NULL;
+        return PTABLE_ENTRIES;
+    }
+    *n = tree_ceil(root->v.u.vnode.children, i);
+    return *n ? (*n)->v.entry + 1 : PTABLE_ENTRIES;
+}
+
+/**
+ * \brief Starting at a given root, return the vnode with entry equal to #entry
+ */
+struct vnode *pmap_find_vnode(struct vnode *root, uint16_t entry)
+{
+    assert(root != NULL);
+    assert(root->v.is_vnode);
+    assert(entry < PTABLE_ENTRIES);
+
+    struct vnode *n = tree_floor(root->v.u.vnode.children, entry);
+    if (n == NULL) {
+        return NULL;
+    }
+    if (n->v.is_vnode) {
+        return n->v.entry == entry ? n : NULL;
+    }
+    // check whether entry is inside a large region
+    if (entry < n->v.entry + n->v.u.frame.pte_count) {
+        return n;
+    }
+    return NULL;
+}
+
+bool pmap_inside_region(struct vnode *root, uint16_t entry, uint16_t npages)
+{
+    assert(root != NULL);
+    assert(root->v.is_vnode);
+
+    struct vnode *n = tree_floor(root->v.u.vnode.children, entry);
+
+    // empty or ptable
+    if (!n || n->v.is_vnode) {
+        return false;
+    }
+
+    uint16_t end = n->v.entry + n->v.u.frame.pte_count;
+    return entry + npages <= end;
+}
+
+void pmap_remove_vnode(struct vnode *root, struct vnode *item)
+{
+    assert(root->v.is_vnode);
+    bool found = false;
+    root->v.u.vnode.children = tree_remove(root->v.u.vnode.children, item,
+                                           &found);
+    if (!found) {
+        USER_PANIC("Should not get here");
+    }
+}
+
+errval_t pmap_vnode_mgmt_init(struct pmap *pmap)
+{
+    struct pmap_vnode_mgmt *m = &pmap->m;
+    if (get_current_pmap() == pmap) {
+        slab_init(&m->slab, sizeof(struct vnode), NULL);
+        /* use static buffer for own pmap */
+        slab_grow(&m->slab, m->slab_buffer, INIT_SLAB_BUFFER_SIZE);
+    } else {
+        /* malloc initial buffer for other pmaps */
+        uint8_t *buf = malloc(INIT_SLAB_BUFFER_SIZE);
+        if (!buf) {
+            return LIB_ERR_MALLOC_FAIL;
+        }
+        slab_init(&m->slab, sizeof(struct vnode), NULL);
+        slab_grow(&m->slab, buf, INIT_SLAB_BUFFER_SIZE);
+    }
+
+    return SYS_ERR_OK;
+}
+
+void pmap_vnode_init(struct pmap *p, struct vnode *v)
+{
+    v->v.u.vnode.children = NULL;
+    v->v.meta.left = v->v.meta.right = NULL;
+    v->v.meta.height = 1;
+}
+
+void pmap_vnode_insert_child(struct vnode *root, struct vnode *newvnode)
+{
+    // leaf mappings are inserted without going through pmap_vnode_init()
+    newvnode->v.meta.left = newvnode->v.meta.right = NULL;
+    newvnode->v.meta.height = 1;
+    root->v.u.vnode.children = tree_insert(root->v.u.vnode.children, newvnode);
+}
+
+void pmap_vnode_free(struct pmap *pmap, struct vnode *n)
+{
+    slab_free(&pmap->m.slab, n);
+}
+
+errval_t pmap_refill_slabs(struct pmap *pmap, size_t max_slabs)
+{
+    errval_t err = pmap_slab_refill(pmap, &pmap->m.slab, max_slabs);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    pmap_slab_refill_check(pmap);
+    return SYS_ERR_OK;
+}
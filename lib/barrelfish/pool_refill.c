@@ -0,0 +1,173 @@
+/**
+ * \file
+ * \brief Watermark-driven deferred refill of allocator pools.
+ *
+ * The slab and slot allocators used by the pmap and the cspace code refill
+ * themselves lazily, from inside the map or allocation call that found them
+ * empty, and only by as much as that call needs. Such a refill allocates and
+ * maps memory, so every few allocations one of them becomes orders of
+ * magnitude slower than the common case. With a watermark, the allocation
+ * path that takes the pool below its low watermark only queues an event on
+ * the pool's waitset, and that event refills the pool up to a high watermark
+ * in one go, outside of any allocation call.
+ *
+ * The pmap and the root slot allocator are not locked. The refill event runs
+ * in whichever thread dispatches the waitset, between two of that thread's
+ * events, so it never interrupts an allocation of that thread. Against
+ * allocations in other threads it is no more and no less safe than those
+ * threads already are against each other. Refills of one pool are serialised
+ * by the pool's mutex.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/waitset_chan.h>
+#include <barrelfish/pool_refill.h>
+
+/**
+ * \brief Initialise a pool refill descriptor
+ *
+ * \param pool   Descriptor to initialise
+ * \param name   Name of the pool, for debugging
+ * \param level  Returns the number of free objects in the pool
+ * \param refill Refills the pool to a given number of free objects
+ * \param st     Argument passed to level and refill
+ * \param low    Low watermark
+ * \param high   High watermark, must be at least \c low
+ *
+ * Until a waitset is set with #pool_refill_set_waitset(), the pool is
+ * refilled in the thread that finds it low.
+ */
+void pool_refill_init(struct pool_refill *pool, const char *name,
+                      pool_level_func_t level, pool_refill_func_t refill,
+                      void *st, size_t low, size_t high)
+{
+    assert(low <= high);
+
+    waitset_chanstate_init(&pool->chan, CHANTYPE_EVENT_QUEUE);
+    pool->ws = NULL;
+    thread_mutex_init(&pool->mutex);
+    pool->name = name;
+    pool->level = level;
+    pool->refill = refill;
+    pool->st = st;
+    pool->low = low;
+    pool->high = high;
+    pool->kicks = pool->refills = pool->failures = 0;
+}
+
+/**
+ * \brief Set the waitset on which deferred refills run
+ *
+ * \param pool Pool descriptor
+ * \param ws   Waitset, or NULL to refill in the thread that finds the pool low
+ *
+ * Must not be called while a refill is queued.
+ */
+void pool_refill_set_waitset(struct pool_refill *pool, struct waitset *ws)
+{
+    assert(pool->chan.state == CHAN_UNREGISTERED);
+    pool->ws = ws;
+}
+
+/**
+ * \brief Change the watermarks of a pool
+ */
+void pool_refill_set_watermarks(struct pool_refill *pool, size_t low,
+                                size_t high)
+{
+    assert(low <= high);
+    pool->low = low;
+    pool->high = high;
+}
+
+static void pool_refill_handler(void *arg)
+{
+    struct pool_refill *pool = arg;
+
+    // the allocation path may have refilled the pool in the meantime
+    if (pool->level(pool->st) >= pool->low) {
+        return;
+    }
+
+    errval_t err = pool_refill_now(pool);
+    if (err_is_fail(err)) {
+        // Not fatal: the allocation path still refills synchronously, and
+        // reports the error if it fails there as well.
+        debug_printf("%s: deferred refill of %s failed: %s\n", __FUNCTION__,
+                     pool->name, err_getstring(err));
+    }
+}
+
+/**
+ * \brief Check a pool against its low watermark
+ *
+ * \param pool Pool descriptor
+ *
+ * If the pool is below its low watermark, queues a refill up to its high
+ * watermark on the pool's waitset, unless one is queued already. This is
+ * cheap and may be called from allocation fast paths. A pool without a
+ * waitset is refilled right away instead.
+ */
+void pool_refill_check(struct pool_refill *pool)
+{
+    if (pool->level(pool->st) >= pool->low) {
+        return;
+    }
+
+    if (pool->ws == NULL) {
+        errval_t err = pool_refill_now(pool);
+        if (err_is_fail(err)) {
+            debug_printf("%s: early refill of %s failed: %s\n", __FUNCTION__,
+                         pool->name, err_getstring(err));
+        }
+        return;
+    }
+
+    if (pool->chan.state != CHAN_UNREGISTERED) {
+        return; // already queued
+    }
+
+    errval_t err = waitset_chan_trigger_closure(pool->ws, &pool->chan,
+                                    MKCLOSURE(pool_refill_handler, pool));
+    if (err_is_ok(err)) {
+        pool->kicks++;
+    } else if (err_no(err) != LIB_ERR_CHAN_ALREADY_REGISTERED) {
+        DEBUG_ERR(err, "queueing refill of %s", pool->name);
+    }
+}
+
+/**
+ * \brief Refill a pool up to its high watermark in the calling thread
+ *
+ * \param pool Pool descriptor
+ *
+ * Used by the deferred refill, and by callers that need the pool full now.
+ * Only one refill of a pool runs at a time. If a refill of the same pool is
+ * already in progress, either in another thread or because the refill itself
+ * allocates from the pool, returns without doing anything.
+ */
+errval_t pool_refill_now(struct pool_refill *pool)
+{
+    if (!thread_mutex_trylock(&pool->mutex)) {
+        return SYS_ERR_OK;
+    }
+
+    errval_t err = pool->refill(pool->st, pool->high);
+    if (err_is_fail(err)) {
+        pool->failures++;
+    } else {
+        pool->refills++;
+    }
+
+    thread_mutex_unlock(&pool->mutex);
+    return err;
+}
@@ -12,8 +12,10 @@
  * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
  */
 
+#include <string.h>
 #include <barrelfish/barrelfish.h>
 #include <barrelfish/core_state.h>
+#include <barrelfish_kpi/cnode_batch.h>
 
 #include <if/monitor_defs.h>
 #include <if/mem_defs.h>
@@ -21,6 +23,49 @@
 #include <if/hyper_defs.h>
 #endif
 
+/// Take a cap from the cache of page-sized RAM caps
+static bool page_cache_get(struct ram_alloc_state *state, struct capref *ret)
+{
+    bool found = false;
+
+    thread_mutex_lock(&state->ram_alloc_lock);
+    if (state->page_cache_count > 0) {
+        *ret = state->page_cache[--state->page_cache_count];
+        found = true;
+    }
+    thread_mutex_unlock(&state->ram_alloc_lock);
+
+    return found;
+}
+
+/// Put caps into the cache of page-sized RAM caps, returning any surplus
+static void page_cache_put(struct ram_alloc_state *state, struct capref *caps,
+                           size_t count)
+{
+    size_t i;
+
+    thread_mutex_lock(&state->ram_alloc_lock);
+    for (i = 0; i < count && state->page_cache_count < RAM_ALLOC_PAGE_BATCH;
+         i++) {
+        state->page_cache[state->page_cache_count++] = caps[i];
+    }
+    thread_mutex_unlock(&state->ram_alloc_lock);
+
+    if (i == count) {
+        return;
+    }
+
+    errval_t err = ram_free_batch(&caps[i], count - i);
+    if (err_no(err) == LIB_ERR_CNODE_CREATE || err_no(err) == LIB_ERR_CAP_COPY) {
+        // the caps were not handed over, drop them here
+        for (; i < count; i++) {
+            cap_destroy(caps[i]);
+        }
+    } else if (err_is_fail(err)) {
+        DEBUG_ERR(err, "ram_free_batch of surplus page caps");
+    }
+}
+
 /* remote (indirect through a channel) version of ram_alloc, for most domains */
 static errval_t ram_alloc_remote(struct capref *ret, uint8_t size_bits,
                                  uint64_t minbase, uint64_t maxlimit)
@@ -28,6 +73,30 @@ static errval_t ram_alloc_remote(struct capref *ret, uint8_t size_bits,
     struct ram_alloc_state *ram_alloc_state = get_ram_alloc_state();
     errval_t err, result;
 
+    // Page-sized caps without constraints (page tables, slab refills) are
+    // fetched RAM_ALLOC_PAGE_BATCH at a time, with a single request.
+    if (size_bits == BASE_PAGE_BITS && minbase == 0 && maxlimit == 0
+        && !ram_alloc_state->page_cache_refilling) {
+        if (page_cache_get(ram_alloc_state, ret)) {
+            return SYS_ERR_OK;
+        }
+
+        struct capref caps[RAM_ALLOC_PAGE_BATCH];
+        uint8_t bits[RAM_ALLOC_PAGE_BATCH];
+        memset(bits, BASE_PAGE_BITS, sizeof(bits));
+
+        // ram_alloc_batch() may itself need RAM to allocate slots
+        ram_alloc_state->page_cache_refilling = true;
+        err = ram_alloc_batch(caps, bits, RAM_ALLOC_PAGE_BATCH);
+        ram_alloc_state->page_cache_refilling = false;
+        if (err_is_ok(err)) {
+            *ret = caps[0];
+            page_cache_put(ram_alloc_state, &caps[1], RAM_ALLOC_PAGE_BATCH - 1);
+            return SYS_ERR_OK;
+        }
+        // fall back to a single request
+    }
+
     // XXX: the transport that ram_alloc uses will allocate slots,
     // which may cause slot_allocator to grow itself.
     // To grow itself, the slot_allocator needs to call ram_alloc.
@@ -178,6 +247,235 @@ errval_t ram_alloc(struct capref *ret, uint8_t size_bits)
     return err;
 }
 
+/**
+ * \brief Copy RAM caps out of a CNode returned by the mem_serv
+ *
+ * \param cnode CNode with the caps in slots 0..count-1, which is destroyed
+ * \param ret   Array of `count` allocated slots, filled in with the caps
+ * \param count Number of caps
+ *
+ * On failure, none of the caps are kept.
+ */
+static errval_t copy_out_ram(struct capref cnode, struct capref *ret,
+                             size_t count)
+{
+    errval_t err;
+
+    // Mount the CNode in our root CNode, and copy the caps out of it
+    struct capref cnode_root;
+    err = slot_alloc_root(&cnode_root);
+    if (err_is_fail(err)) {
+        cap_destroy(cnode);
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
+    err = cap_copy(cnode_root, cnode);
+    cap_destroy(cnode);
+    if (err_is_fail(err)) {
+        slot_free(cnode_root);
+        return err;
+    }
+
+    struct capref src = {
+        .cnode = build_cnoderef(cnode_root, CNODE_TYPE_OTHER),
+        .slot  = 0,
+    };
+    struct capref srcs[CNODE_BATCH_MAX];
+    size_t copied = 0;
+    err = SYS_ERR_OK;
+    while (copied < count) {
+        size_t n = count - copied;
+        if (n > CNODE_BATCH_MAX) {
+            n = CNODE_BATCH_MAX;
+        }
+        for (size_t j = 0; j < n; j++) {
+            srcs[j] = src;
+            srcs[j].slot = copied + j;
+        }
+        err = cap_copy_slots(&ret[copied], srcs, n);
+        if (err_is_fail(err)) {
+            break;
+        }
+        copied += n;
+    }
+
+    // Deleting the CNode deletes the caps we did not copy out
+    cap_destroy(cnode_root);
+
+    if (err_is_fail(err)) {
+        for (size_t i = 0; i < copied; i++) {
+            cap_delete(ret[i]);
+        }
+    }
+    return err;
+}
+
+/**
+ * \brief Allocates a number of RAM capabilities with a single request
+ *
+ * \param ret       Array of `count` caprefs, filled in with the caps
+ * \param size_bits Array of `count` sizes, as powers of two
+ * \param count     Number of caps to allocate, at most #RAM_ALLOC_BATCH_MAX
+ *
+ * Either all or none of the caps are allocated. The mem_serv returns the
+ * caps in a CNode, from which they are copied into newly-allocated slots.
+ * Domains with a local allocator (see ram_alloc_set()) allocate one by one.
+ */
+errval_t ram_alloc_batch(struct capref *ret, const uint8_t *size_bits,
+                         size_t count)
+{
+    struct ram_alloc_state *ram_alloc_state = get_ram_alloc_state();
+    errval_t err, result;
+    size_t i;
+
+    assert(count <= RAM_ALLOC_BATCH_MAX);
+
+    if (count == 0) {
+        return SYS_ERR_OK;
+    }
+
+    if (ram_alloc_state->ram_alloc_func != ram_alloc_remote) {
+        for (i = 0; i < count; i++) {
+            err = ram_alloc(&ret[i], size_bits[i]);
+            if (err_is_fail(err)) {
+                while (i-- > 0) {
+                    cap_destroy(ret[i]);
+                }
+                return err;
+            }
+        }
+        return SYS_ERR_OK;
+    }
+
+    // Allocate the slots first, as this may need RAM itself
+    for (i = 0; i < count; i++) {
+        err = slot_alloc(&ret[i]);
+        if (err_is_fail(err)) {
+            err = err_push(err, LIB_ERR_SLOT_ALLOC);
+            goto out_slots;
+        }
+    }
+
+    struct capref cnode;
+    uint32_t allocated;
+
+    thread_mutex_lock(&ram_alloc_state->ram_alloc_lock);
+
+    struct mem_binding *b = get_mem_client();
+    err = b->rpc_tx_vtbl.allocate_batch(b, size_bits, count,
+                                        ram_alloc_state->default_minbase,
+                                        ram_alloc_state->default_maxlimit,
+                                        &result, &allocated, &cnode);
+
+    thread_mutex_unlock(&ram_alloc_state->ram_alloc_lock);
+
+    if (err_is_fail(err)) {
+        err = err_push(err, LIB_ERR_RAM_ALLOC_BATCH);
+        goto out_slots;
+    }
+    if (capref_is_null(cnode)) {
+        err = err_is_fail(result) ? result : LIB_ERR_RAM_ALLOC_BATCH;
+        goto out_slots;
+    }
+
+    if (allocated > count) {
+        allocated = count;
+    }
+
+    err = copy_out_ram(cnode, ret, allocated);
+    if (err_is_ok(err) && allocated < count) {
+        for (i = 0; i < allocated; i++) {
+            cap_delete(ret[i]);
+        }
+        err = err_is_fail(result) ? result : LIB_ERR_RAM_ALLOC_BATCH;
+    }
+    if (err_is_ok(err)) {
+        return SYS_ERR_OK;
+    }
+
+    i = count;
+
+out_slots:
+    while (i-- > 0) {
+        slot_free(ret[i]);
+    }
+    return err;
+}
+
+/**
+ * \brief Returns a number of RAM capabilities with a single request
+ *
+ * \param caps  Array of `count` RAM caps, which are deleted
+ * \param count Number of caps, at most #RAM_ALLOC_BATCH_MAX
+ *
+ * The mem_serv revokes the caps before reusing their memory, so any copies
+ * and descendants of the caps are deleted as well. Caps that still have an
+ * ancestor (e.g. RAM retyped from a larger cap the caller kept) are not
+ * taken back, and LIB_ERR_RAM_FREE_SHARED is returned.
+ *
+ * If this fails with LIB_ERR_CNODE_CREATE or LIB_ERR_CAP_COPY, the caps were
+ * left untouched. Otherwise they have been deleted.
+ */
+errval_t ram_free_batch(struct capref *caps, size_t count)
+{
+    struct ram_alloc_state *ram_alloc_state = get_ram_alloc_state();
+    errval_t err, result;
+
+    assert(count <= RAM_ALLOC_BATCH_MAX);
+
+    if (ram_alloc_state->ram_alloc_func != ram_alloc_remote) {
+        for (size_t i = 0; i < count; i++) {
+            err = cap_destroy(caps[i]);
+            if (err_is_fail(err)) {
+                return err_push(err, LIB_ERR_CAP_DESTROY);
+            }
+        }
+        return SYS_ERR_OK;
+    }
+
+    struct capref cnode;
+    struct cnoderef cnoder;
+    err = cnode_create_l2(&cnode, &cnoder);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_CNODE_CREATE);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        struct capref dest = {
+            .cnode = cnoder,
+            .slot  = i,
+        };
+        err = cap_copy(dest, caps[i]);
+        if (err_is_fail(err)) {
+            cap_destroy(cnode);
+            return err_push(err, LIB_ERR_CAP_COPY);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        err = cap_destroy(caps[i]);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "cap_destroy in ram_free_batch");
+        }
+    }
+
+    thread_mutex_lock(&ram_alloc_state->ram_alloc_lock);
+
+    struct mem_binding *b = get_mem_client();
+    err = b->rpc_tx_vtbl.free_batch(b, cnode, count, &result);
+
+    thread_mutex_unlock(&ram_alloc_state->ram_alloc_lock);
+
+    if (err_is_fail(err)) {
+        cap_destroy(cnode);
+        return err_push(err, LIB_ERR_RAM_FREE_BATCH);
+    }
+
+    // the CNode was given away with the request
+    slot_free(cnode);
+
+    return result;
+}
+
 errval_t ram_available(genpaddr_t *available, genpaddr_t *total)
 {
     errval_t err;
@@ -192,6 +490,175 @@ errval_t ram_available(genpaddr_t *available, genpaddr_t *total)
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Allocates RAM on a NUMA node
+ *
+ * \param ret       Pointer to capref struct, filled-in with the cap
+ * \param size_bits Amount of RAM to allocate, as a power of two
+ * \param node      NUMA node (SRAT proximity domain) of the RAM
+ *
+ * Without SRAT data, the mem_serv treats all memory as node 0. Domains with
+ * a local allocator (see ram_alloc_set()) ignore the node.
+ */
+errval_t ram_alloc_node(struct capref *ret, uint8_t size_bits, uint32_t node)
+{
+    struct ram_alloc_state *ram_alloc_state = get_ram_alloc_state();
+    errval_t err, result;
+
+    if (ram_alloc_state->ram_alloc_func != ram_alloc_remote) {
+        return ram_alloc(ret, size_bits);
+    }
+
+    err = slot_alloc(ret);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
+
+    thread_mutex_lock(&ram_alloc_state->ram_alloc_lock);
+
+    struct mem_binding *b = get_mem_client();
+    err = b->rpc_tx_vtbl.allocate_node(b, size_bits, node, &result, ret);
+
+    thread_mutex_unlock(&ram_alloc_state->ram_alloc_lock);
+
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_RAM_ALLOC_NODE);
+    }
+
+    return result;
+}
+
+/**
+ * \brief Allocates RAM interleaved across NUMA nodes
+ *
+ * \param ret        Array of 2^(size_bits - chunk_bits) caprefs, filled in
+ *                   with the caps
+ * \param size_bits  Total amount of RAM to allocate, as a power of two
+ * \param chunk_bits Size of each cap, as a power of two
+ * \param nodemask   Nodes to take the caps from in turn, lowest node first
+ *
+ * Either all or none of the caps are allocated.
+ */
+errval_t ram_alloc_interleaved(struct capref *ret, uint8_t size_bits,
+                               uint8_t chunk_bits, uint64_t nodemask)
+{
+    struct ram_alloc_state *ram_alloc_state = get_ram_alloc_state();
+    errval_t err, result;
+    size_t i;
+
+    if (chunk_bits > size_bits || size_bits - chunk_bits > L2_CNODE_BITS) {
+        return LIB_ERR_RAM_ALLOC_WRONG_SIZE;
+    }
+    size_t count = 1UL << (size_bits - chunk_bits);
+
+    if (ram_alloc_state->ram_alloc_func != ram_alloc_remote) {
+        for (i = 0; i < count; i++) {
+            err = ram_alloc(&ret[i], chunk_bits);
+            if (err_is_fail(err)) {
+                while (i-- > 0) {
+                    cap_destroy(ret[i]);
+                }
+                return err;
+            }
+        }
+        return SYS_ERR_OK;
+    }
+
+    for (i = 0; i < count; i++) {
+        err = slot_alloc(&ret[i]);
+        if (err_is_fail(err)) {
+            err = err_push(err, LIB_ERR_SLOT_ALLOC);
+            goto out_slots;
+        }
+    }
+
+    struct capref cnode;
+    uint32_t allocated;
+
+    thread_mutex_lock(&ram_alloc_state->ram_alloc_lock);
+
+    struct mem_binding *b = get_mem_client();
+    err = b->rpc_tx_vtbl.allocate_interleaved(b, size_bits, chunk_bits,
+                                              nodemask, &result, &allocated,
+                                              &cnode);
+
+    thread_mutex_unlock(&ram_alloc_state->ram_alloc_lock);
+
+    if (err_is_fail(err)) {
+        err = err_push(err, LIB_ERR_RAM_ALLOC_INTERLEAVED);
+        goto out_slots;
+    }
+    if (capref_is_null(cnode)) {
+        err = err_is_fail(result) ? result : LIB_ERR_RAM_ALLOC_INTERLEAVED;
+        goto out_slots;
+    }
+
+    if (allocated > count) {
+        allocated = count;
+    }
+
+    err = copy_out_ram(cnode, ret, allocated);
+    if (err_is_ok(err) && allocated < count) {
+        for (i = 0; i < allocated; i++) {
+            cap_delete(ret[i]);
+        }
+        err = err_is_fail(result) ? result : LIB_ERR_RAM_ALLOC_INTERLEAVED;
+    }
+    if (err_is_ok(err)) {
+        return SYS_ERR_OK;
+    }
+
+    i = count;
+
+out_slots:
+    while (i-- > 0) {
+        slot_free(ret[i]);
+    }
+    return err;
+}
+
+/**
+ * \brief Returns the free and total RAM of a NUMA node
+ */
+errval_t ram_available_node(uint32_t node, genpaddr_t *available,
+                            genpaddr_t *total)
+{
+    errval_t err, result;
+
+    struct mem_binding *mc = get_mem_client();
+
+    err = mc->rpc_tx_vtbl.available_node(mc, node, &result, available, total);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return result;
+}
+
+/**
+ * \brief Tells the mem_serv that [base, limit) is memory of a NUMA node
+ *
+ * Meant to be called by acpi for each memory affinity entry in the SRAT.
+ *
+ * \param physaddr  A PhysAddr cap, proving that the caller is trusted with
+ *                  the physical address space
+ */
+errval_t ram_add_node_range(struct capref physaddr, uint32_t node,
+                            genpaddr_t base, genpaddr_t limit)
+{
+    errval_t err, result;
+
+    struct mem_binding *mc = get_mem_client();
+
+    err = mc->rpc_tx_vtbl.add_node_range(mc, physaddr, node, base, limit,
+                                         &result);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return result;
+}
+
 static void bind_continuation(void *st, errval_t err, struct mem_binding *b)
 {
     struct ram_alloc_state *ram_alloc_state = st;
@@ -234,6 +701,8 @@ void ram_alloc_init(void)
     ram_alloc_state->default_maxlimit = 0;
     ram_alloc_state->base_capnum      = 0;
     ram_alloc_state->earlycn_capnum   = 0;
+    ram_alloc_state->page_cache_count = 0;
+    ram_alloc_state->page_cache_refilling = false;
 }
 
 /**
@@ -0,0 +1,242 @@
+/**
+ * \file
+ * \brief Per-thread magazine caches in front of a slab allocator.
+ *
+ * This implements the magazine layer described by Bonwick and Adams
+ * ("Magazines and Vmem", USENIX 2001) on top of the simple slab allocator.
+ * Each thread keeps two magazines of free blocks in its #slab_cache, and
+ * allocates and frees from those without synchronisation. Only when both are
+ * empty (on allocation) or full (on free) does it take the depot lock, to
+ * exchange a whole magazine, or in the worst case to go to the slabs.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/slab_magazine.h>
+
+/**
+ * \brief Initialise a magazine depot
+ *
+ * \param depot Depot to initialise
+ * \param slabs Backing slab allocator. From now on, it must only be accessed
+ *              through the depot and its caches.
+ */
+void slab_depot_init(struct slab_depot *depot, struct slab_allocator *slabs)
+{
+    depot->lock = 0;
+    depot->slabs = slabs;
+    slab_init(&depot->magazines, sizeof(struct slab_magazine),
+              slab_default_refill);
+    depot->full = depot->empty = NULL;
+    depot->exchanges = depot->slab_allocs = depot->slab_frees = 0;
+}
+
+/// Get an empty magazine from the depot. Called with the depot lock held.
+static struct slab_magazine *depot_get_empty(struct slab_depot *depot)
+{
+    struct slab_magazine *mag = depot->empty;
+    if (mag != NULL) {
+        depot->empty = mag->next;
+    } else {
+        mag = slab_alloc(&depot->magazines);
+        if (mag == NULL) {
+            return NULL;
+        }
+    }
+    mag->rounds = 0;
+    mag->next = NULL;
+    return mag;
+}
+
+/**
+ * \brief Initialise a per-thread cache on a depot
+ *
+ * \param cache Cache to initialise
+ * \param depot Depot to exchange magazines with
+ */
+errval_t slab_cache_init(struct slab_cache *cache, struct slab_depot *depot)
+{
+    cache->depot = depot;
+    cache->allocs = cache->frees = cache->hits = 0;
+
+    acquire_spinlock(&depot->lock);
+    cache->loaded = depot_get_empty(depot);
+    cache->previous = depot_get_empty(depot);
+    release_spinlock(&depot->lock);
+
+    if (cache->loaded == NULL || cache->previous == NULL) {
+        // leaves the cache without magazines, but usable
+        slab_cache_flush(cache);
+        return LIB_ERR_SLAB_ALLOC_FAIL;
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Return all blocks and magazines held by a cache to its depot
+ *
+ * Afterwards the cache has no magazines. It can still be used, but takes the
+ * depot lock on every call until it is re-initialised with slab_cache_init().
+ */
+void slab_cache_flush(struct slab_cache *cache)
+{
+    struct slab_depot *depot = cache->depot;
+    struct slab_magazine *mags[2] = { cache->loaded, cache->previous };
+
+    acquire_spinlock(&depot->lock);
+    for (int i = 0; i < 2; i++) {
+        struct slab_magazine *mag = mags[i];
+        if (mag == NULL) {
+            continue;
+        }
+        if (mag->rounds == SLAB_MAGAZINE_ROUNDS) {
+            mag->next = depot->full;
+            depot->full = mag;
+        } else {
+            while (mag->rounds > 0) {
+                slab_free(depot->slabs, mag->blocks[--mag->rounds]);
+                depot->slab_frees++;
+            }
+            mag->next = depot->empty;
+            depot->empty = mag;
+        }
+    }
+    release_spinlock(&depot->lock);
+
+    cache->loaded = cache->previous = NULL;
+}
+
+static inline void swap_magazines(struct slab_cache *cache)
+{
+    struct slab_magazine *tmp = cache->loaded;
+    cache->loaded = cache->previous;
+    cache->previous = tmp;
+}
+
+/**
+ * \brief Allocate a zeroed block through a per-thread cache
+ *
+ * \returns Pointer to block on success, NULL on error (out of memory)
+ */
+void *slab_cache_alloc(struct slab_cache *cache)
+{
+    struct slab_depot *depot = cache->depot;
+    void *block;
+
+    cache->allocs++;
+
+    if (cache->loaded == NULL) {
+        // no magazines, go to the slabs
+        acquire_spinlock(&depot->lock);
+        block = slab_alloc(depot->slabs);
+        if (block != NULL) {
+            depot->slab_allocs++;
+        }
+        release_spinlock(&depot->lock);
+        return block;
+    }
+
+    if (cache->loaded->rounds == 0 && cache->previous->rounds > 0) {
+        swap_magazines(cache);
+    }
+
+    if (cache->loaded->rounds > 0) {
+        cache->hits++;
+        block = cache->loaded->blocks[--cache->loaded->rounds];
+        memset(block, 0, depot->slabs->blocksize);
+        return block;
+    }
+
+    // both magazines are empty: trade one for a full one from the depot
+    acquire_spinlock(&depot->lock);
+    if (depot->full != NULL) {
+        struct slab_magazine *full = depot->full;
+        depot->full = full->next;
+        cache->previous->next = depot->empty;
+        depot->empty = cache->previous;
+        cache->previous = cache->loaded;
+        cache->loaded = full;
+        depot->exchanges++;
+        release_spinlock(&depot->lock);
+
+        block = cache->loaded->blocks[--cache->loaded->rounds];
+        memset(block, 0, depot->slabs->blocksize);
+        return block;
+    }
+
+    // nothing cached anywhere, go to the slabs
+    block = slab_alloc(depot->slabs);
+    if (block != NULL) {
+        depot->slab_allocs++;
+    }
+    release_spinlock(&depot->lock);
+    return block;
+}
+
+/**
+ * \brief Free a block through a per-thread cache
+ *
+ * \param cache Cache of the calling thread
+ * \param block Block previously returned by slab_cache_alloc() on any cache
+ *              of the same depot
+ */
+void slab_cache_free(struct slab_cache *cache, void *block)
+{
+    struct slab_depot *depot = cache->depot;
+
+    if (block == NULL) {
+        return;
+    }
+
+    cache->frees++;
+
+    if (cache->loaded == NULL) {
+        // no magazines, give the block straight back to the slabs
+        acquire_spinlock(&depot->lock);
+        slab_free(depot->slabs, block);
+        depot->slab_frees++;
+        release_spinlock(&depot->lock);
+        return;
+    }
+
+    if (cache->loaded->rounds == SLAB_MAGAZINE_ROUNDS
+        && cache->previous->rounds < SLAB_MAGAZINE_ROUNDS) {
+        swap_magazines(cache);
+    }
+
+    if (cache->loaded->rounds < SLAB_MAGAZINE_ROUNDS) {
+        cache->hits++;
+        cache->loaded->blocks[cache->loaded->rounds++] = block;
+        return;
+    }
+
+    // both magazines are full: trade one for an empty one from the depot
+    acquire_spinlock(&depot->lock);
+    struct slab_magazine *empty = depot_get_empty(depot);
+    if (empty != NULL) {
+        cache->previous->next = depot->full;
+        depot->full = cache->previous;
+        cache->previous = cache->loaded;
+        cache->loaded = empty;
+        depot->exchanges++;
+        release_spinlock(&depot->lock);
+
+        cache->loaded->blocks[cache->loaded->rounds++] = block;
+        return;
+    }
+
+    // couldn't get a magazine, give the block straight back to the slabs
+    slab_free(depot->slabs, block);
+    depot->slab_frees++;
+    release_spinlock(&depot->lock);
+}
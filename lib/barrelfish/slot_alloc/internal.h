@@ -21,4 +21,6 @@ errval_t multi_free(struct slot_allocator *ca, struct capref cap);
 errval_t two_level_alloc(struct slot_allocator *ca, struct capref *ret);
 errval_t two_level_free(struct slot_allocator *ca, struct capref cap);
 
+void root_slot_allocator_refill_check(void);
+
 #endif //SLOT_ALLOC_INTERNAL_H_
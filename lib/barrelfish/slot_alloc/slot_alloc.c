@@ -20,8 +20,17 @@
 #include <barrelfish/barrelfish.h>
 #include <barrelfish/core_state.h>
 #include <barrelfish/caddr.h>
+#include <barrelfish/pool_refill.h>
 #include "internal.h"
 
+// Resize the root cnode early once fewer than this many slots are left in it.
+// A resize at least doubles the root cnode, so the high watermark does not
+// need to be any higher.
+#define ROOTCN_LOW_WATERMARK 16
+
+/// Deferred refill state for the root slot allocator
+static struct pool_refill rootcn_pool;
+
 
 /**
  * \brief Returns the default slot allocator for the caller
@@ -68,7 +77,11 @@ errval_t slot_alloc_root(struct capref *ret)
         }
     }
     struct slot_allocator *ca = (struct slot_allocator*)(&state->rootca);
-    return ca->alloc(ca, ret);
+    err = ca->alloc(ca, ret);
+    if (err_is_ok(err)) {
+        root_slot_allocator_refill_check();
+    }
+    return err;
 }
 
 typedef errval_t (*cn_ram_alloc_func_t)(void *st, uint8_t reqbits, struct capref *ret);
@@ -134,6 +147,36 @@ errval_t root_slot_allocator_refill(cn_ram_alloc_func_t myalloc, void *allocst)
     return single_slot_alloc_resize(sca, nslots * 2);
 }
 
+static size_t rootcn_level(void *st)
+{
+    struct single_slot_allocator *sca = st;
+    return single_slot_alloc_freecount(sca);
+}
+
+static errval_t rootcn_refill(void *st, size_t target)
+{
+    struct single_slot_allocator *sca = st;
+    while (single_slot_alloc_freecount(sca) < target) {
+        errval_t err = root_slot_allocator_refill(NULL, NULL);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_ROOTSA_RESIZE);
+        }
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Queue a resize of the root cnode if it is running low
+ *
+ * The resize runs from the default waitset. The allocation paths still
+ * resize the root cnode when it is about to run out, but normally the
+ * deferred resize gets there first.
+ */
+void root_slot_allocator_refill_check(void)
+{
+    pool_refill_check(&rootcn_pool);
+}
+
 /**
  * \brief Default slot free
  *
@@ -205,6 +248,11 @@ errval_t slot_alloc_init(void)
     state->rootca.head->space = L2_CNODE_SLOTS - ROOTCN_FREE_SLOTS;
     state->rootca.head->slot  = ROOTCN_FREE_SLOTS;
 
+    pool_refill_init(&rootcn_pool, "root cnode slots", rootcn_level,
+                     rootcn_refill, &state->rootca, ROOTCN_LOW_WATERMARK,
+                     ROOTCN_LOW_WATERMARK);
+    pool_refill_set_waitset(&rootcn_pool, get_default_waitset());
+
     // Head
     cap.cnode = cnode_root;
     cap.slot  = ROOTCN_SLOT_SLOT_ALLOC1;
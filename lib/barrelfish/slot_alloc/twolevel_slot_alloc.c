@@ -77,6 +77,7 @@ errval_t two_level_alloc(struct slot_allocator *ca, struct capref *ret)
             DEBUG_ERR(err, "allocating root cnode slot failed");
             return err_push(err, LIB_ERR_SLOT_ALLOC);
         }
+        root_slot_allocator_refill_check();
         err = cnode_create_raw(cap, &cnode, ObjType_L2CNode, ca->nslots, NULL);
         if (err_is_fail(err)) {
             return err_push(err, LIB_ERR_CNODE_CREATE);
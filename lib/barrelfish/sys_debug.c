@@ -70,6 +70,27 @@ errval_t sys_debug_print_timeslice(void)
     return err;
 }
 
+errval_t sys_debug_get_wakeup_stats(struct wakeup_stats *stats)
+{
+    uint64_t *fields[WAKEUP_STAT_COUNT] = {
+        [WAKEUP_STAT_SET]           = &stats->set,
+        [WAKEUP_STAT_COALESCED]     = &stats->coalesced,
+        [WAKEUP_STAT_FIRED]         = &stats->fired,
+        [WAKEUP_STAT_CHECKS]        = &stats->checks,
+        [WAKEUP_STAT_IDLE_ENTRIES]  = &stats->idle_entries,
+        [WAKEUP_STAT_TICKS_SKIPPED] = &stats->ticks_skipped,
+    };
+
+    for (int i = 0; i < WAKEUP_STAT_COUNT; i++) {
+        struct sysret sr = syscall3(SYSCALL_DEBUG, DEBUG_GET_WAKEUP_STAT, i);
+        if (err_is_fail(sr.error)) {
+            return sr.error;
+        }
+        *fields[i] = sr.value;
+    }
+    return SYS_ERR_OK;
+}
+
 errval_t sys_debug_flush_cache(void)
 {
     return syscall2(SYSCALL_DEBUG, DEBUG_FLUSH_CACHE).error;
@@ -20,6 +20,7 @@
 #include <barrelfish/dispatcher_arch.h>
 #include <barrelfish/debug.h>
 #include <barrelfish/slab.h>
+#include <barrelfish/slab_magazine.h>
 #include <barrelfish/caddr.h>
 #include <barrelfish/curdispatcher_arch.h>
 #include <barrelfish/vspace_mmu_aware.h>
@@ -58,15 +59,15 @@ static struct thread_mutex staticthread_lock = THREAD_MUTEX_INITIALIZER;
 static struct slab_allocator thread_slabs;
 static struct vspace_mmu_aware thread_slabs_vm;
 
-// XXX: mutex and spinlock protecting thread slabs in spanned domains
-/* This ought to be just a mutex. However, thread_create() is called on the
- * inter-disp message handler thread, and if it blocks in a mutex, there is no
- * way to wake it up and we will deadlock. This is a quick-fix workaround:
- *   The spinlock protects the data structure
- *   The mutex avoids unneccessary spinning (it is acquired first when safe)
+/* Magazine depot in front of thread_slabs. Threads of spanned domains
+ * create and free threads concurrently on all their dispatchers; each thread
+ * does so through the magazines in its own TCB (thread->slab_cache), and
+ * only takes the depot lock to exchange a whole magazine. The depot lock is
+ * a spinlock, because thread_create() is called on the inter-disp message
+ * handler thread, and if it blocks in a mutex, there is no way to wake it up
+ * and we will deadlock.
  */
-static spinlock_t thread_slabs_spinlock;
-static struct thread_mutex thread_slabs_mutex = THREAD_MUTEX_INITIALIZER;
+static struct slab_depot thread_slab_depot;
 
 /// Base and size of the original ("pristine") thread-local storage init data
 static void *tls_block_init_base;
@@ -309,6 +310,22 @@ void thread_run_disabled(dispatcher_handle_t handle)
     }
 }
 
+/**
+ * \brief Return the calling thread's cache of thread slabs
+ *
+ * The cache lives in the TCB and is set up on first use, which also covers
+ * the static thread and the threads of a new dispatcher.
+ */
+static struct slab_cache *thread_slab_cache(void)
+{
+    struct slab_cache *cache = &thread_self()->slab_cache;
+    if (cache->depot == NULL) {
+        // on failure the cache goes to the depot on every call
+        slab_cache_init(cache, &thread_slab_depot);
+    }
+    return cache;
+}
+
 /** Free all heap/slab-allocated state associated with a thread */
 static void free_thread(struct thread *thread)
 {
@@ -333,11 +350,12 @@ static void free_thread(struct thread *thread)
         free(thread->tls_dtv);
     }
 
-    thread_mutex_lock(&thread_slabs_mutex);
-    acquire_spinlock(&thread_slabs_spinlock);
-    slab_free(&thread_slabs, thread->slab); // frees thread itself
-    release_spinlock(&thread_slabs_spinlock);
-    thread_mutex_unlock(&thread_slabs_mutex);
+    // the thread has exited, return its magazines before freeing its TCB
+    if (thread->slab_cache.depot != NULL) {
+        slab_cache_flush(&thread->slab_cache);
+    }
+    // frees thread itself
+    slab_cache_free(thread_slab_cache(), thread->slab);
 }
 
 #define ALIGN_PTR(ptr, alignment) ((((uintptr_t)(ptr)) + (alignment) - 1) & ~((alignment) - 1))
@@ -362,12 +380,7 @@ struct thread *thread_create_unrunnable(thread_func_t start_func, void *arg,
     }
 
     // allocate space for TCB + initial TLS data
-    // no mutex as it may deadlock: see comment for thread_slabs_spinlock
-    // thread_mutex_lock(&thread_slabs_mutex);
-    acquire_spinlock(&thread_slabs_spinlock);
-    void *space = slab_alloc(&thread_slabs);
-    release_spinlock(&thread_slabs_spinlock);
-    // thread_mutex_unlock(&thread_slabs_mutex);
+    void *space = slab_cache_alloc(thread_slab_cache());
     if (space == NULL) {
         free(stack);
         return NULL;
@@ -1140,6 +1153,7 @@ static int bootstrap_thread(struct spawn_domain_params *params)
     // slabs above 4G.
     //assert(vregion_get_base_addr(&thread_slabs_vm.vregion) + vregion_get_size(&thread_slabs_vm.vregion) < 1ul << 32);
     slab_init(&thread_slabs, blocksize, refill_thread_slabs);
+    slab_depot_init(&thread_slab_depot, &thread_slabs);
 
     if (init_domain_global) {
         // run main() on this thread, since we can't allocate
@@ -1245,8 +1259,7 @@ void threads_prepare_to_span(dispatcher_handle_t newdh)
     if (!called) {
         called = true;
 
-        thread_mutex_lock(&thread_slabs_mutex);
-        acquire_spinlock(&thread_slabs_spinlock);
+        acquire_spinlock(&thread_slab_depot.lock);
 
         while (slab_freecount(&thread_slabs) < MAX_THREADS - 1) {
             size_t size;
@@ -1269,8 +1282,7 @@ void threads_prepare_to_span(dispatcher_handle_t newdh)
             slab_grow(&thread_slabs, buf, size);
         }
 
-        release_spinlock(&thread_slabs_spinlock);
-        thread_mutex_unlock(&thread_slabs_mutex);
+        release_spinlock(&thread_slab_depot.lock);
     }
 }
 
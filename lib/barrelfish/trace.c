@@ -3,6 +3,9 @@
  * \brief This file is a hack because essentially all subsystems need to link
  * against these variables and putting them in lib/trace means linking
  * everything against lib/trace
+ *
+ * It also holds the allocation of per-core state and trace rings from the
+ * trace buffer, which every dispatcher needs when it sets up tracing.
  */
 
 /*
@@ -15,7 +18,232 @@
  */
 
 #include <barrelfish/barrelfish.h>
+#include <barrelfish/dispatch.h>
 #include <trace/trace.h>
 
 lvaddr_t trace_buffer_master;
-lvaddr_t trace_buffer_va;
+
+/**
+ * \brief Allocate space from the trace buffer
+ *
+ * Domains on all cores allocate concurrently, so this uses locked atomics.
+ * Space is never freed, but the rings of exited dispatchers are reused.
+ *
+ * \returns offset of the allocation, or 0 if the buffer is full
+ */
+static uintptr_t trace_arena_alloc(size_t bytes)
+{
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
+
+    // The first allocation skips the control structure
+    __sync_bool_compare_and_swap(&master->used, 0,
+                                 ROUND_UP(sizeof(struct trace_buffer),
+                                          TRACE_ALIGN));
+
+    bytes = ROUND_UP(bytes, TRACE_ALIGN);
+    uintptr_t offset;
+    do {
+        offset = master->used;
+        // A failed allocation leaves the space to smaller ones
+        if (bytes > master->size || offset > master->size - bytes) {
+            return 0;
+        }
+    } while (!__sync_bool_compare_and_swap(&master->used, offset,
+                                           offset + bytes));
+
+    memset((uint8_t *)master + offset, 0, bytes);
+    return offset;
+}
+
+/**
+ * \brief Allocate a trace ring on a core with the core's configuration
+ *
+ * \returns offset of the ring, or 0 if the buffer is full
+ */
+static uintptr_t trace_ring_alloc(struct trace_core *core, const char *name)
+{
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
+
+    uintptr_t offset = trace_arena_alloc(TRACE_RING_BYTES(core->ring_events));
+    if (offset == 0) {
+        return 0;
+    }
+
+    struct trace_ring *ring = trace_offset_to_ptr(master, offset);
+    ring->size = core->ring_events;
+    ring->overflow = core->overflow;
+    strncpy(ring->name, name, sizeof(ring->name));
+
+    return offset;
+}
+
+/**
+ * \brief Find or create the trace state of a core
+ *
+ * New cores get TRACE_DEFAULT_RING_EVENTS and stop on overflow, until
+ * their monitor configures them with trace_setup_on_core.
+ */
+errval_t trace_core_setup(coreid_t core_id, struct trace_core **retcore)
+{
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
+    if (master == NULL) {
+        return TRACE_ERR_NO_BUFFER;
+    }
+
+    struct trace_core *core = trace_get_core(master, core_id);
+    if (core != NULL) {
+        *retcore = core;
+        return SYS_ERR_OK;
+    }
+
+    uintptr_t offset = trace_arena_alloc(sizeof(struct trace_core));
+    if (offset == 0) {
+        return TRACE_ERR_BUF_FULL;
+    }
+    core = trace_offset_to_ptr(master, offset);
+    core->core_id = core_id;
+    core->ring_events = TRACE_DEFAULT_RING_EVENTS;
+    core->overflow = TRACE_OVERFLOW_STOP;
+
+    // Link in, unless another domain on the core was faster
+    do {
+        core->next = master->cores;
+        struct trace_core *other = trace_get_core(master, core_id);
+        if (other != NULL) {
+            *retcore = other;
+            return SYS_ERR_OK;
+        }
+    } while (!__sync_bool_compare_and_swap(&master->cores, core->next, offset));
+
+    *retcore = core;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Take over the ring of an exited dispatcher on a core
+ *
+ * \returns the ring, or NULL if no unused ring has the core's ring size
+ */
+static struct trace_ring *trace_ring_reuse(struct trace_core *core,
+                                           const char *name)
+{
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
+
+    for (struct trace_ring *ring = trace_offset_to_ptr(master, core->rings);
+         ring != NULL; ring = trace_offset_to_ptr(master, ring->next)) {
+        if (ring->unused && ring->size == core->ring_events
+            && __sync_bool_compare_and_swap(&ring->unused, 1, 0)) {
+            // The counters keep running, so that the commit words of the
+            // slots stay valid. The old events count as consumed.
+            ring->tail = ring->head;
+            ring->dropped = 0;
+            ring->overflow = core->overflow;
+            strncpy(ring->name, name, sizeof(ring->name));
+            return ring;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * \brief Give the current dispatcher its own trace ring
+ *
+ * Does nothing if the dispatcher already has a ring. User-space trace events
+ * call this on the first event of a dispatcher.
+ */
+errval_t trace_disp_setup(void)
+{
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
+    struct dispatcher_generic *disp = get_dispatcher_generic(curdispatcher());
+    errval_t err;
+
+    if (disp->trace_ring != NULL) {
+        return SYS_ERR_OK;
+    }
+
+    struct trace_core *core;
+    err = trace_core_setup(disp_get_core_id(), &core);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct trace_ring *ring = trace_ring_reuse(core, disp_name());
+    if (ring != NULL) {
+        disp->trace_ring = ring;
+        return SYS_ERR_OK;
+    }
+
+    uintptr_t offset = trace_ring_alloc(core, disp_name());
+    if (offset == 0) {
+        return TRACE_ERR_BUF_FULL;
+    }
+
+    ring = trace_offset_to_ptr(master, offset);
+    do {
+        ring->next = core->rings;
+    } while (!__sync_bool_compare_and_swap(&core->rings, ring->next, offset));
+
+    disp->trace_ring = ring;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Hand the ring of the current dispatcher back for reuse
+ *
+ * Called when the dispatcher exits. The ring stays linked on its core, so
+ * that its events can be dumped until another dispatcher takes it over.
+ * The dispatcher records no further events.
+ */
+void trace_disp_release(void)
+{
+    struct dispatcher_generic *disp = get_dispatcher_generic(curdispatcher());
+    struct trace_ring *ring = disp->trace_ring;
+
+    disp->trace_disabled = true;
+    if (ring == NULL) {
+        return;
+    }
+    disp->trace_ring = NULL;
+
+    // Finish our events before another dispatcher takes the ring
+    __sync_synchronize();
+    ring->unused = 1;
+}
+
+/**
+ * \brief Configure the trace rings of a core and allocate its kernel ring
+ *
+ * The overflow policy applies to all rings of the core, the size only to
+ * rings allocated after this call.
+ */
+errval_t trace_core_configure(struct trace_core *core, size_t ring_events,
+                              enum trace_overflow overflow)
+{
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
+
+    // Ring slots are indexed by masking the event counters
+    size_t events = 1;
+    while (events < ring_events) {
+        events <<= 1;
+    }
+    core->ring_events = events;
+    core->overflow = overflow;
+
+    struct trace_ring *ring = trace_offset_to_ptr(master, core->kernel_ring);
+    if (ring != NULL) {
+        ring->overflow = overflow;
+    }
+    for (ring = trace_offset_to_ptr(master, core->rings); ring != NULL;
+         ring = trace_offset_to_ptr(master, ring->next)) {
+        ring->overflow = overflow;
+    }
+
+    if (core->kernel_ring == 0) {
+        core->kernel_ring = trace_ring_alloc(core, "kernel");
+        if (core->kernel_ring == 0) {
+            return TRACE_ERR_BUF_FULL;
+        }
+    }
+
+    return SYS_ERR_OK;
+}
@@ -58,6 +58,10 @@ errval_t ump_chan_init(struct ump_chan *uc,
     uc->max_send_msgs = outbufsize / UMP_MSG_BYTES;
     uc->max_recv_msgs = inbufsize / UMP_MSG_BYTES;
 
+    // no side channel, unless set up by ump_chan_bind() or ump_chan_accept()
+    memset(&uc->bulk_send, 0, sizeof(uc->bulk_send));
+    memset(&uc->bulk_recv, 0, sizeof(uc->bulk_recv));
+
     memset(&uc->cap_handlers, 0, sizeof(uc->cap_handlers));
     uc->iref = 0;
     uc->monitor_binding = get_monitor_binding(); // TODO: expose non-default to caller
@@ -69,6 +73,49 @@ errval_t ump_chan_init(struct ump_chan *uc,
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Set up the side channel in the spare space of a channel frame
+ *
+ * The spare space behind the two message rings holds two counters, each in
+ * its own cache line, followed by two payload areas of equal power-of-two
+ * size. The first counter and area carry data from the binding to the
+ * accepting side, the second ones the other way.
+ *
+ * \param uc        Channel state, initialised by ump_chan_init()
+ * \param buf       Mapping of the channel frame
+ * \param framesize Size of the channel frame
+ * \param chanlen   Size of both message rings together
+ * \param binder    True on the binding side, false on the accepting side
+ */
+static void ump_chan_bulk_init(struct ump_chan *uc, void *buf, size_t framesize,
+                               size_t chanlen, bool binder)
+{
+    if (framesize < chanlen + 2 * UMP_MSG_BYTES) {
+        return;
+    }
+
+    size_t size = (framesize - chanlen - 2 * UMP_MSG_BYTES) / 2;
+    if (size < UMP_BULK_MIN_BYTES) {
+        return;
+    }
+    // round down to a power of two
+    while (size & (size - 1)) {
+        size &= size - 1;
+    }
+
+    uint8_t *base = (uint8_t *)buf + chanlen;
+    struct ump_bulk *to_acceptor = binder ? &uc->bulk_send : &uc->bulk_recv;
+    struct ump_bulk *to_binder = binder ? &uc->bulk_recv : &uc->bulk_send;
+
+    to_acceptor->consumed = (volatile uintptr_t *)base;
+    to_acceptor->data = base + 2 * UMP_MSG_BYTES;
+    to_acceptor->size = size;
+
+    to_binder->consumed = (volatile uintptr_t *)(base + UMP_MSG_BYTES);
+    to_binder->data = base + 2 * UMP_MSG_BYTES + size;
+    to_binder->size = size;
+}
+
 /// Destroy the local state associated with a given channel
 void ump_chan_destroy(struct ump_chan *uc)
 {
@@ -214,6 +261,52 @@ static void send_bind_cont(void *arg)
     }
 }
 
+/**
+ * \brief Select the size of each direction of a UMP channel's message ring
+ *
+ * The ring length is chosen by the binding side and passed to the service
+ * with the bind request, so each binding may use its own geometry.
+ *
+ * \param bind_flags IDC bind flags (#idc_bind_flags_t) of the binding
+ *
+ * \return Size of a unidirectional message buffer in bytes
+ */
+size_t ump_chan_buflen(uint32_t bind_flags)
+{
+    if (bind_flags & IDC_BIND_FLAG_UMP_SMALL_BUF) {
+        return SMALL_UMP_BUFLEN;
+    } else if (bind_flags & IDC_BIND_FLAG_UMP_LARGE_BUF) {
+        return LARGE_UMP_BUFLEN;
+    } else {
+        return DEFAULT_UMP_BUFLEN;
+    }
+}
+
+/**
+ * \brief Select the size of each direction of a UMP channel's side channel
+ *
+ * Bindings get a side channel by default if their message rings are at
+ * least #DEFAULT_UMP_BUFLEN. A small ring asks for a channel that stays
+ * cache resident, which the side channel's extra pages would defeat, so it
+ * only gets one with #IDC_BIND_FLAG_UMP_BULK. #IDC_BIND_FLAG_UMP_NO_BULK
+ * turns the side channel off for any ring.
+ *
+ * \param bind_flags IDC bind flags (#idc_bind_flags_t) of the binding
+ *
+ * \return Size of a unidirectional payload area in bytes, or 0 for none
+ */
+size_t ump_chan_bulklen(uint32_t bind_flags)
+{
+    if (bind_flags & IDC_BIND_FLAG_UMP_NO_BULK) {
+        return 0;
+    } else if ((bind_flags & IDC_BIND_FLAG_UMP_BULK)
+               || ump_chan_buflen(bind_flags) >= DEFAULT_UMP_BUFLEN) {
+        return DEFAULT_UMP_BULKLEN;
+    } else {
+        return 0;
+    }
+}
+
 /**
  * \brief Initialise a new UMP channel and initiate a binding
  *
@@ -224,12 +317,14 @@ static void send_bind_cont(void *arg)
  * \param monitor_binding Monitor binding to use
  * \param inchanlen Size of incoming channel, in bytes (rounded to #UMP_MSG_BYTES)
  * \param outchanlen Size of outgoing channel, in bytes (rounded to #UMP_MSG_BYTES)
+ * \param bulklen Size of each direction of the side channel, in bytes, or 0
+ *                for none
  * \param notify_cap Capability to use for notifications, or #NULL_CAP
  */
 errval_t ump_chan_bind(struct ump_chan *uc, struct ump_bind_continuation cont,
                        struct event_queue_node *qnode,  iref_t iref,
                        struct monitor_binding *monitor_binding,
-                       size_t inchanlen, size_t outchanlen,
+                       size_t inchanlen, size_t outchanlen, size_t bulklen,
                        struct capref notify_cap)
 {
     errval_t err;
@@ -237,9 +332,17 @@ errval_t ump_chan_bind(struct ump_chan *uc, struct ump_bind_continuation cont,
     // round up channel sizes to message size
     inchanlen = ROUND_UP(inchanlen, UMP_MSG_BYTES);
     outchanlen = ROUND_UP(outchanlen, UMP_MSG_BYTES);
+    if (inchanlen < MIN_UMP_BUFLEN || outchanlen < MIN_UMP_BUFLEN
+        || inchanlen > MAX_UMP_BUFLEN || outchanlen > MAX_UMP_BUFLEN) {
+        return LIB_ERR_UMP_BUFSIZE_INVALID;
+    }
 
-    // compute size of frame needed and allocate it
+    // compute size of frame needed, including any side channel, and
+    // allocate it
     size_t framesize = inchanlen + outchanlen;
+    if (bulklen > 0) {
+        framesize += 2 * (UMP_MSG_BYTES + bulklen);
+    }
     err = frame_alloc(&uc->frame, framesize, &framesize);
     if (err_is_fail(err)) {
         return err_push(err, LIB_ERR_FRAME_ALLOC);
@@ -261,6 +364,7 @@ errval_t ump_chan_bind(struct ump_chan *uc, struct ump_bind_continuation cont,
         cap_destroy(uc->frame);
         return err;
     }
+    ump_chan_bulk_init(uc, buf, framesize, inchanlen + outchanlen, true);
 
     // Ids for tracing
     struct frame_identity id;
@@ -322,6 +426,13 @@ errval_t ump_chan_accept(struct ump_chan *uc, uintptr_t mon_id,
         return LIB_ERR_UMP_FRAME_OVERFLOW;
     }
 
+    // the ring geometry is chosen by the binding side; sanity-check it
+    if (inchanlen % UMP_MSG_BYTES != 0 || outchanlen % UMP_MSG_BYTES != 0
+        || inchanlen < MIN_UMP_BUFLEN || outchanlen < MIN_UMP_BUFLEN
+        || inchanlen > MAX_UMP_BUFLEN || outchanlen > MAX_UMP_BUFLEN) {
+        return LIB_ERR_UMP_BUFSIZE_INVALID;
+    }
+
     // map it in
     void *buf;
     err = vspace_map_one_frame_attr(&buf, frameid.bytes, frame, UMP_MAP_ATTR,
@@ -338,6 +449,7 @@ errval_t ump_chan_accept(struct ump_chan *uc, uintptr_t mon_id,
         cap_destroy(uc->frame);
         return err;
     }
+    ump_chan_bulk_init(uc, buf, frameid.bytes, inchanlen + outchanlen, false);
 
     /* mark connected */
     uc->connstate = UMP_CONNECTED;
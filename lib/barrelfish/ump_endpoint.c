@@ -12,7 +12,9 @@
  * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
  */
 
+#include <string.h>
 #include <barrelfish/barrelfish.h>
+#include <barrelfish/lmp_endpoints.h>
 #include <barrelfish/ump_endpoint.h>
 #include <barrelfish/ump_impl.h>
 #include <barrelfish/waitset.h>
@@ -35,6 +37,10 @@ errval_t ump_endpoint_init(struct ump_endpoint *ep, volatile void *buf,
     }
 
     waitset_chanstate_init(&ep->waitset_state, CHANTYPE_UMP_IN);
+    ep->spin_budget = 0;
+    ep->spins = 0;
+    ep->notify_ep = NULL;
+    memset(&ep->stats, 0, sizeof(ep->stats));
     return SYS_ERR_OK;
 }
 
@@ -46,6 +52,54 @@ void ump_endpoint_destroy(struct ump_endpoint *ep)
     waitset_chanstate_destroy(&ep->waitset_state);
 }
 
+/// Handler of the notification endpoint of a parked UMP endpoint
+static void notify_handler(void *arg)
+{
+    struct ump_endpoint *ep = arg;
+    struct lmp_recv_buf dummy = { .buflen = 0 };
+
+    // consume all notifications, more may have queued while we were polling
+    while (err_is_ok(lmp_endpoint_recv(ep->notify_ep, &dummy, NULL))) {
+    }
+
+    ump_endpoint_wakeup(ep);
+}
+
+/**
+ * \brief Arm the notification that resumes a parked endpoint
+ *
+ * Registers the notification endpoint on the endpoint's waitset. A
+ * notification that arrived before this triggers it immediately.
+ *
+ * \returns true if a notification is armed
+ */
+static bool arm_notify_disabled(struct ump_endpoint *ep,
+                                dispatcher_handle_t handle)
+{
+    if (ep->notify_ep == NULL) {
+        return false;
+    }
+
+    struct event_closure closure = {
+        .handler = notify_handler,
+        .arg = ep,
+    };
+    errval_t err = lmp_endpoint_register_disabled(ep->notify_ep,
+                                                  ep->waitset_state.waitset,
+                                                  closure, handle);
+    return err_is_ok(err);
+}
+
+/// Cancel the notification armed when the endpoint was parked, if any
+static void disarm_notify_disabled(struct ump_endpoint *ep,
+                                   dispatcher_handle_t handle)
+{
+    if (ep->waitset_state.parked && ep->waitset_state.park_notify) {
+        // fails if the handler already ran and consumed the registration
+        lmp_endpoint_deregister_disabled(ep->notify_ep, handle);
+    }
+}
+
 /**
  * \brief Register an event handler to be notified when messages can be received
  *
@@ -67,6 +121,8 @@ errval_t ump_endpoint_register(struct ump_endpoint *ep, struct waitset *ws,
     assert(ep != NULL);
     assert(ws != NULL);
 
+    ep->spins = 0;
+
     if (ump_endpoint_poll(&ep->waitset_state)) { // trigger event immediately
         err = waitset_chan_trigger_closure_disabled(ws, &ep->waitset_state, closure, handle);
     } else {
@@ -85,7 +141,11 @@ errval_t ump_endpoint_register(struct ump_endpoint *ep, struct waitset *ws,
 errval_t ump_endpoint_deregister(struct ump_endpoint *ep)
 {
     assert(ep);
-    return waitset_chan_deregister(&ep->waitset_state);
+    dispatcher_handle_t handle = disp_disable();
+    disarm_notify_disabled(ep, handle);
+    errval_t err = waitset_chan_deregister_disabled(&ep->waitset_state, handle);
+    disp_enable(handle);
+    return err;
 }
 
 #include <stdio.h>
@@ -98,5 +158,126 @@ errval_t ump_endpoint_deregister(struct ump_endpoint *ep)
 void ump_endpoint_migrate(struct ump_endpoint *ep, struct waitset *ws)
 {
     printf("ump_endpoint_migrate\n");
+    dispatcher_handle_t handle = disp_disable();
+    bool armed = ep->waitset_state.parked && ep->waitset_state.park_notify;
+    disarm_notify_disabled(ep, handle);
     waitset_chan_migrate(&ep->waitset_state, ws);
+    if (armed && !arm_notify_disabled(ep, handle)) {
+        // can't happen, the notification endpoint was just deregistered
+        assert_disabled(!"re-arming UMP notify failed");
+    }
+    disp_enable(handle);
+}
+
+/**
+ * \brief Switch a UMP endpoint between pure polling and poll-then-block
+ *
+ * In adaptive mode, a registered endpoint is polled by the dispatcher until
+ * 'spin_budget' consecutive polls have found no message. It is then parked:
+ * it stays registered on its waitset, but the dispatcher stops polling it.
+ *
+ * If a notification endpoint is set (see ump_endpoint_set_notify()), parking
+ * arms it, and its handler resumes the endpoint, so the endpoint also parks
+ * while threads block on its waitset. Otherwise the endpoint only parks while
+ * no thread waits on its waitset, and is polled again as soon as one does, so
+ * a message is never missed. Flounder bindings enable this with
+ * IDC_CONTROL_SET_ADAPTIVE.
+ *
+ * \param ep UMP endpoint
+ * \param spin_budget Number of empty polls before parking, or 0 to always poll
+ */
+void ump_endpoint_set_adaptive(struct ump_endpoint *ep, uint32_t spin_budget)
+{
+    assert(ep != NULL);
+    ep->spin_budget = spin_budget;
+    ep->spins = 0;
+}
+
+/**
+ * \brief Set the notification endpoint that resumes a parked UMP endpoint
+ *
+ * The sender must send a message to 'notify_ep' (eg. raise the IPI of an IPI
+ * notify channel, see ipi_notify.h) after every UMP message. Each raise costs
+ * the sender a system call, and, while the receiver is parked, the receiver
+ * an IPI and a dispatch of the notification handler. Must not be changed
+ * while the endpoint is registered.
+ *
+ * \param ep UMP endpoint
+ * \param notify_ep Notification endpoint, or NULL for none
+ */
+void ump_endpoint_set_notify(struct ump_endpoint *ep,
+                             struct lmp_endpoint *notify_ep)
+{
+    assert(ep != NULL);
+    assert(ep->waitset_state.waitset == NULL);
+    ep->notify_ep = notify_ep;
+}
+
+/**
+ * \brief Resume a parked UMP endpoint after a notification
+ *
+ * Delivers the endpoint's registered event, so the receive handler runs and
+ * drains the channel. Has no effect if the endpoint is not parked.
+ *
+ * \param ep UMP endpoint
+ */
+void ump_endpoint_wakeup(struct ump_endpoint *ep)
+{
+    assert(ep != NULL);
+    dispatcher_handle_t handle = disp_disable();
+
+    if (ep->waitset_state.parked) {
+        assert_disabled(ep->waitset_state.state == CHAN_IDLE);
+        ep->spins = 0;
+        ep->stats.wakeups++;
+        errval_t err = waitset_chan_trigger_disabled(&ep->waitset_state, handle);
+        assert_disabled(err_is_ok(err)); // can't fail if registered
+    }
+
+    disp_enable(handle);
+}
+
+/**
+ * \brief Poll a UMP endpoint from the dispatcher's polled-channel scan
+ *
+ * Called disabled. Updates the endpoint's statistics and, in adaptive mode,
+ * decides whether the endpoint should stop being polled, arming its
+ * notification if it has one.
+ *
+ * \param channel Waitset state of the endpoint
+ * \param waited_on True if a thread waits on the endpoint's waitset, so the
+ *                  endpoint may only park behind an armed notification
+ * \param park Set to true if the caller should park the endpoint
+ * \param notify Set to true if a notification was armed to resume it
+ * \param handle Dispatcher's handle
+ *
+ * \returns true if a message is pending
+ */
+bool ump_endpoint_poll_adaptive(struct waitset_chanstate *channel,
+                                bool waited_on, bool *park, bool *notify,
+                                dispatcher_handle_t handle)
+{
+    struct ump_endpoint *ep = (struct ump_endpoint *)
+        ((char *)channel - offsetof(struct ump_endpoint, waitset_state));
+
+    ep->stats.polls++;
+    *park = false;
+    *notify = false;
+
+    if (ump_endpoint_can_recv(ep)) {
+        ep->stats.poll_hits++;
+        ep->spins = 0;
+        return true;
+    }
+
+    if (ep->spin_budget != 0 && ++ep->spins >= ep->spin_budget) {
+        *notify = arm_notify_disabled(ep, handle);
+        if (*notify || !waited_on) {
+            ep->spins = 0;
+            ep->stats.parks++;
+            *park = true;
+        }
+    }
+
+    return false;
 }
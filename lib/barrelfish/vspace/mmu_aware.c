@@ -71,6 +71,8 @@ errval_t vspace_mmu_aware_init_aligned(struct vspace_mmu_aware *state,
     state->consumed = 0;
     state->alignment = alignment;
     state->pagesize = pagesize_from_vregion_flags(flags);
+    state->promote = false;
+    memset(&state->stats, 0, sizeof(state->stats));
 
     vspace_mmu_aware_set_slot_alloc(state, slot_allocator);
 
@@ -93,6 +95,59 @@ errval_t vspace_mmu_aware_init_aligned(struct vspace_mmu_aware *state,
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Enable or disable automatic page promotion
+ *
+ * With promotion enabled, every new frame is allocated for the largest page
+ * size that the vregion flags allow, that the current map offset is aligned
+ * to, and that the request fills. If the memory server cannot provide a
+ * frame of that size, the next smaller page size is tried. The page sizes
+ * used are counted in state->stats.
+ */
+void vspace_mmu_aware_set_promote(struct vspace_mmu_aware *state,
+                                  bool promote)
+{
+    state->promote = promote;
+}
+
+/// Page size of the next frame to map for a request of req_size bytes
+static size_t pagesize_for_map(struct vspace_mmu_aware *state, size_t req_size)
+{
+    if (state->promote &&
+        get_ram_alloc_state()->ram_alloc_func == ram_alloc_fixed) {
+        // early in the domain's life there is only the base page allocator
+        return BASE_PAGE_SIZE;
+    }
+#if __x86_64__
+    // without promotion, large and huge pages are used whenever they are
+    // requested; with it, only for requests that fill a whole page
+    if ((state->vregion.flags & VREGION_FLAGS_HUGE) &&
+        (state->mapoffset & HUGE_PAGE_MASK) == 0 &&
+        (!state->promote || req_size >= HUGE_PAGE_SIZE))
+    {
+        return HUGE_PAGE_SIZE;
+    }
+#endif
+    if ((state->vregion.flags & VREGION_FLAGS_LARGE) &&
+        (state->mapoffset & LARGE_PAGE_MASK) == 0 &&
+        (!state->promote || req_size >= LARGE_PAGE_SIZE))
+    {
+        return LARGE_PAGE_SIZE;
+    }
+    return BASE_PAGE_SIZE;
+}
+
+/// Next smaller page size to fall back to
+static size_t pagesize_smaller(size_t pagesize)
+{
+#if __x86_64__
+    if (pagesize == HUGE_PAGE_SIZE) {
+        return LARGE_PAGE_SIZE;
+    }
+#endif
+    return BASE_PAGE_SIZE;
+}
+
 /**
  * \brief Create mappings
  *
@@ -126,32 +181,15 @@ errval_t vspace_mmu_aware_map(struct vspace_mmu_aware *state, size_t req_size,
     size_t ret_size = 0;
 
     if (req_size > 0) {
-#if __x86_64__
-        if ((state->vregion.flags & VREGION_FLAGS_HUGE) &&
-            (state->mapoffset & HUGE_PAGE_MASK) == 0)
-        {
-            // this is an opportunity to switch to 1G pages if requested.
-            // we know that we can use large pages without jumping through hoops
-            // if state->vregion.flags has VREGION_FLAGS_HUGE set and
-            // mapoffset is aligned to at least HUGE_PAGE_SIZE.
-            alloc_size = ROUND_UP(req_size, HUGE_PAGE_SIZE);
-
-            // goto allocation directly so we can avoid nasty code interaction
-            // between #if __x86_64__ and the size checks, we want to be able
-            // to use 2M pages on x86_64 also. -SG, 2015-04-30.
-            goto allocate;
+        size_t pagesize = pagesize_for_map(state, req_size);
+        if (pagesize > BASE_PAGE_SIZE) {
+            // this is an opportunity to switch to large or huge pages.
+            // we know that we can use them without jumping through hoops
+            // if state->vregion.flags allows it and mapoffset is aligned to
+            // at least the page size.
+            alloc_size = ROUND_UP(req_size, pagesize);
         }
-#endif
-        if ((state->vregion.flags & VREGION_FLAGS_LARGE) &&
-            (state->mapoffset & LARGE_PAGE_MASK) == 0)
-        {
-            // this is an opportunity to switch to 2M pages if requested.
-            // we know that we can use large pages without jumping through hoops
-            // if state->vregion.flags has VREGION_FLAGS_LARGE set and
-            // mapoffset is aligned to at least LARGE_PAGE_SIZE.
-            alloc_size = ROUND_UP(req_size, LARGE_PAGE_SIZE);
-        }
-        // allocate slot before jump target
+
         err = state->slot_alloc->alloc(state->slot_alloc, &frame);
         if (err_is_fail(err)) {
             return err_push(err, LIB_ERR_SLOT_ALLOC_NO_SPACE);
@@ -160,6 +198,13 @@ allocate:
         // Create frame of appropriate size
         err = frame_create(frame, alloc_size, &ret_size);
         if (err_is_fail(err)) {
+            if (state->promote && pagesize > BASE_PAGE_SIZE) {
+                // no contiguous memory for this page size; try a smaller one
+                pagesize = pagesize_smaller(pagesize);
+                alloc_size = ROUND_UP(req_size, pagesize);
+                state->stats.fallbacks++;
+                goto allocate;
+            }
             if (err_no(err) == LIB_ERR_RAM_ALLOC_MS_CONSTRAINTS) {
                 // we can only get 4k frames for now; retry with 4k
                 if (alloc_size > BASE_PAGE_SIZE && req_size <= BASE_PAGE_SIZE) {
@@ -195,6 +240,17 @@ allocate:
         if (err_is_fail(err)) {
             return err_push(err, LIB_ERR_MEMOBJ_PAGEFAULT_HANDLER);
         }
+
+#if __x86_64__
+        if (pagesize == HUGE_PAGE_SIZE) {
+            state->stats.huge++;
+        } else
+#endif
+        if (pagesize == LARGE_PAGE_SIZE) {
+            state->stats.large++;
+        } else {
+            state->stats.base++;
+        }
     }
 
     // Return buffer
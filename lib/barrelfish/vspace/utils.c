@@ -48,6 +48,40 @@ errval_t vspace_unmap(const void *buf)
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Page size flags for an anonymous region
+ *
+ * A region that is aligned to, and at least as large as, a large or huge page
+ * gets the matching vregion flag, so that suitably sized frames filled into
+ * it are mapped with large or huge pages. The pmap maps smaller frames with
+ * base pages regardless of the flag.
+ */
+static vregion_flags_t anon_promote_flags(size_t size, vregion_flags_t flags,
+                                          size_t alignment)
+{
+#ifdef __x86_64__
+    if (flags & (VREGION_FLAGS_LARGE|VREGION_FLAGS_HUGE|VREGION_FLAGS_GUARD)) {
+        // caller chose the page size, or this is not memory
+        return 0;
+    }
+    if (size < LARGE_PAGE_SIZE) {
+        // smaller than a large page, base pages waste nothing
+        return 0;
+    }
+    vregion_flags_t promote = 0;
+    if (alignment >= LARGE_PAGE_SIZE && (alignment & LARGE_PAGE_MASK) == 0) {
+        promote |= VREGION_FLAGS_LARGE;
+    }
+    if (alignment >= HUGE_PAGE_SIZE && (alignment & HUGE_PAGE_MASK) == 0 &&
+        size >= HUGE_PAGE_SIZE) {
+        promote |= VREGION_FLAGS_HUGE;
+    }
+    return promote;
+#else
+    return 0;
+#endif
+}
+
 /// Map with an alignment constraint
 errval_t vspace_map_anon_nomalloc(void **retaddr, struct memobj_anon *memobj,
                                   struct vregion *vregion, size_t size,
@@ -60,6 +94,8 @@ errval_t vspace_map_anon_nomalloc(void **retaddr, struct memobj_anon *memobj,
         *retsize = size;
     }
 
+    flags |= anon_promote_flags(size, flags, alignment);
+
     // Create a memobj and vregion
     err1 = memobj_create_anon(memobj, size, 0);
     if (err_is_fail(err1)) {
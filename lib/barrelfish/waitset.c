@@ -65,6 +65,42 @@ static void enqueue(struct waitset_chanstate **queue, struct waitset_chanstate *
     }
 }
 
+/**
+ * \brief Enqueue a chanstate on the pending queue of a waitset
+ *
+ * The pending queue is kept sorted by priority class, and FIFO within a class.
+ * In the common case where the new channel's class is not higher than that of
+ * the last pending channel, this is a plain append.
+ */
+static void enqueue_pending(struct waitset *ws, struct waitset_chanstate *chan)
+{
+    struct waitset_chanstate *head = ws->pending, *pos;
+
+    ws->npending[chan->priority]++;
+    if (head == NULL || head->prev->priority >= chan->priority) {
+        enqueue(&ws->pending, chan);
+        return;
+    }
+
+    // insert before the first channel of a lower class
+    for (pos = head; pos->priority >= chan->priority; pos = pos->next);
+    chan->next = pos;
+    chan->prev = pos->prev;
+    chan->prev->next = chan;
+    pos->prev = chan;
+    if (pos == head) {
+        ws->pending = chan;
+    }
+}
+
+/// Dequeue a chanstate from the pending queue of a waitset
+static void dequeue_pending(struct waitset *ws, struct waitset_chanstate *chan)
+{
+    assert(ws->npending[chan->priority] > 0);
+    ws->npending[chan->priority]--;
+    dequeue(&ws->pending, chan);
+}
+
 /// Dequeue a chanstate from polled queue
 static void dequeue_polled(struct waitset_chanstate **queue,
                             struct waitset_chanstate *chan)
@@ -106,6 +142,48 @@ void waitset_init(struct waitset *ws)
     assert(ws != NULL);
     ws->pending = ws->polled = ws->idle = ws->waiting = NULL;
     ws->waiting_threads = NULL;
+    ws->nparked = 0;
+    ws->policy = WS_POLICY_STRICT;
+    ws->weight = WS_DEFAULT_WEIGHT;
+    memset(ws->npending, 0, sizeof(ws->npending));
+    memset(ws->bypassed, 0, sizeof(ws->bypassed));
+    memset(ws->starved, 0, sizeof(ws->starved));
+}
+
+/**
+ * \brief Set the dispatch policy between channel priority classes
+ *
+ * \param ws Waitset
+ * \param policy Dispatch policy
+ * \param weight Under #WS_POLICY_WEIGHTED, the number of consecutive events
+ *               from higher classes after which the oldest pending event of a
+ *               lower class is dispatched. Ignored for #WS_POLICY_STRICT.
+ *
+ * Under #WS_POLICY_WEIGHTED, a class with pending events is bypassed at most
+ * 'weight' + #WS_PRIO_COUNT - 2 times in a row, as classes that became due at
+ * the same time are served one after the other.
+ */
+void waitset_set_policy(struct waitset *ws, enum ws_policy policy,
+                        uint32_t weight)
+{
+    assert(ws != NULL);
+    assert(policy == WS_POLICY_STRICT || weight > 0);
+    dispatcher_handle_t handle = disp_disable();
+    ws->policy = policy;
+    ws->weight = weight;
+    memset(ws->bypassed, 0, sizeof(ws->bypassed));
+    disp_enable(handle);
+}
+
+/**
+ * \brief Number of times pending events of a class were bypassed by events of
+ * a higher class
+ */
+uint64_t waitset_get_starved(struct waitset *ws, enum ws_priority priority)
+{
+    assert(ws != NULL);
+    assert(priority < WS_PRIO_COUNT);
+    return ws->starved[priority];
 }
 
 /**
@@ -128,12 +206,15 @@ errval_t waitset_destroy(struct waitset *ws)
         assert(chan->waitset == ws);
         chan->waitset = NULL;
         chan->next = chan->prev = NULL;
+        chan->parked = false;
+        chan->park_notify = false;
 
         if (next == ws->idle) {
             break;
         }
     }
     ws->idle = NULL;
+    ws->nparked = 0;
 
     for (chan = ws->polled; chan != NULL; chan = next) {
         next = chan->next;
@@ -198,6 +279,27 @@ static struct waitset_chanstate *get_pending_event_disabled(struct waitset *ws,
         if (chan == ws->waiting)
             break;
     }
+    // let a lower class through if it has been bypassed for too long
+    if (ws->policy == WS_POLICY_WEIGHTED && ws->pending != NULL) {
+        // the longest-bypassed class is due; on a tie, the lowest
+        int due = -1;
+        for (int c = 0; c < ws->pending->priority; c++) {
+            if (ws->npending[c] > 0 && ws->bypassed[c] >= ws->weight
+                && (due < 0 || ws->bypassed[c] > ws->bypassed[due])) {
+                due = c;
+            }
+        }
+        if (due >= 0) {
+            chan = ws->pending;
+            do {
+                if (chan->priority == due && waitset_can_receive(chan, me)) {
+                    assert_disabled(chan->state == CHAN_PENDING);
+                    return chan;
+                }
+                chan = chan->next;
+            } while (chan != ws->pending && chan->priority >= due);
+        }
+    }
     // check a pending queue for matching event
     for (chan = ws->pending; chan;) {
         if (waitset_can_receive(chan, me)) {
@@ -224,31 +326,107 @@ void poll_ahci(struct waitset_chanstate *chan)
     assert(err_is_ok(err)); // should not be able to fail
 }
 
-/// Check polled channels
+/// Stop polling a channel, leaving it registered as idle on its waitset
+static void park_channel_disabled(struct waitset_chanstate *chan,
+                                  bool notify, dispatcher_handle_t handle)
+{
+    struct waitset *ws = chan->waitset;
+    assert_disabled(ws != NULL);
+    assert_disabled(chan->state == CHAN_POLLED);
+
+    dequeue(&ws->polled, chan);
+    dequeue_polled(&get_dispatcher_generic(handle)->polled_channels, chan);
+    enqueue(&ws->idle, chan);
+    chan->state = CHAN_IDLE;
+    chan->parked = true;
+    chan->park_notify = notify;
+    ws->nparked++;
+}
+
+/**
+ * \brief Poll the parked channels of a waitset again
+ *
+ * Called before a thread waits on the waitset. Parked channels without an
+ * armed notification only become pending through polling, so they must be
+ * polled while anyone waits for them. Channels with an armed notification
+ * stay parked: the notification handler resumes them.
+ */
+static void unpark_channels_disabled(struct waitset *ws,
+                                     dispatcher_handle_t handle)
+{
+    struct waitset_chanstate *chan, *next;
+    uint32_t left = ws->nparked;
+
+    chan = ws->idle;
+    while (left > 0) {
+        assert_disabled(chan != NULL);
+        next = chan->next;
+        if (chan->parked) {
+            left--;
+            if (!chan->park_notify) {
+                chan->parked = false;
+                ws->nparked--;
+                dequeue(&ws->idle, chan);
+                enqueue(&ws->polled, chan);
+                enqueue_polled(&get_dispatcher_generic(handle)->polled_channels,
+                               chan);
+                chan->state = CHAN_POLLED;
+            }
+        }
+        chan = next;
+    }
+}
+
+/**
+ * \brief Check polled channels
+ *
+ * Makes a single pass over the dispatcher's polled channels. Channels that
+ * are triggered or parked leave the polled queue, so we remember the successor
+ * and the last channel of the pass before polling each channel, rather than
+ * restarting the scan from the head after every event. Only the lwIP socket
+ * poll can remove other channels; the pass restarts if it removed either.
+ */
 void poll_channels_disabled(dispatcher_handle_t handle) {
     struct dispatcher_generic *dp = get_dispatcher_generic(handle);
-    struct waitset_chanstate *chan;
+    struct waitset_chanstate *chan, *next, *last;
+    bool done;
 
     if (!dp->polled_channels)
         return;
     chan = dp->polled_channels;
+    last = chan->polled_prev;
     do {
+        next = chan->polled_next;
+        done = (chan == last);
         switch (chan->chantype) {
 #ifdef CONFIG_INTERCONNECT_DRIVER_UMP
         case CHANTYPE_UMP_IN: {
-            if (ump_endpoint_poll(chan)) {
+            // a channel a thread is waiting on may only park behind an
+            // armed notification
+            bool waited_on = (chan->waitset->waiting_threads != NULL);
+            bool park, notify;
+            if (ump_endpoint_poll_adaptive(chan, waited_on, &park, &notify,
+                                           handle)) {
                 errval_t err = waitset_chan_trigger_disabled(chan, handle);
                 assert(err_is_ok(err)); // should not fail
-                if (!dp->polled_channels) // restart scan
-                    return;
-                chan = dp->polled_channels;
-                continue;
-            } else
-                chan = chan->polled_next;
+            } else if (park) {
+                park_channel_disabled(chan, notify, handle);
+            }
         } break;
 #endif // CONFIG_INTERCONNECT_DRIVER_UMP
         case CHANTYPE_LWIP_SOCKET:
+            // runs its own polling loop, which may trigger arbitrary channels
             arranet_polling_loop_proxy();
+            if (next->polled_next == NULL || last->polled_next == NULL) {
+                // our place in the pass left the queue: make a new pass
+                // over the remaining channels
+                if (dp->polled_channels == NULL) {
+                    return;
+                }
+                next = dp->polled_channels;
+                last = next->polled_prev;
+                done = false;
+            }
             break;
         case CHANTYPE_AHCI:
             poll_ahci(chan);
@@ -256,7 +434,21 @@ void poll_channels_disabled(dispatcher_handle_t handle) {
         default:
             assert(!"invalid channel type to poll!");
         }
-    } while (chan != dp->polled_channels);
+        chan = next;
+    } while (!done && dp->polled_channels != NULL);
+}
+
+/// Update the starvation accounting after dispatching an event from 'chan'
+static void account_dispatch(struct waitset *ws, struct waitset_chanstate *chan)
+{
+    // every lower class with pending events was bypassed once more
+    for (int c = 0; c < chan->priority; c++) {
+        if (ws->npending[c] > 0) {
+            ws->bypassed[c]++;
+            ws->starved[c]++;
+        }
+    }
+    ws->bypassed[chan->priority] = 0;
 }
 
 /// Re-register a channel (if persistent)
@@ -265,7 +457,7 @@ static void reregister_channel(struct waitset *ws, struct waitset_chanstate *cha
 {
     assert(chan->waitset == ws);
     if (chan->state == CHAN_PENDING) {
-        dequeue(&ws->pending, chan);
+        dequeue_pending(ws, chan);
     } else {
         assert(chan->state == CHAN_WAITING);
         dequeue(&ws->waiting, chan);
@@ -339,6 +531,8 @@ errval_t get_next_event_disabled(struct waitset *ws,
 {
     struct waitset_chanstate * chan;
 
+    unpark_channels_disabled(ws, handle);
+
 // debug_printf("%s: %p %p %p %p\n", __func__, __builtin_return_address(0), __builtin_return_address(1), __builtin_return_address(2), __builtin_return_address(3));
     for (;;) {
         chan = get_pending_event_disabled(ws, waitfor, waitfor2); // get our event
@@ -352,6 +546,7 @@ errval_t get_next_event_disabled(struct waitset *ws,
             } else {
                 waitset_chan_deregister_disabled(chan, handle);
             }
+            account_dispatch(ws, chan);
             wake_up_other_thread(handle, ws);
     // debug_printf("%s.%d: %p\n", __func__, __LINE__, retclosure->handler);
             return SYS_ERR_OK;
@@ -362,7 +557,7 @@ errval_t get_next_event_disabled(struct waitset *ws,
             disp_disable();
         } else { // something but it's not our event
             if (!ws->waiting_threads) { // no other thread interested in
-                dequeue(&ws->pending, chan);
+                dequeue_pending(ws, chan);
                 enqueue(&ws->waiting, chan);
                 chan->state = CHAN_WAITING;
                 chan->waitset = ws;
@@ -379,7 +574,7 @@ errval_t get_next_event_disabled(struct waitset *ws,
                     }
                     t = t->next;
                     if (t == ws->waiting_threads) { // no recipient found
-                        dequeue(&ws->pending, chan);
+                        dequeue_pending(ws, chan);
                         enqueue(&ws->waiting, chan);
                         chan->state = CHAN_WAITING;
                         chan->waitset = ws;
@@ -427,6 +622,7 @@ static errval_t check_for_event_disabled(struct waitset *ws, dispatcher_handle_t
 {
     struct waitset_chanstate *chan;
 
+    unpark_channels_disabled(ws, handle);
     poll_channels_disabled(handle);
     chan = get_pending_event_disabled(ws, NULL, NULL);
     if (chan != NULL) {
@@ -559,6 +755,60 @@ errval_t event_dispatch_non_block(struct waitset *ws)
 }
 
 
+/**
+ * \brief Wait for (block) and dispatch a run of events on given waitset
+ *
+ * Like event_dispatch(), but once the first event has been handled, the
+ * channels are polled once and up to 'max' - 1 further pending events are
+ * dispatched without blocking and without polling all channels again for
+ * each event.
+ *
+ * \param ws Waitset
+ * \param max Maximum number of events to dispatch (must be > 0)
+ * \param retcount If non-NULL, filled in with the number of events dispatched
+ */
+errval_t event_dispatch_bulk(struct waitset *ws, size_t max, size_t *retcount)
+{
+    struct event_closure closure;
+    struct waitset_chanstate *channel;
+    size_t count = 0;
+    errval_t err;
+
+    assert(ws != NULL);
+    assert(max > 0);
+
+    err = event_dispatch(ws);
+    if (err_is_fail(err)) {
+        goto out;
+    }
+    count++;
+
+    dispatcher_handle_t handle = disp_disable();
+    poll_channels_disabled(handle);
+    while (count < max
+           && get_pending_event_disabled(ws, NULL, NULL) != NULL) {
+        err = get_next_event_disabled(ws, &channel, &closure, NULL, NULL,
+                                      handle, false);
+        disp_enable(handle);
+        if (err_is_fail(err)) {
+            goto out;
+        }
+
+        assert(closure.handler != NULL);
+        closure.handler(closure.arg);
+        count++;
+
+        handle = disp_disable();
+    }
+    disp_enable(handle);
+
+out:
+    if (retcount != NULL) {
+        *retcount = count;
+    }
+    return err;
+}
+
 /**
  * \privatesection
  * "Private" functions that are called only by the channel implementations
@@ -584,6 +834,37 @@ void waitset_chanstate_init(struct waitset_chanstate *chan,
     chan->token = 0;
     chan->wait_for = NULL;
     chan->trigger = NULL;
+    chan->priority = WS_PRIO_NORMAL;
+    chan->parked = false;
+    chan->park_notify = false;
+}
+
+/**
+ * \brief Set the dispatch priority class of a channel
+ *
+ * A pending event of the channel moves to the end of its new class.
+ * For a flounder binding, pass b->get_receiving_chanstate(b).
+ *
+ * \param chan Channel state
+ * \param priority Priority class
+ */
+void waitset_chanstate_set_priority(struct waitset_chanstate *chan,
+                                    enum ws_priority priority)
+{
+    assert(chan != NULL);
+    assert(priority < WS_PRIO_COUNT);
+
+    dispatcher_handle_t handle = disp_disable();
+    if (chan->state == CHAN_PENDING) {
+        // keep the pending queue sorted
+        struct waitset *ws = chan->waitset;
+        dequeue_pending(ws, chan);
+        chan->priority = priority;
+        enqueue_pending(ws, chan);
+    } else {
+        chan->priority = priority;
+    }
+    disp_enable(handle);
 }
 
 /**
@@ -700,6 +981,26 @@ errval_t waitset_chan_register(struct waitset *ws, struct waitset_chanstate *cha
     return err;
 }
 
+/**
+ * \brief Register a closure with a given priority class on a channel
+ *
+ * Equivalent to waitset_chanstate_set_priority() followed by
+ * waitset_chan_register(). This function must only be called when enabled.
+ *
+ * \param ws Waitset
+ * \param chan Waitset's per-channel state
+ * \param closure Event handler
+ * \param priority Priority class of the channel's events
+ */
+errval_t waitset_chan_register_prio(struct waitset *ws,
+                                    struct waitset_chanstate *chan,
+                                    struct event_closure closure,
+                                    enum ws_priority priority)
+{
+    waitset_chanstate_set_priority(chan, priority);
+    return waitset_chan_register(ws, chan, closure);
+}
+
 /**
  * \brief Register a closure on a channel, and mark the channel as polled
  *
@@ -747,6 +1048,11 @@ errval_t waitset_chan_deregister_disabled(struct waitset_chanstate *chan,
     switch (chan->state) {
     case CHAN_IDLE:
         dequeue(&ws->idle, chan);
+        if (chan->parked) {
+            chan->parked = false;
+            chan->park_notify = false;
+            ws->nparked--;
+        }
         break;
 
     case CHAN_POLLED:
@@ -755,7 +1061,7 @@ errval_t waitset_chan_deregister_disabled(struct waitset_chanstate *chan,
         break;
 
     case CHAN_PENDING:
-        dequeue(&ws->pending, chan);
+        dequeue_pending(ws, chan);
         break;
 
     case CHAN_WAITING:
@@ -806,6 +1112,10 @@ void waitset_chan_migrate(struct waitset_chanstate *chan,
     case CHAN_IDLE:
         dequeue(&ws->idle, chan);
         enqueue(&new_ws->idle, chan);
+        if (chan->parked) {
+            ws->nparked--;
+            new_ws->nparked++;
+        }
         break;
 
     case CHAN_POLLED:
@@ -814,8 +1124,8 @@ void waitset_chan_migrate(struct waitset_chanstate *chan,
         break;
 
     case CHAN_PENDING:
-        dequeue(&ws->pending, chan);
-        enqueue(&new_ws->pending, chan);
+        dequeue_pending(ws, chan);
+        enqueue_pending(new_ws, chan);
         break;
 
     case CHAN_WAITING:
@@ -858,14 +1168,19 @@ errval_t waitset_chan_trigger_disabled(struct waitset_chanstate *chan,
     // remove from previous queue (either idle or polled)
     if (chan->state == CHAN_IDLE) {
         dequeue(&ws->idle, chan);
+        if (chan->parked) {
+            chan->parked = false;
+            chan->park_notify = false;
+            ws->nparked--;
+        }
     } else {
         assert_disabled(chan->state == CHAN_POLLED);
         dequeue(&ws->polled, chan);
         dequeue_polled(&get_dispatcher_generic(handle)->polled_channels, chan);
     }
 
-    // else mark channel pending and move to end of pending event queue
-    enqueue(&ws->pending, chan);
+    // else mark channel pending and move to end of its class in the pending queue
+    enqueue_pending(ws, chan);
     chan->state = CHAN_PENDING;
 
     // is there a thread blocked on this waitset? if so, awaken it with the event
@@ -929,7 +1244,7 @@ errval_t waitset_chan_trigger_closure_disabled(struct waitset *ws,
 
     // mark channel pending and place on end of pending event queue
     chan->waitset = ws;
-    enqueue(&ws->pending, chan);
+    enqueue_pending(ws, chan);
     // if (first)
     //     ws->pending = chan;
     chan->state = CHAN_PENDING;
@@ -27,8 +27,11 @@ static struct bomp_state *bomp_st;
 
 static rsrcid_t my_rsrc_id;
 
-//static const char *my_manifest = "B 1\n"             // Normal phase
-//                "G 80 160 80 480\n";// Gang phase
+/// Are the dispatchers of the domain gang scheduled?
+static bool gang_scheduled = false;
+
+/// Gang phase of the resource manifest, after the normal (best-effort) phase
+#define PHASE_GANG      1
 
 static void set_numa(unsigned id)
 {
@@ -145,8 +148,12 @@ static struct thread_sem init_sem = THREAD_SEM_INITIALIZER
 
 static int remote_init(void *dumm)
 {
-//    errval_t err = rsrc_join(my_rsrc_id);
-    //assert(err_is_ok(err));
+    if (gang_scheduled) {
+        errval_t err = rsrc_join(my_rsrc_id);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "rsrc_join");
+        }
+    }
 
     thread_sem_post(&init_sem);
     thread_detach(thread_self());
@@ -172,13 +179,24 @@ static void bomp_span_domain(int nos_threads,
     // Remember default stack size
     thread_stack_size = stack_size;
 
-    // Submit manifest (derived from program)
-//     = rsrc_manifest(my_manifest, &my_rsrc_id);
-//
-//    if (err_is_fail(err)) {
- //       DEBUG_ERR(err, "rsrc_manifest");
- //       abort();
- //   }
+    /*
+     * Gang schedule the dispatchers, if BOMP_GANG="<wcet> <period>" is set.
+     * They then run in synchronized slices of <wcet> every <period> on all
+     * cores, so that barriers do not wait for a descheduled dispatcher.
+     */
+    char *gang = getenv("BOMP_GANG");
+    unsigned long wcet, period;
+    if (gang != NULL && sscanf(gang, "%lu %lu", &wcet, &period) == 2) {
+        char manifest[64];
+        snprintf(manifest, sizeof(manifest), "B 1\nG %lu %lu\n", wcet,
+                 period);
+        err = rsrc_manifest(manifest, &my_rsrc_id);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "rsrc_manifest");
+        } else {
+            gang_scheduled = true;
+        }
+    }
 
     /* Span domain to all cores */
     for (int i = 1; i < nos_threads; ++i) {
@@ -208,12 +226,24 @@ static void bomp_span_domain(int nos_threads,
         }
         thread_sem_wait(&init_sem);
     }
+
+    // All dispatchers have joined, start the gang phase
+    if (gang_scheduled) {
+        err = rsrc_phase(my_rsrc_id, PHASE_GANG);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "rsrc_phase");
+        }
+    }
 }
 
 static void bomp_synchronize(void)
 {
+    if (!gang_scheduled) {
+        return;
+    }
+
     /* if(GOMP_single_start()) { */
-    errval_t err = rsrc_phase(my_rsrc_id, 1);
+    errval_t err = rsrc_phase(my_rsrc_id, PHASE_GANG);
     assert(err_is_ok(err));
     /* } */
 }
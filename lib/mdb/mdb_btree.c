@@ -0,0 +1,1287 @@
+/**
+ * \file
+ * \brief B+-tree implementation of the mapping database.
+ *
+ * This is an alternative to the AA tree in mdb_tree.c, with the same
+ * interface. The AA tree is threaded through the ctes themselves, so every
+ * step of a lookup dereferences another, usually cold, cte. Here the ctes are
+ * kept in the leaves of a B+-tree, in compare_caps() order. Each node caches
+ * the type root and address of its keys, which decide almost all comparisons
+ * without touching the ctes, and inner nodes keep the maximum end of each
+ * child's subtree (like mdbnode.end in the AA tree) to prune range queries.
+ *
+ * The nodes do not fit into the ctes, so they have to be allocated: user
+ * space takes them from malloc(), the kernel from memory given to it with
+ * mdb_add_memory(). The free nodes and the current chunk of that memory are
+ * kept in the KCB, so the tree moves with the KCB. An insert that cannot get
+ * the nodes it may need fails with CAPS_ERR_MDB_NO_NODES.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <mdb/mdb_tree.h>
+#include <mdb/mdb.h>
+#include <cap_predicates.h>
+#include <barrelfish_kpi/capabilities.h>
+#include <capabilities.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#if IN_KERNEL
+#include <kernel.h>
+#include <kcb.h>
+#else
+#include <stdlib.h>
+#endif
+
+#ifdef C
+#undef C
+#endif
+#define C(cte) (&(cte)->cap)
+
+// define panic() for user-land build
+#ifndef IN_KERNEL
+#define panic(msg...) \
+    do { \
+        printf(msg); \
+        abort(); \
+    }while(0)
+#endif
+
+/// Maximum number of keys in a node
+#define MDB_BTREE_ORDER 16
+/// Minimum number of keys in a node other than the root
+#define MDB_BTREE_MIN   (MDB_BTREE_ORDER / 2)
+
+#if IN_KERNEL
+/// Number of nodes a new tree in the kernel starts with (about 400kB on 64-bit)
+#ifndef MDB_BTREE_BOOT_NODES
+#define MDB_BTREE_BOOT_NODES 512
+#endif
+#endif
+
+/**
+ * \brief A B+-tree node.
+ *
+ * The keys of a leaf are the ctes in the tree. The keys of an inner node are
+ * the smallest cte of each child. For every key, its type root and address
+ * are cached, as these are the first criteria of compare_caps().
+ */
+struct mdb_bnode {
+    uint8_t count;                      ///< Number of keys
+    bool leaf;                          ///< Node is a leaf
+    mdb_root_t roots[MDB_BTREE_ORDER];  ///< Type root of each key
+    genpaddr_t addrs[MDB_BTREE_ORDER];  ///< Address of each key
+    struct cte *keys[MDB_BTREE_ORDER];  ///< Keys
+    union {
+        struct {
+            struct mdb_bnode *prev, *next;  ///< Neighbouring leaves
+        } leaf;
+        struct {
+            struct mdb_bnode *children[MDB_BTREE_ORDER];
+            /// Maximum end of each child, with end_roots as address prefix
+            genpaddr_t ends[MDB_BTREE_ORDER];
+            mdb_root_t end_roots[MDB_BTREE_ORDER];
+        } inner;
+    } u;
+};
+
+/// A search key
+struct mdb_bkey {
+    struct capability *cap;
+    mdb_root_t root;
+    genpaddr_t addr;
+    bool tiebreak;
+};
+
+/// A position in the tree: entry `i` of `leaf`, or the end if i == count
+struct mdb_bpos {
+    struct mdb_bnode *leaf;
+    int i;
+};
+
+static struct mdb_bnode *mdb_root = NULL;
+#if IN_KERNEL
+struct kcb *my_kcb = NULL;
+#endif
+
+/// Position of the cte last returned by mdb_successor()/mdb_predecessor()
+static struct mdb_bpos cursor;
+
+static void set_root(struct mdb_bnode *new_root)
+{
+    mdb_root = new_root;
+#if IN_KERNEL
+    my_kcb->mdb_root = (lvaddr_t) new_root;
+#endif
+}
+
+/*
+ * Node allocation.
+ */
+
+#if IN_KERNEL
+static inline struct mdb_node_pool *node_pool(void)
+{
+    return &my_kcb->mdb_nodes;
+}
+#else
+static struct mdb_node_pool user_nodes;
+
+static inline struct mdb_node_pool *node_pool(void)
+{
+    return &user_nodes;
+}
+#endif
+
+static void bnode_free(struct mdb_bnode *n)
+{
+    struct mdb_node_pool *pool = node_pool();
+    n->u.leaf.next = pool->free;
+    pool->free = n;
+    pool->free_count++;
+}
+
+/// Take a node from the unused part of the current chunk
+static struct mdb_bnode *chunk_alloc(struct mdb_node_pool *pool)
+{
+    const lvaddr_t align = __alignof__(struct mdb_bnode);
+    lvaddr_t n = (pool->brk + align - 1) & ~(align - 1);
+    if (n < pool->brk || n + sizeof(struct mdb_bnode) > pool->limit) {
+        return NULL;
+    }
+    pool->brk = n + sizeof(struct mdb_bnode);
+    return (struct mdb_bnode *)n;
+}
+
+/// Make sure that the next `count` calls to bnode_alloc() succeed
+static errval_t bnode_reserve(size_t count)
+{
+    struct mdb_node_pool *pool = node_pool();
+    while (pool->free_count < count) {
+        struct mdb_bnode *n = chunk_alloc(pool);
+#ifndef IN_KERNEL
+        if (!n) {
+            n = malloc(sizeof(struct mdb_bnode));
+        }
+#endif
+        if (!n) {
+            return CAPS_ERR_MDB_NO_NODES;
+        }
+        bnode_free(n);
+    }
+    return SYS_ERR_OK;
+}
+
+static struct mdb_bnode *bnode_alloc(bool leaf)
+{
+    struct mdb_node_pool *pool = node_pool();
+    struct mdb_bnode *n = pool->free;
+    assert(n);
+    pool->free = n->u.leaf.next;
+    pool->free_count--;
+
+    n->count = 0;
+    n->leaf = leaf;
+    n->u.leaf.prev = n->u.leaf.next = NULL;
+    return n;
+}
+
+#ifndef IN_KERNEL
+static void bnode_free_tree(struct mdb_bnode *n)
+{
+    if (!n->leaf) {
+        for (int i = 0; i < n->count; i++) {
+            bnode_free_tree(n->u.inner.children[i]);
+        }
+    }
+    bnode_free(n);
+}
+#endif
+
+/*
+ * Node helpers.
+ */
+
+static inline struct mdb_bkey bkey(struct capability *cap, bool tiebreak)
+{
+    return (struct mdb_bkey) {
+        .cap = cap,
+        .root = get_type_root(cap->type),
+        .addr = get_address(cap),
+        .tiebreak = tiebreak,
+    };
+}
+
+/// Compare a search key with key `i` of `n`, like compare_caps()
+static inline int bnode_compare(struct mdb_bkey *k, struct mdb_bnode *n, int i)
+{
+    if (k->root != n->roots[i]) {
+        return k->root < n->roots[i] ? -1 : 1;
+    }
+    if (k->addr != n->addrs[i]) {
+        return k->addr < n->addrs[i] ? -1 : 1;
+    }
+    return compare_caps(k->cap, C(n->keys[i]), k->tiebreak);
+}
+
+/**
+ * \brief Return the index of the first key in `n` which is greater than or
+ * equal to (if `upper`, greater than) the search key.
+ */
+static int bnode_search(struct mdb_bnode *n, struct mdb_bkey *k, bool upper)
+{
+    int lo = 0, hi = n->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int compare = bnode_compare(k, n, mid);
+        if (compare > 0 || (upper && compare == 0)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/// Compute the maximum end of the subtree at `n`, see mdb_update_end()
+static void bnode_summary(struct mdb_bnode *n, mdb_root_t *ret_root,
+                          genpaddr_t *ret_end)
+{
+    mdb_root_t end_root = 0;
+    genpaddr_t end = 0;
+    for (int i = 0; i < n->count; i++) {
+        mdb_root_t r;
+        genpaddr_t e;
+        if (n->leaf) {
+            r = n->roots[i];
+            e = n->addrs[i] + get_size(C(n->keys[i]));
+        }
+        else {
+            r = n->u.inner.end_roots[i];
+            e = n->u.inner.ends[i];
+        }
+        if (r > end_root || (r == end_root && e > end)) {
+            end_root = r;
+            end = e;
+        }
+    }
+    *ret_root = end_root;
+    *ret_end = end;
+}
+
+/// Update the key and summary of child `i` of `n` after the child changed
+static void bnode_update_child(struct mdb_bnode *n, int i)
+{
+    assert(!n->leaf);
+    struct mdb_bnode *child = n->u.inner.children[i];
+    assert(child->count > 0);
+    n->keys[i] = child->keys[0];
+    n->roots[i] = child->roots[0];
+    n->addrs[i] = child->addrs[0];
+    bnode_summary(child, &n->u.inner.end_roots[i], &n->u.inner.ends[i]);
+}
+
+/// Move entries [from, count) of `n` by `delta` slots
+static void bnode_shift(struct mdb_bnode *n, int from, int delta)
+{
+    size_t len = n->count - from;
+    int to = from + delta;
+    assert(to >= 0 && to + len <= MDB_BTREE_ORDER);
+
+    memmove(&n->roots[to], &n->roots[from], len * sizeof(n->roots[0]));
+    memmove(&n->addrs[to], &n->addrs[from], len * sizeof(n->addrs[0]));
+    memmove(&n->keys[to], &n->keys[from], len * sizeof(n->keys[0]));
+    if (!n->leaf) {
+        memmove(&n->u.inner.children[to], &n->u.inner.children[from],
+                len * sizeof(n->u.inner.children[0]));
+        memmove(&n->u.inner.ends[to], &n->u.inner.ends[from],
+                len * sizeof(n->u.inner.ends[0]));
+        memmove(&n->u.inner.end_roots[to], &n->u.inner.end_roots[from],
+                len * sizeof(n->u.inner.end_roots[0]));
+    }
+    n->count += delta;
+}
+
+/// Copy `len` entries from `src` at `si` to `dst` at `di`
+static void bnode_copy(struct mdb_bnode *dst, int di, struct mdb_bnode *src,
+                       int si, int len)
+{
+    assert(dst->leaf == src->leaf);
+    assert(di + len <= MDB_BTREE_ORDER);
+
+    memcpy(&dst->roots[di], &src->roots[si], len * sizeof(dst->roots[0]));
+    memcpy(&dst->addrs[di], &src->addrs[si], len * sizeof(dst->addrs[0]));
+    memcpy(&dst->keys[di], &src->keys[si], len * sizeof(dst->keys[0]));
+    if (!dst->leaf) {
+        memcpy(&dst->u.inner.children[di], &src->u.inner.children[si],
+               len * sizeof(dst->u.inner.children[0]));
+        memcpy(&dst->u.inner.ends[di], &src->u.inner.ends[si],
+               len * sizeof(dst->u.inner.ends[0]));
+        memcpy(&dst->u.inner.end_roots[di], &src->u.inner.end_roots[si],
+               len * sizeof(dst->u.inner.end_roots[0]));
+    }
+}
+
+/// Insert a cte (leaf) or child (inner node) at `pos` of a non-full node
+static void bnode_put(struct mdb_bnode *n, int pos, struct cte *cte,
+                      struct mdb_bnode *child)
+{
+    assert(n->count < MDB_BTREE_ORDER);
+    bnode_shift(n, pos, 1);
+    if (n->leaf) {
+        n->keys[pos] = cte;
+        n->roots[pos] = get_type_root(C(cte)->type);
+        n->addrs[pos] = get_address(C(cte));
+    }
+    else {
+        n->u.inner.children[pos] = child;
+        bnode_update_child(n, pos);
+    }
+}
+
+/// Split a full node, returns the new right half
+static struct mdb_bnode *bnode_split(struct mdb_bnode *n)
+{
+    struct mdb_bnode *right = bnode_alloc(n->leaf);
+    int half = n->count / 2;
+
+    bnode_copy(right, 0, n, half, n->count - half);
+    right->count = n->count - half;
+    n->count = half;
+
+    if (n->leaf) {
+        right->u.leaf.prev = n;
+        right->u.leaf.next = n->u.leaf.next;
+        if (n->u.leaf.next) {
+            n->u.leaf.next->u.leaf.prev = right;
+        }
+        n->u.leaf.next = right;
+    }
+    return right;
+}
+
+/// Insert into `n`, which may be full, returns the new right half on a split
+static struct mdb_bnode *bnode_insert_at(struct mdb_bnode *n, int pos,
+                                         struct cte *cte,
+                                         struct mdb_bnode *child)
+{
+    struct mdb_bnode *right = NULL;
+    if (n->count == MDB_BTREE_ORDER) {
+        right = bnode_split(n);
+        if (pos > n->count) {
+            bnode_put(right, pos - n->count, cte, child);
+            return right;
+        }
+    }
+    bnode_put(n, pos, cte, child);
+    return right;
+}
+
+/// Return the child of inner node `n` that should contain the search key
+static inline int bnode_child_index(struct mdb_bnode *n, struct mdb_bkey *k,
+                                    bool upper)
+{
+    int pos = bnode_search(n, k, upper);
+    return pos > 0 ? pos - 1 : 0;
+}
+
+static int bnode_height(struct mdb_bnode *n)
+{
+    int height = 0;
+    for (; n; n = n->leaf ? NULL : n->u.inner.children[0]) {
+        height++;
+    }
+    return height;
+}
+
+/*
+ * Positions.
+ */
+
+/**
+ * \brief Return the position of the first cte in the tree which is greater
+ * than or equal to (if `upper`, greater than) the search key.
+ */
+static struct mdb_bpos bpos_bound(struct mdb_bkey *k, bool upper)
+{
+    struct mdb_bnode *n = mdb_root;
+    if (!n) {
+        return (struct mdb_bpos) { .leaf = NULL, .i = 0 };
+    }
+    while (!n->leaf) {
+        n = n->u.inner.children[bnode_child_index(n, k, upper)];
+    }
+    int i = bnode_search(n, k, upper);
+    if (i == n->count && n->u.leaf.next) {
+        // all keys of this leaf are smaller, so the first key of the next
+        // leaf is the bound
+        return (struct mdb_bpos) { .leaf = n->u.leaf.next, .i = 0 };
+    }
+    return (struct mdb_bpos) { .leaf = n, .i = i };
+}
+
+static inline struct cte *bpos_cte(struct mdb_bpos p)
+{
+    if (!p.leaf || p.i >= p.leaf->count) {
+        return NULL;
+    }
+    return p.leaf->keys[p.i];
+}
+
+static inline struct mdb_bpos bpos_next(struct mdb_bpos p)
+{
+    if (p.leaf && ++p.i >= p.leaf->count && p.leaf->u.leaf.next) {
+        p.leaf = p.leaf->u.leaf.next;
+        p.i = 0;
+    }
+    return p;
+}
+
+static inline struct mdb_bpos bpos_prev(struct mdb_bpos p)
+{
+    if (!p.leaf) {
+        return p;
+    }
+    if (p.i > 0) {
+        p.i--;
+    }
+    else if (p.leaf->u.leaf.prev) {
+        p.leaf = p.leaf->u.leaf.prev;
+        p.i = p.leaf->count - 1;
+    }
+    else {
+        // before the first entry
+        p.leaf = NULL;
+    }
+    return p;
+}
+
+static struct mdb_bnode *bnode_first_leaf(void)
+{
+    struct mdb_bnode *n = mdb_root;
+    while (n && !n->leaf) {
+        n = n->u.inner.children[0];
+    }
+    return n;
+}
+
+static struct mdb_bnode *bnode_last_leaf(void)
+{
+    struct mdb_bnode *n = mdb_root;
+    while (n && !n->leaf) {
+        n = n->u.inner.children[n->count - 1];
+    }
+    return n;
+}
+
+/*
+ * (re)initialization
+ */
+errval_t
+mdb_init(struct kcb *k)
+{
+    assert (k != NULL);
+#if IN_KERNEL
+    my_kcb = k;
+    if (!my_kcb->is_valid) {
+        // empty kcb, do nothing
+        return SYS_ERR_OK;
+    }
+#else
+    // there is only one tree in user space, release the nodes of the old one
+    if (mdb_root && (lvaddr_t)mdb_root != k->mdb_root) {
+        bnode_free_tree(mdb_root);
+    }
+#endif
+    // set root
+    mdb_root = (struct mdb_bnode *)k->mdb_root;
+    cursor.leaf = NULL;
+
+    return SYS_ERR_OK;
+}
+
+/*
+ * Node memory.
+ */
+
+errval_t
+mdb_add_memory(lvaddr_t base, size_t bytes)
+{
+    struct mdb_node_pool *pool = node_pool();
+
+    // the rest of the current chunk goes to the free nodes
+    struct mdb_bnode *n;
+    while ((n = chunk_alloc(pool)) != NULL) {
+        bnode_free(n);
+    }
+
+    pool->brk = base;
+    pool->limit = base + bytes;
+    return SYS_ERR_OK;
+}
+
+size_t
+mdb_free_nodes(void)
+{
+#if IN_KERNEL
+    struct mdb_node_pool *pool = node_pool();
+    return pool->free_count
+           + (pool->limit - pool->brk) / sizeof(struct mdb_bnode);
+#else
+    return SIZE_MAX;
+#endif
+}
+
+size_t
+mdb_boot_memory(void)
+{
+#if IN_KERNEL
+    return MDB_BTREE_BOOT_NODES * sizeof(struct mdb_bnode);
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Debug printing.
+ */
+
+static void print_cte(struct cte *cte, char *indent_buff)
+{
+    struct mdbnode *node = &cte->mdbnode;
+    printf("%s%p{address=0x%08"PRIxGENPADDR",size=0x%08"PRIx64","
+           "type=%"PRIu8",remote_rels=%d%d%d}\n",
+           indent_buff, cte, get_address(C(cte)), get_size(C(cte)),
+           (uint8_t)C(cte)->type, node->remote_copies,
+           node->remote_ancs, node->remote_descs);
+}
+
+static void bnode_dump(struct mdb_bnode *n, int indent)
+{
+    char indent_buff[indent+2];
+    for (int i=0; i < indent+1; i++) {
+        indent_buff[i]='\t';
+    }
+    indent_buff[indent+1] = '\0';
+
+    if (n->leaf) {
+        printf("%sleaf %p{count=%"PRIu8",prev=%p,next=%p}\n", indent_buff, n,
+               n->count, n->u.leaf.prev, n->u.leaf.next);
+        for (int i = 0; i < n->count; i++) {
+            print_cte(n->keys[i], indent_buff);
+        }
+        return;
+    }
+
+    printf("%snode %p{count=%"PRIu8"}\n", indent_buff, n, n->count);
+    for (int i = 0; i < n->count; i++) {
+        printf("%s[%d]{key=%p,end=0x%08"PRIxGENPADDR",end_root=%"PRIu8"}\n",
+               indent_buff, i, n->keys[i], n->u.inner.ends[i],
+               n->u.inner.end_roots[i]);
+        bnode_dump(n->u.inner.children[i], indent + 1);
+    }
+}
+
+void
+mdb_dump_all_the_things(void)
+{
+    if (!mdb_root) {
+        printf("NULL{}\n");
+        return;
+    }
+    bnode_dump(mdb_root, 0);
+}
+
+void
+mdb_dump(struct cte *cte, int indent)
+{
+    // ctes are not the nodes of the tree here, so there is no subtree to
+    // print below a cte
+    char indent_buff[indent+2];
+    for (int i=0; i < indent+1; i++) {
+        indent_buff[i]='\t';
+    }
+    indent_buff[indent+1] = '\0';
+
+    if (!cte) {
+        printf("NULL{}\n");
+        return;
+    }
+    print_cte(cte, indent_buff);
+}
+
+/*
+ * Invariant checking.
+ */
+
+// PP switch to change behaviour if invariants fail
+#ifdef MDB_FAIL_INVARIANTS
+// on failure, dump mdb and terminate
+__attribute__((noreturn))
+static void
+mdb_dump_and_fail(struct mdb_bnode *n, enum mdb_invariant failure)
+{
+    mdb_dump_all_the_things();
+    panic("failed on node %p with failure %s (%d)\n",
+          n, mdb_invariant_to_str(failure), failure);
+}
+#define MDB_RET_INVARIANT(n, failure) mdb_dump_and_fail(n, failure)
+#else
+#define MDB_RET_INVARIANT(n, failure) return failure
+#endif
+
+static int
+bnode_check_invariants(struct mdb_bnode *n, bool is_root, int depth,
+                       int *leaf_depth)
+{
+    if (n->count == 0 || (!is_root && n->count < MDB_BTREE_MIN)) {
+        MDB_RET_INVARIANT(n, MDB_INVARIANT_NODE_FILL);
+    }
+
+    for (int i = 0; i < n->count; i++) {
+        struct capability *cap = C(n->keys[i]);
+        assert(cap->type != 0);
+        if (n->roots[i] != get_type_root(cap->type) ||
+            n->addrs[i] != get_address(cap))
+        {
+            MDB_RET_INVARIANT(n, MDB_INVARIANT_NODE_KEY);
+        }
+        if (i > 0 && compare_caps(C(n->keys[i-1]), cap, true) >= 0) {
+            MDB_RET_INVARIANT(n, MDB_INVARIANT_LEFT_SMALLER);
+        }
+    }
+
+    if (n->leaf) {
+        if (*leaf_depth < 0) {
+            *leaf_depth = depth;
+        }
+        else if (*leaf_depth != depth) {
+            MDB_RET_INVARIANT(n, MDB_INVARIANT_LEAF_DEPTH);
+        }
+        struct mdb_bnode *next = n->u.leaf.next;
+        if (next) {
+            if (next->u.leaf.prev != n) {
+                MDB_RET_INVARIANT(n, MDB_INVARIANT_LEAF_LINKS);
+            }
+            if (compare_caps(C(n->keys[n->count-1]), C(next->keys[0]), true) >= 0) {
+                MDB_RET_INVARIANT(n, MDB_INVARIANT_RIGHT_GREATER);
+            }
+        }
+        return MDB_INVARIANT_OK;
+    }
+
+    for (int i = 0; i < n->count; i++) {
+        struct mdb_bnode *child = n->u.inner.children[i];
+        int err = bnode_check_invariants(child, false, depth + 1, leaf_depth);
+        if (err) {
+            return err;
+        }
+        if (n->keys[i] != child->keys[0]) {
+            MDB_RET_INVARIANT(n, MDB_INVARIANT_NODE_KEY);
+        }
+        mdb_root_t end_root;
+        genpaddr_t end;
+        bnode_summary(child, &end_root, &end);
+        if (n->u.inner.end_roots[i] != end_root || n->u.inner.ends[i] != end) {
+            MDB_RET_INVARIANT(n, MDB_INVARIANT_END_IS_MAX);
+        }
+    }
+
+    return MDB_INVARIANT_OK;
+}
+
+int
+mdb_check_invariants(void)
+{
+    if (!mdb_root) {
+        return MDB_INVARIANT_OK;
+    }
+    int leaf_depth = -1;
+    int res = bnode_check_invariants(mdb_root, true, 0, &leaf_depth);
+    if (res != 0) {
+        printf("mdb_check_invariants() -> %d\n", res);
+    }
+    return res;
+}
+
+// PP switch to toggle top-level checking of invariants
+#ifdef MDB_CHECK_INVARIANTS
+#define CHECK_INVARIANTS(cte, reach) \
+do { \
+    if (mdb_reachable(cte) != reach) { \
+        panic("mdb_reachable(%p) != %d", cte, reach); \
+    } \
+    mdb_check_invariants(); \
+} while(0)
+#else
+#define CHECK_INVARIANTS(cte, reach) ((void)0)
+#endif
+
+/*
+ * Insert and remove.
+ */
+
+static errval_t
+bnode_insert(struct mdb_bnode *n, struct mdb_bkey *k, struct cte *new_node,
+             struct mdb_bnode **split)
+{
+    int pos = bnode_search(n, k, false);
+    if (pos < n->count && n->keys[pos] == new_node) {
+        return CAPS_ERR_MDB_DUPLICATE_ENTRY;
+    }
+
+    if (n->leaf) {
+        *split = bnode_insert_at(n, pos, new_node, NULL);
+        return SYS_ERR_OK;
+    }
+
+    int i = pos > 0 ? pos - 1 : 0;
+    struct mdb_bnode *child_split = NULL;
+    errval_t err = bnode_insert(n->u.inner.children[i], k, new_node,
+                                &child_split);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    bnode_update_child(n, i);
+    *split = child_split ? bnode_insert_at(n, i + 1, NULL, child_split) : NULL;
+    return SYS_ERR_OK;
+}
+
+uint64_t mdb_insert_count;
+errval_t
+mdb_insert(struct cte *new_node)
+{
+    mdb_insert_count++;
+    cursor.leaf = NULL;
+
+    // a split on every level plus a new root
+    errval_t err = bnode_reserve(bnode_height(mdb_root) + 1);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (!mdb_root) {
+        set_root(bnode_alloc(true));
+    }
+
+    struct mdb_bkey k = bkey(C(new_node), true);
+    struct mdb_bnode *split = NULL;
+    err = bnode_insert(mdb_root, &k, new_node, &split);
+    if (err_is_fail(err)) {
+        if (mdb_root->count == 0) {
+            bnode_free(mdb_root);
+            set_root(NULL);
+        }
+        return err;
+    }
+
+    if (split) {
+        // grow the tree
+        struct mdb_bnode *root = bnode_alloc(false);
+        bnode_put(root, 0, NULL, mdb_root);
+        bnode_put(root, 1, NULL, split);
+        set_root(root);
+    }
+
+    CHECK_INVARIANTS(new_node, true);
+    return SYS_ERR_OK;
+}
+
+/// Restore the minimum fill of child `i` of `n`
+static void bnode_fix_underflow(struct mdb_bnode *n, int i)
+{
+    struct mdb_bnode *child = n->u.inner.children[i];
+    struct mdb_bnode *left = i > 0 ? n->u.inner.children[i - 1] : NULL;
+    struct mdb_bnode *right = i + 1 < n->count ? n->u.inner.children[i + 1]
+                                               : NULL;
+
+    if (left && left->count > MDB_BTREE_MIN) {
+        // borrow the last entry of the left sibling
+        bnode_shift(child, 0, 1);
+        bnode_copy(child, 0, left, left->count - 1, 1);
+        left->count--;
+        bnode_update_child(n, i - 1);
+        bnode_update_child(n, i);
+    }
+    else if (right && right->count > MDB_BTREE_MIN) {
+        // borrow the first entry of the right sibling
+        bnode_copy(child, child->count, right, 0, 1);
+        child->count++;
+        bnode_shift(right, 1, -1);
+        bnode_update_child(n, i);
+        bnode_update_child(n, i + 1);
+    }
+    else {
+        // merge with a sibling, always into the left one
+        if (!left) {
+            left = child;
+            child = right;
+            i++;
+        }
+        assert(child);
+        bnode_copy(left, left->count, child, 0, child->count);
+        left->count += child->count;
+        if (left->leaf) {
+            left->u.leaf.next = child->u.leaf.next;
+            if (child->u.leaf.next) {
+                child->u.leaf.next->u.leaf.prev = left;
+            }
+        }
+        bnode_free(child);
+        bnode_shift(n, i + 1, -1);
+        bnode_update_child(n, i - 1);
+    }
+}
+
+static errval_t
+bnode_remove(struct mdb_bnode *n, struct mdb_bkey *k, struct cte *target)
+{
+    int pos = bnode_search(n, k, false);
+    bool found = pos < n->count && n->keys[pos] == target;
+
+    if (n->leaf) {
+        if (!found) {
+            return CAPS_ERR_MDB_ENTRY_NOTFOUND;
+        }
+        bnode_shift(n, pos + 1, -1);
+        return SYS_ERR_OK;
+    }
+
+    int i = found ? pos : (pos > 0 ? pos - 1 : 0);
+    struct mdb_bnode *child = n->u.inner.children[i];
+    errval_t err = bnode_remove(child, k, target);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    if (child->count < MDB_BTREE_MIN) {
+        bnode_fix_underflow(n, i);
+    }
+    else {
+        bnode_update_child(n, i);
+    }
+    return SYS_ERR_OK;
+}
+
+uint64_t mdb_remove_count;
+errval_t
+mdb_remove(struct cte *target)
+{
+    CHECK_INVARIANTS(target, true);
+    mdb_remove_count++;
+    cursor.leaf = NULL;
+
+    if (!mdb_root) {
+        return CAPS_ERR_MDB_ENTRY_NOTFOUND;
+    }
+
+    struct mdb_bkey k = bkey(C(target), true);
+    errval_t err = bnode_remove(mdb_root, &k, target);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    // shrink the tree
+    if (mdb_root->leaf && mdb_root->count == 0) {
+        bnode_free(mdb_root);
+        set_root(NULL);
+    }
+    else if (!mdb_root->leaf && mdb_root->count == 1) {
+        struct mdb_bnode *old_root = mdb_root;
+        set_root(old_root->u.inner.children[0]);
+        bnode_free(old_root);
+    }
+
+    CHECK_INVARIANTS(target, false);
+    return SYS_ERR_OK;
+}
+
+/*
+ * Queries on the ordering.
+ */
+
+uint64_t mdb_find_equal_count;
+struct cte*
+mdb_find_equal(struct capability *cap)
+{
+    mdb_find_equal_count++;
+    struct mdb_bkey k = bkey(cap, false);
+    struct cte *cte = bpos_cte(bpos_bound(&k, false));
+    if (cte && compare_caps(cap, C(cte), false) == 0) {
+        return cte;
+    }
+    return NULL;
+}
+
+uint64_t mdb_find_less_count;
+struct cte*
+mdb_find_less(struct capability *cap, bool equal_ok)
+{
+    mdb_find_less_count++;
+    struct mdb_bkey k = bkey(cap, false);
+    return bpos_cte(bpos_prev(bpos_bound(&k, equal_ok)));
+}
+
+uint64_t mdb_find_greater_count;
+struct cte*
+mdb_find_greater(struct capability *cap, bool equal_ok)
+{
+    mdb_find_greater_count++;
+    struct mdb_bkey k = bkey(cap, false);
+    return bpos_cte(bpos_bound(&k, !equal_ok));
+}
+
+static inline bool cursor_at(struct cte *cte)
+{
+    return cursor.leaf && cursor.i < cursor.leaf->count &&
+           cursor.leaf->keys[cursor.i] == cte;
+}
+
+uint64_t mdb_predecessor_count;
+struct cte*
+mdb_predecessor(struct cte *current)
+{
+    mdb_predecessor_count++;
+    struct mdb_bpos p;
+    if (cursor_at(current)) {
+        // iterating, no need to search
+        p = cursor;
+    }
+    else {
+        struct mdb_bkey k = bkey(C(current), true);
+        p = bpos_bound(&k, false);
+    }
+    p = bpos_prev(p);
+    cursor = p;
+    return bpos_cte(p);
+}
+
+uint64_t mdb_successor_count;
+struct cte*
+mdb_successor(struct cte *current)
+{
+    mdb_successor_count++;
+    struct mdb_bpos p;
+    if (cursor_at(current)) {
+        // iterating, no need to search
+        p = bpos_next(cursor);
+    }
+    else {
+        struct mdb_bkey k = bkey(C(current), true);
+        p = bpos_bound(&k, true);
+    }
+    cursor = p;
+    return bpos_cte(p);
+}
+
+/*
+ * The range query.
+ */
+
+static bool
+mdb_is_inside(genpaddr_t outer_begin, genpaddr_t outer_end,
+              genpaddr_t inner_begin, genpaddr_t inner_end)
+{
+    assert(outer_begin <= outer_end);
+    assert(inner_begin <= inner_end);
+    return
+        (inner_begin >= outer_begin && inner_end < outer_end) ||
+        (inner_begin > outer_begin && inner_end <= outer_end);
+}
+
+static struct cte*
+mdb_choose_surrounding(struct cte *first, struct cte *second)
+{
+    return compare_caps(C(first), C(second), true) >= 0 ? first : second;
+}
+
+static struct cte*
+mdb_choose_inner(struct cte *first, struct cte *second)
+{
+    return compare_caps(C(first), C(second), true) <= 0 ? first : second;
+}
+
+static struct cte*
+mdb_choose_partial(genpaddr_t address, struct cte *first, struct cte *second)
+{
+    genpaddr_t fst_beg = get_address(C(first));
+    genpaddr_t snd_beg = get_address(C(second));
+
+    if (fst_beg < address && snd_beg > address) {
+        return first;
+    }
+    else if (snd_beg < address && fst_beg > address) {
+        return second;
+    }
+    else {
+        return mdb_choose_surrounding(first, second);
+    }
+}
+
+struct mdb_range_query {
+    mdb_root_t root;
+    genpaddr_t address;
+    genpaddr_t end;
+    int max_precision;
+    int ret;
+    struct cte *result;
+};
+
+/// Classify a cte with respect to the query, see mdb_sub_find_range()
+static int
+mdb_range_classify(struct mdb_range_query *q, struct cte *cte)
+{
+    genpaddr_t address = get_address(C(cte));
+    genpaddr_t end = address + get_size(C(cte));
+
+    if ((address > q->address && address < q->end && end > q->end) ||
+        (end > q->address && end < q->end && address < q->address))
+    {
+        return MDB_RANGE_FOUND_PARTIAL;
+    }
+    if (mdb_is_inside(q->address, q->end, address, end)) {
+        return MDB_RANGE_FOUND_INNER;
+    }
+    if (address <= q->address &&
+        // exclude 0-length match with curaddr==addr
+        address < q->end &&
+        end >= q->end &&
+        // exclude 0-length match with currend==addr
+        end > q->address)
+    {
+        return MDB_RANGE_FOUND_SURROUNDING;
+    }
+    return MDB_RANGE_NOT_FOUND;
+}
+
+/// Returns true if ctes from key `i` of `n` onwards cannot match the query
+static inline bool
+mdb_range_past_end(struct mdb_range_query *q, struct mdb_bnode *n, int i)
+{
+    // no cap starting at or after the end of the query can overlap it
+    return n->roots[i] > q->root ||
+           (n->roots[i] == q->root && n->addrs[i] >= q->end);
+}
+
+/// Search the subtree at `n`, returns true if the query is finished
+static bool
+mdb_sub_find_range(struct mdb_range_query *q, struct mdb_bnode *n)
+{
+    for (int i = 0; i < n->count; i++) {
+        if (mdb_range_past_end(q, n, i)) {
+            return false;
+        }
+
+        if (!n->leaf) {
+            mdb_root_t end_root = n->u.inner.end_roots[i];
+            if (end_root < q->root ||
+                (end_root == q->root && n->u.inner.ends[i] <= q->address))
+            {
+                // subtree ends before the query
+                continue;
+            }
+            if (mdb_sub_find_range(q, n->u.inner.children[i])) {
+                return true;
+            }
+            continue;
+        }
+
+        if (n->roots[i] != q->root) {
+            continue;
+        }
+        struct cte *cte = n->keys[i];
+        int ret = mdb_range_classify(q, cte);
+        if (ret > q->max_precision) {
+            q->ret = ret;
+            q->result = cte;
+            return true;
+        }
+        else if (ret > q->ret) {
+            q->ret = ret;
+            q->result = cte;
+        }
+        else if (ret == q->ret) {
+            switch (ret) {
+            case MDB_RANGE_NOT_FOUND:
+                break;
+            case MDB_RANGE_FOUND_SURROUNDING:
+                q->result = mdb_choose_surrounding(q->result, cte);
+                break;
+            case MDB_RANGE_FOUND_INNER:
+                q->result = mdb_choose_inner(q->result, cte);
+                break;
+            case MDB_RANGE_FOUND_PARTIAL:
+                q->result = mdb_choose_partial(q->address, q->result, cte);
+                break;
+            default:
+                assert(!"Unhandled enum value for mdb_find_range result");
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+uint64_t mdb_find_range_count;
+errval_t
+mdb_find_range(mdb_root_t root, genpaddr_t address, gensize_t size,
+               int max_result, /*out*/ struct cte **ret_node,
+               /*out*/ int *result)
+{
+    mdb_find_range_count++;
+    if (max_result < MDB_RANGE_NOT_FOUND ||
+        max_result > MDB_RANGE_FOUND_PARTIAL)
+    {
+        return CAPS_ERR_INVALID_ARGS;
+    }
+    if (max_result > MDB_RANGE_NOT_FOUND && !ret_node) {
+        return CAPS_ERR_INVALID_ARGS;
+    }
+    if (!result) {
+        return CAPS_ERR_INVALID_ARGS;
+    }
+
+    struct mdb_range_query q = {
+        .root = root,
+        .address = address,
+        .end = address + size,
+        .max_precision = max_result,
+        .ret = MDB_RANGE_NOT_FOUND,
+        .result = NULL,
+    };
+    if (mdb_root) {
+        mdb_sub_find_range(&q, mdb_root);
+    }
+
+    if (ret_node) {
+        *ret_node = q.result;
+    }
+    *result = q.ret;
+    return SYS_ERR_OK;
+}
+
+uint64_t mdb_find_cap_for_address_count;
+errval_t
+mdb_find_cap_for_address(genpaddr_t address, struct cte **ret_node)
+{
+    mdb_find_cap_for_address_count++;
+    int result;
+    errval_t err;
+    // query for size 1 to get the smallest cap that includes the byte at the
+    // given address
+    err = mdb_find_range(get_type_root(ObjType_RAM), address,
+                         1, MDB_RANGE_FOUND_SURROUNDING, ret_node, &result);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    if (result != MDB_RANGE_FOUND_SURROUNDING) {
+        return SYS_ERR_CAP_NOT_FOUND;
+    }
+    return SYS_ERR_OK;
+}
+
+bool mdb_reachable(struct cte *cte)
+{
+    struct mdb_bkey k = bkey(C(cte), true);
+    return bpos_cte(bpos_bound(&k, false)) == cte;
+}
+
+/*
+ * Traversal.
+ */
+
+errval_t
+mdb_traverse(enum mdb_tree_traversal_order order, mdb_tree_traversal_fn cb, void *data)
+{
+    errval_t err;
+    if (order == MDB_TRAVERSAL_ORDER_ASCENDING) {
+        for (struct mdb_bnode *n = bnode_first_leaf(); n; n = n->u.leaf.next) {
+            for (int i = 0; i < n->count; i++) {
+                err = cb(n->keys[i], data);
+                if (err_is_fail(err)) {
+                    return err;
+                }
+            }
+        }
+    } else {
+        for (struct mdb_bnode *n = bnode_last_leaf(); n; n = n->u.leaf.prev) {
+            for (int i = n->count - 1; i >= 0; i--) {
+                err = cb(n->keys[i], data);
+                if (err_is_fail(err)) {
+                    return err;
+                }
+            }
+        }
+    }
+    return SYS_ERR_OK;
+}
+
+/// Whether `other` has the type root of `cte` and lies within its range
+static inline bool in_range_of(struct cte *cte, struct cte *other)
+{
+    struct capability *cap = C(cte), *o = C(other);
+    return get_type_root(o->type) == get_type_root(cap->type)
+           && get_address(o) >= get_address(cap)
+           && get_address(o) + get_size(o) <= get_address(cap) + get_size(cap);
+}
+
+errval_t
+mdb_traverse_subtree(struct cte *cte, enum mdb_tree_traversal_order order,
+        mdb_tree_traversal_fn cb, void *data)
+{
+    // ctes are not the nodes of the tree here. The subtree of a cte is the
+    // cte and the ctes after it within its range: its later copies and its
+    // descendants.
+    errval_t err;
+    struct mdb_bkey k = bkey(C(cte), true);
+    struct mdb_bpos first = bpos_bound(&k, false);
+    if (bpos_cte(first) != cte) {
+        return SYS_ERR_CAP_NOT_FOUND;
+    }
+
+    struct mdb_bpos p;
+    struct cte *c;
+    if (order == MDB_TRAVERSAL_ORDER_ASCENDING) {
+        for (p = first; (c = bpos_cte(p)) && in_range_of(cte, c);
+             p = bpos_next(p)) {
+            err = cb(c, data);
+            if (err_is_fail(err)) {
+                return err;
+            }
+        }
+    } else {
+        struct mdb_bpos last = first;
+        for (p = bpos_next(first); (c = bpos_cte(p)) && in_range_of(cte, c);
+             p = bpos_next(p)) {
+            last = p;
+        }
+        for (p = last; ; p = bpos_prev(p)) {
+            c = bpos_cte(p);
+            err = cb(c, data);
+            if (err_is_fail(err)) {
+                return err;
+            }
+            if (c == cte) {
+                break;
+            }
+        }
+    }
+    return SYS_ERR_OK;
+}
+
+errval_t
+mdb_size(size_t *count)
+{
+    for (struct mdb_bnode *n = bnode_first_leaf(); n; n = n->u.leaf.next) {
+        *count += n->count;
+    }
+    return SYS_ERR_OK;
+}
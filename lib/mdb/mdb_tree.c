@@ -159,6 +159,28 @@ mdb_init(struct kcb *k)
     return SYS_ERR_OK;
 }
 
+/*
+ * Node memory. The tree is threaded through the ctes and needs none.
+ */
+
+errval_t
+mdb_add_memory(lvaddr_t base, size_t bytes)
+{
+    return SYS_ERR_OK;
+}
+
+size_t
+mdb_free_nodes(void)
+{
+    return SIZE_MAX;
+}
+
+size_t
+mdb_boot_memory(void)
+{
+    return 0;
+}
+
 
 /*
  * Debug printing.
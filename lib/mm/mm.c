@@ -21,6 +21,17 @@
  *      split up into child nodes for smaller allocations.
  *   2. A free node, which is a regular free child node in the tree.
  *   3. An allocated node.
+ *
+ * In addition to the tree, every free node is kept on a doubly-linked free
+ * list for its size. By default, an allocation without address constraints
+ * takes the smallest free region that fits from these lists in constant time,
+ * rather than searching the tree first-fit from the lowest address (see
+ * mm_set_smallest_fit()).
+ *
+ * When a freed region completes a chunked node whose children are all free,
+ * the children are merged back into that node, as in a buddy allocator. This
+ * needs the cap of the chunked node, so it only happens if the allocator
+ * keeps chunked caps (delete_chunked is false).
  */
 
 /*
@@ -82,6 +93,56 @@ static struct mmnode *new_node(struct mm *mm, enum nodetype type,
     return node;
 }
 
+/// Put a free node on the free list for its size
+static void freelist_push(struct mm *mm, struct mmnode *node, genpaddr_t base,
+                          uint8_t sizebits)
+{
+    assert(node->type == NodeType_Free);
+    assert(sizebits < MM_FREE_LISTS);
+
+    node->base = base;
+    node->sizebits = sizebits;
+    node->free_prev = NULL;
+    node->free_next = mm->free_lists[sizebits];
+    if (node->free_next != NULL) {
+        node->free_next->free_prev = node;
+    }
+    mm->free_lists[sizebits] = node;
+}
+
+/// Take a free node off the free list for its size
+static void freelist_remove(struct mm *mm, struct mmnode *node)
+{
+    assert(node->type == NodeType_Free);
+
+    if (node->free_prev != NULL) {
+        node->free_prev->free_next = node->free_next;
+    } else {
+        assert(mm->free_lists[node->sizebits] == node);
+        mm->free_lists[node->sizebits] = node->free_next;
+    }
+    if (node->free_next != NULL) {
+        node->free_next->free_prev = node->free_prev;
+    }
+    node->free_next = node->free_prev = NULL;
+}
+
+/// Take all free nodes below a node off their free lists, marking them allocated
+static void freelist_remove_subtree(struct mm *mm, struct mmnode *node)
+{
+    if (node == NULL) {
+        return;
+    }
+    if (node->type == NodeType_Free) {
+        freelist_remove(mm, node);
+        node->type = NodeType_Allocated;
+    } else if (node->childbits != FLAGBITS) {
+        for (cslot_t i = 0; i < UNBITS_CA(node->childbits); i++) {
+            freelist_remove_subtree(mm, node->children[i]);
+        }
+    }
+}
+
 /// Reduce the number of children of a node by pushing existing children down.
 static errval_t resize_node(struct mm *mm, struct mmnode *node,
                             uint8_t newchildbits)
@@ -404,15 +465,41 @@ static errval_t chunk_node(struct mm *mm, uint8_t sizebits,
         // TODO: Should deallocate the unused slots from mm->slot_alloc()
     }
 
+    if (node->type == NodeType_Free) {
+        freelist_remove(mm, node);
+    }
+
     /* construct child nodes */
+    uint8_t childsizebits = *nodesizebits - childbits;
+    struct capref firstcap = cap;
     for (cslot_t i = 0; i < UNBITS_CA(childbits); i++) {
         struct mmnode *new = new_node(mm, node->type, FLAGBITS);
         if (new == NULL) {
+            // leave the node as it was: drop the children made so far and
+            // the caps of all children
+            for (cslot_t j = 0; j < i; j++) {
+                if (node->children[j]->type == NodeType_Free) {
+                    freelist_remove(mm, node->children[j]);
+                }
+                slab_free(&mm->slabs, node->children[j]);
+                node->children[j] = NULL;
+            }
+            for (cslot_t j = 0; j < UNBITS_CA(childbits); j++) {
+                cap_delete(firstcap);
+                firstcap.slot++;
+            }
+            if (node->type == NodeType_Free) {
+                freelist_push(mm, node, *nodebase, *nodesizebits);
+            }
             return MM_ERR_NEW_NODE;
         }
         node->children[i] = new;
         new->cap = cap;
         cap.slot++;
+        if (new->type == NodeType_Free) {
+            freelist_push(mm, new, *nodebase + i * UNBITS_GENPA(childsizebits),
+                          childsizebits);
+        }
     }
 
     // If configured to delete chunked capabilities, we do so now
@@ -513,6 +600,10 @@ errval_t mm_init(struct mm *mm, enum objtype objtype, genpaddr_t base,
     mm->slot_refill = slot_refill_func;
     mm->slot_alloc_inst = slot_alloc_inst;
     mm->delete_chunked = delete_chunked;
+    mm->smallest_fit = true;
+    for (int i = 0; i < MM_FREE_LISTS; i++) {
+        mm->free_lists[i] = NULL;
+    }
 
     /* init slab allocator */
     slab_init(&mm->slabs, MM_NODE_SIZE(maxchildbits), slab_refill_func);
@@ -562,6 +653,7 @@ errval_t mm_add(struct mm *mm, struct capref cap, uint8_t sizebits, genpaddr_t b
                 return MM_ERR_NEW_NODE;
             }
             mm->root->cap = cap;
+            freelist_push(mm, mm->root, base, sizebits);
             return SYS_ERR_OK;
         } else {
             mm->root = new_node(mm, NodeType_Dummy, FLAGBITS);
@@ -577,6 +669,7 @@ errval_t mm_add(struct mm *mm, struct capref cap, uint8_t sizebits, genpaddr_t b
     if (err_is_ok(err)) {
         assert(node != NULL);
         node->cap = cap;
+        freelist_push(mm, node, base, sizebits);
     }
     return err;
 }
@@ -656,6 +749,57 @@ errval_t mm_add_multi(struct mm *mm, struct capref cap, gensize_t size, genpaddr
     return SYS_ERR_OK;
 }
 
+/// Allocate a region of the given size within a free node, chunking it up
+static errval_t alloc_from_node(struct mm *mm, uint8_t sizebits,
+                                genpaddr_t minbase, genpaddr_t maxlimit,
+                                struct mmnode *node, genpaddr_t nodebase,
+                                uint8_t nodesizebits, struct capref *retcap,
+                                genpaddr_t *retbase)
+{
+    errval_t err;
+
+    assert(node != NULL);
+    assert(node->type == NodeType_Free);
+    assert(nodesizebits >= sizebits);
+
+    /* split up node until it fits */
+    while (nodesizebits > sizebits) {
+        err = chunk_node(mm, sizebits, minbase, maxlimit, node, &nodebase,
+                          &nodesizebits, &node);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    assert(nodebase >= minbase && nodebase + UNBITS_GENPA(sizebits) <= maxlimit);
+    freelist_remove(mm, node);
+    node->type = NodeType_Allocated;
+
+    assert(retcap != NULL);
+    *retcap = node->cap;
+    if (retbase != NULL) {
+        *retbase = nodebase;
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Choose how mm_alloc() places allocations
+ *
+ * By default, mm_alloc() takes the most recently freed region of the smallest
+ * size that fits, in constant time. Without smallest_fit, it takes the first
+ * free region that fits, searching from the lowest address, which is slower
+ * but keeps allocations packed at the bottom of the managed range.
+ *
+ * \param mm Memory manager instance
+ * \param smallest_fit Whether to take the smallest free region that fits
+ */
+void mm_set_smallest_fit(struct mm *mm, bool smallest_fit)
+{
+    mm->smallest_fit = smallest_fit;
+}
+
 /**
  * \brief Allocate an arbitrary memory region of a given size
  *
@@ -673,8 +817,25 @@ errval_t mm_alloc(struct mm *mm, uint8_t sizebits, struct capref *retcap,
         return MM_ERR_NOT_FOUND;
     }
 
-    return mm_alloc_range(mm, sizebits, mm->base,
-                          mm->base + UNBITS_GENPA(mm->sizebits), retcap, retbase);
+    if (!mm->smallest_fit) {
+        return mm_alloc_range(mm, sizebits, mm->base,
+                              mm->base + UNBITS_GENPA(mm->sizebits), retcap,
+                              retbase);
+    }
+
+    /* take the smallest free region that fits */
+    for (uint8_t bits = sizebits; bits <= mm->sizebits && bits < MM_FREE_LISTS;
+         bits++) {
+        struct mmnode *node = mm->free_lists[bits];
+        if (node != NULL) {
+            assert(node->sizebits == bits);
+            return alloc_from_node(mm, sizebits, node->base,
+                                   node->base + UNBITS_GENPA(bits), node,
+                                   node->base, bits, retcap, retbase);
+        }
+    }
+
+    return MM_ERR_NOT_FOUND;
 }
 
 /**
@@ -722,29 +883,8 @@ errval_t mm_alloc_range(struct mm *mm, uint8_t sizebits, genpaddr_t minbase,
         return err;
     }
 
-    assert(node != NULL);
-    assert(node->type == NodeType_Free);
-    assert(nodesizebits >= sizebits);
-
-    /* split up node until it fits */
-    while (nodesizebits > sizebits) {
-        err = chunk_node(mm, sizebits, minbase, maxlimit, node, &nodebase,
-                          &nodesizebits, &node);
-        if (err_is_fail(err)) {
-            return err;
-        }
-    }
-
-    assert(nodebase >= minbase && nodebase + UNBITS_GENPA(sizebits) <= maxlimit);
-    node->type = NodeType_Allocated;
-
-    assert(retcap != NULL);
-    *retcap = node->cap;
-    if (retbase != NULL) {
-        *retbase = nodebase;
-    }
-
-    return SYS_ERR_OK;
+    return alloc_from_node(mm, sizebits, minbase, maxlimit, node, nodebase,
+                           nodesizebits, retcap, retbase);
 }
 
 /**
@@ -794,6 +934,7 @@ errval_t mm_realloc_range(struct mm *mm, uint8_t sizebits, genpaddr_t base,
     assert(node != NULL);
     if (node->type == NodeType_Chunked) {
         assert(nodesizebits == sizebits);
+        freelist_remove_subtree(mm, node);
         node->type = NodeType_Allocated;
         /* FIXME: walk child nodes and mark them allocated? or destroy? */
         *retcap = node->cap;
@@ -813,6 +954,9 @@ errval_t mm_realloc_range(struct mm *mm, uint8_t sizebits, genpaddr_t base,
     }
 
     assert(nodebase == base && nodesizebits == sizebits);
+    if (node->type == NodeType_Free) {
+        freelist_remove(mm, node);
+    }
     node->type = NodeType_Allocated;
 
     assert(retcap != NULL);
@@ -821,10 +965,76 @@ errval_t mm_realloc_range(struct mm *mm, uint8_t sizebits, genpaddr_t base,
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Merge chunked nodes on the path to a freed region back together
+ *
+ * Walks down from node to the region at base, and on the way back up turns
+ * every chunked node whose children are all free into a single free node.
+ * The chunked cap covers the children, so revoking it removes their caps.
+ *
+ * \param mm Memory manager instance
+ * \param node Node to start from
+ * \param nodebase Base address of node
+ * \param nodesizebits Size of node
+ * \param base Base address of the freed region
+ */
+static void coalesce_node(struct mm *mm, struct mmnode *node,
+                          genpaddr_t nodebase, uint8_t nodesizebits,
+                          genpaddr_t base)
+{
+    errval_t err;
+
+    if ((node->type != NodeType_Chunked && node->type != NodeType_Dummy)
+        || node->childbits == FLAGBITS) {
+        return;
+    }
+
+    uint8_t childsizebits = nodesizebits - node->childbits;
+    cslot_t nchild = (base - nodebase) / UNBITS_GENPA(childsizebits);
+    assert(nchild < UNBITS_CA(node->childbits));
+    if (node->children[nchild] != NULL) {
+        coalesce_node(mm, node->children[nchild],
+                      nodebase + nchild * UNBITS_GENPA(childsizebits),
+                      childsizebits, base);
+    }
+
+    if (node->type != NodeType_Chunked || mm->delete_chunked) {
+        return;
+    }
+    for (cslot_t i = 0; i < UNBITS_CA(node->childbits); i++) {
+        if (node->children[i] == NULL
+            || node->children[i]->type != NodeType_Free) {
+            return;
+        }
+    }
+
+    err = cap_revoke(node->cap);
+    if (err_is_fail(err)) {
+        // the chunked cap may be gone (e.g. it was handed out before being
+        // split on free), keep the children
+        DEBUG("coalesce_node: cap_revoke failed: %" PRIuERRV "\n", err);
+        return;
+    }
+
+    DEBUG("coalesce_node %" PRIxGENPADDR "-%" PRIxGENPADDR " <- %" PRIuCSLOT
+          " children\n", nodebase, nodebase + UNBITS_GENPA(nodesizebits),
+          UNBITS_CA(node->childbits));
+
+    for (cslot_t i = 0; i < UNBITS_CA(node->childbits); i++) {
+        freelist_remove(mm, node->children[i]);
+        slab_free(&mm->slabs, node->children[i]);
+        node->children[i] = NULL;
+    }
+    node->childbits = FLAGBITS;
+    node->type = NodeType_Free;
+    freelist_push(mm, node, nodebase, nodesizebits);
+}
+
 /**
  * \brief Free an allocated region
  *
- * Marks the region (which must previously have been allocated) as free.
+ * Marks the region (which must previously have been allocated) as free, and
+ * merges it with its free buddies into their chunked parent where possible.
  *
  * \bug The user might not know (or care about) the base address.
  *
@@ -842,6 +1052,10 @@ errval_t mm_free(struct mm *mm, struct capref cap, genpaddr_t base,
     struct mmnode *node = NULL;
     errval_t err;
 
+    if (mm->root == NULL) {
+        return MM_ERR_NOT_FOUND; // nothing added
+    }
+
     /* search for closest matching node in the tree */
     err = find_node(mm, true, sizebits, base, base + UNBITS_GENPA(sizebits),
                     mm->root, mm->base, mm->sizebits, &nodebase, &nodesizebits,
@@ -869,6 +1083,9 @@ errval_t mm_free(struct mm *mm, struct capref cap, genpaddr_t base,
 
     node->type = NodeType_Free;
     node->cap = cap;
+    freelist_push(mm, node, nodebase, nodesizebits);
+
+    coalesce_node(mm, mm->root, mm->base, mm->sizebits, nodebase);
 
     return SYS_ERR_OK;
 }
@@ -887,8 +1104,9 @@ errval_t mm_free(struct mm *mm, struct capref cap, genpaddr_t base,
  */
 size_t mm_relinquish_all(struct mm *mm, struct mem_cap *ret, size_t retlen)
 {
-    USER_PANIC("NYI");
-    return 0;
+    return mm_relinquish_range(mm, mm->base,
+                               mm->base + UNBITS_GENPA(mm->sizebits),
+                               ret, retlen);
 }
 
 /**
@@ -911,6 +1129,44 @@ size_t mm_relinquish_all(struct mm *mm, struct mem_cap *ret, size_t retlen)
 size_t mm_relinquish_range(struct mm *mm, genpaddr_t base, genpaddr_t limit,
                            struct mem_cap *ret, size_t retlen)
 {
-    USER_PANIC("NYI");
-    return 0;
+    size_t count = 0;
+
+    /* Walk the free lists from the largest size down, so that the halves of
+     * a free region straddling an end of the range are visited after it has
+     * been split. */
+    for (int bits = MM_FREE_LISTS - 1; bits >= 0; bits--) {
+        struct mmnode *node = mm->free_lists[bits];
+        while (node != NULL) {
+            struct mmnode *next = node->free_next;
+            genpaddr_t nodebase = node->base;
+            genpaddr_t nodelimit = nodebase + UNBITS_GENPA(bits);
+
+            if (nodelimit <= base || nodebase >= limit) {
+                /* outside the range */
+            } else if (nodebase >= base && nodelimit <= limit) {
+                if (count < retlen) {
+                    freelist_remove(mm, node);
+                    node->type = NodeType_Allocated;
+                    ret[count].cap = node->cap;
+                    ret[count].sizebits = bits;
+                    ret[count].base = nodebase;
+                }
+                count++;
+            } else if (bits > 0) {
+                /* straddles an end of the range, split it in half */
+                uint8_t nodesizebits = bits;
+                struct mmnode *child;
+                errval_t err = chunk_node(mm, bits - 1, nodebase, nodelimit,
+                                          node, &nodebase, &nodesizebits,
+                                          &child);
+                if (err_is_fail(err)) {
+                    DEBUG_ERR(err, "chunk_node in mm_relinquish_range");
+                }
+            }
+
+            node = next;
+        }
+    }
+
+    return count;
 }
@@ -480,31 +480,24 @@ errval_t numa_ram_alloc_on_node(struct capref *dest, size_t size,
 {
     errval_t err;
 
-    NUMA_DEBUG_ALLOC("allocating frame on node %" PRIuNODEID "\n", node);
-
-    uint64_t min_base, max_limit;
-    ram_get_affinity(&min_base, &max_limit);
+    NUMA_DEBUG_ALLOC("allocating RAM on node %" PRIuNODEID "\n", node);
 
     if (node >= numa_topology.num_nodes) {
         return NUMA_ERR_NODEID_INVALID;
     }
 
-    uint64_t node_base = numa_node_base(node);
-    uint64_t node_limit = node_base + numa_node_size(node, NULL);
-
-    NUMA_DEBUG_ALLOC("setting affinity to 0x%" PRIx64 "..0x%" PRIx64 "\n",
-                     node_base, node_limit);
+    uint8_t bits = log2ceil(size);
 
-    ram_set_affinity(node_base, node_limit);
-
-    err = ram_alloc(dest, log2ceil(size));
-
-    ram_set_affinity(min_base, max_limit);
+    err = ram_alloc_node(dest, bits, node);
+    if (err_is_fail(err)) {
+        return err;
+    }
 
-    NUMA_DEBUG_ALLOC("restore affinity to 0x%" PRIx64 "..0x%" PRIx64 "\n",
-                     min_base, max_limit);
+    if (ret_size) {
+        *ret_size = (size_t)1 << bits;
+    }
 
-    return err;
+    return SYS_ERR_OK;
 }
 
 /**
@@ -527,29 +520,33 @@ errval_t numa_frame_alloc_on_node(struct capref *dest,
 
     NUMA_DEBUG_ALLOC("allocating frame on node %" PRIuNODEID "\n", node);
 
-    uint64_t min_base, max_limit;
-    ram_get_affinity(&min_base, &max_limit);
+    size = (size + BASE_PAGE_SIZE - 1) & ~(BASE_PAGE_SIZE - 1);
 
-    if (node >= numa_topology.num_nodes) {
-        return NUMA_ERR_NODEID_INVALID;
+    struct capref ram;
+    size_t ram_size;
+    err = numa_ram_alloc_on_node(&ram, size, node, &ram_size);
+    if (err_is_fail(err)) {
+        return err;
     }
 
-    uint64_t node_base = numa_node_base(node);
-    uint64_t node_limit = node_base + numa_node_size(node, NULL);
-
-    NUMA_DEBUG_ALLOC("setting affinity to 0x%" PRIx64 "..0x%" PRIx64 "\n",
-                     node_base, node_limit);
-
-    ram_set_affinity(node_base, node_limit);
-
-    err = frame_alloc(dest, size, ret_size);
+    err = slot_alloc(dest);
+    if (err_is_fail(err)) {
+        cap_destroy(ram);
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
 
-    ram_set_affinity(min_base, max_limit);
+    err = cap_retype(*dest, ram, 0, ObjType_Frame, ram_size, 1);
+    cap_destroy(ram);
+    if (err_is_fail(err)) {
+        slot_free(*dest);
+        return err_push(err, LIB_ERR_CAP_RETYPE);
+    }
 
-    NUMA_DEBUG_ALLOC("restore affinity to 0x%" PRIx64 "..0x%" PRIx64 "\n",
-                     min_base, max_limit);
+    if (ret_size) {
+        *ret_size = ram_size;
+    }
 
-    return err;
+    return SYS_ERR_OK;
 }
 
 
@@ -288,7 +288,9 @@ size_t numa_node_size(nodeid_t node, uintptr_t *freep)
     numa_check_node_id(node);
 
     if (freep) {
-        // TODO: figure out how much memory is left in the node
+        genpaddr_t avail, total;
+        errval_t err = ram_available_node(node, &avail, &total);
+        *freep = err_is_ok(err) ? avail : 0;
     }
 
     return (numa_topology.nodes[node].mem_limit - numa_topology.nodes[node].mem_base);
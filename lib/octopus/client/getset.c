@@ -20,6 +20,7 @@
 #include <stdarg.h>
 
 #include <barrelfish/barrelfish.h>
+#include <flounder/flounder_rpc_pipeline.h>
 
 #include <if/octopus_defs.h>
 #include <if/octopus_thc.h>
@@ -124,6 +125,106 @@ errval_t oct_get(char** data, const char* query, ...)
     return err;
 }
 
+/// A get call sent by oct_get_records()
+struct get_records_call {
+    char** record;
+    errval_t err;
+};
+
+/// Serializes the users of the pipelined binding
+static struct thread_mutex get_records_mutex = THREAD_MUTEX_INITIALIZER;
+
+static void get_records_done(struct octopus_binding* b, void* st,
+        const char* output, octopus_trigger_id_t tid, errval_t error_code)
+{
+    struct get_records_call* call = st;
+
+    call->err = error_code;
+    if (err_is_ok(error_code)) {
+        *call->record = strdup(output);
+        if (*call->record == NULL) {
+            call->err = LIB_ERR_MALLOC_FAIL;
+        }
+    }
+}
+
+/**
+ * \brief Gets the records matching several queries.
+ *
+ * Unlike calling oct_get() for each query, which waits for every round
+ * trip, the queries are sent on a pipelined binding with many calls in
+ * flight at a time.
+ *
+ * \param[out] records Records returned by the server, NULL for a query that
+ * failed. Need to be freed by the client.
+ * \param[in] queries Queries sent to the server, for example record names
+ * returned by oct_get_names().
+ * \param[in] len Number of queries.
+ *
+ * \retval SYS_ERR_OK
+ * \retval OCT_ERR_NO_RECORD
+ * \retval OCT_ERR_PARSER_FAIL
+ * \retval OCT_ERR_ENGINE_FAIL
+ * \retval LIB_ERR_MALLOC_FAIL
+ * The error of the first query that failed is returned.
+ */
+errval_t oct_get_records(char** records, char* const* queries, size_t len)
+{
+    assert(records != NULL);
+    assert(queries != NULL || len == 0);
+    errval_t err = SYS_ERR_OK;
+
+    for (size_t i = 0; i < len; i++) {
+        records[i] = NULL;
+    }
+
+    struct get_records_call* calls = calloc(len, sizeof(*calls));
+    if (len > 0 && calls == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    thread_mutex_lock(&get_records_mutex);
+
+    struct octopus_binding* b = NULL;
+    err = oct_get_pipeline_binding(&b);
+    if (err_is_fail(err)) {
+        goto out;
+    }
+
+    size_t sent;
+    for (sent = 0; sent < len; sent++) {
+        // the pipeline holds FLOUNDER_RPC_PIPELINE_DEPTH calls
+        err = flounder_rpc_pipeline_wait(b->waitset, b->rpc_pipeline,
+                FLOUNDER_RPC_PIPELINE_DEPTH - 1);
+        if (err_is_fail(err)) {
+            break;
+        }
+
+        calls[sent].record = &records[sent];
+        err = octopus_get__rpc_async(b, get_records_done, &calls[sent],
+                queries[sent], NOP_TRIGGER);
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+
+    // the calls in flight write to calls and records, wait for all of them
+    errval_t wait_err = flounder_rpc_pipeline_wait(b->waitset,
+            b->rpc_pipeline, 0);
+    if (err_is_fail(wait_err)) {
+        USER_PANIC_ERR(wait_err, "waiting for pipelined octopus calls");
+    }
+
+    for (size_t i = 0; i < sent && err_is_ok(err); i++) {
+        err = calls[i].err;
+    }
+
+out:
+    thread_mutex_unlock(&get_records_mutex);
+    free(calls);
+    return err;
+}
+
 /**
  * \brief Sets a record.
  *
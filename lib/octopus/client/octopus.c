@@ -3,7 +3,8 @@
  * \brief Initialization functions for the octopus client library.
  *
  * We use two bindings: One for communication with the server using RPC calls,
- * and one for asynchronous events coming from the server.
+ * and one for asynchronous events coming from the server. A third binding,
+ * set up on first use, carries pipelined RPC calls.
  */
 
 /*
@@ -36,7 +37,7 @@ static struct oct_state {
     struct waitset ws;
     errval_t err;
     bool is_done;
-} rpc, event;
+} rpc, event, pipeline;
 
 static iref_t service_iref = 0;
 static uint64_t client_identifier = 0;
@@ -165,6 +166,52 @@ static errval_t get_service_iref(void)
 
 }
 
+static void pipeline_bind_cb(void *st, errval_t err, struct octopus_binding *b)
+{
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "oct_pipeline bind failed");
+        goto out;
+    }
+
+    err = octopus_rpc_pipeline_init(b, 0);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "octopus_rpc_pipeline_init");
+        goto out;
+    }
+    pipeline.binding = b;
+
+out:
+    assert(!pipeline.is_done);
+    pipeline.is_done = true;
+    pipeline.err = err;
+}
+
+/**
+ * \brief Returns the binding for pipelined RPC calls, binding it if needed.
+ *
+ * The binding is separate from the RPC binding, as the pipeline takes over
+ * its response handlers. Only calls without triggers may be sent on it,
+ * as the server doesn't know which client it belongs to. The caller must
+ * serialize the use of the binding.
+ */
+errval_t oct_get_pipeline_binding(struct octopus_binding** b)
+{
+    if (pipeline.binding == NULL) {
+        errval_t err = get_service_iref();
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        err = init_binding(&pipeline, pipeline_bind_cb);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    *b = pipeline.binding;
+    return SYS_ERR_OK;
+}
+
 errval_t oct_thc_init(void)
 {
     errval_t err = SYS_ERR_OK;
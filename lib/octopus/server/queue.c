@@ -21,15 +21,25 @@ static void oct_rpc_send_next(void *arg)
 
     struct oct_reply_state* current = oct_rpc_dequeue_reply(b);
 
-    // If more state in the queue, send them
+    // If more state in the queue, send them with the token of their call,
+    // so pipelined clients can match the response
     if (current) {
+        thread_set_outgoing_token(current->token);
         current->reply(b, current);
+        uint32_t token;
+        thread_get_outgoing_token(&token); // clear it if the send failed
     }
 }
 
 void oct_rpc_enqueue_reply(struct octopus_binding *b,
         struct oct_reply_state* st)
 {
+    // Replies are first queued from the handler of their call, so this is
+    // its token. Other messages queued here don't need one.
+    if (st->token == 0) {
+        st->token = octopus_rpc_call_token(b) & ~1;
+    }
+
     if (b->st == NULL) {
         struct waitset *ws = get_default_waitset();
         b->register_send(b, ws, MKCONT(oct_rpc_send_next, b));
@@ -76,6 +76,7 @@ errval_t new_oct_reply_state(struct oct_reply_state** drt,
     (*drt)->client_state = 0;
     (*drt)->client_handler = 0;
     (*drt)->server_id = 0;
+    (*drt)->token = 0;
 
     (*drt)->reply = reply_handler;
     (*drt)->next = NULL;
@@ -25,46 +25,68 @@
 #include <stdio.h>
 
 
+/// Return the core with the lowest id above prev, or the lowest if prev is NULL
+static struct trace_core *next_core(struct trace_buffer *master,
+                                    struct trace_core *prev)
+{
+    struct trace_core *next = NULL;
+    for (struct trace_core *core = trace_offset_to_ptr(master, master->cores);
+         core != NULL; core = trace_offset_to_ptr(master, core->next)) {
+        if ((prev == NULL || core->core_id > prev->core_id) &&
+            (next == NULL || core->core_id < next->core_id)) {
+            next = core;
+        }
+    }
+    return next;
+}
+
+/// Discard the events of all rings of a core
+static void reset_core(struct trace_buffer *master, struct trace_core *core)
+{
+    for (struct trace_ring *ring = trace_next_ring(master, core, NULL);
+         ring != NULL; ring = trace_next_ring(master, core, ring)) {
+        ring->tail = ring->head;
+        ring->dropped = 0;
+    }
+}
+
 /**
  * \brief Reset the trace buffer on the current core.
  *
- * Reset head and tail pointers.
+ * Discard the events of all rings on the core.
  */
 void trace_reset_buffer(void)
 {
-    uintptr_t i, new;
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
 
-    assert(trace_buffer_va);
-    if (!trace_buffer_va) {
-        debug_printf("%s: trace_buffer_va == NULL! expect badness when tracing!\n", __FUNCTION__);
+    assert(master);
+    if (!master) {
+        debug_printf("%s: trace_buffer_master == NULL! expect badness when tracing!\n", __FUNCTION__);
         return;
     }
 
-    struct trace_buffer *buf = (struct trace_buffer *)trace_buffer_va;
+    struct trace_core *core = trace_get_core(master, disp_get_core_id());
+    if (core == NULL) {
+        return;
+    }
 
-    //buf->master = (struct trace_buffer *)trace_buffer_master;
-    do {
-        i = buf->head_index;
-        new = 1;
-    } while (!trace_cas(&buf->head_index, i, new));
-    buf->tail_index = 0;
+    reset_core(master, core);
 
-    buf->num_applications = 0;
+    core->num_applications = 0;
 }
 
 /**
  * \brief Reset all trace buffers discarding the current trace
  *
- * Reset head and tail pointers.
+ * Discard the events of all rings on all cores.
  */
 void trace_reset_all(void)
 {
     struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
     master->event_counter = 0;
-    for (coreid_t core = 0; core < TRACE_COREID_LIMIT; core++) {
-        struct trace_buffer *tbuf = (struct trace_buffer *)compute_trace_buf_addr(core);
-        tbuf->head_index = 1;
-        tbuf->tail_index = 0;
+    for (struct trace_core *core = trace_offset_to_ptr(master, master->cores);
+         core != NULL; core = trace_offset_to_ptr(master, core->next)) {
+        reset_core(master, core);
     }
 }
 
@@ -87,14 +109,9 @@ errval_t trace_control_fixed_events_counter(uint64_t start_trigger,
                        uint64_t duration,
                        uint64_t event_counter)
 {
-    dispatcher_handle_t handle = curdispatcher();
-    struct dispatcher_generic *disp = get_dispatcher_generic(handle);
-    struct trace_buffer *buf = disp->trace_buf;
-
-    if (buf == NULL) return TRACE_ERR_NO_BUFFER;
+    if (trace_buffer_master == 0) return TRACE_ERR_NO_BUFFER;
 
     struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
-    //struct trace_buffer *master = buf->master;
 
     master->running = false;
     master->stop_trigger = stop_trigger;
@@ -106,19 +123,36 @@ errval_t trace_control_fixed_events_counter(uint64_t start_trigger,
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Start tracing now, without waiting for a start trigger
+ *
+ * Tracing runs until it is reconfigured with trace_control. This is meant
+ * for streaming the trace out while the system runs.
+ */
+errval_t trace_start(void)
+{
+    struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
+
+    if (master == NULL) return TRACE_ERR_NO_BUFFER;
+
+    master->start_trigger = 0;
+    master->stop_trigger = 0;
+    master->duration = 0;
+    master->stop_time = 0xFFFFFFFFFFFFFFFFULL;
+    master->t0 = TRACE_TIMESTAMP();
+    master->running = true;
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief Wait for a trace to complete
  */
 errval_t trace_wait(void)
 {
-    dispatcher_handle_t handle = curdispatcher();
-    struct dispatcher_generic *disp = get_dispatcher_generic(handle);
-    struct trace_buffer *buf = disp->trace_buf;
-
-    if (buf == NULL) return TRACE_ERR_NO_BUFFER;
+    if (trace_buffer_master == 0) return TRACE_ERR_NO_BUFFER;
 
     struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
-    //struct trace_buffer *master = buf->master;
 
     while (master->start_trigger != 0) thread_yield_dispatcher(NULL_CAP);
     while (master->stop_trigger != 0) thread_yield_dispatcher(NULL_CAP);
@@ -144,13 +178,13 @@ size_t trace_dump(char *buf, size_t buflen, int *number_of_events_dumped)
     size_t retval_total = 0;
     size_t ev_dumped_total = 0;
 
-    for (coreid_t core = 0; core < TRACE_COREID_LIMIT && remaining_buflen > 0; core++) {
+    struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
+    for (struct trace_core *core = next_core(master, NULL);
+         core != NULL && remaining_buflen > 0; core = next_core(master, core)) {
         int ev_dumped = 0;
         size_t used_bytes = 0;
         size_t retval = trace_dump_core(buf, remaining_buflen, &used_bytes,
-                &ev_dumped, core, isfirst, isOnlyOne);
-//        assert(used_bytes != 0);
-//        assert(ev_dumped != 0);
+                &ev_dumped, core->core_id, isfirst, isOnlyOne);
         retval_total += retval; // adding up the return value
         ev_dumped_total += ev_dumped; // adding up the ptr argument
         buf = buf +  used_bytes;
@@ -165,20 +199,58 @@ size_t trace_dump(char *buf, size_t buflen, int *number_of_events_dumped)
     return retval_total;
 }
 
+/**
+ * \brief Number of events recorded on a core and not dumped yet
+ */
 size_t trace_get_event_count(coreid_t specified_core)
 {
-    struct trace_buffer *tbuf = (struct trace_buffer *)compute_trace_buf_addr(specified_core);
+    struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
+    struct trace_core *core = trace_get_core(master, specified_core);
+    if (core == NULL) {
+        return 0;
+    }
 
-    size_t num_events;
-    if (tbuf->head_index > tbuf->tail_index) {
-        num_events = tbuf->head_index - tbuf->tail_index - 1;
-    } else {
-        num_events = (TRACE_MAX_EVENTS - tbuf->tail_index) + tbuf->head_index - 1;
+    size_t num_events = 0;
+    for (struct trace_ring *ring = trace_next_ring(master, core, NULL);
+         ring != NULL; ring = trace_next_ring(master, core, ring)) {
+        uintptr_t head = ring->head;
+        num_events += head - trace_ring_first(ring, head);
     }
     return num_events;
 }
 
+/**
+ * \brief Number of events lost on a core because its rings were full
+ */
+size_t trace_get_dropped_count(coreid_t specified_core)
+{
+    struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
+    struct trace_core *core = trace_get_core(master, specified_core);
+    if (core == NULL) {
+        return 0;
+    }
+
+    size_t dropped = 0;
+    for (struct trace_ring *ring = trace_next_ring(master, core, NULL);
+         ring != NULL; ring = trace_next_ring(master, core, ring)) {
+        dropped += ring->dropped;
+    }
+    return dropped;
+}
+
+/// Position of the reader in one ring while dumping a core
+struct ring_cursor {
+    struct trace_ring *ring;
+    uintptr_t pos;
+    uintptr_t end;
+};
 
+/**
+ * \brief Dump the events of one core
+ *
+ * The rings of the dispatchers and the kernel on the core are merged in
+ * timestamp order, and the dumped events are consumed.
+ */
 size_t trace_dump_core(char *buf, size_t buflen, size_t *usedBytes,
         int *number_of_events_dumped, coreid_t specified_core,
         bool first_dump, bool isOnlyOne)
@@ -188,7 +260,6 @@ size_t trace_dump_core(char *buf, size_t buflen, size_t *usedBytes,
 
     struct trace_buffer *master = (struct trace_buffer*)trace_buffer_master;
     assert(master);
-    //struct trace_buffer *master = trace_buf->master;
 
     char *ptr = buf;
     size_t totlen = 0;
@@ -209,37 +280,30 @@ size_t trace_dump_core(char *buf, size_t buflen, size_t *usedBytes,
 
         // Determine the minimum timestamp for which an event has been recorded.
         uint64_t min_timestamp = 0xFFFFFFFFFFFFFFFFULL;
-        for (coreid_t core = 0; core < TRACE_COREID_LIMIT; core++) {
+        for (struct trace_core *core = trace_offset_to_ptr(master, master->cores);
+             core != NULL; core = trace_offset_to_ptr(master, core->next)) {
 
             if (isOnlyOne) {
-                if (core != specified_core) {
+                if (core->core_id != specified_core) {
                     // We want minimum time only for this core
                     continue;
                 }
             }
-            struct trace_buffer *tbuf = (struct trace_buffer *)compute_trace_buf_addr(core);
 
-            int num_events;
-            if (tbuf->head_index > tbuf->tail_index) {
-                num_events = tbuf->head_index - tbuf->tail_index - 1;
-            } else {
-                num_events = (TRACE_MAX_EVENTS - tbuf->tail_index) + tbuf->head_index - 1;
-            }
-
-            if (num_events == 0) {
-                // Ringbuffer is empty.
-                continue;
-            }
-
-            // Get the first event
-            int idx = tbuf->tail_index + 1;
-            if (idx == TRACE_MAX_EVENTS) {
-                idx = 0;
-            }
+            for (struct trace_ring *ring = trace_next_ring(master, core, NULL);
+                 ring != NULL; ring = trace_next_ring(master, core, ring)) {
+                uintptr_t first = trace_ring_first(ring, ring->head);
+                uintptr_t head = trace_ring_committed(ring, first, ring->head);
+                if (first == head) {
+                    // Ringbuffer is empty.
+                    continue;
+                }
 
-            uint64_t timestamp = tbuf->events[idx].timestamp;
-            if (timestamp <= min_timestamp) {
-                min_timestamp = timestamp;
+                uint64_t timestamp =
+                    ring->events[first & (ring->size - 1)].timestamp;
+                if (timestamp <= min_timestamp) {
+                    min_timestamp = timestamp;
+                }
             }
 
         } // end for: for each core
@@ -252,75 +316,120 @@ size_t trace_dump_core(char *buf, size_t buflen, size_t *usedBytes,
         ptr += len; totlen += len;
     } // end if: if this is first core
 
-    coreid_t core = specified_core;
-    // Create dumps for each core.
-//    for (coreid_t core = 0; core < TRACE_COREID_LIMIT; core++) {
+    struct trace_core *core = trace_get_core(master, specified_core);
+    if (core == NULL) {
+        *usedBytes = totlen;
+        return totlen;
+    }
+
+    // Snapshot the events of each ring
+    int num_rings = 0;
+    for (struct trace_ring *ring = trace_next_ring(master, core, NULL);
+         ring != NULL; ring = trace_next_ring(master, core, ring)) {
+        num_rings++;
+    }
+    struct ring_cursor *cursors = malloc(num_rings * sizeof(*cursors));
+    assert(cursors != NULL);
+
+    int num_events = 0;
+    int r = 0;
+    for (struct trace_ring *ring = trace_next_ring(master, core, NULL);
+         ring != NULL && r < num_rings;
+         ring = trace_next_ring(master, core, ring)) {
+        cursors[r].ring = ring;
+        cursors[r].pos = trace_ring_first(ring, ring->head);
+        cursors[r].end = trace_ring_committed(ring, cursors[r].pos,
+                                              ring->head);
+        num_events += cursors[r].end - cursors[r].pos;
+        r++;
+    }
+    num_rings = r;
 
-        struct trace_buffer *tbuf = (struct trace_buffer *)compute_trace_buf_addr(core);
+    if (num_events > 0) {
 
-        int num_events;
-        if (tbuf->head_index > tbuf->tail_index) {
-            num_events = tbuf->head_index - tbuf->tail_index - 1;
-            //printf("> , head %ld tail %ld num_events %d\n", tbuf->head_index, tbuf->tail_index, num_events);
-        } else {
-            num_events = (TRACE_MAX_EVENTS - tbuf->tail_index) + tbuf->head_index - 1;
-            //printf("< , head %ld tail %ld num_events %d\n", tbuf->head_index, tbuf->tail_index, num_events);
-        }
+        assert(totlen < buflen);
+        len = snprintf(ptr, buflen-totlen,
+                "# Core %d LOG DUMP ==================================================\n",
+                core->core_id);
+        assert(len >= 0);
+        ptr += len; totlen += len;
+
+        // Print the core time offset relative to core 0
+        assert(totlen < buflen);
+        len = snprintf(ptr, buflen-totlen,
+                "# Offset %d %" PRIi64 "\n",
+                core->core_id, core->t_offset);
+
+        assert(len >= 0);
+        ptr += len; totlen += len;
 
-        if (num_events > 0) {
-            // Ringbuffer is empty.
+        // Print all application names
+        for(int app_index = 0; app_index < core->num_applications; app_index++ ) {
 
             assert(totlen < buflen);
             len = snprintf(ptr, buflen-totlen,
-                    "# Core %d LOG DUMP ==================================================\n", core);
+                    "# DCB %d %" PRIx64 " %.*s\n",
+                    core->core_id, core->applications[app_index].dcb,
+                    8, (char*)&core->applications[app_index].name);
+
             assert(len >= 0);
             ptr += len; totlen += len;
+        }
+
+        // Print the events lost in each ring
+        for (r = 0; r < num_rings; r++) {
+            struct trace_ring *ring = cursors[r].ring;
+            if (ring->dropped == 0) {
+                continue;
+            }
 
-            // Print the core time offset relative to core 0
             assert(totlen < buflen);
             len = snprintf(ptr, buflen-totlen,
-                    "# Offset %d %" PRIi64 "\n",
-                    core, tbuf->t_offset);
+                    "# Dropped %d %.*s %" PRIuPTR "\n",
+                    core->core_id, 8, ring->name, ring->dropped);
 
             assert(len >= 0);
             ptr += len; totlen += len;
+        }
 
-            // Print all application names
-            for(int app_index = 0; app_index < tbuf->num_applications; app_index++ ) {
-
-                assert(totlen < buflen);
-                len = snprintf(ptr, buflen-totlen,
-                        "# DCB %d %" PRIx64 " %.*s\n",
-                        core, tbuf->applications[app_index].dcb,
-                        8, (char*)&tbuf->applications[app_index].name);
+        for (int i = 0; i < num_events; i++) {
 
-                assert(len >= 0);
-                ptr += len; totlen += len;
+            // Take the oldest event of all rings
+            struct ring_cursor *c = NULL;
+            struct trace_event *ev = NULL;
+            for (r = 0; r < num_rings; r++) {
+                if (cursors[r].pos == cursors[r].end) {
+                    continue;
+                }
+                struct trace_ring *ring = cursors[r].ring;
+                struct trace_event *e =
+                    &ring->events[cursors[r].pos & (ring->size - 1)];
+                if (ev == NULL || e->timestamp < ev->timestamp) {
+                    c = &cursors[r];
+                    ev = e;
+                }
             }
+            c->pos++;
 
-            for (int i = 0; i < num_events; i++) {
+            assert(totlen < buflen);
+            len = snprintf(ptr, buflen-totlen,
+                    "%d %" PRIu64 " %" PRIx64 "\n",
+                    core->core_id, ev->timestamp, ev->u.raw);
+            assert(len >= 0);
+            ptr += len; totlen += len;
 
-                tbuf->tail_index++;
-                if (tbuf->tail_index == TRACE_MAX_EVENTS) {
-                    tbuf->tail_index = 0;
-                }
+            if(number_of_events_dumped != NULL) {
+                (*number_of_events_dumped)++;
+            }
+        } // end for:
+    } // end if: no. of events > 0
 
-                assert(totlen < buflen);
-                len = snprintf(ptr, buflen-totlen,
-                        "%d %" PRIu64 " %" PRIx64 "\n",
-                        core, tbuf->events[tbuf->tail_index].timestamp,
-                        //core, tbuf->events[tbuf->tail_index].timestamp - t0,
-                        tbuf->events[tbuf->tail_index].u.raw);
-                assert(len >= 0);
-                ptr += len; totlen += len;
-
-                if(number_of_events_dumped != NULL) {
-                    (*number_of_events_dumped)++;
-                }
-            } // end for:
-        } // end if: no. of events > 0
+    // Consume the dumped events
+    for (r = 0; r < num_rings; r++) {
+        cursors[r].ring->tail = cursors[r].end;
+    }
+    free(cursors);
 
-//    } // end for: for each core
     *usedBytes = totlen;
     return totlen;
 }
@@ -519,9 +628,9 @@ void trace_set_autoflush(bool enabled)
  */
 errval_t trace_set_subsys_enabled(uint16_t subsys, bool enabled)
 {
-	bool* subsystem_states = (bool*) (((uint8_t*) trace_buffer_master) + TRACE_BUF_SIZE);
+	struct trace_buffer *master = (struct trace_buffer*) trace_buffer_master;
 
-	subsystem_states[subsys] = enabled;
+	master->subsys_enabled[subsys] = enabled;
 
 	return SYS_ERR_OK;
 }
@@ -531,10 +640,10 @@ errval_t trace_set_subsys_enabled(uint16_t subsys, bool enabled)
  */
 errval_t trace_set_all_subsys_enabled(bool enabled)
 {
-	bool* subsystem_states = (bool*) (((uint8_t*) trace_buffer_master) + TRACE_BUF_SIZE);
+	struct trace_buffer *master = (struct trace_buffer*) trace_buffer_master;
 	int i = 0;
 	for (i = 0; i < TRACE_NUM_SUBSYSTEMS; i++) {
-		subsystem_states[i] = enabled;
+		master->subsys_enabled[i] = enabled;
 	}
 
 	return SYS_ERR_OK;
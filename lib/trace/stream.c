@@ -0,0 +1,414 @@
+/**
+ * \file
+ * \brief Streaming export of the trace rings
+ *
+ * Instead of dumping the trace buffer as text once tracing has stopped, a
+ * trace stream drains the rings of all cores while tracing runs, and
+ * encodes the events into a compact binary format:
+ *
+ *   "BFTRACE\1"                       magic, once at the start
+ *   followed by records, each starting with a one byte tag:
+ *
+ *   CLOCK   varint tsc_per_ms
+ *   RING    varint ring, varint core, char name[8]
+ *   APP     varint core, varint dcb, char name[8]
+ *   OFFSET  varint core, svarint t_offset
+ *   EVENTS  varint ring, varint count,
+ *           count * (svarint timestamp delta, varint raw >> 32,
+ *                    varint raw & 0xffffffff)
+ *   DROPPED varint ring, varint count
+ *
+ * varints are unsigned LEB128, svarints are zigzag encoded LEB128. Rings
+ * are numbered by the stream in the order it finds them. The timestamp of
+ * an event is encoded relative to the previous event of its ring. The
+ * DROPPED record counts the events the ring lost since the last DROPPED
+ * record. tools/tracing/trace2json.py decodes the stream.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/sys_debug.h>
+#include <trace/trace.h>
+#include <string.h>
+#include <sys/param.h>
+
+#define STREAM_MAGIC        "BFTRACE\1"
+
+enum stream_tag {
+    STREAM_TAG_CLOCK    = 1,
+    STREAM_TAG_RING     = 2,
+    STREAM_TAG_APP      = 3,
+    STREAM_TAG_OFFSET   = 4,
+    STREAM_TAG_EVENTS   = 5,
+    STREAM_TAG_DROPPED  = 6,
+};
+
+/// Events copied out of a ring at a time
+#define STREAM_CHUNK_EVENTS 512
+
+/// Worst case encoded size of a record other than EVENTS
+#define STREAM_RECORD_MAX   32
+
+/// Worst case encoded size of an event
+#define STREAM_EVENT_MAX    20
+
+#define STREAM_BUF_SIZE     (STREAM_RECORD_MAX + \
+                             STREAM_CHUNK_EVENTS * STREAM_EVENT_MAX)
+
+/// Stream state of one trace ring
+struct stream_ring {
+    struct trace_ring *ring;
+    uint64_t last_timestamp;        ///< Timestamp of the last event sent
+    uintptr_t dropped;              ///< Drops already reported
+};
+
+/// Stream state of one core
+struct stream_core {
+    struct trace_core *core;
+    uintptr_t num_applications;     ///< Applications already sent
+    int64_t t_offset;               ///< Time offset last sent
+};
+
+struct trace_stream {
+    trace_stream_write_fn_t write;
+    void *arg;
+
+    struct stream_ring *rings;
+    size_t num_rings, max_rings;
+
+    struct stream_core *cores;
+    size_t num_cores, max_cores;
+
+    struct trace_event chunk[STREAM_CHUNK_EVENTS];
+
+    size_t len;                     ///< Bytes used in buf
+    uint8_t buf[STREAM_BUF_SIZE];
+};
+
+static void put_byte(struct trace_stream *st, uint8_t b)
+{
+    assert(st->len < STREAM_BUF_SIZE);
+    st->buf[st->len++] = b;
+}
+
+static void put_varint(struct trace_stream *st, uint64_t v)
+{
+    while (v >= 0x80) {
+        put_byte(st, (v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    put_byte(st, v);
+}
+
+static void put_svarint(struct trace_stream *st, int64_t v)
+{
+    put_varint(st, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void put_name(struct trace_stream *st, const char *name)
+{
+    for (int i = 0; i < 8; i++) {
+        put_byte(st, name[i]);
+    }
+}
+
+/// Hand the encoded bytes to the writer
+static errval_t flush(struct trace_stream *st)
+{
+    if (st->len == 0) {
+        return SYS_ERR_OK;
+    }
+    errval_t err = st->write(st->arg, st->buf, st->len);
+    st->len = 0;
+    return err;
+}
+
+/// Make sure that a record of up to bytes fits in the buffer
+static errval_t reserve(struct trace_stream *st, size_t bytes)
+{
+    if (st->len + bytes > STREAM_BUF_SIZE) {
+        return flush(st);
+    }
+    return SYS_ERR_OK;
+}
+
+/// Grow an array of the stream state if it is full
+static errval_t grow(void **array, size_t *max, size_t num, size_t elem)
+{
+    if (num < *max) {
+        return SYS_ERR_OK;
+    }
+    size_t newmax = *max == 0 ? 16 : *max * 2;
+    void *a = realloc(*array, newmax * elem);
+    if (a == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    *array = a;
+    *max = newmax;
+    return SYS_ERR_OK;
+}
+
+/// Send the per-core records that changed since the last drain
+static errval_t stream_core(struct trace_stream *st, struct stream_core *sc)
+{
+    struct trace_core *core = sc->core;
+    errval_t err;
+
+    if (core->t_offset != sc->t_offset) {
+        err = reserve(st, STREAM_RECORD_MAX);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        put_byte(st, STREAM_TAG_OFFSET);
+        put_varint(st, core->core_id);
+        put_svarint(st, core->t_offset);
+        sc->t_offset = core->t_offset;
+    }
+
+    uintptr_t num_applications = core->num_applications;
+    if (num_applications < sc->num_applications) {
+        // The core was reset
+        sc->num_applications = 0;
+    }
+    for (; sc->num_applications < num_applications; sc->num_applications++) {
+        struct trace_application *app =
+            &core->applications[sc->num_applications];
+        err = reserve(st, STREAM_RECORD_MAX);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        put_byte(st, STREAM_TAG_APP);
+        put_varint(st, core->core_id);
+        put_varint(st, app->dcb);
+        put_name(st, app->name);
+    }
+
+    return SYS_ERR_OK;
+}
+
+/// Drain the events of one ring
+static errval_t stream_ring(struct trace_stream *st, size_t id,
+                            size_t *retevents)
+{
+    struct stream_ring *sr = &st->rings[id];
+    struct trace_ring *ring = sr->ring;
+    errval_t err;
+
+    // Stop at the first event still being written, the next drain sends it
+    uintptr_t pos = trace_ring_first(ring, ring->head);
+    uintptr_t head = trace_ring_committed(ring, pos, ring->head);
+    while (pos != head) {
+        size_t n = MIN(head - pos, STREAM_CHUNK_EVENTS);
+        for (size_t i = 0; i < n; i++) {
+            st->chunk[i] = ring->events[(pos + i) & (ring->size - 1)];
+        }
+
+        // Skip events that were overwritten while we copied them
+        uintptr_t first = trace_ring_first(ring, ring->head);
+        size_t skip = MIN(first - pos, n);
+        pos += n;
+        ring->tail = pos;
+
+        if (skip == n) {
+            continue;
+        }
+
+        err = reserve(st, STREAM_RECORD_MAX + (n - skip) * STREAM_EVENT_MAX);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        put_byte(st, STREAM_TAG_EVENTS);
+        put_varint(st, id);
+        put_varint(st, n - skip);
+        for (size_t i = skip; i < n; i++) {
+            struct trace_event *ev = &st->chunk[i];
+            put_svarint(st, (int64_t)(ev->timestamp - sr->last_timestamp));
+            put_varint(st, ev->u.raw >> 32);
+            put_varint(st, ev->u.raw & 0xffffffff);
+            sr->last_timestamp = ev->timestamp;
+        }
+        *retevents += n - skip;
+    }
+
+    uintptr_t dropped = ring->dropped;
+    if (dropped < sr->dropped) {
+        // The ring was reset
+        sr->dropped = 0;
+    }
+    if (dropped != sr->dropped) {
+        err = reserve(st, STREAM_RECORD_MAX);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        put_byte(st, STREAM_TAG_DROPPED);
+        put_varint(st, id);
+        put_varint(st, dropped - sr->dropped);
+        sr->dropped = dropped;
+    }
+
+    return SYS_ERR_OK;
+}
+
+/// Find the stream state of a core, adding it if it is new
+static errval_t find_core(struct trace_stream *st, struct trace_core *core,
+                          struct stream_core **retsc)
+{
+    for (size_t i = 0; i < st->num_cores; i++) {
+        if (st->cores[i].core == core) {
+            *retsc = &st->cores[i];
+            return SYS_ERR_OK;
+        }
+    }
+
+    errval_t err = grow((void **)&st->cores, &st->max_cores, st->num_cores,
+                        sizeof(*st->cores));
+    if (err_is_fail(err)) {
+        return err;
+    }
+    struct stream_core *sc = &st->cores[st->num_cores++];
+    sc->core = core;
+    sc->num_applications = 0;
+    sc->t_offset = 0;
+    *retsc = sc;
+    return SYS_ERR_OK;
+}
+
+/// Find the stream id of a ring, announcing it if it is new
+static errval_t find_ring(struct trace_stream *st, struct trace_core *core,
+                          struct trace_ring *ring, size_t *retid)
+{
+    for (size_t i = 0; i < st->num_rings; i++) {
+        if (st->rings[i].ring == ring) {
+            *retid = i;
+            return SYS_ERR_OK;
+        }
+    }
+
+    errval_t err = grow((void **)&st->rings, &st->max_rings, st->num_rings,
+                        sizeof(*st->rings));
+    if (err_is_fail(err)) {
+        return err;
+    }
+    err = reserve(st, STREAM_RECORD_MAX);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    size_t id = st->num_rings++;
+    st->rings[id].ring = ring;
+    st->rings[id].last_timestamp = 0;
+    st->rings[id].dropped = 0;
+
+    put_byte(st, STREAM_TAG_RING);
+    put_varint(st, id);
+    put_varint(st, core->core_id);
+    put_name(st, ring->name);
+
+    *retid = id;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Create a trace stream
+ *
+ * Writes the stream header. Events are only sent by trace_stream_drain.
+ *
+ * \param write   Called with each chunk of encoded stream
+ * \param arg     Argument for write
+ */
+errval_t trace_stream_create(trace_stream_write_fn_t write, void *arg,
+                             struct trace_stream **retstream)
+{
+    if (trace_buffer_master == 0) {
+        return TRACE_ERR_NO_BUFFER;
+    }
+
+    struct trace_stream *st = calloc(1, sizeof(*st));
+    if (st == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    st->write = write;
+    st->arg = arg;
+
+    for (size_t i = 0; i < sizeof(STREAM_MAGIC) - 1; i++) {
+        put_byte(st, STREAM_MAGIC[i]);
+    }
+
+    cycles_t tsc_per_ms = 0;
+    errval_t err = sys_debug_get_tsc_per_ms(&tsc_per_ms);
+    if (err_is_ok(err)) {
+        put_byte(st, STREAM_TAG_CLOCK);
+        put_varint(st, tsc_per_ms);
+    }
+
+    *retstream = st;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Send all events recorded since the last drain, and consume them
+ *
+ * Tracing keeps running. Cores and rings that were set up since the last
+ * drain are picked up.
+ *
+ * \param retevents  Returns the number of events sent, may be NULL
+ */
+errval_t trace_stream_drain(struct trace_stream *st, size_t *retevents)
+{
+    struct trace_buffer *master = (struct trace_buffer *)trace_buffer_master;
+    size_t events = 0;
+    errval_t err;
+
+    for (struct trace_core *core = trace_offset_to_ptr(master, master->cores);
+         core != NULL; core = trace_offset_to_ptr(master, core->next)) {
+
+        struct stream_core *sc;
+        err = find_core(st, core, &sc);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        err = stream_core(st, sc);
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        for (struct trace_ring *ring = trace_next_ring(master, core, NULL);
+             ring != NULL; ring = trace_next_ring(master, core, ring)) {
+            size_t id;
+            err = find_ring(st, core, ring, &id);
+            if (err_is_fail(err)) {
+                return err;
+            }
+            err = stream_ring(st, id, &events);
+            if (err_is_fail(err)) {
+                return err;
+            }
+        }
+    }
+
+    if (retevents != NULL) {
+        *retevents = events;
+    }
+
+    return flush(st);
+}
+
+/**
+ * \brief Free a trace stream
+ *
+ * Does not drain the stream.
+ */
+void trace_stream_destroy(struct trace_stream *st)
+{
+    free(st->rings);
+    free(st->cores);
+    free(st);
+}
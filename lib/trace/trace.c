@@ -21,7 +21,6 @@
 #include <spawndomain/spawndomain.h>
 
 STATIC_ASSERT_SIZEOF(struct trace_event, 16);
-STATIC_ASSERT((sizeof(struct trace_buffer) <= TRACE_PERCORE_BUF_SIZE), "size mismatch");
 
 /**
  * \brief Initialize per-core tracing buffer
@@ -30,18 +29,28 @@ STATIC_ASSERT((sizeof(struct trace_buffer) <= TRACE_PERCORE_BUF_SIZE), "size mis
  * It is called from init at startup.
  *
  * Note that it does *not* map the buffer into its own vspace.
+ *
+ * \param bytes  Size of the buffer shared by all cores, 0 for
+ *               TRACE_ALLOC_SIZE. Every core needs a ring for its kernel and
+ *               one for each of its dispatchers.
  */
-errval_t trace_init(void)
+errval_t trace_init(size_t bytes)
 {
     errval_t err;
-    size_t bytes;
+
+    if (bytes == 0) {
+        bytes = TRACE_ALLOC_SIZE;
+    }
+    if (bytes < sizeof(struct trace_buffer)) {
+        return TRACE_ERR_CREATE_CAP;
+    }
 
     struct capref cap = {
         .cnode = cnode_task,
         .slot = TASKCN_SLOT_TRACEBUF
     };
 
-    err = frame_create(cap, TRACE_ALLOC_SIZE, &bytes);
+    err = frame_create(cap, bytes, &bytes);
     if (err_is_fail(err)) {
         return err_push(err, TRACE_ERR_CREATE_CAP);
     }
@@ -56,7 +65,8 @@ errval_t trace_disable_domain(void)
 {
     dispatcher_handle_t handle = curdispatcher();
     struct dispatcher_generic *disp = get_dispatcher_generic(handle);
-    disp->trace_buf = NULL;
+    disp->trace_disabled = true;
+    trace_disp_release();
     return SYS_ERR_OK;
 }
 
@@ -66,9 +76,10 @@ errval_t trace_disable_domain(void)
  */
 void trace_init_disp(void)
 { 
-    dispatcher_handle_t handle = curdispatcher();
-    struct dispatcher_generic *disp = get_dispatcher_generic(handle);
-    disp->trace_buf = (struct trace_buffer*)trace_buffer_va;    
+    errval_t err = trace_disp_setup();
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "trace_disp_setup");
+    }
 }
 
 /**
@@ -105,14 +116,44 @@ errval_t trace_setup_child(struct cnoderef taskcn,
 /**
  * \brief Set up the trace buffer on the current core and notify the kernel.
  *
- * Clear the buffer. Return the cap for the buffer.
- * Should be called once on each core.
+ * Map the buffer if needed. Configure the rings of this core, allocate the
+ * kernel's ring and one for the calling dispatcher, which therefore need
+ * not call trace_my_setup first. Clear the buffer, and return the cap for it.
+ * Should be called once on each core, by its monitor.
+ *
+ * \param ring_events  Number of events in rings created from now on,
+ *                     rounded up to a power of two
+ * \param overflow     What to do with new events when a ring is full
  */
-errval_t trace_setup_on_core(struct capref *retcap)
+errval_t trace_setup_on_core(struct capref *retcap, size_t ring_events,
+                             enum trace_overflow overflow)
 {
 #ifdef __i386__
     return TRACE_ERR_NO_BUFFER;
 #endif
+    errval_t err;
+
+    err = trace_map_buffer();
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct trace_core *core;
+    err = trace_core_setup(disp_get_core_id(), &core);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = trace_core_configure(core, ring_events, overflow);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    // The caller's ring gets the size just configured
+    err = trace_disp_setup();
+    if (err_is_fail(err)) {
+        return err;
+    }
 
     // Clear the buffer
     trace_reset_buffer();
@@ -73,6 +73,10 @@ msg_enum_name ifn = ifscope ifn "msg_enum"
 msg_enum_elem_name :: String -> String -> String
 msg_enum_elem_name ifn mn = idscope ifn mn "msgnum"
 
+-- Name of the function mapping message numbers to names
+msg_name_fn_name :: String -> String
+msg_name_fn_name ifn = ifscope ifn "msg_name"
+
 -- Name of the type of a message function
 msg_sig_type :: String -> MessageDef -> Direction -> String
 msg_sig_type ifn m@(RPC _ _ _) TX = idscope ifn (msg_name m) "rpc_tx_method_fn"
@@ -302,14 +306,21 @@ binding_struct_init drv ifn binding_var waitset_ex tx_vtbl_ex = [
                  "tx_str_pos", "rx_str_pos", "tx_str_len", "rx_str_len"]],
     C.Ex $ C.Assignment (C.FieldOf binding_var "incoming_token") (C.NumConstant 0),
     C.Ex $ C.Assignment (C.FieldOf binding_var "outgoing_token") (C.NumConstant 0),
-    C.Ex $ C.Assignment (C.FieldOf binding_var "local_binding") (C.Variable "NULL") ]
+    C.Ex $ C.Assignment (C.FieldOf binding_var "local_binding") (C.Variable "NULL"),
+    C.Ex $ C.Assignment (C.FieldOf binding_var "rpc_pipeline") (C.Variable "NULL"),
+    C.Ex $ C.Call "FL_STATS_INIT" [C.AddressOf binding_var,
+                                   C.StringConstant ifn, C.StringConstant drv,
+                                   C.Variable $ msg_name_fn_name ifn] ]
 
 binding_struct_destroy :: String -> C.Expr -> [C.Stmt]
 binding_struct_destroy ifn binding_var
     = [C.Ex $ C.Call "flounder_support_waitset_chanstate_destroy"
             [C.AddressOf $ C.FieldOf binding_var "register_chanstate"],
        C.Ex $ C.Call "flounder_support_waitset_chanstate_destroy"
-            [C.AddressOf $ C.FieldOf binding_var "tx_cont_chanstate"]]
+            [C.AddressOf $ C.FieldOf binding_var "tx_cont_chanstate"],
+       C.Ex $ C.Call "flounder_rpc_pipeline_destroy"
+            [C.FieldOf binding_var "rpc_pipeline"],
+       C.Ex $ C.Call "FL_STATS_DESTROY" [C.AddressOf binding_var]]
 
 --
 -- Generate a generic can_send function
@@ -409,15 +420,17 @@ block_sending cont_ex = [
         mask = C.CallInd (C.DerefField bindvar "get_receiving_chanstate") [bindvar]
         tx_cont_chanstate = C.AddressOf $ bindvar `C.DerefField` "tx_cont_chanstate"
 
--- starting a send: just a debug hook
+-- starting a send: debug and statistics hooks
 start_send :: String -> String -> String -> [MessageArgument] -> [C.Stmt]
 start_send drvn ifn mn msgargs
     = [C.Ex $ C.Call "FL_DEBUG" [C.StringConstant $
-                                 drvn ++ " TX " ++ ifn ++ "." ++ mn ++ "\n"]]
+                                 drvn ++ " TX " ++ ifn ++ "." ++ mn ++ "\n"],
+       C.Ex $ C.Call "FL_STATS_TX_START" [bindvar]]
 
 -- finished a send: clear msgnum, trigger pending waitsets/events
 finished_send :: [C.Stmt]
 finished_send = [
+    C.Ex $ C.Call "FL_STATS_TX_DONE" [bindvar, tx_msgnum_field],
     C.Ex $ C.Assignment tx_msgnum_field (C.NumConstant 0)] ++
     [C.Ex $ C.Call "flounder_support_trigger_chan" [wsaddr ws]
     | ws <- ["tx_cont_chanstate", "register_chanstate"]]
@@ -428,7 +441,7 @@ finished_send = [
 -- start receiving: allocate space for any static arrays in message
 start_recv :: String -> String -> [TypeDef] -> String -> [MessageArgument] -> [C.Stmt]
 start_recv drvn ifn typedefs mn msgargs
-  = concat [
+  = [C.Ex $ C.Call "FL_STATS_RX_START" [bindvar]] ++ concat [
     [C.Ex $ C.Assignment (field fn)
           $ C.Call "malloc" [C.SizeOfT $ type_c_type ifn tr],
      C.Ex $ C.Call "assert" [C.Binary C.NotEquals (field fn) (C.Variable "NULL")]
@@ -441,6 +454,8 @@ start_recv drvn ifn typedefs mn msgargs
         _ -> False
 
 -- finished recv: debug, run handler and clean up
+-- The receive statistics are recorded once the handler returns, so that
+-- their latency includes handling the message.
 finished_recv :: String -> String -> [TypeDef] ->  MessageType -> String -> [MessageArgument] -> [C.Stmt]
 finished_recv drvn ifn typedefs mtype mn msgargs
     = [ C.Ex $ C.Call "FL_DEBUG" [C.StringConstant $
@@ -451,7 +466,8 @@ finished_recv drvn ifn typedefs mtype mn msgargs
             [C.Ex $ C.Assignment (C.FieldOf message_chanstate "token") binding_incoming_token,
              C.Ex $ C.Call "flounder_support_trigger_chan" [C.AddressOf message_chanstate],
              C.Ex $ C.Assignment (C.Variable "no_register") (C.NumConstant 1)],
-             C.Ex $ C.Assignment rx_msgnum_field (C.NumConstant 0)]
+        C.Ex $ C.Call "FL_STATS_RX_DONE" [bindvar, C.Variable $ msg_enum_elem_name ifn mn],
+        C.Ex $ C.Assignment rx_msgnum_field (C.NumConstant 0)]
     where
         rx_msgnum_field = C.DerefField bindvar "rx_msgnum"
         handler = C.DerefField bindvar "rx_vtbl" `C.FieldOf` mn
@@ -469,10 +485,12 @@ finished_recv_nocall drvn ifn typedefs mtype mn msgargs
     = [ C.Ex $ C.Call "FL_DEBUG" [C.StringConstant $
                                  drvn ++ " RX " ++ ifn ++ "." ++ mn ++ "\n"],
         C.If (C.Binary C.NotEquals handler (C.Variable "NULL"))
+            -- statistics recorded by call_handler
             [C.Ex $ C.Assignment (C.Variable "call_msgnum") (C.Variable $ msg_enum_elem_name ifn mn)]
             [C.Ex $ C.Assignment (C.FieldOf message_chanstate "token") binding_incoming_token,
              C.Ex $ C.Call "flounder_support_trigger_chan" [C.AddressOf message_chanstate],
-             C.Ex $ C.Assignment (C.Variable "no_register") (C.NumConstant 1)],
+             C.Ex $ C.Assignment (C.Variable "no_register") (C.NumConstant 1),
+             C.Ex $ C.Call "FL_STATS_RX_DONE" [bindvar, C.Variable $ msg_enum_elem_name ifn mn]],
         C.Ex $ C.Assignment rx_msgnum_field (C.NumConstant 0)]
     where
         rx_msgnum_field = C.DerefField bindvar "rx_msgnum"
@@ -483,7 +501,8 @@ finished_recv_nocall drvn ifn typedefs mtype mn msgargs
 -- call callback, directly from a receiving handler
 call_handler :: String -> String -> [TypeDef] ->  MessageType -> String -> [MessageArgument] -> [C.Stmt]
 call_handler drvn ifn typedefs mtype mn msgargs
-    =   [C.Ex $ C.CallInd handler (bindvar:args)]
+    =   [C.Ex $ C.CallInd handler (bindvar:args),
+         C.Ex $ C.Call "FL_STATS_RX_DONE" [bindvar, C.Variable $ msg_enum_elem_name ifn mn]]
     where
         handler = C.DerefField bindvar "rx_vtbl" `C.FieldOf` mn
         args = concat [mkargs tr a | Arg tr a <- msgargs]
@@ -17,7 +17,7 @@ import Data.Char
 
 import qualified CAbsSyntax as C
 import Syntax
-import GHBackend (flounder_backends, export_fn_name, bind_fn_name, accept_fn_name, connect_fn_name, connect_handlers_fn_name, disconnect_handlers_fn_name, rpc_tx_vtbl_type, rpc_init_fn_name, ep_create_fn_name, ep_bind_fn_name, ep_create_function_params, ep_bind_function_params)
+import GHBackend (flounder_backends, export_fn_name, bind_fn_name, accept_fn_name, connect_fn_name, connect_handlers_fn_name, disconnect_handlers_fn_name, rpc_tx_vtbl_type, rpc_init_fn_name, rpc_pipeline_init_fn_name, rpc_pipeline_init_fn_params, rpc_async_fn_name, rpc_async_fn_params, rpc_async_done_type, rpc_reply_fn_name, rpc_reply_fn_params, ep_create_fn_name, ep_bind_fn_name, ep_create_function_params, ep_bind_function_params)
 import qualified Backend
 import BackendCommon
 import LMP (lmp_bind_type, lmp_bind_fn_name)
@@ -49,6 +49,9 @@ local_rpc_vtbl_name ifn = ifscope ifn "local_rpc_vtbl"
 rpc_error_fn_name :: String -> String
 rpc_error_fn_name ifn = ifscope ifn "rpc_client_error"
 
+-- Name of the response handler of pipelined RPC calls
+rpc_async_rx_fn_name ifn mn = idscope ifn mn "rpc_async_rx"
+
 compile :: String -> String -> Interface -> String
 compile infile outfile interface =
     unlines $ C.pp_unit $ stub_body infile interface
@@ -124,6 +127,16 @@ stub_body_message_handlers infile (Interface ifn descr decls) = C.UnitList [
 
     C.MultiComment [ "RPC init function" ],
     rpc_init_fn ifn rpcs,
+    C.Blank,
+
+    C.MultiComment [ "Pipelined RPC calls" ],
+    C.UnitList [ rpc_async_rx_fn ifn m | m <- rpcs ],
+    C.UnitList [ rpc_async_fn ifn m | m <- rpcs ],
+    rpc_pipeline_init_fn ifn rpcs,
+    C.Blank,
+
+    C.MultiComment [ "Responses sent after the call handler returned" ],
+    C.UnitList [ rpc_reply_fn ifn m | m <- rpcs ],
 
     C.Blank]
 
@@ -694,6 +707,109 @@ rpc_init_fn ifn ml = C.FunctionDef C.NoScope (C.Void)
     where
         rpc_init_fn_params n = [C.Param (C.Ptr $ C.Struct (intf_bind_type n)) "_binding"]
 
+-- response handler of pipelined calls: find the call and run its handler
+rpc_async_rx_fn :: String -> MessageDef -> C.Unit
+rpc_async_rx_fn ifn (RPC n args _) =
+    C.FunctionDef C.Static C.Void (rpc_async_rx_fn_name ifn n) params [
+        localvar (C.Ptr C.Void) "_done" Nothing,
+        localvar (C.Ptr C.Void) "_st" Nothing,
+        localvar (C.TypeName "errval_t") errvar_name Nothing,
+        C.SBlank,
+        C.Ex $ C.Assignment errvar $ C.Call "flounder_rpc_pipeline_complete"
+            [pipeline, C.Variable $ msg_enum_elem_name ifn (rpc_resp_name n),
+             bindvar `C.DerefField` "incoming_token",
+             C.AddressOf $ C.Variable "_done", C.AddressOf $ C.Variable "_st"],
+        C.If (C.Call "err_is_fail" [errvar])
+            [report_user_err errvar, C.ReturnVoid] [],
+        C.Ex $ C.CallInd done_fn ([bindvar, C.Variable "_st"]
+                                  ++ map C.Variable (concat $ map arg_names outargs))
+    ]
+    where
+        params = [binding_param ifn] ++ concat [msg_argdecl RX ifn a | a <- outargs]
+        (_, outargs) = partition_rpc_args args
+        pipeline = bindvar `C.DerefField` "rpc_pipeline"
+        done_fn = C.Cast (C.Ptr $ C.TypeName $ rpc_async_done_type ifn n) (C.Variable "_done")
+        errvar_name = "_err"
+        errvar = C.Variable errvar_name
+
+-- send a pipelined call; returns once the call is handed to the channel
+rpc_async_fn :: String -> MessageDef -> C.Unit
+rpc_async_fn ifn m@(RPC n args _) =
+    C.FunctionDef C.NoScope (C.TypeName "errval_t") (rpc_async_fn_name ifn n)
+        (rpc_async_fn_params ifn m) [
+        localvar (C.TypeName "errval_t") errvar_name Nothing,
+        localvar (C.TypeName "uint32_t") "_token" Nothing,
+        C.SBlank,
+        C.Ex $ C.Call "assert" [C.Binary C.NotEquals pipeline (C.Variable "NULL")],
+        C.SComment "record the call first, its response may arrive while sending",
+        C.Ex $ C.Assignment errvar $ C.Call "flounder_rpc_pipeline_push"
+            [pipeline, C.Variable $ msg_enum_elem_name ifn (rpc_resp_name n),
+             C.Cast (C.Ptr C.Void) (C.Variable "_done"), C.Variable "_st",
+             C.AddressOf tokenvar],
+        C.If (C.Call "err_is_fail" [errvar]) [C.Return errvar] [],
+        C.SBlank,
+        C.SComment "send the call with its own token",
+        C.Ex $ C.Call "thread_set_outgoing_token" [tokenvar],
+        C.Ex $ C.Assignment errvar $ C.CallInd tx_func tx_func_args,
+        C.SComment "clear the token if the send failed before taking it",
+        C.Ex $ C.Call "thread_get_outgoing_token" [C.AddressOf tokenvar],
+        C.If (C.Call "err_is_fail" [errvar])
+            [C.Ex $ C.Call "flounder_rpc_pipeline_cancel" [pipeline, tokenvar]] [],
+        C.Return errvar
+    ]
+    where
+        (txargs, _) = partition_rpc_args args
+        pipeline = bindvar `C.DerefField` "rpc_pipeline"
+        tokenvar = C.Variable "_token"
+        tx_func = C.DerefField bindvar "tx_vtbl" `C.FieldOf` (rpc_call_name n)
+        tx_func_args = [bindvar, C.Variable "BLOCKING_CONT"]
+                       ++ map C.Variable (concat $ map arg_names txargs)
+        errvar_name = "_err"
+        errvar = C.Variable errvar_name
+
+rpc_pipeline_init_fn :: String -> [MessageDef] -> C.Unit
+rpc_pipeline_init_fn ifn ml = C.FunctionDef C.NoScope (C.TypeName "errval_t")
+                            (rpc_pipeline_init_fn_name ifn) (rpc_pipeline_init_fn_params ifn) [
+     localvar (C.TypeName "errval_t") "err" Nothing,
+     C.SBlank,
+     C.Ex $ C.Call "assert" [C.Binary C.Equals pipeline (C.Variable "NULL")],
+     C.Ex $ C.Assignment errvar $ C.Call "flounder_rpc_pipeline_create"
+                [C.Variable "depth", C.AddressOf pipeline],
+     C.If (C.Call "err_is_fail" [errvar]) [C.Return errvar] [],
+     C.SBlank,
+     C.SComment "Complete pipelined calls from the response handlers, replacing the user's",
+     C.StmtList [C.Ex $ C.Assignment (C.FieldOf (C.DerefField bindvar "rx_vtbl")
+                                        (rpc_resp_name mn))
+         (C.Variable $ rpc_async_rx_fn_name ifn mn) | RPC mn _ _ <- ml],
+     C.SBlank,
+     C.Return $ C.Variable "SYS_ERR_OK"]
+    where
+        pipeline = bindvar `C.DerefField` "rpc_pipeline"
+
+-- send a response after the call handler returned, with the token of the call
+rpc_reply_fn :: String -> MessageDef -> C.Unit
+rpc_reply_fn ifn m@(RPC n args _) =
+    C.FunctionDef C.NoScope (C.TypeName "errval_t") (rpc_reply_fn_name ifn n)
+        (rpc_reply_fn_params ifn m) [
+        localvar (C.TypeName "errval_t") errvar_name Nothing,
+        C.SBlank,
+        C.SComment "restore the token of the call, the binding holds that of the last message",
+        C.Ex $ C.Call "thread_set_outgoing_token"
+            [C.Binary C.BitwiseAnd tokenvar (C.Variable "~1")],
+        C.Ex $ C.Assignment errvar $ C.CallInd tx_func tx_func_args,
+        C.SComment "clear the token if the send failed before taking it",
+        C.Ex $ C.Call "thread_get_outgoing_token" [C.AddressOf tokenvar],
+        C.Return errvar
+    ]
+    where
+        (_, outargs) = partition_rpc_args args
+        tokenvar = C.Variable "_token"
+        tx_func = C.DerefField bindvar "tx_vtbl" `C.FieldOf` (rpc_resp_name n)
+        tx_func_args = [bindvar, C.Variable intf_cont_var]
+                       ++ map C.Variable (concat $ map arg_names outargs)
+        errvar_name = "_err"
+        errvar = C.Variable errvar_name
+
 ----------------------------------------------------------------------------
 -- everything that we need to know about a backend to attempt a generic bind
 ----------------------------------------------------------------------------
@@ -782,8 +898,8 @@ ump_bind_backend ifn cont =
         C.Ex $ C.Assignment errvar $
             C.Call (UMP.bind_fn_name ifn) [binding, bind_iref, cont, C.Variable "b", waitset,
                                            flags,
-                                           C.Variable "DEFAULT_UMP_BUFLEN",
-                                           C.Variable "DEFAULT_UMP_BUFLEN"]
+                                           C.Call "ump_chan_buflen" [flags],
+                                           C.Call "ump_chan_buflen" [flags]]
     ],
     test_cb_success = C.Call "err_is_ok" [errvar],
     test_cb_try_next = C.Variable "true",
@@ -800,8 +916,8 @@ ump_ipi_bind_backend ifn cont =
         C.Ex $ C.Assignment errvar $
             C.Call (UMP_IPI.bind_fn_name ifn) [binding, bind_iref, cont, C.Variable "b", waitset,
                                            flags,
-                                           C.Variable "DEFAULT_UMP_BUFLEN",
-                                           C.Variable "DEFAULT_UMP_BUFLEN"]
+                                           C.Call "ump_chan_buflen" [flags],
+                                           C.Call "ump_chan_buflen" [flags]]
     ],
     test_cb_success = C.Call "err_is_ok" [errvar],
     test_cb_try_next = C.Variable "true",
@@ -37,6 +37,18 @@ disconnect_handlers_fn_name n = ifscope n "disconnect_handlers"
 rpc_init_fn_name :: String -> String
 rpc_init_fn_name ifn = ifscope ifn "rpc_client_init"
 
+-- Name of the function setting up pipelined RPC calls
+rpc_pipeline_init_fn_name :: String -> String
+rpc_pipeline_init_fn_name ifn = ifscope ifn "rpc_pipeline_init"
+
+-- Name of the pipelined RPC call function and its completion handler type
+rpc_async_fn_name ifn mn = idscope ifn mn "rpc_async"
+rpc_async_done_type ifn mn = idscope ifn mn "rpc_async_done_fn"
+
+-- Names of the functions for responding to a call after its handler returned
+rpc_call_token_fn_name ifn = ifscope ifn "rpc_call_token"
+rpc_reply_fn_name ifn mn = idscope ifn mn "reply"
+
 rpc_rx_vtbl_type ifn = ifscope ifn "rpc_rx_vtbl"
 rpc_tx_vtbl_type ifn = ifscope ifn "rpc_tx_vtbl"
 local_rpc_tx_vtbl_type ifn = ifscope ifn "local_rpc_tx_vtbl"
@@ -96,6 +108,10 @@ intf_header_body infile interface@(Interface name descr decls) =
         msg_enums name messages,
         C.Blank,
 
+        C.MultiComment [ "Names of the message numbers" ],
+        msg_name_fn name messages,
+        C.Blank,
+
         C.MultiComment [ "Message type signatures (transmit)" ],
         C.UnitList [ msg_signature TX name m | m <- messages ],
         C.Blank,
@@ -114,6 +130,10 @@ intf_header_body infile interface@(Interface name descr decls) =
                     | m <- rpcs ],
         C.Blank,
 
+        C.MultiComment [ "Completion handler types of pipelined RPC calls" ],
+        C.UnitList [ rpc_async_done_typedef name m | m <- rpcs ],
+        C.Blank,
+
         C.MultiComment [ "Struct type for holding the RX args for each msg" ],
         C.UnitList [ msg_argstruct RX name types m | m <- messages ],
         C.Blank,
@@ -202,6 +222,16 @@ intf_header_body infile interface@(Interface name descr decls) =
         C.MultiComment [ "Function to initialise an RPC client" ],
         rpc_init_fn_proto name,
 
+        C.MultiComment [ "Functions for pipelined RPC calls",
+                         "rpc_pipeline_init replaces the rx_vtbl handlers of all RPC responses" ],
+        rpc_pipeline_init_fn_proto name,
+        C.UnitList [ rpc_async_fn_proto name m | m <- rpcs ],
+        C.Blank,
+
+        C.MultiComment [ "Functions for responding to a call after its handler returned" ],
+        rpc_call_token_fn name,
+        C.UnitList [ rpc_reply_fn_proto name m | m <- rpcs ],
+
         C.MultiComment [ "And we're done" ]
       ]
 
@@ -217,6 +247,19 @@ msg_enums ifname msgs
          [C.EnumItem (msg_enum_elem_name ifname (msg_name m)) (Just $ C.NumConstant i)
             | (m, i) <- zip msgs [3..]])
 
+--
+-- Generate a function mapping message numbers to names, used by the
+-- message statistics
+--
+msg_name_fn :: String -> [MessageDef] -> C.Unit
+msg_name_fn ifname msgs
+    = C.StaticInline (C.Ptr $ C.ConstT $ C.TypeName "char") (msg_name_fn_name ifname)
+        [C.Param (C.TypeName "int") "msgnum"]
+        [C.Switch (C.Variable "msgnum")
+            [C.Case (C.Variable $ msg_enum_elem_name ifname mn) [C.Return $ C.StringConstant mn]
+             | mn <- ["__bind", "__bind_reply"] ++ map msg_name msgs]
+            [C.Return $ C.StringConstant "(invalid)"]]
+
 --
 -- Generate type definitions for each message signature
 --
@@ -416,7 +459,15 @@ binding_struct n ml = C.StructDecl (intf_bind_type n) fields
         C.Param (C.Struct "thread_mutex") "rxtx_mutex",
         C.Param (C.Struct "thread_mutex") "send_mutex",
         C.Param (C.TypeName "errval_t") "error",
-        C.Param (C.Ptr $ C.Struct $ intf_bind_type n) "local_binding"
+        C.Param (C.Ptr $ C.Struct $ intf_bind_type n) "local_binding",
+        C.ParamBlank,
+
+        C.ParamComment "Pipelined RPC calls in flight, NULL unless set up by rpc_pipeline_init",
+        C.Param (C.Ptr $ C.Struct "flounder_rpc_pipeline") "rpc_pipeline",
+        C.ParamBlank,
+
+        C.ParamComment "Message statistics, NULL unless built with flounder_stats",
+        C.Param (C.Ptr $ C.Struct "flounder_binding_stats") "stats"
         ]
 
 --
@@ -630,6 +681,69 @@ rpc_init_fn_proto n =
         name = rpc_init_fn_name n
         rpc_init_fn_params n = [C.Param (C.Ptr $ C.Struct (intf_bind_type n)) "binding"]
 
+rpc_pipeline_init_fn_proto :: String -> C.Unit
+rpc_pipeline_init_fn_proto n =
+    C.GVarDecl C.Extern C.NonConst
+         (C.Function C.NoScope (C.TypeName "errval_t") (rpc_pipeline_init_fn_params n))
+         (rpc_pipeline_init_fn_name n) Nothing
+
+rpc_pipeline_init_fn_params :: String -> [C.Param]
+rpc_pipeline_init_fn_params n = [binding_param n,
+                                  C.Param (C.TypeName "size_t") "depth"]
+
+--
+-- Generate the completion handler type of a pipelined RPC call, which
+-- receives the output arguments like the handler of the response message
+--
+rpc_async_done_typedef :: String -> MessageDef -> C.Unit
+rpc_async_done_typedef ifn (RPC n args _) =
+    C.TypeDef (C.Function C.NoScope C.Void params) (rpc_async_done_type ifn n)
+    where
+        params = [binding_param ifn, C.Param (C.Ptr C.Void) "_st"]
+                 ++ concat [msg_argdecl RX ifn a | a <- outargs]
+        (_, outargs) = partition_rpc_args args
+
+rpc_async_fn_proto :: String -> MessageDef -> C.Unit
+rpc_async_fn_proto ifn m@(RPC n _ _) =
+    C.GVarDecl C.Extern C.NonConst
+         (C.Function C.NoScope (C.TypeName "errval_t") (rpc_async_fn_params ifn m))
+         (rpc_async_fn_name ifn n) Nothing
+
+rpc_async_fn_params :: String -> MessageDef -> [C.Param]
+rpc_async_fn_params ifn (RPC n args _) =
+    [binding_param ifn,
+     C.Param (C.Ptr $ C.TypeName $ rpc_async_done_type ifn n) "_done",
+     C.Param (C.Ptr C.Void) "_st"]
+    ++ concat [msg_argdecl TX ifn a | a <- inargs]
+    where
+        (inargs, _) = partition_rpc_args args
+
+--
+-- Generate the function returning the token of the call being handled. A
+-- server answering later saves it, and passes it to the reply function, so
+-- the response is matched to its call.
+--
+rpc_call_token_fn :: String -> C.Unit
+rpc_call_token_fn ifn =
+    C.StaticInline (C.TypeName "uint32_t") (rpc_call_token_fn_name ifn)
+        [binding_param ifn]
+        [C.Return $ bindvar `C.DerefField` "incoming_token"]
+
+rpc_reply_fn_proto :: String -> MessageDef -> C.Unit
+rpc_reply_fn_proto ifn m@(RPC n _ _) =
+    C.GVarDecl C.Extern C.NonConst
+         (C.Function C.NoScope (C.TypeName "errval_t") (rpc_reply_fn_params ifn m))
+         (rpc_reply_fn_name ifn n) Nothing
+
+rpc_reply_fn_params :: String -> MessageDef -> [C.Param]
+rpc_reply_fn_params ifn (RPC n args _) =
+    [binding_param ifn,
+     C.Param (C.TypeName "uint32_t") "_token",
+     C.Param (C.Struct "event_closure") intf_cont_var]
+    ++ concat [msg_argdecl TX ifn a | a <- outargs]
+    where
+        (_, outargs) = partition_rpc_args args
+
 --
 -- Generate send function inline wrappers for each message signature
 --
@@ -291,6 +291,7 @@ binding_struct p ifn = C.StructDecl (my_bind_type p ifn) fields
         C.Param (C.TypeName "iref_t") "iref",
         C.Param (C.TypeName "size_t") "inchanlen",
         C.Param (C.TypeName "size_t") "outchanlen",
+        C.Param (C.TypeName "size_t") "bulklen",
         C.ParamBlank,
         C.ParamComment "flag indicating that transfers of caps are not supported"
         ]
@@ -361,7 +362,7 @@ stub_body p infile intf@(Interface ifn descr decls) = C.UnitList [
       register_send_fn_def drvname ifn,
       default_error_handler_fn_def drvname ifn,
       change_waitset_fn_def p ifn,
-      generic_control_fn_def drvname ifn,
+      control_fn_def p ifn,
       receive_next_fn_def p ifn,
       get_receiving_chanstate_fn_def p ifn,
       C.Blank,
@@ -562,6 +563,7 @@ bind_fn p ifn =
         C.Ex $ C.Assignment (my_bindvar `C.DerefField` "iref") (C.Variable "iref"),
         C.Ex $ C.Assignment (my_bindvar `C.DerefField` "inchanlen") (C.Variable "inchanlen"),
         C.Ex $ C.Assignment (my_bindvar `C.DerefField` "outchanlen") (C.Variable "outchanlen"),
+        C.Ex $ C.Assignment (my_bindvar `C.DerefField` "bulklen") (C.Call "ump_chan_bulklen" [C.Variable "flags"]),
         C.Ex $ C.Assignment (C.FieldOf (common_field "tx_cont_chanstate") "trigger") (C.AddressOf $ C.FieldOf chanvar "send_waitset"),
         C.StmtList $ (ump_binding_extra_fields_init p),
         C.SBlank,
@@ -591,6 +593,7 @@ bind_fn p ifn =
                      C.AddressOf $ intf_bind_var `C.FieldOf` "event_qnode",
                      C.Variable "iref", C.Call "get_monitor_binding" [],
                      C.Variable "inchanlen", C.Variable "outchanlen",
+                     my_bindvar `C.DerefField` "bulklen",
                      C.Variable "NULL_CAP"]]),
         C.SBlank,
         C.If (C.Call "err_is_fail" [errvar])
@@ -903,6 +906,7 @@ new_monitor_cont_fn p ifn =
                  C.Variable "monitor_binding",
                  my_bindvar `C.DerefField` "inchanlen",
                  my_bindvar `C.DerefField` "outchanlen",
+                 my_bindvar `C.DerefField` "bulklen",
                  C.Variable "NULL_CAP"]],
         C.SBlank,
 
@@ -1026,6 +1030,30 @@ connect_handler_fn p ifn = C.FunctionDef C.NoScope (C.TypeName "errval_t")
         common_field f = my_bindvar `C.DerefField` "b" `C.FieldOf` f
         receiving_chanstate = my_bindvar `C.DerefField` "b" `C.FieldOf` "receiving_chanstate"
 
+-- switch the receive endpoint between pure and adaptive polling
+control_fn_def :: UMPParams -> String -> C.Unit
+control_fn_def p ifn =
+    C.FunctionDef C.Static (C.TypeName "errval_t") (generic_control_fn_name (ump_drv p) ifn) params [
+        localvar (C.Ptr $ C.Struct $ my_bind_type p ifn)
+            my_bind_var_name (Just $ C.Cast (C.Ptr C.Void) bindvar),
+        C.SBlank,
+
+        C.Switch (C.Variable "control") [
+            C.Case (C.Variable "IDC_CONTROL_SET_ADAPTIVE") [
+                C.Ex $ C.Call "ump_chan_set_adaptive"
+                    [chanaddr, C.Variable "UMP_DEFAULT_SPIN_BUDGET"],
+                C.Break],
+            C.Case (C.Variable "IDC_CONTROL_CLEAR_ADAPTIVE") [
+                C.Ex $ C.Call "ump_chan_set_adaptive" [chanaddr, C.NumConstant 0],
+                C.Break]
+            ] [C.SComment "other control flags are not supported", C.Break],
+        C.Return $ C.Variable "SYS_ERR_OK"
+    ]
+    where
+        params = [C.Param (C.Ptr $ C.Struct $ intf_bind_type ifn) intf_bind_var,
+                  C.Param (C.TypeName "idc_control_t") "control"]
+        chanaddr = C.AddressOf $ my_bindvar `C.DerefField` "ump_state" `C.FieldOf` "chan"
+
 change_waitset_fn_def :: UMPParams -> String -> C.Unit
 change_waitset_fn_def p ifn =
     C.FunctionDef C.Static (C.TypeName "errval_t") (change_waitset_fn_name p ifn) params [
@@ -1355,7 +1383,7 @@ tx_handler_case :: UMPParams -> String -> String -> MsgFragment -> [C.Stmt]
 tx_handler_case p ifn mn (MsgFragment words) = [
     C.SComment "send the next fragment",
     C.Ex $ C.Assignment ump_token binding_outgoing_token,
-    C.Ex $ C.Assignment msgvar $ C.Call "ump_chan_get_next" [chanaddr, ctrladdr],
+    C.Ex $ C.Assignment msgvar $ C.Call "flounder_stub_ump_get_next" [stateaddr, ctrladdr],
     C.SComment "check if we can send another message",
     C.If (C.Unary C.Not msgvar)
       [C.Ex $ C.Assignment (C.Variable "tx_notify") (C.Variable "true"),
@@ -1729,7 +1757,7 @@ rx_handler p ifn typedefs msgdefs msgs =
                 ],
             C.Break]
             where
-                args = [msg_arg, string_arg, pos_arg, len_arg, max_size]
+                args = [chanst, msg_arg, string_arg, pos_arg, len_arg, max_size]
                 msg_arg = C.Variable "msg"
                 string_arg = argfield_expr RX mn af
                 pos_arg = C.AddressOf $ C.DerefField bindvar "rx_str_pos"
@@ -1755,7 +1783,7 @@ rx_handler p ifn typedefs msgdefs msgs =
                 ],
             C.Break]
             where
-                args = [msg_arg, buf_arg, len_arg, pos_arg, max_size]
+                args = [chanst, msg_arg, buf_arg, len_arg, pos_arg, max_size]
                 msg_arg = C.Variable "msg"
                 buf_arg = C.Cast (C.Ptr C.Void) $ argfield_expr RX mn afn
                 len_arg = C.AddressOf $ argfield_expr RX mn afl
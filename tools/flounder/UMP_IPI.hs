@@ -70,29 +70,48 @@ ump_ipi_connect_extra_fields_init =
       exportvar = C.Variable "e"
 
 -- generate the code to register for receive notification
+-- an adaptive channel with a notify cap polls the UMP channel, and arms the
+-- IPI notify endpoint only when it parks; see ump_endpoint_set_adaptive()
 ump_ipi_register_recv :: String -> [C.Stmt]
 ump_ipi_register_recv ifn =
     [ C.If (C.Call "capref_is_null" [notifyvar `C.FieldOf` "my_notify_cap"])
       [ C.Ex $ C.Assignment errvar $ C.Call "ump_chan_register_recv"
-        [C.AddressOf $ my_bindvar `C.DerefField` "ump_state" `C.FieldOf` "chan",
-         bindvar `C.DerefField` "waitset", C.StructConstant "event_closure"
-         [("handler", C.Variable $ rx_handler_name uparams ifn), ("arg", bindvar)]]
+        [chanaddr, bindvar `C.DerefField` "waitset", rx_closure]
       ]
-      [ C.Ex $ C.Assignment errvar $ C.Call "ipi_notify_register"
-        [notifyaddr, bindvar `C.DerefField` "waitset",
-         C.StructConstant "event_closure"
-         [("handler", C.Variable $ rx_handler_name uparams ifn), ("arg", bindvar)]]
+      [ C.If (C.Binary C.NotEquals
+                (chanvar `C.FieldOf` "endpoint" `C.FieldOf` "spin_budget")
+                (C.NumConstant 0))
+        [ C.Ex $ C.Call "ump_chan_set_notify"
+            [chanaddr, notifyvar `C.FieldOf` "iep"],
+          C.Ex $ C.Assignment errvar $ C.Call "ump_chan_register_recv"
+            [chanaddr, bindvar `C.DerefField` "waitset", rx_closure]
+        ]
+        [ C.Ex $ C.Assignment errvar $ C.Call "ipi_notify_register"
+            [notifyaddr, bindvar `C.DerefField` "waitset", rx_closure]
+        ]
       ]
     ]
+    where
+      rx_closure = C.StructConstant "event_closure"
+        [("handler", C.Variable $ rx_handler_name uparams ifn), ("arg", bindvar)]
 
+-- deregister whichever of the two is registered, the channel may have been
+-- switched to or from adaptive mode since it registered
 ump_ipi_deregister_recv :: String -> [C.Stmt]
 ump_ipi_deregister_recv ifn =
-    [ C.If (C.Call "capref_is_null" [notifyvar `C.FieldOf` "my_notify_cap"])
-      [C.Ex $ C.Assignment errvar $ C.Call "ump_chan_deregister_recv"
-       [C.AddressOf $ my_bindvar `C.DerefField` "ump_state" `C.FieldOf` "chan"]]
+    [ C.If (C.Binary C.Or
+              (C.Call "capref_is_null" [notifyvar `C.FieldOf` "my_notify_cap"])
+              (C.Binary C.NotEquals
+                 (chanvar `C.FieldOf` "endpoint" `C.FieldOf` "waitset_state"
+                    `C.FieldOf` "waitset")
+                 (C.Variable "NULL")))
+      [C.Ex $ C.Assignment errvar $ C.Call "ump_chan_deregister_recv" [chanaddr]]
       [C.Ex $ C.Assignment errvar $ C.Call "ipi_notify_deregister" [notifyaddr]]
     ]
 
+chanvar = my_bindvar `C.DerefField` "ump_state" `C.FieldOf` "chan"
+chanaddr = C.AddressOf chanvar
+
 alloc_notify :: String -> [C.Stmt]
 alloc_notify handler =
     [ C.If (my_bindvar `C.DerefField` "no_notify")
@@ -129,6 +148,7 @@ bind_alloc_notify ifn =
              chanvar `C.FieldOf` "monitor_binding",
              my_bindvar `C.DerefField` "inchanlen",
              my_bindvar `C.DerefField` "outchanlen",
+             my_bindvar `C.DerefField` "bulklen",
              C.Variable "NULL_CAP" ] ] []
       ]
       [ C.Ex $ C.Assignment errvar $ C.Call "ipi_notify_alloc"
@@ -199,6 +219,7 @@ bind_alloc_notify_cont_fn ifn =
              chanvar `C.FieldOf` "monitor_binding",
              my_bindvar `C.DerefField` "inchanlen",
              my_bindvar `C.DerefField` "outchanlen",
+             my_bindvar `C.DerefField` "bulklen",
              notifyvar `C.FieldOf` "my_notify_cap"],
         C.If (C.Call "err_is_fail" [errvar])
             [C.Ex $ C.CallInd (bindvar `C.DerefField` "bind_cont")
@@ -198,6 +198,15 @@ class HakeTestMdbInvariantsBuild(HakeTestBuild):
         conf["mdb_check_invariants"] = "True"
         return conf
 
+class HakeTestFlounderStatsBuild(HakeTestBuild):
+    """optimisations, no debug symbols, assertions and flounder binding statistics enabled"""
+    name = 'test_flounder_stats'
+
+    def _get_hake_conf(self, *args):
+        conf = super(HakeTestFlounderStatsBuild, self)._get_hake_conf(*args)
+        conf["flounder_stats"] = "True"
+        return conf
+
 class HakeDebugBuild(HakeBuildBase):
     """Default Hake build: debug symbols, optimisations, assertions"""
     name = 'debug'
@@ -219,7 +228,8 @@ class HakeDebugTraceBuild(HakeBuildBase):
 
 
 all_builds = [HakeReleaseBuild, HakeTestBuild, HakeDebugBuild, HakeReleaseTraceBuild,
-              HakeTestMdbInvariantsBuild, HakeDebugTraceBuild]
+              HakeTestMdbInvariantsBuild, HakeDebugTraceBuild,
+              HakeTestFlounderStatsBuild]
 
 
 class ExistingBuild(HakeBuildBase):
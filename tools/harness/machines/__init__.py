@@ -263,6 +263,10 @@ class Machine(object):
             m.add_module("acpi", ["boot"] + machine.get_acpi_args())
             m.add_module("routing_setup", ["boot"])
 
+            # Per-core memory servers
+            if a == "x86_64":
+                m.add_module("mem_serv_dist", ["dist-serv", "core=0", "-ma"])
+
             # Add pci with machine-specific extra-arguments
             m.add_module("pci", ["auto"] + machine.get_pci_args())
 
@@ -61,6 +61,28 @@ class RetypeMultiTest(TestCommon):
                     npassed += 1
         return PassFailResult(npassed == nspawned)
 
+@tests.add_test
+class LocalOpsTest(TestCommon):
+    '''test that revokes and deletes of caps that never left their core
+    do not run the cross core protocol'''
+    name = "capops_local"
+
+    def get_modules(self, build, machine):
+        modules = super(LocalOpsTest, self).get_modules(build, machine)
+        modules.add_module("test_capops_local")
+        return modules
+
+    def get_finish_string(self):
+        return "capops_local: result:"
+
+    def process_data(self, testdir, rawiter):
+        passed = False
+        for line in rawiter:
+            if line.startswith(self.get_finish_string()):
+                _,_,results=line.split(':')
+                passed = results.strip() == "0"
+        return PassFailResult(passed)
+
 @tests.add_test
 class RootCNResize(TestCommon):
     '''test root cnode resizing'''
@@ -234,6 +234,22 @@ class DistopsBenchRevokeWithRemoteCopies(DistopsBench):
     name = 'bench_distops_revoke_with_remote_copies'
     binary_name = "bench_revoke_with_remote_copies"
 
+@tests.add_test
+class DistopsBenchRevokeSharedDescendants(DistopsBench):
+    '''Benchmark latency of revoking a capability whose owned descendants
+    have copies on all cores'''
+    name = 'bench_distops_revoke_shared_descendants'
+    binary_name = "bench_revoke_shared_descendants"
+
+    def get_modules(self, build, machine):
+        modules = super(DistopsBench, self).get_modules(build, machine)
+        ncores = machine.get_ncores()
+        modules.add_module(self.binary_name,
+                           ["core=0", "mgmt", "%d" % (ncores - 1)])
+        modules.add_module(self.binary_name,
+                           ["core=1-%d" % (ncores - 1), "node"])
+        return modules
+
 @tests.add_test
 class DistopsBenchRetypeNoRemote(DistopsBench):
     '''Benchmark latency of retyping capability with no remote relations'''
@@ -52,3 +52,26 @@ class IdcTestCross(IdcTestCommon):
         modules.add_module("idctest",
                 ["core=%d" % machine.get_coreids()[1], "client"])
         return modules
+
+@tests.add_test
+class IdcTestCrossAdaptive(IdcTestCommon):
+    ''' Execute IDC test. Client/server on different core, and the server's
+    endpoint parks before the client sends'''
+    name = "idc_cross_adaptive"
+
+    def get_modules(self, build, machine):
+        modules = super(IdcTestCrossAdaptive, self).get_modules(build, machine)
+        modules.add_module("idctest",
+                ["core=%d" % machine.get_coreids()[0], "server", "adaptive"])
+        modules.add_module("idctest",
+                ["core=%d" % machine.get_coreids()[1], "client", "adaptive"])
+        return modules
+
+    def process_data(self, testdir, rawiter):
+        parked = False
+        for line in rawiter:
+            if "server endpoint parked" in line:
+                parked = True
+            if parked and re.search(MATCH_RE, line):
+                return PassFailResult(True)
+        return PassFailResult(False)
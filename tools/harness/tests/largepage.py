@@ -0,0 +1,35 @@
+##########################################################################
+# Copyright (c) 2018, ETH Zurich.
+# All rights reserved.
+#
+# This file is distributed under the terms in the attached LICENSE file.
+# If you do not find this file, copies can be found by writing to:
+# ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+##########################################################################
+
+import re
+import tests
+from common import TestCommon
+from results import RowResults
+
+@tests.add_test
+class LargePagePromoteBench(TestCommon):
+    '''TLB-miss-heavy workloads on base pages and promoted large pages'''
+    name = "largepage_promote"
+
+    def get_modules(self, build, machine):
+        modules = super(LargePagePromoteBench, self).get_modules(build, machine)
+        modules.add_module("largepage_promote_bench", ["core=1", "256"])
+        return modules
+
+    def get_finish_string(self):
+        return "largepage_promote_bench done"
+
+    def process_data(self, testdir, rawiter):
+        results = RowResults(['mapping', 'workload', 'avg', 'min'])
+        for line in rawiter:
+            m = re.match(r"largepage: (\w+) (chase|update) (\d+) (\d+)", line)
+            if m:
+                results.add_row([m.group(1), m.group(2),
+                                 int(m.group(3)), int(m.group(4))])
+        return results
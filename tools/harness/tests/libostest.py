@@ -61,3 +61,7 @@ class LibbfPmapArrayMcnTest(LibosTestMemtestMulti):
 @tests.add_test
 class LibbfPmapListMcnTest(LibosTestMemtestMulti):
     name = "libos_memtest_pmap_list_mcn"
+
+@tests.add_test
+class LibbfPmapTreeTest(LibosTestMemtestMulti):
+    name = "libos_memtest_pmap_tree"
@@ -15,10 +15,12 @@ class MdbBench(TestCommon):
     counts = [1<<x for x in range(12, 16+1)]
     #counts = [ 4096 ]
     #counts = [1<<10]
-    impls = ["mdb_bench_noparent", "mdb_bench_linkedlist"]
+    impls = ["mdb_bench_noparent", "mdb_bench_btree", "mdb_bench_linkedlist"]
     measures = [
         "insert_one",
         "remove_one",
+        "insert_all",
+        "remove_all",
         "iterate_1",
         "iterate_10",
         "iterate_100",
@@ -29,7 +31,12 @@ class MdbBench(TestCommon):
     ]
     impl_measures = {
         "mdb_bench_noparent": [
-            "query_address"
+            "query_address",
+            "query_range_100",
+        ],
+        "mdb_bench_btree": [
+            "query_address",
+            "query_range_100",
         ],
     }
     dump = False
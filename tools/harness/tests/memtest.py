@@ -64,3 +64,63 @@ class MemTestMulti(TestCommon):
             if line.startswith("memtest passed successfully!"):
                 nseen += 1
         return PassFailResult(nspawned > 0 and nspawned == nseen)
+
+@tests.add_test
+class MemBenchDist(TestCommon):
+    '''RAM allocation on all cores through the per-core memory servers'''
+    name = "mem_bench_dist"
+
+    def get_modules(self, build, machine):
+        modules = super(MemBenchDist, self).get_modules(build, machine)
+        modules.add_module("mem_bench", ["core=0", "%d" % (machine.get_ncores()-1)])
+        return modules
+
+    def get_finish_string(self):
+        return "all benchmarks completed"
+
+    def process_data(self, testdir, rawiter):
+        passed = False
+        for line in rawiter:
+            if self.get_finish_string() in line:
+                passed = True
+        return PassFailResult(passed)
+
+@tests.add_test
+class RamBatchTest(TestCommon):
+    '''returning RAM caps to the memory server in batches'''
+    name = "memtest_ram_batch"
+
+    def get_modules(self, build, machine):
+        modules = super(RamBatchTest, self).get_modules(build, machine)
+        modules.add_module("memtest_ram_batch")
+        return modules
+
+    def get_finish_string(self):
+        return "memtest_ram_batch: "
+
+    def process_data(self, testdir, rawiter):
+        passed = False
+        for line in rawiter:
+            if line.startswith("memtest_ram_batch: passed"):
+                passed = True
+        return PassFailResult(passed)
+
+@tests.add_test
+class PoolRefillTest(TestCommon):
+    '''deferred refill of pmap slabs and root cnode slots'''
+    name = "pool_refill"
+
+    def get_modules(self, build, machine):
+        modules = super(PoolRefillTest, self).get_modules(build, machine)
+        modules.add_module("pool_refill_test")
+        return modules
+
+    def get_finish_string(self):
+        return "pool_refill_test: "
+
+    def process_data(self, testdir, rawiter):
+        passed = False
+        for line in rawiter:
+            if line.startswith("pool_refill_test: passed"):
+                passed = True
+        return PassFailResult(passed)
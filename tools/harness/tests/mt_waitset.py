@@ -39,3 +39,23 @@ class MultithreadedWaitsetTest(TestCommon):
             if "Test PASSED" in line:
                 passed = True
         return PassFailResult(passed)
+
+@tests.add_test
+class WaitsetPriorityTest(TestCommon):
+    '''waitset priority classes and starvation bound'''
+    name = "mt_waitset_prio"
+
+    def get_modules(self, build, machine):
+        modules = super(WaitsetPriorityTest, self).get_modules(build, machine)
+        modules.add_module("mt_waitset_prio")
+        return modules
+
+    def get_finish_string(self):
+        return "Test "
+
+    def process_data(self, testdir, rawiter):
+        passed = False
+        for line in rawiter:
+            if "Test PASSED" in line:
+                passed = True
+        return PassFailResult(passed)
@@ -52,3 +52,23 @@ class NkmTestMapOffset(TestCommon):
             if line.startswith("nkmtest_map_offset: FAILURE"):
                 errors.append(line)
         return PassFailMultiResult(self.name, errors)
+
+@tests.add_test
+class NkmTestBatchUnmap(TestCommon):
+    '''test that a batched unmap can unmap the page holding the batch'''
+    name = "nkmtest_batch_unmap"
+
+    def get_modules(self, build, machine):
+        modules = super(NkmTestBatchUnmap, self).get_modules(build, machine)
+        modules.add_module("nkmtest_batch_unmap")
+        return modules
+
+    def get_finish_string(self):
+        return "nkmtest_batch_unmap: "
+
+    def process_data(self, testdir, rawiter):
+        passed = False
+        for line in rawiter:
+            if line.startswith("nkmtest_batch_unmap: SUCCESS"):
+                passed = True
+        return PassFailResult(passed)
@@ -19,9 +19,12 @@ class PmapLookupTest(TestCommon):
 
     def get_modules(self, build, machine):
         modules = super(PmapLookupTest, self).get_modules(build, machine)
-        modules.add_module("pmaplookuptest")
+        modules.add_module(self.get_module_name())
         return modules
 
+    def get_module_name(self):
+        return "pmaplookuptest"
+
     def get_finish_string(self):
         return "pmaplookuptest passed successfully!"
 
@@ -32,3 +35,21 @@ class PmapLookupTest(TestCommon):
             lastline = line
         passed = lastline.startswith(self.get_finish_string())
         return PassFailResult(passed)
+
+class PmapLookupLibosTest(PmapLookupTest):
+    '''Run the pmap lookup test against a specific pmap datastructure'''
+
+    def get_module_name(self):
+        return "pmaplookuptest_%s" % self.name.split("_", 1)[1]
+
+@tests.add_test
+class PmapLookupArrayTest(PmapLookupLibosTest):
+    name = "pmaplookup_pmap_array"
+
+@tests.add_test
+class PmapLookupListTest(PmapLookupLibosTest):
+    name = "pmaplookup_pmap_list"
+
+@tests.add_test
+class PmapLookupTreeTest(PmapLookupLibosTest):
+    name = "pmaplookup_pmap_tree"
@@ -13,6 +13,8 @@ from common import TestCommon
 from results import PassFailResult
 
 class RpcCapTestCommon(TestCommon):
+    client_args = []
+
     def get_finish_string(self):
         return "TEST PASSED"
 
@@ -30,12 +32,10 @@ class RpcCapTestCommon(TestCommon):
 
         modules.add_module("rpc_cap_test",
                 ["core=%d" % machine.get_coreids()[0], "server"])
-        modules.add_module("rpc_cap_test",
-                ["core=%d" % ccid, "client", "id=0"])
-        modules.add_module("rpc_cap_test",
-                ["core=%d" % ccid, "client", "id=1"])
-        modules.add_module("rpc_cap_test",
-                ["core=%d" % ccid, "client", "id=2"])
+        for i in range(3):
+            modules.add_module("rpc_cap_test",
+                    ["core=%d" % ccid, "client", "id=%d" % i]
+                    + self.client_args)
         return modules
 
 @tests.add_test
@@ -57,3 +57,9 @@ class RpcCapTestCross(RpcCapTestCommon):
             raise Exception("Machine must have at least 2 cores")
         return machine.get_coreids()[1]
 
+
+@tests.add_test
+class RpcCapTestCrossSmallBuf(RpcCapTestCross):
+    ''' test cap transfer using RPC over a small UMP message ring '''
+    name = "rpc_cap_cross_smallbuf"
+    client_args = ["smallbuf"]
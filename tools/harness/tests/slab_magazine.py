@@ -0,0 +1,36 @@
+##########################################################################
+# Copyright (c) 2016, ETH Zurich.
+# All rights reserved.
+#
+# This file is distributed under the terms in the attached LICENSE file.
+# If you do not find this file, copies can be found by writing to:
+# ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+##########################################################################
+
+import re
+import tests
+from common import TestCommon
+from results import RowResults
+
+@tests.add_test
+class SlabMagazineBench(TestCommon):
+    '''slab allocation under contention, with and without magazines'''
+    name = "slab_magazine"
+
+    def get_modules(self, build, machine):
+        modules = super(SlabMagazineBench, self).get_modules(build, machine)
+        modules.add_module("benchmarks/slab_magazine",
+                           [str(machine.get_ncores())])
+        return modules
+
+    def get_finish_string(self):
+        return "slab_magazine: done"
+
+    def process_data(self, testdir, rawiter):
+        results = RowResults(['mode', 'dispatchers', 'cycles_per_op'])
+        for line in rawiter:
+            m = re.match(r'slab_magazine: (\w+) (\d+) (\d+)$', line.strip())
+            if m:
+                results.add_row([m.group(1), int(m.group(2)),
+                                 int(m.group(3))])
+        return results
@@ -0,0 +1,37 @@
+##########################################################################
+# Copyright (c) 2018, ETH Zurich.
+# All rights reserved.
+#
+# This file is distributed under the terms in the attached LICENSE file.
+# If you do not find this file, copies can be found by writing to:
+# ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+##########################################################################
+
+import re
+import tests
+from common import TestCommon
+from results import PassFailResult
+
+@tests.add_test
+class TicklessTest(TestCommon):
+    '''Idle cores sleep without their periodic tick'''
+    name = "tickless"
+    # wakeup coalescing slack, large against the timer resolution
+    SLACK_US = 100000
+
+    def get_modules(self, build, machine):
+        modules = super(TicklessTest, self).get_modules(build, machine)
+        modules.add_kernel_args(["wakeup_slack=%d" % self.SLACK_US])
+        modules.add_module("ticklesstest", ["core=1", "%d" % self.SLACK_US])
+        return modules
+
+    def get_finish_string(self):
+        return "tickless: result:"
+
+    def process_data(self, testdir, rawiter):
+        passed = False
+        for line in rawiter:
+            m = re.match(r'tickless: result: (\d+)', line)
+            if m:
+                passed = int(m.group(1)) == 0
+        return PassFailResult(passed)
@@ -58,10 +58,16 @@ struct dcb {
     struct cte          ep;
     size_t              vspace;
     struct dcb          *next;          ///< Next DCB in schedule
+    struct dcb          *prev;          ///< Previous DCB in schedule
     unsigned long       release_time, etime, last_dispatch;
     unsigned long       wcet, period, deadline;
     unsigned short      weight;
     enum task_type      type;
+    struct dcb          *rq_parent, *rq_left, *rq_right;
+    uint32_t            rq_prio;
+    unsigned long       rq_min_release, rq_max_release, rq_max_deadline;
+    unsigned long       rq_min_gang_release;
+    bool                gang;
 
     // Simulator state
     int                 id;
@@ -73,8 +79,9 @@ struct dcb {
 struct kcb {
     struct kcb *prev, *next;
     struct dcb *queue_head, *queue_tail;
+    struct dcb *queue_root;
     unsigned int u_hrt, u_srt, w_be, n_be;
-} curr = { 0, 0, 0, 0, 0, 0, 0, 0 };
+} curr = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 struct kcb *kcb_current = &curr;
 
 
@@ -98,6 +105,7 @@ get_dispatcher_shared_generic(dispatcher_handle_t handle)
 }
 
 typedef uint64_t systime_t;
+#define TIMER_INF ((systime_t)(-1))
 #define systime_now() kernel_now
 static size_t kernel_now = 0;
 static int kernel_timeslice = 80;
@@ -107,6 +115,55 @@ static struct dcb *dcb_current = NULL;
 
 #include "../../kernel/schedule_rbed.c"
 
+/***** Run queue consistency check *****/
+
+/// Check the subtree at 'n' against the list, starting at list element '*i'
+static void check_subtree(struct dcb *n, struct dcb *parent, struct dcb **i)
+{
+    if(n == NULL) {
+        return;
+    }
+
+    assert(n->rq_parent == parent);
+    assert(parent == NULL || n->rq_prio <= parent->rq_prio);
+    check_subtree(n->rq_left, n, i);
+    assert(*i == n);
+    *i = n->next;
+    check_subtree(n->rq_right, n, i);
+
+    unsigned long minr = n->release_time, maxr = n->release_time;
+    unsigned long maxd = deadline(n);
+    unsigned long ming = is_gang(n) ? n->release_time : (unsigned long)-1;
+    struct dcb *children[2] = { n->rq_left, n->rq_right };
+    for(int c = 0; c < 2; c++) {
+        if(children[c] != NULL) {
+            minr = MIN(minr, children[c]->rq_min_release);
+            maxr = MAX(maxr, children[c]->rq_max_release);
+            maxd = MAX(maxd, children[c]->rq_max_deadline);
+            ming = MIN(ming, children[c]->rq_min_gang_release);
+        }
+    }
+    assert(n->rq_min_release == minr);
+    assert(n->rq_max_release == maxr);
+    assert(n->rq_max_deadline == maxd);
+    assert(n->rq_min_gang_release == ming);
+}
+
+/// Check that the run queue tree indexes exactly the run queue list
+static void check_queue(void)
+{
+    struct dcb *prev = NULL;
+    for(struct dcb *i = kcb_current->queue_head; i != NULL; i = i->next) {
+        assert(i->prev == prev);
+        prev = i;
+    }
+    assert(kcb_current->queue_tail == prev && queue_tail == prev);
+
+    struct dcb *i = kcb_current->queue_head;
+    check_subtree(kcb_current->queue_root, NULL, &i);
+    assert(i == NULL);
+}
+
 /***** Simulator internal definitions *****/
 
 #define MAXTASKS        10
@@ -119,12 +176,13 @@ static void init_dcb(struct dcb *dcb, int id)
     dcb->cspace.cap.type = ObjType_L1CNode;
     dcb->ep.cap.type = ObjType_EndPointLMP;
     dcb->vspace = 1;
-    dcb->next = NULL;
+    dcb->next = dcb->prev = NULL;
     dcb->release_time = 0;
     dcb->wcet = 0;
     dcb->period = 0;
     dcb->weight = 0;
     dcb->etime = 0;
+    dcb->gang = false;
 
     dcb->id = id;
     snprintf(dcb->dsg.name, DISP_NAME_LEN, "%d", id);
@@ -172,7 +230,7 @@ int main(int argc, char **argv)
 
     for(kernel_now = 0; kernel_now < runtime; kernel_now++) {
         unsigned long time, wcet, period, weight, id, blocktime, deadline, rd;
-        char b[512], *r;
+        char b[512], *r, flag;
 
         for(;;) {
             if(readline) {
@@ -187,9 +245,11 @@ int main(int argc, char **argv)
                 readline = true;
             }
 
-            if((rd = sscanf(b, "%lu H %lu %lu %lu %lu", &time, &wcet, &period, &blocktime, &deadline)) >= 4) {
+            if((rd = sscanf(b, "%lu H %lu %lu %lu %lu %c", &time, &wcet, &period, &blocktime, &deadline, &flag)) >= 4) {
                 if(time != kernel_now) { readline = false; break; }
-                // Create new hard real-time task
+                // Create new hard real-time task, gang scheduled if flagged
+                // with 'g' (like the monitor's gang phases, which request it
+                // explicitly with the dispatcher properties)
                 struct dcb *dcb = malloc(sizeof(struct dcb));
                 init_dcb(dcb, tasks);
                 dcb->type = TASK_TYPE_HARD_REALTIME;
@@ -198,12 +258,39 @@ int main(int argc, char **argv)
                 dcb->blocktime = blocktime;
                 dcb->release_time = kernel_now;
                 snprintf(dcb->dsg.name, DISP_NAME_LEN, "h %d", tasks);
-                if(rd == 5) {
+                if(rd >= 5) {
                     dcb->deadline = deadline;
                 } else {
                     dcb->deadline = period;
                 }
-                make_runnable(dcb);
+                bool gang = rd == 6 && flag == 'g';
+                // Like the kernel, never run a task that was not admitted
+                if(scheduler_admissible(dcb, dcb->type, dcb->deadline, wcet,
+                                        period, dcb->release_time, gang)) {
+                    dcb->gang = gang;
+                    make_runnable(dcb);
+                }
+                assert(tasks < MAXTASKS);
+                allptrs[tasks++] = dcb;
+            } else if(sscanf(b, "%lu G %lu %lu", &time, &wcet, &period) == 3) {
+                if(time != kernel_now) { readline = false; break; }
+                // Create new gang scheduled task. Like the monitor does for
+                // a gang phase, this is a hard real-time task without
+                // laxity, released on a grid of period boundaries that is
+                // common to all cores
+                struct dcb *dcb = malloc(sizeof(struct dcb));
+                init_dcb(dcb, tasks);
+                dcb->type = TASK_TYPE_HARD_REALTIME;
+                dcb->wcet = wcet;
+                dcb->period = period;
+                dcb->deadline = wcet;
+                dcb->release_time = roundup(kernel_now, period);
+                snprintf(dcb->dsg.name, DISP_NAME_LEN, "g %d", tasks);
+                if(scheduler_admissible(dcb, dcb->type, dcb->deadline, wcet,
+                                        period, dcb->release_time, true)) {
+                    dcb->gang = true;
+                    make_runnable(dcb);
+                }
                 assert(tasks < MAXTASKS);
                 allptrs[tasks++] = dcb;
             } else if(sscanf(b, "%lu S %lu %lu", &time, &wcet, &period) == 3) {
@@ -240,6 +327,9 @@ int main(int argc, char **argv)
                 assert(id < MAXTASKS);
                 if(allptrs[id]->type != TASK_TYPE_BEST_EFFORT) {
                     allptrs[id]->release_time = kernel_now;
+                    if(in_queue(allptrs[id])) {
+                        queue_update(allptrs[id]);
+                    }
                 }
                 make_runnable(allptrs[id]);
             } else if(sscanf(b, "%lu y %lu", &time, &id) == 2) {
@@ -259,6 +349,7 @@ int main(int argc, char **argv)
             }
 
             dcb_current = schedule();
+            check_queue();
         }
 
         for(int i = 0; i < alltasks; i++) {
@@ -278,6 +369,7 @@ int main(int argc, char **argv)
 
         if(kernel_now % quantum == 0) {
             dcb_current = schedule();
+            check_queue();
         }
 
         if(dcb_current != NULL) {
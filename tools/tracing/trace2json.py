@@ -0,0 +1,284 @@
+#!/usr/bin/env python
+
+##########################################################################
+# Copyright (c) 2018, ETH Zurich.
+# All rights reserved.
+#
+# This file is distributed under the terms in the attached LICENSE file.
+# If you do not find this file, copies can be found by writing to:
+# ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+##########################################################################
+
+"""Convert a Barrelfish trace stream to the Chrome trace event format.
+
+The input is either the raw stream written by tracestream to a file, or a
+console log containing the base64 encoded "TRACESTREAM" lines. The output
+can be loaded into chrome://tracing or https://ui.perfetto.dev.
+
+Every core becomes a process, and every trace ring (the kernel's, and one
+per dispatcher) becomes a thread of it. Context switch events of the
+kernel are turned into slices showing which dispatcher ran on the core.
+"""
+
+from __future__ import print_function
+
+import argparse
+import base64
+import json
+import struct
+import sys
+
+MAGIC = b'BFTRACE\x01'
+CONSOLE_PREFIX = 'TRACESTREAM '
+
+TAG_CLOCK = 1
+TAG_RING = 2
+TAG_APP = 3
+TAG_OFFSET = 4
+TAG_EVENTS = 5
+TAG_DROPPED = 6
+
+# Context switch event, see trace_definitions/trace_defs.pleco
+SUBSYS_KERNEL = 0
+EVENT_KERNEL_CSWITCH = 0
+
+
+class TraceFormatError(Exception):
+    pass
+
+
+class Reader(object):
+    def __init__(self, data):
+        self.data = bytearray(data)
+        self.pos = 0
+
+    def at_end(self):
+        return self.pos >= len(self.data)
+
+    def byte(self):
+        if self.pos >= len(self.data):
+            raise TraceFormatError('truncated stream')
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def varint(self):
+        v = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            v |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                return v
+
+    def svarint(self):
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+    def name(self):
+        raw = bytes(self.data[self.pos:self.pos + 8])
+        if len(raw) < 8:
+            raise TraceFormatError('truncated stream')
+        self.pos += 8
+        return raw.split(b'\0', 1)[0].decode('ascii', 'replace')
+
+
+def read_input(f):
+    """Return the raw stream, decoding a console log if necessary."""
+    data = f.read()
+    if data.startswith(MAGIC):
+        return data
+
+    chunks = []
+    prefix = CONSOLE_PREFIX.encode('ascii')
+    for line in data.splitlines():
+        idx = line.find(prefix)
+        if idx >= 0:
+            chunks.append(base64.b64decode(line[idx + len(prefix):].strip()))
+    data = b''.join(chunks)
+    if not data.startswith(MAGIC):
+        raise TraceFormatError('no trace stream found in input')
+    return data
+
+
+def decode(data):
+    """Decode the stream into its rings, applications and events."""
+    r = Reader(data)
+    r.pos = len(MAGIC)
+
+    trace = {
+        'tsc_per_ms': None,
+        'rings': {},        # ring -> (core, name)
+        'apps': {},         # (core, dcb) -> name
+        'offsets': {},      # core -> t_offset
+        'events': [],       # (timestamp, ring, subsys, event, arg)
+        'dropped': [],      # (timestamp, ring, total dropped)
+    }
+    last = {}
+    dropped = {}
+
+    while not r.at_end():
+        tag = r.byte()
+        if tag == TAG_CLOCK:
+            trace['tsc_per_ms'] = r.varint()
+        elif tag == TAG_RING:
+            ring = r.varint()
+            core = r.varint()
+            trace['rings'][ring] = (core, r.name())
+        elif tag == TAG_APP:
+            core = r.varint()
+            dcb = r.varint()
+            trace['apps'][(core, dcb)] = r.name()
+        elif tag == TAG_OFFSET:
+            core = r.varint()
+            trace['offsets'][core] = r.svarint()
+        elif tag == TAG_EVENTS:
+            ring = r.varint()
+            count = r.varint()
+            ts = last.get(ring, 0)
+            for _ in range(count):
+                ts += r.svarint()
+                hi = r.varint()
+                lo = r.varint()
+                trace['events'].append((ts, ring, hi >> 16, hi & 0xffff, lo))
+            last[ring] = ts
+        elif tag == TAG_DROPPED:
+            ring = r.varint()
+            dropped[ring] = dropped.get(ring, 0) + r.varint()
+            trace['dropped'].append((last.get(ring, 0), ring, dropped[ring]))
+        else:
+            raise TraceFormatError('unknown record tag %d at offset %d'
+                                   % (tag, r.pos - 1))
+
+    return trace
+
+
+def load_defs(path):
+    """Load the event names from the trace_defs.json generated by pleco."""
+    with open(path) as f:
+        raw = json.load(f)
+    defs = {}
+    for num, subsys in raw.items():
+        num = int(num)
+        if num < 0:
+            continue
+        events = dict((int(e), v[0]) for e, v in subsys.get('events', {}).items())
+        defs[num] = (subsys['name'], events)
+    return defs
+
+
+def event_name(defs, subsys, event):
+    if subsys in defs:
+        name, events = defs[subsys]
+        return '%s.%s' % (name, events.get(event, event))
+    return '%d.%d' % (subsys, event)
+
+
+def to_chrome(trace, defs, tsc_per_us):
+    out = []
+    rings = trace['rings']
+    offsets = trace['offsets']
+
+    # Timestamps are on the clock of core 0, relative to the first event
+    def core_ts(core, ts):
+        return ts - offsets.get(core, 0)
+
+    events = sorted(((core_ts(rings.get(ring, (0,))[0], ts), ring, s, e, a)
+                     for ts, ring, s, e, a in trace['events']))
+    t0 = events[0][0] if events else 0
+
+    def us(ts):
+        return (ts - t0) / tsc_per_us
+
+    for core in sorted(set(c for c, _ in rings.values())):
+        out.append({'ph': 'M', 'name': 'process_name', 'pid': core,
+                    'args': {'name': 'core %d' % core}})
+    for ring, (core, name) in sorted(rings.items()):
+        out.append({'ph': 'M', 'name': 'thread_name', 'pid': core,
+                    'tid': ring, 'args': {'name': name or 'ring %d' % ring}})
+
+    # Dispatcher names by the truncated DCB a context switch event carries
+    apps = dict(((core, dcb & 0xffffffff), name)
+                for (core, dcb), name in trace['apps'].items())
+
+    running = {}        # core -> (start, ring, name)
+    for ts, ring, subsys, event, arg in events:
+        core = rings.get(ring, (0, ''))[0]
+        out.append({'ph': 'i', 's': 't', 'pid': core, 'tid': ring,
+                    'ts': us(ts), 'name': event_name(defs, subsys, event),
+                    'args': {'arg': '0x%x' % arg}})
+
+        if subsys == SUBSYS_KERNEL and event == EVENT_KERNEL_CSWITCH:
+            if core in running:
+                start, kring, name = running[core]
+                out.append({'ph': 'X', 'pid': core, 'tid': kring,
+                            'ts': us(start), 'dur': us(ts) - us(start),
+                            'name': name})
+            name = apps.get((core, arg), 'dcb 0x%x' % arg)
+            running[core] = (ts, ring, name)
+
+    for ts, ring, count in trace['dropped']:
+        core = rings.get(ring, (0, ''))[0]
+        out.append({'ph': 'C', 'pid': core, 'name': 'dropped',
+                    'ts': us(core_ts(core, ts)),
+                    'args': {rings.get(ring, (0, str(ring)))[1]: count}})
+
+    return {'traceEvents': out, 'displayTimeUnit': 'ns'}
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    p.add_argument('input', help='trace stream or console log, - for stdin')
+    p.add_argument('-o', '--output', default='-',
+                   help='output JSON file (default: stdout)')
+    p.add_argument('--defs', help='trace_defs.json generated by pleco, '
+                   'to name the events')
+    p.add_argument('--mhz', type=float,
+                   help='timestamp clock rate, overrides the rate in the stream')
+    args = p.parse_args()
+
+    if args.input == '-':
+        data = read_input(getattr(sys.stdin, 'buffer', sys.stdin))
+    else:
+        with open(args.input, 'rb') as f:
+            data = read_input(f)
+
+    trace = decode(data)
+    defs = load_defs(args.defs) if args.defs else {}
+
+    if args.mhz:
+        tsc_per_us = args.mhz
+    elif trace['tsc_per_ms']:
+        tsc_per_us = trace['tsc_per_ms'] / 1000.0
+    else:
+        print('warning: clock rate unknown, timestamps are in cycles',
+              file=sys.stderr)
+        tsc_per_us = 1.0
+
+    result = to_chrome(trace, defs, tsc_per_us)
+    if args.output == '-':
+        json.dump(result, sys.stdout)
+    else:
+        with open(args.output, 'w') as f:
+            json.dump(result, f)
+
+    print('%d events, %d rings, %d dropped' % (
+        len(trace['events']), len(trace['rings']),
+        sum(c for _, _, c in _last_drops(trace['dropped']))),
+        file=sys.stderr)
+
+
+def _last_drops(dropped):
+    last = {}
+    for ts, ring, count in dropped:
+        last[ring] = (ts, ring, count)
+    return last.values()
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except TraceFormatError as e:
+        print('error: %s' % e, file=sys.stderr)
+        sys.exit(1)
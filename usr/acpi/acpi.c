@@ -860,6 +860,24 @@ static void process_srat(ACPI_TABLE_SRAT *srat)
                     skb_add_fact("memory_affinity(%" PRIu64 ", %" PRIu64 ", %"PRIu32").",
                         a->BaseAddress, a->Length, a->ProximityDomain);
 
+                    // let mem_serv partition its memory by node, proving
+                    // with our first PhysAddr cap that we may do so
+                    struct capref pacn = {
+                        .cnode = cnode_root,
+                        .slot = ROOTCN_SLOT_PACN
+                    };
+                    struct capref physaddr = {
+                        .cnode = build_cnoderef(pacn, CNODE_TYPE_OTHER),
+                        .slot = 0
+                    };
+                    errval_t err = ram_add_node_range(physaddr,
+                                            a->ProximityDomain,
+                                            a->BaseAddress,
+                                            a->BaseAddress + a->Length);
+                    if (err_is_fail(err)) {
+                        DEBUG_ERR(err, "passing memory affinity to mem_serv");
+                    }
+
                 } else {
                     ACPI_DEBUG("Memory affinity table disabled!\n");
                 }
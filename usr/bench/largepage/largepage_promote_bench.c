@@ -0,0 +1,227 @@
+/**
+ * \file
+ * \brief Benchmark for automatic large page promotion
+ *
+ * Runs TLB-miss-heavy workloads (a random pointer chase and random updates)
+ * over a working set that is mapped in three ways: an explicitly base page
+ * mapped frame, an aligned anonymous region, which is promoted to large or
+ * huge pages, and the malloc heap, which is promoted when morecore runs with
+ * the automatic page size.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/morecore.h>
+#include <barrelfish/vspace_mmu_aware.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <bench/bench.h>
+
+#define DEFAULT_WSS_MB  256
+#define ACCESSES        (1UL << 22)
+#define RUN_COUNT       10
+#define LINE_SIZE       64
+
+static size_t wss;
+
+/// Link the cache lines of buf into one random cycle, visiting every page
+static void make_chain(uint8_t *buf, size_t bytes)
+{
+    size_t nlines = bytes / LINE_SIZE;
+    size_t *order = malloc(nlines * sizeof(size_t));
+    assert(order != NULL);
+
+    for (size_t i = 0; i < nlines; i++) {
+        order[i] = i;
+    }
+    for (size_t i = nlines - 1; i > 0; i--) {
+        size_t j = ((size_t)rand() * RAND_MAX + rand()) % (i + 1);
+        size_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (size_t i = 0; i < nlines; i++) {
+        void **line = (void **)(buf + order[i] * LINE_SIZE);
+        *line = buf + order[(i + 1) % nlines] * LINE_SIZE;
+    }
+
+    free(order);
+}
+
+static cycles_t run_chase(uint8_t *buf)
+{
+    void **p = (void **)buf;
+    cycles_t start = bench_tsc();
+    for (size_t i = 0; i < ACCESSES; i++) {
+        p = *p;
+    }
+    cycles_t end = bench_tsc();
+    // keep the chase from being optimised away
+    if (p == NULL) {
+        printf("chain broken\n");
+    }
+    return bench_time_diff(start, end);
+}
+
+static cycles_t run_update(uint8_t *buf, size_t bytes)
+{
+    uint64_t *words = (uint64_t *)buf;
+    size_t nwords = bytes / sizeof(uint64_t);
+    uint64_t x = 88172645463325252ULL;
+
+    cycles_t start = bench_tsc();
+    for (size_t i = 0; i < ACCESSES; i++) {
+        // xorshift, so the address stream does not touch memory
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        words[x % nwords] ^= x;
+    }
+    cycles_t end = bench_tsc();
+    return bench_time_diff(start, end);
+}
+
+static void run_workloads(const char *mapping, uint8_t *buf, size_t bytes)
+{
+    cycles_t runs[RUN_COUNT];
+
+    make_chain(buf, bytes);
+    for (int j = 0; j < RUN_COUNT; j++) {
+        runs[j] = run_chase(buf);
+    }
+    printf("largepage: %s chase %" PRIu64 " %" PRIu64 "\n", mapping,
+           bench_avg(runs, RUN_COUNT) / (ACCESSES / 1000),
+           bench_min(runs, RUN_COUNT) / (ACCESSES / 1000));
+
+    for (int j = 0; j < RUN_COUNT; j++) {
+        runs[j] = run_update(buf, bytes);
+    }
+    printf("largepage: %s update %" PRIu64 " %" PRIu64 "\n", mapping,
+           bench_avg(runs, RUN_COUNT) / (ACCESSES / 1000),
+           bench_min(runs, RUN_COUNT) / (ACCESSES / 1000));
+}
+
+/// One frame, mapped with base pages
+static errval_t bench_base(void)
+{
+    errval_t err;
+    struct capref frame;
+    size_t bytes;
+    void *buf;
+
+    err = frame_alloc(&frame, wss, &bytes);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_FRAME_ALLOC);
+    }
+    err = vspace_map_one_frame_attr(&buf, wss, frame,
+                                    VREGION_FLAGS_READ_WRITE, NULL, NULL);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_VSPACE_MAP);
+    }
+
+    run_workloads("base", buf, wss);
+
+    err = vspace_unmap(buf);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    return cap_destroy(frame);
+}
+
+/// An aligned anonymous region, promoted by vspace_map_anon_aligned()
+static errval_t bench_anon(void)
+{
+    errval_t err;
+    struct memobj *memobj;
+    struct vregion *vregion;
+    struct capref frame;
+    size_t bytes;
+    void *buf;
+
+    size_t alignment = wss >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : LARGE_PAGE_SIZE;
+    err = vspace_map_anon_aligned(&buf, &memobj, &vregion, wss, NULL,
+                                  VREGION_FLAGS_READ_WRITE, alignment);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_VSPACE_MAP);
+    }
+    err = frame_alloc(&frame, wss, &bytes);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_FRAME_ALLOC);
+    }
+    err = memobj->f.fill(memobj, 0, frame, wss);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_MEMOBJ_FILL);
+    }
+    err = memobj->f.pagefault(memobj, vregion, 0, 0);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_MEMOBJ_PAGEFAULT_HANDLER);
+    }
+
+    run_workloads("anon", buf, wss);
+
+    return vregion_destroy(vregion);
+}
+
+/// The malloc heap, promoted by morecore
+static errval_t bench_heap(void)
+{
+    struct vspace_mmu_aware_stats before, after;
+
+    morecore_get_stats(&before);
+    uint8_t *buf = malloc(wss);
+    if (buf == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    morecore_get_stats(&after);
+
+    printf("largepage: heap pages huge %zu large %zu base %zu fallbacks %zu\n",
+           after.huge - before.huge, after.large - before.large,
+           after.base - before.base, after.fallbacks - before.fallbacks);
+
+    run_workloads("heap", buf, wss);
+
+    free(buf);
+    return SYS_ERR_OK;
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+
+    size_t mb = DEFAULT_WSS_MB;
+    if (argc > 1) {
+        mb = strtoul(argv[1], NULL, 0);
+    }
+    wss = ROUND_UP(mb * 1024 * 1024, LARGE_PAGE_SIZE);
+
+    bench_init();
+    // results are "<mapping> <workload> <average> <minimum>", in cycles per
+    // thousand accesses
+    printf("largepage: working set %zu MB, %lu accesses per run\n",
+           wss >> 20, ACCESSES);
+
+    err = bench_base();
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "base page benchmark");
+    }
+    err = bench_anon();
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "anonymous region benchmark");
+    }
+    err = bench_heap();
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "heap benchmark");
+    }
+
+    printf("largepage_promote_bench done\n");
+    return EXIT_SUCCESS;
+}
@@ -43,6 +43,38 @@ static cycles_t measure_remove_one(struct cte *ctes, size_t count)
     return end - begin;
 }
 
+static cycles_t measure_insert_all(struct cte *ctes, size_t count)
+{
+    __asm volatile ("" : : : "memory");
+
+    // measure insert time for all caps
+    cycles_t begin = bench_tsc();
+    for (int i = 0; i < count; i++) {
+        INS(&ctes[i]);
+    }
+    cycles_t end = bench_tsc();
+
+    return end - begin;
+}
+
+static cycles_t measure_remove_all(struct cte *ctes, size_t count)
+{
+    for (int i = 0; i < count; i++) {
+        INS(&ctes[i]);
+    }
+
+    __asm volatile ("" : : : "memory");
+
+    // measure remove time for all caps
+    cycles_t begin = bench_tsc();
+    for (int i = 0; i < count; i++) {
+        REM(&ctes[i]);
+    }
+    cycles_t end = bench_tsc();
+
+    return end - begin;
+}
+
 static cycles_t measure_iterate_n(struct cte *ctes, size_t count, size_t steps)
 {
     // insert all caps
@@ -188,11 +220,48 @@ static cycles_t measure_query_address(struct cte *ctes, size_t count)
 
     return end - begin;
 }
+
+#define RANGE_QUERIES 100
+static cycles_t measure_query_range(struct cte *ctes, size_t count)
+{
+    for (int i = 0; i < count; i++) {
+        INS(&ctes[i]);
+    }
+
+    // randomly select caps whose regions to query
+    genpaddr_t bases[RANGE_QUERIES];
+    gensize_t sizes[RANGE_QUERIES];
+    size_t pos, mod = 1;
+    while (mod < count) { mod <<= 1; }
+    for (int i = 0; i < RANGE_QUERIES; i++) {
+        do {
+            // assuming count is power-of-two
+            pos = rand() % mod;
+        } while (pos >= count);
+        bases[i] = ctes[pos].cap.u.ram.base;
+        sizes[i] = ctes[pos].cap.u.ram.bytes;
+    }
+    struct cte *result;
+    int find_result;
+
+    __asm volatile ("" : : : "memory");
+
+    cycles_t begin = bench_tsc();
+    for (int i = 0; i < RANGE_QUERIES; i++) {
+        mdb_find_range(get_type_root(ObjType_RAM), bases[i], sizes[i],
+                       MDB_RANGE_FOUND_PARTIAL, &result, &find_result);
+    }
+    cycles_t end = bench_tsc();
+
+    return end - begin;
+}
 #endif
 
 struct measure_opt measure_opts[] = {
     { "insert_one", measure_insert_one, },
     { "remove_one", measure_remove_one, },
+    { "insert_all", measure_insert_all, },
+    { "remove_all", measure_remove_all, },
     { "iterate_1", measure_iterate_1, },
     { "iterate_10", measure_iterate_10, },
     { "iterate_100", measure_iterate_100, },
@@ -202,6 +271,7 @@ struct measure_opt measure_opts[] = {
     { "has_descendants", measure_has_descendants, },
 #ifndef OLD_MDB
     { "query_address", measure_query_address, },
+    { "query_range_100", measure_query_range, },
 #endif
     { NULL, NULL, },
 };
@@ -0,0 +1,244 @@
+/**
+ * \file
+ * \brief Contention benchmark for the slab magazine layer
+ *
+ * Spans the domain to up to N dispatchers and lets one thread on each of the
+ * first n of them hammer a shared slab allocator, for n = 1..N:
+ *
+ *   locked:   slab_alloc()/slab_free() under one spinlock, as the slab users
+ *             in libbarrelfish did before the magazines
+ *   magazine: slab_cache_alloc()/slab_cache_free() on a per-thread cache of
+ *             a shared slab_depot
+ *   threads:  thread_create()/thread_join() pairs, whose TCBs come from the
+ *             magazine depot in threads.c
+ *
+ * Output lines are "slab_magazine: <mode> <dispatchers> <cycles per op>".
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/slab.h>
+#include <barrelfish/slab_magazine.h>
+#include <bench/bench.h>
+
+/// Allocation rounds per thread
+#define ROUNDS          2000
+/// Blocks allocated (and then freed) per round
+#define BURST           32
+/// Size of the benchmarked blocks
+#define BLOCKSIZE       64
+/// Thread create/join pairs per thread
+#define THREAD_ROUNDS   200
+
+#define MAX_DISPATCHERS 64
+
+enum bench_mode {
+    MODE_LOCKED,
+    MODE_MAGAZINE,
+    MODE_THREADS,
+};
+
+static const char *mode_names[] = {
+    [MODE_LOCKED]   = "locked",
+    [MODE_MAGAZINE] = "magazine",
+    [MODE_THREADS]  = "threads",
+};
+
+struct worker {
+    enum bench_mode mode;
+    int nworkers;
+    cycles_t cycles;
+};
+
+static struct slab_allocator slabs;
+static spinlock_t slabs_lock;
+static struct slab_depot depot;
+
+static volatile uint32_t arrived;
+static int ndispatchers = 1;
+
+static void domain_spanned_callback(void *arg, errval_t err)
+{
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "spanning domain");
+    }
+    ndispatchers++;
+}
+
+/// Wait until all workers of a run are ready, so that they really contend
+static void start_barrier(int nworkers)
+{
+    __sync_fetch_and_add(&arrived, 1);
+    while (arrived < nworkers) {
+        thread_yield();
+    }
+}
+
+static void *locked_alloc(void)
+{
+    acquire_spinlock(&slabs_lock);
+    void *block = slab_alloc(&slabs);
+    release_spinlock(&slabs_lock);
+    return block;
+}
+
+static void locked_free(void *block)
+{
+    acquire_spinlock(&slabs_lock);
+    slab_free(&slabs, block);
+    release_spinlock(&slabs_lock);
+}
+
+static int noop_thread(void *arg)
+{
+    return 0;
+}
+
+static int worker_thread(void *arg)
+{
+    struct worker *w = arg;
+    struct slab_cache cache;
+    void *blocks[BURST];
+    errval_t err;
+
+    if (w->mode == MODE_MAGAZINE) {
+        err = slab_cache_init(&cache, &depot);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "slab_cache_init");
+        }
+    }
+
+    start_barrier(w->nworkers);
+
+    cycles_t start = bench_tsc();
+    switch (w->mode) {
+    case MODE_LOCKED:
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int i = 0; i < BURST; i++) {
+                blocks[i] = locked_alloc();
+                assert(blocks[i] != NULL);
+            }
+            for (int i = 0; i < BURST; i++) {
+                locked_free(blocks[i]);
+            }
+        }
+        break;
+
+    case MODE_MAGAZINE:
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int i = 0; i < BURST; i++) {
+                blocks[i] = slab_cache_alloc(&cache);
+                assert(blocks[i] != NULL);
+            }
+            for (int i = 0; i < BURST; i++) {
+                slab_cache_free(&cache, blocks[i]);
+            }
+        }
+        break;
+
+    case MODE_THREADS:
+        for (int r = 0; r < THREAD_ROUNDS; r++) {
+            struct thread *t = thread_create(noop_thread, NULL);
+            assert(t != NULL);
+            err = thread_join(t, NULL);
+            assert(err_is_ok(err));
+        }
+        break;
+    }
+    w->cycles = bench_time_diff(start, bench_tsc());
+
+    if (w->mode == MODE_MAGAZINE) {
+        slab_cache_flush(&cache);
+    }
+
+    return 0;
+}
+
+static void run(enum bench_mode mode, int nworkers)
+{
+    struct worker workers[nworkers];
+    struct thread *threads[nworkers];
+    coreid_t my_core = disp_get_core_id();
+    errval_t err;
+
+    arrived = 0;
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].mode = mode;
+        workers[i].nworkers = nworkers;
+        err = domain_thread_create_on(my_core + i, worker_thread, &workers[i],
+                                      &threads[i]);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_thread_create_on");
+        }
+    }
+
+    cycles_t total = 0;
+    for (int i = 0; i < nworkers; i++) {
+        err = domain_thread_join(threads[i], NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_thread_join");
+        }
+        total += workers[i].cycles;
+    }
+
+    uint64_t ops = (mode == MODE_THREADS) ? THREAD_ROUNDS
+                                          : 2 * ROUNDS * BURST;
+    printf("slab_magazine: %s %d %"PRIuCYCLES"\n", mode_names[mode], nworkers,
+           total / (ops * nworkers));
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+
+    if (argc != 2) {
+        printf("Usage: %s <dispatchers>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int maxdisp = atoi(argv[1]);
+    if (maxdisp < 1 || maxdisp > MAX_DISPATCHERS) {
+        printf("%s: between 1 and %d dispatchers\n", argv[0], MAX_DISPATCHERS);
+        return EXIT_FAILURE;
+    }
+
+    bench_init();
+
+    for (int i = 1; i < maxdisp; i++) {
+        err = domain_new_dispatcher(disp_get_core_id() + i,
+                                    domain_spanned_callback, NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "domain_new_dispatcher");
+        }
+    }
+    while (ndispatchers < maxdisp) {
+        event_dispatch(get_default_waitset());
+    }
+
+    slab_init(&slabs, BLOCKSIZE, slab_default_refill);
+    struct slab_allocator magazine_slabs;
+    slab_init(&magazine_slabs, BLOCKSIZE, slab_default_refill);
+    slab_depot_init(&depot, &magazine_slabs);
+
+    for (int n = 1; n <= maxdisp; n++) {
+        run(MODE_LOCKED, n);
+        run(MODE_MAGAZINE, n);
+        run(MODE_THREADS, n);
+    }
+
+    printf("slab_magazine: depot exchanges %"PRIu64" slab allocs %"PRIu64
+           " slab frees %"PRIu64"\n", depot.exchanges, depot.slab_allocs,
+           depot.slab_frees);
+    printf("slab_magazine: done\n");
+    return EXIT_SUCCESS;
+}
@@ -15,6 +15,7 @@
 #include "ump_bench.h"
 
 #define MAX_COUNT 100
+#define BATCH_MSGS NUM_MSGS
 static struct timestamps *timestamps;
 
 void experiment(coreid_t idx)
@@ -62,4 +63,33 @@ void experiment(coreid_t idx)
                    timestamps[i].time0);
         }
     }
+
+    /* Same stream, but published and drained BATCH_MSGS at a time */
+    volatile struct ump_message *msgs[BATCH_MSGS];
+    struct ump_control ctrls[BATCH_MSGS];
+    for (int i = 0; i < MAX_COUNT; i++) {
+        size_t sent = 0, rcvd = 0;
+
+        timestamps[i].time0 = bench_tsc();
+        while (sent < BATCH_MSGS) {
+            size_t n = ump_impl_get_next_batch(send, msgs, ctrls,
+                                               BATCH_MSGS - sent);
+            ump_impl_publish_batch(msgs, ctrls, n);
+            sent += n;
+        }
+        while (rcvd < BATCH_MSGS) {
+            size_t n = ump_impl_recv_batch(recv, msgs, BATCH_MSGS - rcvd);
+            ump_impl_free_batch(msgs, n);
+            rcvd += n;
+        }
+        timestamps[i].time1 = bench_tsc();
+    }
+
+    for (int i = 0; i < MAX_COUNT; i++) {
+        if (timestamps[i].time1 > timestamps[i].time0) {
+            printf("batch %d of %d took %"PRIuCYCLES"\n", i, BATCH_MSGS,
+                   timestamps[i].time1 - bench_tscoverhead() -
+                   timestamps[i].time0);
+        }
+    }
 }
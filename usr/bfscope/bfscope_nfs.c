@@ -229,9 +229,7 @@ int main(int argc, char**argv)
     assert(trace_buf);
 
     // Disable tracing for bfscope
-    dispatcher_handle_t handle = curdispatcher();
-    struct dispatcher_generic *disp = get_dispatcher_generic(handle);
-    disp->trace_buf = NULL;
+    trace_disable_domain();
 
     printf("%.*s running on core %d\n", DISP_NAME_LEN, disp_name(),
            disp_get_core_id());
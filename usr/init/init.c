@@ -14,6 +14,7 @@
 
 #include "init.h"
 #include <stdlib.h>
+#include <string.h>
 #include <trace/trace.h>
 #include <barrelfish/morecore.h>
 #include <barrelfish/dispatcher_arch.h>
@@ -115,8 +116,15 @@ static errval_t bootstrap(int argc, char *argv[])
 {
     errval_t err;
 
-    /* Initialize tracing */
-    err = trace_init();
+    /* Initialize tracing, trace_size=<MiB> sizes the buffer for all cores */
+    size_t trace_size = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strncmp(argv[i], "trace_size=", strlen("trace_size=")) == 0) {
+            trace_size = strtoul(argv[i] + strlen("trace_size="), NULL, 10)
+                         << 20;
+        }
+    }
+    err = trace_init(trace_size);
     if (err_is_fail(err)) {
         DEBUG_ERR(err, "error initializing trace buffer");
         printf("Warning: tracing not available\n");
@@ -163,22 +163,27 @@ int main(int argc, char **argv)
         exit(err);
     }
 
-    for (int i = 0; i < size; i++) {
-        char *data;
+    char **records = calloc(size, sizeof(char *));
+    if (size && records == NULL) {
+        fprintf(stderr, "Error: calloc failed.\n");
+        exit(LIB_ERR_MALLOC_FAIL);
+    }
 
-        err = oct_get(&data, names[i]);
-        if (err) {
-            fprintf(stderr, "Error: oct_get failed.\n");
-            exit(err);
-        }
+    err = oct_get_records(records, names, size);
+    if (err) {
+        fprintf(stderr, "Error: oct_get_records failed.\n");
+        exit(err);
+    }
 
+    for (int i = 0; i < size; i++) {
         if (option[opt].option_number == OPT_LIST_PCI)
-            print_pci(data);
+            print_pci(records[i]);
         else
-            printf("%s\n", data);
+            printf("%s\n", records[i]);
 
-        free(data);
+        free(records[i]);
     }
+    free(records);
 
     if (size)
         oct_free_names(names, size);
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include <sys/param.h>
 #include <barrelfish/barrelfish.h>
 #include <barrelfish/dispatch.h>
 #include <skb/skb.h>
@@ -93,6 +94,119 @@ static struct mm mm_ram;
 /// Slot allocator for MM
 static struct slot_prealloc ram_slot_alloc;
 
+/* Parameters for the partitioning of memory by NUMA node */
+#define MAXNODES        16      ///< Max number of NUMA nodes
+#define MAXNODERANGES   8       ///< Max number of memory ranges per node
+#define RELINQUISH_BATCH 16     ///< Regions moved to a node per refill
+#define SLOT_RESERVE_BITS 24    ///< Memory kept in mm_ram for slot CNodes
+
+/**
+ * \brief Memory of one NUMA node
+ *
+ * Once acpi has passed on the memory affinity from the SRAT, the free memory
+ * of each node is moved from #mm_ram into an allocator of its own, so that a
+ * request for a node is a free list lookup in a tree only holding the node's
+ * memory. #mm_ram keeps whatever memory is not in any node's ranges, and a
+ * reserve from which the slot allocator creates its CNodes.
+ */
+struct mem_node {
+    bool present;                       ///< Node has any ranges
+    struct mm mm;                       ///< Free memory of the node
+    genpaddr_t base[MAXNODERANGES];     ///< Base of each range
+    genpaddr_t limit[MAXNODERANGES];    ///< Limit of each range
+    int nranges;                        ///< Number of ranges
+    size_t total;                       ///< RAM in the node's ranges
+    size_t avail;                       ///< Free memory in #mm
+};
+
+static struct mem_node mem_nodes[MAXNODES];
+
+/// True once any node range has been added
+static bool numa_partitioned = false;
+
+/// Return the node whose ranges contain the given address, or NULL
+static struct mem_node *node_of(genpaddr_t addr)
+{
+    for (int i = 0; i < MAXNODES; i++) {
+        struct mem_node *n = &mem_nodes[i];
+        for (int r = 0; r < n->nranges; r++) {
+            if (addr >= n->base[r] && addr < n->limit[r]) {
+                return n;
+            }
+        }
+    }
+    return NULL;
+}
+
+/// Does any range of the node overlap [minbase, maxlimit)?
+static bool node_overlaps(struct mem_node *n, genpaddr_t minbase,
+                          genpaddr_t maxlimit)
+{
+    for (int r = 0; r < n->nranges; r++) {
+        if (n->base[r] < maxlimit && n->limit[r] > minbase) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Allocate from a node's memory
+static errval_t node_alloc(struct mem_node *n, struct capref *ret, uint8_t bits,
+                           genpaddr_t minbase, genpaddr_t maxlimit)
+{
+    errval_t err;
+
+    if (n->mm.root == NULL) {
+        return MM_ERR_NOT_FOUND;
+    }
+
+    if (maxlimit == 0) {
+        err = mm_alloc(&n->mm, bits, ret, NULL);
+    } else {
+        err = mm_alloc_range(&n->mm, bits, minbase, maxlimit, ret, NULL);
+    }
+    if (err_is_ok(err)) {
+        n->avail -= (size_t)1 << bits;
+    }
+
+    return err;
+}
+
+/// Allocate from the nodes' memory, see mymm_alloc()
+static errval_t nodes_alloc(struct capref *ret, uint8_t bits,
+                            genpaddr_t minbase, genpaddr_t maxlimit)
+{
+    errval_t err = MM_ERR_NOT_FOUND;
+
+    if (maxlimit == 0) {
+        // no constraints, take it from the node with the most free memory
+        bool tried[MAXNODES] = { false };
+        for (int i = 0; i < MAXNODES && err_is_fail(err); i++) {
+            struct mem_node *best = NULL;
+            for (int j = 0; j < MAXNODES; j++) {
+                if (mem_nodes[j].present && !tried[j]
+                    && (best == NULL || mem_nodes[j].avail > best->avail)) {
+                    best = &mem_nodes[j];
+                }
+            }
+            if (best == NULL) {
+                break;
+            }
+            tried[best - mem_nodes] = true;
+            err = node_alloc(best, ret, bits, 0, 0);
+        }
+    } else {
+        for (int i = 0; i < MAXNODES && err_is_fail(err); i++) {
+            if (mem_nodes[i].present
+                && node_overlaps(&mem_nodes[i], minbase, maxlimit)) {
+                err = node_alloc(&mem_nodes[i], ret, bits, minbase, maxlimit);
+            }
+        }
+    }
+
+    return err;
+}
+
 static errval_t mymm_alloc(struct capref *ret, uint8_t bits, genpaddr_t minbase,
                            genpaddr_t maxlimit)
 {
@@ -100,6 +214,15 @@ static errval_t mymm_alloc(struct capref *ret, uint8_t bits, genpaddr_t minbase,
 
     assert(bits >= MINSIZEBITS);
 
+    // once partitioned, mm_ram mostly holds the reserve for the slot
+    // allocator, so only fall back to it
+    if (numa_partitioned) {
+        err = nodes_alloc(ret, bits, minbase, maxlimit);
+        if (err_is_ok(err)) {
+            return err;
+        }
+    }
+
     if(maxlimit == 0) {
         err = mm_alloc(&mm_ram, bits, ret, NULL);
     } else {
@@ -109,6 +232,44 @@ static errval_t mymm_alloc(struct capref *ret, uint8_t bits, genpaddr_t minbase,
     return err;
 }
 
+static void refill_mm(void);
+
+/// Move the free memory in [base, limit) from #mm_ram to a node
+static void node_take_range(struct mem_node *n, genpaddr_t base,
+                            genpaddr_t limit)
+{
+    struct mem_cap caps[RELINQUISH_BATCH];
+    size_t count;
+    errval_t err;
+
+    do {
+        refill_mm();
+
+        count = mm_relinquish_range(&mm_ram, base, limit, caps,
+                                    RELINQUISH_BATCH);
+        size_t i;
+        for (i = 0; i < count && i < RELINQUISH_BATCH; i++) {
+            err = mm_add(&n->mm, caps[i].cap, caps[i].sizebits, caps[i].base);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "moving RAM to NUMA node, leaving it unpartitioned");
+                break;
+            }
+            n->avail += (size_t)1 << caps[i].sizebits;
+        }
+        if (i < count && i < RELINQUISH_BATCH) {
+            // give the rest back to mm_ram
+            for (; i < count && i < RELINQUISH_BATCH; i++) {
+                err = mm_free(&mm_ram, caps[i].cap, caps[i].base,
+                              caps[i].sizebits);
+                if (err_is_fail(err)) {
+                    DEBUG_ERR(err, "mm_free. This memory will leak.");
+                }
+            }
+            return;
+        }
+    } while (count > RELINQUISH_BATCH);
+}
+
 static errval_t mymm_free(struct capref ramcap, genpaddr_t base, uint8_t bits)
 {
     errval_t ret;
@@ -116,6 +277,39 @@ static errval_t mymm_free(struct capref ramcap, genpaddr_t base, uint8_t bits)
 
     mem_to_add = (genpaddr_t)1 << bits;
 
+    struct mem_node *n = node_of(base);
+    if (n != NULL) {
+        ret = mm_free(&n->mm, ramcap, base, bits);
+        if (err_is_ok(ret)) {
+            n->avail += mem_to_add;
+            mem_avail += mem_to_add;
+            return SYS_ERR_OK;
+        } else if (err_no(ret) != MM_ERR_NOT_FOUND) {
+            return ret;
+        }
+
+        // allocated before the node was known, move it over once it is free
+        ret = mm_free(&mm_ram, ramcap, base, bits);
+        if (err_is_ok(ret)) {
+            mem_avail += mem_to_add;
+            node_take_range(n, base, base + mem_to_add);
+            return SYS_ERR_OK;
+        } else if (err_no(ret) != MM_ERR_NOT_FOUND) {
+            return ret;
+        }
+
+        // memory wasn't there initially, add it
+        ret = mm_add(&n->mm, ramcap, bits, base);
+        if (err_is_fail(ret)) {
+            return ret;
+        }
+        mem_total += mem_to_add;
+        mem_avail += mem_to_add;
+        n->total += mem_to_add;
+        n->avail += mem_to_add;
+        return SYS_ERR_OK;
+    }
+
     ret = mm_free(&mm_ram, ramcap, base, bits);
     if (err_is_fail(ret)) {
         if (err_no(ret) == MM_ERR_NOT_FOUND) {
@@ -146,6 +340,7 @@ struct pending_reply {
     struct mem_binding *b;
     errval_t err;
     struct capref *cap;
+    uint32_t allocated;
 };
 
 
@@ -257,6 +452,50 @@ static void mem_available_handler(struct mem_binding *b)
 
 }
 
+/// Refill the slab allocator of an MM instance if needed
+// FIXME: error handling (not asserts) needed in this function
+static void refill_slabs(struct slab_allocator *slabs)
+{
+    errval_t err;
+
+    while (slab_freecount(slabs) <= MINSPARENODES) {
+        struct capref frame;
+        err = slot_alloc(&frame);
+        assert(err_is_ok(err));
+        err = frame_create(frame, BASE_PAGE_SIZE * 8, NULL);
+        assert(err_is_ok(err));
+        void *buf;
+        err = vspace_map_one_frame(&buf, BASE_PAGE_SIZE * 8, frame, NULL, NULL);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "vspace_map_one_frame failed");
+            assert(buf);
+        }
+        slab_grow(slabs, buf, BASE_PAGE_SIZE * 8);
+    }
+}
+
+/// Refill the slot and slab allocators of the MMs before an allocation
+// FIXME: error handling (not asserts) needed in this function
+static void refill_mm(void)
+{
+    errval_t err;
+
+    /* refill slot allocator if needed */
+    err = slot_prealloc_refill(mm_ram.slot_alloc_inst);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "slot_prealloc_refill in mem_allocate_handler");
+    }
+    assert(err_is_ok(err));
+
+    /* refill slab allocators if needed */
+    refill_slabs(&mm_ram.slabs);
+    for (int i = 0; i < MAXNODES; i++) {
+        if (mem_nodes[i].present) {
+            refill_slabs(&mem_nodes[i].mm.slabs);
+        }
+    }
+}
+
 // FIXME: error handling (not asserts) needed in this function
 static void mem_allocate_handler(struct mem_binding *b, uint8_t bits,
                                  genpaddr_t minbase, genpaddr_t maxlimit)
@@ -276,28 +515,7 @@ static void mem_allocate_handler(struct mem_binding *b, uint8_t bits,
 
     trace_event(TRACE_SUBSYS_MEMSERV, TRACE_EVENT_MEMSERV_ALLOC, bits);
 
-    /* refill slot allocator if needed */
-    err = slot_prealloc_refill(mm_ram.slot_alloc_inst);
-    if (err_is_fail(err)) {
-        DEBUG_ERR(err, "slot_prealloc_refill in mem_allocate_handler");
-    }
-    assert(err_is_ok(err));
-
-    /* refill slab allocator if needed */
-    while (slab_freecount(&mm_ram.slabs) <= MINSPARENODES) {
-        struct capref frame;
-        err = slot_alloc(&frame);
-        assert(err_is_ok(err));
-        err = frame_create(frame, BASE_PAGE_SIZE * 8, NULL);
-        assert(err_is_ok(err));
-        void *buf;
-        err = vspace_map_one_frame(&buf, BASE_PAGE_SIZE * 8, frame, NULL, NULL);
-        if (err_is_fail(err)) {
-            DEBUG_ERR(err, "vspace_map_one_frame failed");
-            assert(buf);
-        }
-        slab_grow(&mm_ram.slabs, buf, BASE_PAGE_SIZE * 8);
-    }
+    refill_mm();
 
 #ifdef OSDI18_PAPER_HACK
     //// XXX HACK for OSDI PAPER!!! BAD!
@@ -359,6 +577,608 @@ static void mem_allocate_handler(struct mem_binding *b, uint8_t bits,
     }
 }
 
+static void allocate_batch_response_done(void *arg)
+{
+    struct capref *cnode = arg;
+
+    if (!capref_is_null(*cnode)) {
+        // the client has its own copy of the CNode now
+        errval_t err = cap_delete(*cnode);
+        if (err_is_fail(err) && err_no(err) != SYS_ERR_CAP_NOT_FOUND) {
+            DEBUG_ERR(err, "cap_delete after send. This memory will leak.");
+        }
+        slot_free(*cnode);
+    }
+
+    free(cnode);
+}
+
+static void retry_allocate_batch_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.allocate_batch_response(b,
+                        MKCONT(allocate_batch_response_done, r->cap),
+                        r->err, r->allocated, *r->cap);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_allocate_batch_reply, r));
+        assert(err_is_ok(err));
+    } else {
+        DEBUG_ERR(err, "failed to reply to memory request");
+        allocate_batch_response_done(r->cap);
+        free(r);
+    }
+}
+
+/// Move a RAM cap into a slot of a CNode we hand out, freeing it on failure
+static errval_t hand_out_ram(struct cnoderef cnoder, cslot_t slot,
+                             struct capref ramcap)
+{
+    errval_t err, ret;
+
+    struct capref dest = {
+        .cnode = cnoder,
+        .slot  = slot,
+    };
+    ret = cap_copy(dest, ramcap);
+    if (err_is_fail(ret)) {
+        struct capability info;
+        err = debug_cap_identify(ramcap, &info);
+        if (err_is_ok(err)) {
+            err = mymm_free(ramcap, info.u.ram.base,
+                            log2ceil(info.u.ram.bytes));
+        }
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "returning RAM cap. This memory will leak.");
+        }
+        return ret;
+    }
+    err = cap_delete(ramcap);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "cap_delete of batched RAM cap");
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Allocate a RAM cap of each of the requested sizes, and return them
+ * in a new L2 CNode, so that a single reply carries all of them
+ */
+static void mem_allocate_batch_handler(struct mem_binding *b,
+                                       const uint8_t *bits, size_t count,
+                                       genpaddr_t minbase, genpaddr_t maxlimit)
+{
+    struct capref *cnode = malloc(sizeof(struct capref));
+    assert(cnode != NULL);
+    struct cnoderef cnoder;
+    uint32_t allocated = 0;
+    errval_t err, ret;
+
+    refill_mm();
+
+    ret = cnode_create_l2(cnode, &cnoder);
+    if (err_is_fail(ret)) {
+        *cnode = NULL_CAP;
+        count = 0;
+    }
+
+    for (; allocated < count; allocated++) {
+        trace_event(TRACE_SUBSYS_MEMSERV, TRACE_EVENT_MEMSERV_ALLOC,
+                    bits[allocated]);
+
+        if (bits[allocated] < MINSIZEBITS) {
+            ret = LIB_ERR_RAM_ALLOC_WRONG_SIZE;
+            break;
+        }
+
+        refill_mm();
+
+        struct capref ramcap;
+        ret = mymm_alloc(&ramcap, bits[allocated], minbase, maxlimit);
+        if (err_is_fail(ret)) {
+            break;
+        }
+        mem_avail -= 1UL << bits[allocated];
+
+        ret = hand_out_ram(cnoder, allocated, ramcap);
+        if (err_is_fail(ret)) {
+            break;
+        }
+    }
+
+    /* Reply */
+    err = b->tx_vtbl.allocate_batch_response(b,
+                        MKCONT(allocate_batch_response_done, cnode),
+                        ret, allocated, *cnode);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            r->cap = cnode;
+            r->allocated = allocated;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_allocate_batch_reply, r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to memory request");
+            allocate_batch_response_done(cnode);
+        }
+    }
+}
+
+static void retry_free_batch_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.free_batch_response(b, NOP_CONT, r->err);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_free_batch_reply, r));
+        assert(err_is_ok(err));
+    } else {
+        DEBUG_ERR(err, "failed to reply to free request");
+        free(r);
+    }
+}
+
+/// Take back the RAM caps in slots 0..count-1 of a client's CNode
+static errval_t free_batch(struct capref cnode, uint32_t count)
+{
+    errval_t err;
+
+    if (count > L2_CNODE_SLOTS) {
+        return SYS_ERR_SLOTS_INVALID;
+    }
+
+    // make the CNode addressable in our cspace
+    struct capref cnode_root;
+    err = slot_alloc_root(&cnode_root);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
+    err = cap_copy(cnode_root, cnode);
+    if (err_is_fail(err)) {
+        slot_free(cnode_root);
+        return err;
+    }
+    struct cnoderef cnoder = build_cnoderef(cnode_root, CNODE_TYPE_OTHER);
+
+    err = SYS_ERR_OK;
+    cslot_t i;
+    struct capability info[count];
+    for (i = 0; i < count; i++) {
+        struct capref cap = {
+            .cnode = cnoder,
+            .slot  = i,
+        };
+        err = debug_cap_identify(cap, &info[i]);
+        if (err_is_fail(err)) {
+            break;
+        }
+        if (info[i].type != ObjType_RAM) {
+            err = SYS_ERR_INVALID_SOURCE_TYPE;
+            break;
+        }
+
+        // the client may have kept copies or retyped the cap, take them away
+        err = cap_revoke(cap);
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+    count = i;
+
+    // a cap retyped from RAM the client still holds must not be taken back
+    uint32_t unrelated = 0;
+    if (count > 0) {
+        errval_t err2 = monitor_first_related_cap(cnode, count, &unrelated);
+        if (err_is_fail(err2)) {
+            cap_destroy(cnode_root);
+            return err2;
+        }
+        if (unrelated < count && err_is_ok(err)) {
+            err = LIB_ERR_RAM_FREE_SHARED;
+        }
+    }
+
+    for (i = 0; i < unrelated; i++) {
+        struct capref cap = {
+            .cnode = cnoder,
+            .slot  = i,
+        };
+        errval_t err2;
+        struct capref ramcap;
+        err2 = slot_alloc_prealloc(mm_ram.slot_alloc_inst, 1, &ramcap);
+        if (err_is_fail(err2)) {
+            err = err2;
+            break;
+        }
+        err2 = cap_copy(ramcap, cap);
+        if (err_is_fail(err2)) {
+            err = err2;
+            break;
+        }
+        err2 = mymm_free(ramcap, info[i].u.ram.base,
+                         log2ceil(info[i].u.ram.bytes));
+        if (err_is_fail(err2)) {
+            cap_delete(ramcap);
+            err = err2;
+            break;
+        }
+    }
+
+    cap_destroy(cnode_root);
+
+    return err;
+}
+
+static void mem_free_batch_handler(struct mem_binding *b, struct capref cnode,
+                                   uint32_t count)
+{
+    errval_t err, ret;
+
+    refill_mm();
+
+    ret = free_batch(cnode, count);
+
+    err = cap_destroy(cnode);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "cap_destroy of freed CNode");
+    }
+
+    err = b->tx_vtbl.free_batch_response(b, NOP_CONT, ret);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_free_batch_reply, r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to free request");
+        }
+    }
+}
+
+/// Allocate on a node; without SRAT data, all memory counts as node 0
+static errval_t alloc_on_node(uint32_t node, struct capref *ret, uint8_t bits)
+{
+    errval_t err;
+
+    if (bits < MINSIZEBITS) {
+        return LIB_ERR_RAM_ALLOC_WRONG_SIZE;
+    }
+
+    if (!numa_partitioned) {
+        if (node != 0) {
+            return LIB_ERR_RAM_NODE_INVALID;
+        }
+        err = mymm_alloc(ret, bits, 0, 0);
+    } else {
+        if (node >= MAXNODES || !mem_nodes[node].present) {
+            return LIB_ERR_RAM_NODE_INVALID;
+        }
+        err = node_alloc(&mem_nodes[node], ret, bits, 0, 0);
+    }
+
+    if (err_is_ok(err)) {
+        mem_avail -= 1UL << bits;
+    }
+    return err;
+}
+
+static void retry_allocate_node_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.allocate_node_response(b,
+                        MKCONT(allocate_response_done, r->cap),
+                        r->err, *r->cap);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_allocate_node_reply, r));
+        assert(err_is_ok(err));
+    } else {
+        DEBUG_ERR(err, "failed to reply to memory request");
+        allocate_response_done(r->cap);
+        free(r);
+    }
+}
+
+static void mem_allocate_node_handler(struct mem_binding *b, uint8_t bits,
+                                      uint32_t node)
+{
+    struct capref *cap = malloc(sizeof(struct capref));
+    assert(cap != NULL);
+    errval_t err, ret;
+
+    trace_event(TRACE_SUBSYS_MEMSERV, TRACE_EVENT_MEMSERV_ALLOC, bits);
+
+    refill_mm();
+
+    ret = alloc_on_node(node, cap, bits);
+    if (err_is_fail(ret)) {
+        *cap = NULL_CAP;
+    }
+
+    err = b->tx_vtbl.allocate_node_response(b,
+                        MKCONT(allocate_response_done, cap), ret, *cap);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            r->cap = cap;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_allocate_node_reply, r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to memory request");
+            allocate_response_done(cap);
+        }
+    }
+}
+
+/**
+ * \brief Allocate 2^bits bytes as chunks of 2^chunkbits bytes, taken in turn
+ * from the nodes in the mask, into a new L2 CNode
+ */
+static errval_t interleave_alloc(uint8_t bits, uint8_t chunkbits,
+                                 uint64_t nodemask, struct capref *cnode,
+                                 uint32_t *allocated)
+{
+    uint32_t nodes[MAXNODES];
+    int nnodes = 0;
+    errval_t err;
+
+    *allocated = 0;
+    *cnode = NULL_CAP;
+
+    if (chunkbits < MINSIZEBITS || chunkbits > bits
+        || bits - chunkbits > L2_CNODE_BITS) {
+        return LIB_ERR_RAM_ALLOC_WRONG_SIZE;
+    }
+
+    for (uint32_t i = 0; i < MAXNODES; i++) {
+        if (!(nodemask & ((uint64_t)1 << i))) {
+            continue;
+        }
+        if (numa_partitioned ? mem_nodes[i].present : i == 0) {
+            nodes[nnodes++] = i;
+        }
+    }
+    if (nnodes == 0) {
+        return LIB_ERR_RAM_NODE_INVALID;
+    }
+
+    struct cnoderef cnoder;
+    err = cnode_create_l2(cnode, &cnoder);
+    if (err_is_fail(err)) {
+        *cnode = NULL_CAP;
+        return err;
+    }
+
+    uint32_t count = 1UL << (bits - chunkbits);
+    for (; *allocated < count; (*allocated)++) {
+        refill_mm();
+
+        struct capref ramcap;
+        err = alloc_on_node(nodes[*allocated % nnodes], &ramcap, chunkbits);
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        err = hand_out_ram(cnoder, *allocated, ramcap);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+static void retry_allocate_interleaved_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.allocate_interleaved_response(b,
+                        MKCONT(allocate_batch_response_done, r->cap),
+                        r->err, r->allocated, *r->cap);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_allocate_interleaved_reply, r));
+        assert(err_is_ok(err));
+    } else {
+        DEBUG_ERR(err, "failed to reply to memory request");
+        allocate_batch_response_done(r->cap);
+        free(r);
+    }
+}
+
+static void mem_allocate_interleaved_handler(struct mem_binding *b,
+                                             uint8_t bits, uint8_t chunkbits,
+                                             uint64_t nodemask)
+{
+    struct capref *cnode = malloc(sizeof(struct capref));
+    assert(cnode != NULL);
+    uint32_t allocated;
+    errval_t err, ret;
+
+    refill_mm();
+
+    ret = interleave_alloc(bits, chunkbits, nodemask, cnode, &allocated);
+
+    err = b->tx_vtbl.allocate_interleaved_response(b,
+                        MKCONT(allocate_batch_response_done, cnode),
+                        ret, allocated, *cnode);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            r->cap = cnode;
+            r->allocated = allocated;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_allocate_interleaved_reply, r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to memory request");
+            allocate_batch_response_done(cnode);
+        }
+    }
+}
+
+static void mem_available_node_handler(struct mem_binding *b, uint32_t node)
+{
+    errval_t err, ret = SYS_ERR_OK;
+    genpaddr_t avail = 0, total = 0;
+
+    if (!numa_partitioned) {
+        if (node == 0) {
+            avail = mem_avail;
+            total = mem_total;
+        } else {
+            ret = LIB_ERR_RAM_NODE_INVALID;
+        }
+    } else if (node < MAXNODES && mem_nodes[node].present) {
+        avail = mem_nodes[node].avail;
+        total = mem_nodes[node].total;
+    } else {
+        ret = LIB_ERR_RAM_NODE_INVALID;
+    }
+
+    err = b->tx_vtbl.available_node_response(b, NOP_CONT, ret, avail, total);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "failed to reply to memory request");
+    }
+}
+
+/**
+ * \brief Add a memory range to a NUMA node, and move its free memory over
+ */
+static errval_t node_add_range(uint32_t node, genpaddr_t base,
+                               genpaddr_t limit)
+{
+    errval_t err;
+
+    if (node >= MAXNODES || limit <= base) {
+        return LIB_ERR_RAM_NODE_RANGE;
+    }
+    struct mem_node *n = &mem_nodes[node];
+    if (n->nranges == MAXNODERANGES) {
+        return LIB_ERR_RAM_NODE_RANGE;
+    }
+    for (int i = 0; i < MAXNODES; i++) {
+        if (node_overlaps(&mem_nodes[i], base, limit)) {
+            return LIB_ERR_RAM_NODE_RANGE;
+        }
+    }
+
+    if (!n->present) {
+        err = mm_init(&n->mm, ObjType_RAM, mm_ram.base, mm_ram.sizebits,
+                      MAXCHILDBITS, NULL, slot_alloc_prealloc, NULL,
+                      &ram_slot_alloc, true);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        n->present = true;
+    }
+
+    n->base[n->nranges] = base;
+    n->limit[n->nranges] = limit;
+    n->nranges++;
+    numa_partitioned = true;
+
+    /* count the RAM of the range that bootinfo knows about */
+    for (int i = 0; i < bi->regions_length; i++) {
+        struct mem_region *m = &bi->regions[i];
+        if (m->mr_type != RegionType_Empty) {
+            continue;
+        }
+        genpaddr_t rbase = MAX(m->mr_base, base);
+        genpaddr_t rlimit = MIN(m->mr_base + m->mr_bytes, limit);
+        if (rlimit > rbase) {
+            n->total += rlimit - rbase;
+        }
+    }
+
+    // keep a reserve in mm_ram for the CNodes of the slot allocator
+    struct capref reserve;
+    genpaddr_t reserve_base;
+    refill_mm();
+    err = mm_alloc(&mm_ram, SLOT_RESERVE_BITS, &reserve, &reserve_base);
+
+    node_take_range(n, base, limit);
+
+    if (err_is_ok(err)) {
+        err = mm_free(&mm_ram, reserve, reserve_base, SLOT_RESERVE_BITS);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "returning slot allocator reserve");
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+static void mem_add_node_range_handler(struct mem_binding *b,
+                                       struct capref physaddr, uint32_t node,
+                                       genpaddr_t base, genpaddr_t limit)
+{
+    errval_t err, ret;
+
+    // only domains given the physical address space may partition memory
+    struct capability info;
+    ret = debug_cap_identify(physaddr, &info);
+    if (err_is_ok(ret) && info.type != ObjType_PhysAddr) {
+        ret = LIB_ERR_RAM_NODE_RANGE_DENIED;
+    }
+    if (err_is_ok(ret)) {
+        ret = node_add_range(node, base, limit);
+    }
+
+    err = cap_destroy(physaddr);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "cap_destroy of add_node_range PhysAddr cap");
+    }
+
+    err = b->tx_vtbl.add_node_range_response(b, NOP_CONT, ret);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "failed to reply to add_node_range request");
+    }
+}
+
 static void dump_ram_region(int idx, struct mem_region* m)
 {
 #if 0
@@ -560,6 +1380,12 @@ static struct mem_rx_vtbl rx_vtbl = {
     .allocate_call = mem_allocate_handler,
     .available_call = mem_available_handler,
     .free_monitor_call = mem_free_handler,
+    .allocate_batch_call = mem_allocate_batch_handler,
+    .free_batch_call = mem_free_batch_handler,
+    .allocate_node_call = mem_allocate_node_handler,
+    .allocate_interleaved_call = mem_allocate_interleaved_handler,
+    .available_node_call = mem_available_node_handler,
+    .add_node_range_call = mem_add_node_range_handler,
 };
 
 static bool do_rpc_init = false;
@@ -195,11 +195,12 @@ struct args process_args(int argc, char *argv[])
         .all_cores = false,
         .master = false,
         .ram = 0,
+        .stats_interval = 0,
     };
     
     int opt;
 
-    while ((opt = getopt(argc, argv, "wmax:c:n:r:")) != -1) {
+    while ((opt = getopt(argc, argv, "wmax:c:n:r:s:")) != -1) {
  
         switch (opt) {
         case 'w':
@@ -236,6 +237,10 @@ struct args process_args(int argc, char *argv[])
             // memory to use per core
             res.ram = (genpaddr_t) strtoll(optarg, NULL, 10);
             break;
+        case 's':
+            // print counters every <num> allocations
+            res.stats_interval = strtoull(optarg, NULL, 10);
+            break;
         default:
             goto fail;
         }
@@ -278,8 +283,8 @@ struct args process_args(int argc, char *argv[])
     return res;
 
  fail:
-    printf("Usage: %s [-mw] [-a] [-c list] [-x list] [-n num_cores]\n", 
-           argv[0]);
+    printf("Usage: %s [-mw] [-a] [-c list] [-x list] [-n num_cores] "
+           "[-r ram] [-s stats_interval]\n", argv[0]);
     exit(EXIT_FAILURE);
     return res;
 }
@@ -25,6 +25,7 @@ struct args {
     bool all_cores;
     bool master;
     genpaddr_t ram;
+    uint64_t stats_interval;
 };
 
 struct args process_args(int argc, char *argv[]);
@@ -47,6 +47,7 @@ struct pending_reply {
     struct capref *acap, cap;
     memsize_t mem_avail, mem_total;
     errval_t err;
+    uint32_t allocated;
 };
 
 
@@ -64,6 +65,22 @@ static void allocate_response_done(void *arg)
     free(cap);
 }
 
+static void allocate_batch_response_done(void *arg)
+{
+    struct capref *cnode = arg;
+
+    if (!capref_is_null(*cnode)) {
+        // the client has its own copy of the CNode now
+        errval_t err = cap_delete(*cnode);
+        if (err_is_fail(err) && err_no(err) != SYS_ERR_CAP_NOT_FOUND) {
+            DEBUG_ERR(err, "cap_delete after send. This memory will leak.");
+        }
+        slot_free(*cnode);
+    }
+
+    free(cnode);
+}
+
 // The various send retry functions
 
 static void retry_allocate_reply(void *arg)
@@ -90,6 +107,148 @@ static void retry_allocate_reply(void *arg)
     }
 }
 
+static void retry_allocate_batch_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.allocate_batch_response(b,
+                        MKCONT(allocate_batch_response_done, r->acap),
+                        r->err, r->allocated, *r->acap);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_allocate_batch_reply,r));
+    }
+
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "failed to reply to memory request");
+        allocate_batch_response_done(r->acap);
+        free(r);
+    }
+}
+
+static void retry_free_batch_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.free_batch_response(b, NOP_CONT, r->err);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_free_batch_reply,r));
+    }
+
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "failed to reply to free request");
+        free(r);
+    }
+}
+
+static void retry_allocate_node_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.allocate_node_response(b,
+                        MKCONT(allocate_response_done, r->acap),
+                        r->err, *r->acap);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_allocate_node_reply,r));
+    }
+
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "failed to reply to memory request");
+        allocate_response_done(r->acap);
+        free(r);
+    }
+}
+
+static void retry_allocate_interleaved_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.allocate_interleaved_response(b,
+                        MKCONT(allocate_batch_response_done, r->acap),
+                        r->err, r->allocated, *r->acap);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_allocate_interleaved_reply,r));
+    }
+
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "failed to reply to memory request");
+        allocate_batch_response_done(r->acap);
+        free(r);
+    }
+}
+
+static void retry_available_node_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.available_node_response(b, NOP_CONT, r->err,
+                                             r->mem_avail, r->mem_total);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_available_node_reply,r));
+    }
+
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "failed to reply to available_node request");
+        free(r);
+    }
+}
+
+static void retry_add_node_range_reply(void *arg)
+{
+    struct pending_reply *r = arg;
+    assert(r != NULL);
+    struct mem_binding *b = r->b;
+    errval_t err;
+
+    err = b->tx_vtbl.add_node_range_response(b, NOP_CONT, r->err);
+    if (err_is_ok(err)) {
+        b->st = NULL;
+        free(r);
+    } else if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+        err = b->register_send(b, get_default_waitset(),
+                               MKCONT(retry_add_node_range_reply,r));
+    }
+
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "failed to reply to add_node_range request");
+        free(r);
+    }
+}
+
 static void retry_steal_reply(void *arg)
 {
     struct pending_reply *r = arg;
@@ -271,6 +430,187 @@ static void percore_allocate_handler(struct mem_binding *b,
     trace_event(TRACE_SUBSYS_MEMSERV, TRACE_EVENT_MEMSERV_PERCORE_ALLOC_COMPLETE, 0);
 }
 
+static void percore_allocate_batch_handler(struct mem_binding *b,
+                                           const uint8_t *bits, size_t count,
+                                           genpaddr_t minbase,
+                                           genpaddr_t maxlimit)
+{
+    errval_t ret;
+    uint32_t allocated;
+    struct capref *cnode = malloc(sizeof(struct capref));
+    assert(cnode != NULL);
+    ret = percore_allocate_batch_handler_common(bits, count, minbase, maxlimit,
+                                                cnode, &allocated);
+
+    errval_t err;
+    err = b->tx_vtbl.allocate_batch_response(b,
+                        MKCONT(allocate_batch_response_done, cnode),
+                        ret, allocated, *cnode);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            r->acap = cnode;
+            r->allocated = allocated;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_allocate_batch_reply,r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to memory request");
+            allocate_batch_response_done(cnode);
+        }
+    }
+}
+
+static void percore_free_batch_handler(struct mem_binding *b,
+                                       struct capref cnode, uint32_t count)
+{
+    errval_t ret;
+    ret = percore_free_batch_handler_common(cnode, count);
+
+    errval_t err;
+    err = cap_destroy(cnode);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "cap_destroy of freed CNode");
+    }
+
+    err = b->tx_vtbl.free_batch_response(b, NOP_CONT, ret);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_free_batch_reply,r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to free request");
+        }
+    }
+}
+
+
+static void percore_allocate_node_handler(struct mem_binding *b,
+                                          uint8_t bits, uint32_t node)
+{
+    errval_t ret;
+    struct capref *cap = malloc(sizeof(struct capref));
+    assert(cap != NULL);
+    ret = percore_allocate_node_handler_common(bits, node, cap);
+
+    errval_t err;
+    err = b->tx_vtbl.allocate_node_response(b,
+                        MKCONT(allocate_response_done, cap), ret, *cap);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            r->acap = cap;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_allocate_node_reply,r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to memory request");
+            allocate_response_done(cap);
+        }
+    }
+}
+
+static void percore_allocate_interleaved_handler(struct mem_binding *b,
+                                                 uint8_t bits,
+                                                 uint8_t chunkbits,
+                                                 uint64_t nodemask)
+{
+    errval_t ret;
+    uint32_t allocated;
+    struct capref *cnode = malloc(sizeof(struct capref));
+    assert(cnode != NULL);
+    ret = percore_allocate_interleaved_handler_common(bits, chunkbits,
+                                                      nodemask, cnode,
+                                                      &allocated);
+
+    errval_t err;
+    err = b->tx_vtbl.allocate_interleaved_response(b,
+                        MKCONT(allocate_batch_response_done, cnode),
+                        ret, allocated, *cnode);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            r->acap = cnode;
+            r->allocated = allocated;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_allocate_interleaved_reply,r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to memory request");
+            allocate_batch_response_done(cnode);
+        }
+    }
+}
+
+static void percore_available_node_handler(struct mem_binding *b,
+                                           uint32_t node)
+{
+    errval_t ret;
+    memsize_t avail = 0, total = 0;
+    ret = percore_available_node_handler_common(node, &avail, &total);
+
+    errval_t err;
+    err = b->tx_vtbl.available_node_response(b, NOP_CONT, ret, avail, total);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            r->mem_avail = avail;
+            r->mem_total = total;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_available_node_reply,r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to available_node request");
+        }
+    }
+}
+
+static void percore_add_node_range_handler(struct mem_binding *b,
+                                           struct capref physaddr,
+                                           uint32_t node, genpaddr_t base,
+                                           genpaddr_t limit)
+{
+    errval_t ret;
+    ret = percore_add_node_range_handler_common(physaddr, node, base, limit);
+
+    errval_t err;
+    err = cap_destroy(physaddr);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "cap_destroy of add_node_range PhysAddr cap");
+    }
+
+    err = b->tx_vtbl.add_node_range_response(b, NOP_CONT, ret);
+    if (err_is_fail(err)) {
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            struct pending_reply *r = malloc(sizeof(struct pending_reply));
+            assert(r != NULL);
+            r->b = b;
+            r->err = ret;
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(retry_add_node_range_reply,r));
+            assert(err_is_ok(err));
+        } else {
+            DEBUG_ERR(err, "failed to reply to add_node_range request");
+        }
+    }
+}
 
 // Various startup procedures
 
@@ -302,6 +642,12 @@ static struct mem_rx_vtbl percore_rx_vtbl = {
     .available_call = mem_available_handler,
     .free_monitor_call = percore_free_handler,
     .steal_call = percore_steal_handler,
+    .allocate_batch_call = percore_allocate_batch_handler,
+    .free_batch_call = percore_free_batch_handler,
+    .allocate_node_call = percore_allocate_node_handler,
+    .allocate_interleaved_call = percore_allocate_interleaved_handler,
+    .available_node_call = percore_available_node_handler,
+    .add_node_range_call = percore_add_node_range_handler,
 };
 
 static errval_t percore_connect_callback(void *st, struct mem_binding *b)
@@ -41,12 +41,6 @@
 #include "mem_serv.h"
 #include "steal.h"
 
-/*
- * TODO:
- * - currently requests too much memory from initial mem_serv and other
- *   (non_dist) mem_serv clients may suffer
- */
-
 /// Globally track the total memory available
 memsize_t mem_total = 0;
 /// Globally track the actual memory available to allocate
@@ -54,6 +48,11 @@ memsize_t mem_avail = 0;
 /// Globally track the local reserve memory available to allocate
 memsize_t mem_local = 0;
 
+/// Counters for local hit rate and cross-core traffic
+struct memserv_stats memserv_stats;
+/// Print the counters every this many allocations, 0 to never print them
+uint64_t memserv_stats_interval = 0;
+
 /// MM per-core allocator instance data: B-tree to manage mem regions
 struct mm mm_percore;
 // static storage for MM allocator to get it started
@@ -71,6 +70,10 @@ static struct slot_prealloc percore_slot_alloc;
 
 static struct mm *mm_slots = &mm_percore;
 
+/// NUMA node of our core, refills without constraints come from it
+static uint32_t local_node;
+static bool local_node_known = false;
+
 #if 0
 static void dump_ram_region(int index, struct mem_region* m)
 {
@@ -133,6 +136,25 @@ errval_t slab_refill(struct slab_allocator *slabs)
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Print the counters of this per-core server
+ */
+void memserv_stats_print(void)
+{
+    struct memserv_stats *st = &memserv_stats;
+    uint64_t hit_pct = st->allocs == 0 ? 0 : st->local_hits * 100 / st->allocs;
+
+    debug_printf("mem_serv_dist stats: allocs %"PRIu64" local %"PRIu64
+                 " (%"PRIu64"%%) failed %"PRIu64"\n",
+                 st->allocs, st->local_hits, hit_pct, st->alloc_fails);
+    debug_printf("mem_serv_dist stats: stolen %"PRIu64"/%"PRIu64" (%"PRIuMEMSIZE
+                 " bytes), given %"PRIu64" (%"PRIuMEMSIZE" bytes), central %"
+                 PRIu64" (%"PRIuMEMSIZE" bytes)\n",
+                 st->steals_ok, st->steals, st->bytes_stolen,
+                 st->steals_served, st->bytes_given,
+                 st->central_refills, st->bytes_central);
+}
+
 static errval_t do_free(struct mm *mm, struct capref ramcap,
                         genpaddr_t base, uint8_t bits,
                         memsize_t *mem_available)
@@ -186,6 +208,42 @@ static errval_t percore_free(struct capref ramcap)
                    log2ceil(info.u.ram.bytes), &mem_avail);
 }
 
+/**
+ * \brief Add a RAM cap obtained from a peer or the central mem_serv to the
+ * per-core allocator
+ *
+ * \param ramcap RAM cap to add
+ * \param bytes  Returns the size of the cap, if non-NULL
+ */
+errval_t percore_add_ram(struct capref ramcap, memsize_t *bytes)
+{
+    struct capability info;
+    errval_t err;
+
+    // XXX: Mark as local to this core, until we have x-core cap management
+    err = monitor_cap_set_remote(ramcap, false);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "Warning: failed to set cap non-remote. "
+                  "This memory will leak.");
+    }
+
+    err = debug_cap_identify(ramcap, &info);
+    if (err_is_fail(err)) {
+        return err_push(err, MON_ERR_CAP_IDENTIFY);
+    }
+
+    if (info.type != ObjType_RAM) {
+        return SYS_ERR_INVALID_SOURCE_TYPE;
+    }
+
+    if (bytes != NULL) {
+        *bytes = info.u.ram.bytes;
+    }
+
+    return do_free(&mm_percore, ramcap, info.u.ram.base,
+                   log2ceil(info.u.ram.bytes), &mem_avail);
+}
+
 errval_t percore_free_handler_common(struct capref ramcap, genpaddr_t base,
                                      uint8_t bits)
 {
@@ -268,6 +326,62 @@ static errval_t get_more_ram(uint8_t bits, genpaddr_t minbase,
     return SYS_ERR_OK;
 }
 
+/**
+ * \brief Get more memory from the central mem_serv
+ *
+ * Asks for a batch of up to 2^#STEAL_BATCH_BITS times the requested size,
+ * and then for smaller batches down to the requested size, and adds what it
+ * gets to the per-core allocator.
+ */
+static errval_t central_refill(uint8_t bits, genpaddr_t minbase,
+                               genpaddr_t maxlimit)
+{
+    struct mem_binding *b = get_mem_client();
+    struct capref ramcap;
+    errval_t err, ret = MM_ERR_NOT_FOUND;
+
+    uint8_t batch_bits = bits + STEAL_BATCH_BITS;
+    if (batch_bits > MAXSIZEBITS) {
+        batch_bits = MAXSIZEBITS;
+    }
+
+    // unconstrained requests are served with memory local to our core
+    if (minbase == 0 && maxlimit == 0 && local_node_known) {
+        for (int i = batch_bits; i >= bits; i--) {
+            err = b->rpc_tx_vtbl.allocate_node(b, i, local_node, &ret,
+                                               &ramcap);
+            if (err_is_fail(err)) {
+                return err;
+            }
+            if (err_is_ok(ret)) {
+                break;
+            }
+        }
+    }
+
+    // otherwise, or if the node has run out, take memory from anywhere
+    for (int i = batch_bits; err_is_fail(ret) && i >= bits; i--) {
+        err = b->rpc_tx_vtbl.allocate(b, i, minbase, maxlimit, &ret, &ramcap);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+    if (err_is_fail(ret)) {
+        return ret;
+    }
+
+    memsize_t bytes;
+    err = percore_add_ram(ramcap, &bytes);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    memserv_stats.central_refills++;
+    memserv_stats.bytes_central += bytes;
+
+    return SYS_ERR_OK;
+}
+
 static errval_t do_slot_prealloc_refill(struct slot_prealloc *slot_alloc_inst)
 {
     errval_t err;
@@ -318,21 +432,264 @@ errval_t percore_allocate_handler_common(uint8_t bits,
     }
 
     // do the actual allocation
+    memserv_stats.allocs++;
     ret = percore_alloc(&cap, bits, minbase, maxlimit);
 
-    if (err_is_fail(ret)) {
+    if (err_is_ok(ret)) {
+        memserv_stats.local_hits++;
+    } else {
         // debug_printf("percore_alloc(%d (%lu)) failed\n", bits, 1UL << bits);
-		printf("[%d][%"PRIuDOMAINID"] percore_alloc failed, going to steal\n",
-					disp_get_core_id(), disp_get_domain_id());
         try_steal(&ret, &cap, bits, minbase, maxlimit);
     }
 
+    if (err_is_fail(ret)) {
+        // no peer could help, rebalance from the central mem_serv
+        err = central_refill(bits, minbase, maxlimit);
+        if (err_is_ok(err)) {
+            ret = percore_alloc(&cap, bits, minbase, maxlimit);
+        }
+    }
+
+    if (err_is_fail(ret)) {
+        memserv_stats.alloc_fails++;
+        cap = NULL_CAP;
+    }
+
+    if (memserv_stats_interval != 0
+        && memserv_stats.allocs % memserv_stats_interval == 0) {
+        memserv_stats_print();
+    }
+
     trace_event(TRACE_SUBSYS_MEMSERV, TRACE_EVENT_MEMSERV_PERCORE_ALLOC_COMPLETE, bits);
 
     *retcap = cap;
     return ret;
 }
 
+/**
+ * \brief Allocate a RAM cap of each of the requested sizes into a new L2 CNode
+ *
+ * \param bits      Sizes of the caps to allocate
+ * \param count     Number of caps to allocate
+ * \param minbase   Minimum base address of the caps
+ * \param maxlimit  Maximum limit address of the caps, 0 for no constraint
+ * \param cnode     Returns the CNode, or NULL_CAP
+ * \param allocated Returns the number of caps in slots 0.. of the CNode
+ */
+errval_t percore_allocate_batch_handler_common(const uint8_t *bits,
+                                               size_t count,
+                                               genpaddr_t minbase,
+                                               genpaddr_t maxlimit,
+                                               struct capref *cnode,
+                                               uint32_t *allocated)
+{
+    struct cnoderef cnoder;
+    errval_t err, ret;
+
+    *allocated = 0;
+
+    ret = cnode_create_l2(cnode, &cnoder);
+    if (err_is_fail(ret)) {
+        *cnode = NULL_CAP;
+        return ret;
+    }
+
+    for (; *allocated < count; (*allocated)++) {
+        if (bits[*allocated] < MINSIZEBITS) {
+            return LIB_ERR_RAM_ALLOC_WRONG_SIZE;
+        }
+
+        struct capref ramcap;
+        ret = percore_allocate_handler_common(bits[*allocated], minbase,
+                                              maxlimit, &ramcap);
+        if (err_is_fail(ret)) {
+            return ret;
+        }
+
+        // move the cap into the CNode we hand out
+        struct capref dest = {
+            .cnode = cnoder,
+            .slot  = *allocated,
+        };
+        ret = cap_copy(dest, ramcap);
+        if (err_is_fail(ret)) {
+            err = percore_free(ramcap);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "returning RAM cap. This memory will leak.");
+            }
+            return ret;
+        }
+        err = cap_delete(ramcap);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "cap_delete of batched RAM cap");
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+/*
+ * The per-core servers only hold a share of the memory local to their core,
+ * so requests that name NUMA nodes go to the central mem_serv, which keeps
+ * its memory partitioned by node.
+ */
+
+errval_t percore_allocate_node_handler_common(uint8_t bits, uint32_t node,
+                                              struct capref *retcap)
+{
+    struct mem_binding *b = get_mem_client();
+    errval_t err, ret;
+
+    err = b->rpc_tx_vtbl.allocate_node(b, bits, node, &ret, retcap);
+    if (err_is_fail(err)) {
+        *retcap = NULL_CAP;
+        return err;
+    }
+
+    return ret;
+}
+
+errval_t percore_allocate_interleaved_handler_common(uint8_t bits,
+                                                     uint8_t chunkbits,
+                                                     uint64_t nodemask,
+                                                     struct capref *cnode,
+                                                     uint32_t *allocated)
+{
+    struct mem_binding *b = get_mem_client();
+    errval_t err, ret;
+
+    err = b->rpc_tx_vtbl.allocate_interleaved(b, bits, chunkbits, nodemask,
+                                              &ret, allocated, cnode);
+    if (err_is_fail(err)) {
+        *cnode = NULL_CAP;
+        *allocated = 0;
+        return err;
+    }
+
+    return ret;
+}
+
+errval_t percore_available_node_handler_common(uint32_t node,
+                                               memsize_t *avail,
+                                               memsize_t *total)
+{
+    struct mem_binding *b = get_mem_client();
+    errval_t err, ret;
+
+    err = b->rpc_tx_vtbl.available_node(b, node, &ret, avail, total);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return ret;
+}
+
+errval_t percore_add_node_range_handler_common(struct capref physaddr,
+                                               uint32_t node, genpaddr_t base,
+                                               genpaddr_t limit)
+{
+    struct mem_binding *b = get_mem_client();
+    errval_t err, ret;
+
+    err = b->rpc_tx_vtbl.add_node_range(b, physaddr, node, base, limit, &ret);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return ret;
+}
+
+/**
+ * \brief Take back the RAM caps in slots 0..count-1 of a client's CNode
+ */
+errval_t percore_free_batch_handler_common(struct capref cnode, uint32_t count)
+{
+    errval_t err;
+
+    if (count > L2_CNODE_SLOTS) {
+        return SYS_ERR_SLOTS_INVALID;
+    }
+
+    // make the CNode addressable in our cspace
+    struct capref cnode_root;
+    err = slot_alloc_root(&cnode_root);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
+    err = cap_copy(cnode_root, cnode);
+    if (err_is_fail(err)) {
+        slot_free(cnode_root);
+        return err;
+    }
+    struct cnoderef cnoder = build_cnoderef(cnode_root, CNODE_TYPE_OTHER);
+
+    err = SYS_ERR_OK;
+    cslot_t i;
+    for (i = 0; i < count; i++) {
+        struct capref cap = {
+            .cnode = cnoder,
+            .slot  = i,
+        };
+        struct capability info;
+        err = debug_cap_identify(cap, &info);
+        if (err_is_fail(err)) {
+            break;
+        }
+        if (info.type != ObjType_RAM) {
+            err = SYS_ERR_INVALID_SOURCE_TYPE;
+            break;
+        }
+
+        // the client may have kept copies or retyped the cap, take them away
+        err = cap_revoke(cap);
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+    count = i;
+
+    // a cap retyped from RAM the client still holds must not be taken back
+    uint32_t unrelated = 0;
+    if (count > 0) {
+        errval_t err2 = monitor_first_related_cap(cnode, count, &unrelated);
+        if (err_is_fail(err2)) {
+            cap_destroy(cnode_root);
+            return err2;
+        }
+        if (unrelated < count && err_is_ok(err)) {
+            err = LIB_ERR_RAM_FREE_SHARED;
+        }
+    }
+
+    for (i = 0; i < unrelated; i++) {
+        struct capref cap = {
+            .cnode = cnoder,
+            .slot  = i,
+        };
+        errval_t err2;
+        struct capref ramcap;
+        err2 = slot_alloc_prealloc(mm_slots->slot_alloc_inst, 1, &ramcap);
+        if (err_is_fail(err2)) {
+            err = err2;
+            break;
+        }
+        err2 = cap_copy(ramcap, cap);
+        if (err_is_fail(err2)) {
+            err = err2;
+            break;
+        }
+        err2 = percore_free(ramcap);
+        if (err_is_fail(err2)) {
+            cap_delete(ramcap);
+            err = err2;
+            break;
+        }
+    }
+
+    cap_destroy(cnode_root);
+
+    return err;
+}
 
 // this is a candidate for smarter calculation. possibly by the skb
 static memsize_t get_percore_size(int num_cores)
@@ -354,7 +711,9 @@ static memsize_t get_percore_size(int num_cores)
     debug_printf("available memory: %"PRIuMEMSIZE" bytes over %d cores\n",
                   all_mem_avail, num_cores);
 
-    mem_percore = all_mem_avail / num_cores;
+    // leave a share with the central mem_serv, to refill the per-core
+    // servers when they run out and to serve domains that do not use them
+    mem_percore = all_mem_avail / 100 * PERCORE_SHARE_PERCENT / num_cores;
 
     debug_printf("available memory per core: %"PRIuMEMSIZE" bytes\n",
                   mem_percore);
@@ -569,6 +928,13 @@ errval_t initialize_percore_mem_serv(coreid_t core, coreid_t *cores,
     set_affinity(core);
 #endif
 
+    err = get_percore_node(core, &local_node);
+    if (err_is_ok(err)) {
+        local_node_known = true;
+    } else {
+        DEBUG_ERR(err, "Warning: unknown NUMA node, refilling from any node");
+    }
+
     // determine how much memory we need to get to fill up the percore mm
     percore_mem -= mem_total; // memory we've already taken
     percore_mem -= LOCAL_MEM; // memory we'll take for mm_local
@@ -653,6 +1019,8 @@ static int run_worker(coreid_t core, struct args *args)
 
     // debug_printf("Distributed mem_serv. percore server on core %d\n", core);
 
+    memserv_stats_interval = args->stats_interval;
+
     // this should never return
     percore_mem_serv(core, args->cores, args->cores_len, args->ram);
     return EXIT_FAILURE; // so we should never reach here
@@ -680,7 +1048,8 @@ static int run_master(coreid_t core, struct args *args)
     // -w
     // -c <core list>
     // -r <percore_mem>
-    char *new_argv[7];
+    // -s <stats_interval>
+    char *new_argv[9];
     new_argv[0] = args->path;
     new_argv[1] = "-w";
     new_argv[2] = "-c";
@@ -698,7 +1067,15 @@ static int run_master(coreid_t core, struct args *args)
         return EXIT_FAILURE;
     }
     sprintf(new_argv[5], "%"PRIuMEMSIZE, percore_mem);
-    new_argv[6] = NULL;
+    new_argv[6] = "-s";
+    new_argv[7] = malloc(21); // enough to fit a 64 bit number
+    assert(new_argv[7] != NULL);
+    if (new_argv[7] == NULL) {
+        DEBUG_ERR(LIB_ERR_MALLOC_FAIL, "out of memory");
+        return EXIT_FAILURE;
+    }
+    sprintf(new_argv[7], "%"PRIu64, args->stats_interval);
+    new_argv[8] = NULL;
 
     for (int i = 0; i < args->cores_len; i++) {
         err = spawn_program(args->cores[i], new_argv[0], new_argv,
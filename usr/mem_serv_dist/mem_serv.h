@@ -71,6 +71,15 @@ typedef genpaddr_t memsize_t;
 // size of initial RAM cap to fill allocator
 #define SMALLCAP_BITS 20
 
+/// Percentage of the central mem_serv's free memory shared out to the
+/// per-core servers; the rest stays with it for refills and other clients
+#define PERCORE_SHARE_PERCENT 75
+
+/// When running out, get up to 2^STEAL_BATCH_BITS times the requested size
+/// from a peer or the central mem_serv, so that the surplus serves the
+/// following requests locally
+#define STEAL_BATCH_BITS 3
+
 
 /**
  * \brief Size of CNodes to be created by slot allocator.
@@ -88,6 +97,27 @@ typedef genpaddr_t memsize_t;
 extern memsize_t mem_total;
 extern memsize_t mem_avail;
 
+/// Counters for local hit rate and cross-core traffic
+struct memserv_stats {
+    uint64_t allocs;            ///< Allocation requests from clients
+    uint64_t local_hits;        ///< ... satisfied from local memory
+    uint64_t alloc_fails;       ///< ... that failed
+    uint64_t steals;            ///< Steal requests sent to peers
+    uint64_t steals_ok;         ///< ... that returned memory
+    memsize_t bytes_stolen;     ///< Memory obtained from peers
+    uint64_t steals_served;     ///< Steal requests served for peers
+    memsize_t bytes_given;      ///< Memory handed to peers
+    uint64_t central_refills;   ///< Refills from the central mem_serv
+    memsize_t bytes_central;    ///< Memory obtained from the central mem_serv
+};
+
+extern struct memserv_stats memserv_stats;
+
+/// Print the counters every this many allocations, 0 to never print them
+extern uint64_t memserv_stats_interval;
+
+void memserv_stats_print(void);
+
 /// MM per-core allocator instance data: B-tree to manage mem regions
 extern struct mm mm_percore;
 
@@ -98,6 +128,7 @@ extern struct mm mm_local;
 extern struct mem_binding *monitor_mem_binding;
 
 errval_t slab_refill(struct slab_allocator *slabs);
+errval_t percore_add_ram(struct capref ramcap, memsize_t *bytes);
 
 errval_t percore_free_handler_common(struct capref ramcap, genpaddr_t base,
                                      uint8_t bits);
@@ -109,6 +140,29 @@ errval_t percore_allocate_handler_common(uint8_t bits,
                                          genpaddr_t maxlimit,
                                          struct capref *retcap);
 
+errval_t percore_allocate_batch_handler_common(const uint8_t *bits,
+                                               size_t count,
+                                               genpaddr_t minbase,
+                                               genpaddr_t maxlimit,
+                                               struct capref *cnode,
+                                               uint32_t *allocated);
+errval_t percore_free_batch_handler_common(struct capref cnode,
+                                           uint32_t count);
+
+errval_t percore_allocate_node_handler_common(uint8_t bits, uint32_t node,
+                                              struct capref *retcap);
+errval_t percore_allocate_interleaved_handler_common(uint8_t bits,
+                                                     uint8_t chunkbits,
+                                                     uint64_t nodemask,
+                                                     struct capref *cnode,
+                                                     uint32_t *allocated);
+errval_t percore_available_node_handler_common(uint32_t node,
+                                               memsize_t *avail,
+                                               memsize_t *total);
+errval_t percore_add_node_range_handler_common(struct capref physaddr,
+                                               uint32_t node, genpaddr_t base,
+                                               genpaddr_t limit);
+
 errval_t initialize_percore_mem_serv(coreid_t core, 
                                      coreid_t *cores, 
                                      int len_cores,
@@ -14,6 +14,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <inttypes.h>
 
 #include <string.h>
 
@@ -129,6 +130,31 @@ errval_t get_percore_affinity(coreid_t core, genpaddr_t *base, genpaddr_t *limit
 }
 
 
+/**
+ * \brief Get the NUMA node (SRAT proximity domain) of a core
+ */
+errval_t get_percore_node(coreid_t core, uint32_t *node)
+{
+    assert(node != NULL);
+
+    errval_t err = skb_client_connect();
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "skb_client_connect failed");
+        return err;
+    }
+
+    err = skb_execute_query("cpu_affinity(%d, _, Node), write(Node).", core);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = skb_read_output("%"SCNu32, node);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return SYS_ERR_OK;
+}
 
 static errval_t parse_core_id_list(char *s, coreid_t *cores, int n)
 {
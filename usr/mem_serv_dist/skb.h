@@ -18,6 +18,7 @@
 #include <barrelfish/barrelfish.h>
 
 errval_t get_percore_affinity(coreid_t core, genpaddr_t *base, genpaddr_t *limit);
+errval_t get_percore_node(coreid_t core, uint32_t *node);
 errval_t get_cores_skb(coreid_t **cores, int *n_cores);
 
 #endif /* __SKB_H__ */
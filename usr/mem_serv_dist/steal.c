@@ -94,7 +94,6 @@ static errval_t steal_from_serv(struct peer_core *peer,
     errval_t err;
 
     if (!peer->is_bound) {
-      printf("Connecting to new peer\n");
         err = connect_peer(peer);
         if (err_is_fail(err)) {
             DEBUG_ERR(err, "failed to connect to peer");
@@ -132,9 +131,10 @@ static errval_t rr_steal(struct capref *ret_cap, uint8_t bits,
         if (peer->id == mycore) {
             continue;
         }
-	    printf("%d: Trying to steal from %d/%d\n", disp_get_core_id(), i, num_peers);
+        memserv_stats.steals++;
         err = steal_from_serv(peer, ret_cap, bits, minbase, maxlimit);
         if (err_is_ok(err)) {
+            memserv_stats.steals_ok++;
             break;
         }
     }
@@ -150,94 +150,53 @@ static errval_t rr_steal(struct capref *ret_cap, uint8_t bits,
 }
 
 
-static errval_t steal_and_alloc(struct capref *ret_cap, uint8_t steal_bits,
-                                uint8_t alloc_bits,
+static errval_t steal_and_alloc(struct capref *ret_cap, uint8_t alloc_bits,
                                 genpaddr_t minbase, genpaddr_t maxlimit)
 {
     errval_t err;
-
     struct capref ramcap;
-    struct capability info;
 
     /*
-    debug_printf("steal_and_alloc(steal_bits: %d, alloc_bits: %d, "
+    debug_printf("steal_and_alloc(alloc_bits: %d, "
                  "minbase: 0x%"PRIxGENPADDR", maxlimit: 0x%"PRIxGENPADDR")\n",
-                 steal_bits, alloc_bits, minbase, maxlimit);
+                 alloc_bits, minbase, maxlimit);
     */
 
-    err = rr_steal(&ramcap, steal_bits, minbase, maxlimit);
-    if (err_is_fail(err)) {
-        return err;
+    // steal a batch, so that the surplus serves the next requests locally,
+    // and fall back to the smallest useful size if no peer has that much
+    uint8_t steal_bits = alloc_bits + STEAL_BATCH_BITS;
+    if (steal_bits > MAXSIZEBITS) {
+        steal_bits = MAXSIZEBITS;
     }
 
-    // XXX: Mark as local to this core, until we have x-core cap management
-    err = monitor_cap_set_remote(ramcap, false);
-    if(err_is_fail(err)) {
-        DEBUG_ERR(err, "Warning: failed to set cap non-remote. "
-                  "This memory will leak.");
+    err = rr_steal(&ramcap, steal_bits, minbase, maxlimit);
+    if (err_is_fail(err) && steal_bits > alloc_bits + 1) {
+        err = rr_steal(&ramcap, alloc_bits + 1, minbase, maxlimit);
     }
-
-    err = debug_cap_identify(ramcap, &info);
     if (err_is_fail(err)) {
-        return err_push(err, MON_ERR_CAP_IDENTIFY);
-    }
-#if 0
-    debug_printf("STOLEN cap is type %d Ram base 0x%"PRIxGENPADDR
-                 " (%"PRIuGENPADDR") Bits %d\n",
-                 info.type, info.u.ram.base, info.u.ram.base,
-                 info.u.ram.bits);
-#endif
-    if(steal_bits != log2ceil(info.u.ram.bytes)) {
-      printf("asked for %d bits, but got %d bits of type %d\n",
-	     steal_bits, log2ceil(info.u.ram.bytes), info.type);
+        return err;
     }
-    assert(steal_bits == log2ceil(info.u.ram.bytes));
 
-    memsize_t mem_to_add = (memsize_t)info.u.ram.bytes;
-
-    err = mm_free(&mm_percore, ramcap, info.u.ram.base, log2ceil(info.u.ram.bytes));
+    memsize_t bytes;
+    err = percore_add_ram(ramcap, &bytes);
     if (err_is_fail(err)) {
-        if (err_no(err) == MM_ERR_NOT_FOUND) {
-            // memory wasn't there initially, add it
-            err = mm_add(&mm_percore, ramcap, log2ceil(info.u.ram.bytes), info.u.ram.base);
-            if (err_is_fail(err)) {
-                return err_push(err, MM_ERR_MM_ADD);
-            }
-            mem_total += mem_to_add;
-        } else {
-            return err_push(err, MM_ERR_MM_FREE);
-        }
+        return err;
     }
+    memserv_stats.bytes_stolen += bytes;
 
-    mem_avail += mem_to_add;
-
-    err = percore_alloc(ret_cap, alloc_bits, minbase, maxlimit);
-
-    return err;
+    return percore_alloc(ret_cap, alloc_bits, minbase, maxlimit);
 }
 
 
 void try_steal(errval_t *ret, struct capref *cap, uint8_t bits,
                genpaddr_t minbase, genpaddr_t maxlimit)
 {
-    printf("[%d][%"PRIuDOMAINID"]: failed percore alloc request: bits: %d going to STEAL\n",
-            disp_get_core_id(), disp_get_domain_id(), bits);
-	printf("%p %p %p %p %p %p\n",	__builtin_return_address(0),
-								 	__builtin_return_address(1),
-									__builtin_return_address(2),
-									__builtin_return_address(3),
-									__builtin_return_address(4),
-									__builtin_return_address(5));
     //DEBUG_ERR(*ret, "allocation of %d bits in 0x%" PRIxGENPADDR
     //           "-0x%" PRIxGENPADDR " failed", bits, minbase, maxlimit);
-    *ret = steal_and_alloc(cap, bits+1, bits, minbase, maxlimit);
+    *ret = steal_and_alloc(cap, bits, minbase, maxlimit);
     if (err_is_fail(*ret)) {
-        DEBUG_ERR(*ret, "stealing of %d bits in 0x%" PRIxGENPADDR "-0x%"
-                 PRIxGENPADDR " failed", bits, minbase, maxlimit);
         *cap = NULL_CAP;
     }
-//	*ret = MM_ERR_NOT_FOUND;
-//	*cap = NULL_CAP;
 }
 
 errval_t init_peers(coreid_t core, int len_cores, coreid_t *cores)
@@ -283,9 +242,17 @@ errval_t percore_steal_handler_common(uint8_t bits,
         DEBUG_ERR(err, "Warning: failure when refilling mm_percore slab\n");
     }
 
-    // get actual ram cap
-    ret = percore_alloc(&cap, bits, minbase, maxlimit);
-    if (err_is_fail(ret)){
+    // get actual ram cap, but never give away more than half of what we
+    // have left, so that batched stealing doesn't just move the shortage
+    if (((memsize_t)1 << bits) > mem_avail / 2) {
+        ret = MM_ERR_NOT_FOUND;
+    } else {
+        ret = percore_alloc(&cap, bits, minbase, maxlimit);
+    }
+    if (err_is_ok(ret)) {
+        memserv_stats.steals_served++;
+        memserv_stats.bytes_given += (memsize_t)1 << bits;
+    } else {
         // debug_printf("percore steal request failed\n");
         //DEBUG_ERR(ret, "allocation of stolen %d bits in 0x%" PRIxGENPADDR
         //          "-0x%" PRIxGENPADDR " failed", bits, minbase, maxlimit);
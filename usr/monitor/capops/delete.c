@@ -112,12 +112,11 @@ static void delete_wait__fin(void *st_)
     delete_result__rx(SYS_ERR_OK, st, false);
 }
 
-static void delete_last(struct delete_st* del_st)
+static void delete_last(struct delete_st* del_st, bool locked)
 {
     DEBUG_CAPOPS("%s\n", __FUNCTION__);
     TRACE(CAPOPS, DELETE_LAST, 0);
     errval_t err;
-    bool locked = true;
 
     err = monitor_delete_last(del_st->capref.croot, del_st->capref.cptr,
                               del_st->capref.level, del_st->newcap);
@@ -313,9 +312,24 @@ delete_remote_result__rx(struct intermon_binding *b, errval_t status,
                                        SYS_ERR_RETRY_THROUGH_MONITOR);
         // We got DELETE_LAST_OWNED from cpu driver, do delete_last()
         if (err == last_owned) {
-            delete_last(del_st);
-            // We just assume that delete_last() succeeds
-            err = SYS_ERR_OK;
+            // take the lock again, so no other operation on the cap can
+            // run while it is deleted
+            err = monitor_lock_cap(del_st->capref.croot, del_st->capref.cptr,
+                                   del_st->capref.level);
+            if (err_no(err) == SYS_ERR_CAP_LOCKED) {
+                // another operation got the cap first, start over after it
+                caplock_wait(del_st->capref, &del_st->lock_qn,
+                             MKCLOSURE(delete_trylock_cont, del_st));
+                return;
+            }
+            if (err_is_ok(err)) {
+                // delete_last() reports the result
+                delete_last(del_st, true);
+                return;
+            }
+            if (err_no(err) == SYS_ERR_CAP_NOT_FOUND) {
+                err = SYS_ERR_OK;
+            }
         }
         else if (err_no(err) == SYS_ERR_CAP_NOT_FOUND) {
             // this shouldn't really happen either, but isn't a problem
@@ -351,9 +365,6 @@ find_core_cont(errval_t status, coreid_t core, void *st)
     errval_t err = status;
     struct delete_st *del_st = (struct delete_st*)st;
 
-    // unlock cap so it can be manipulated
-    caplock_unlock(del_st->capref);
-
     if (err_no(status) == SYS_ERR_CAP_NOT_FOUND) {
         // no core with cap exists, delete local cap with cleanup
         err = monitor_domcap_remote_relations(del_st->capref.croot,
@@ -364,16 +375,22 @@ find_core_cont(errval_t status, coreid_t core, void *st)
             if (err_no(err) == SYS_ERR_CAP_NOT_FOUND) {
                 err = SYS_ERR_OK;
             }
+            caplock_unlock(del_st->capref);
             goto report_error;
         }
 
-        delete_last(del_st);
+        // still holding the lock from delete_trylock_cont()
+        delete_last(del_st, true);
     }
     else if (err_is_fail(status)) {
         // an error occured
+        caplock_unlock(del_st->capref);
         goto report_error;
     }
     else {
+        // unlock cap so it can be moved
+        caplock_unlock(del_st->capref);
+
         // core found, attempt move
         err = capops_move(del_st->capref, core, move_result_cont, st);
         GOTO_IF_ERR(err, report_error);
@@ -484,7 +501,7 @@ delete_trylock_cont(void *st)
     if (!(relations & RRELS_COPY_BIT)) {
         // no remote relations, proceed with final delete
         DEBUG_CAPOPS("%s: deleting last copy\n", __FUNCTION__);
-        delete_last(del_st);
+        delete_last(del_st, true);
     }
     else if (distcap_is_moveable(del_st->cap.type)) {
         // if cap is moveable, move ownership so cap can then be deleted
@@ -542,6 +559,7 @@ capops_delete(struct domcapref cap,
     //    - may have remote copies, need to move or revoke cap
     //    - contains further slots which need to be cleared
     // * currently locked
+    bool locked = err_no(err) == SYS_ERR_CAP_LOCKED;
 
     struct delete_st *del_st;
     err = calloce(1, sizeof(*del_st), &del_st);
@@ -561,6 +579,24 @@ capops_delete(struct domcapref cap,
 
     // after this setup is complete, nothing less than a catastrophic failure
     // should stop the delete
+
+    if (!locked) {
+        // The last copy of a cap that was never copied to another core cannot
+        // be the target of any other core's operation, so delete it without
+        // taking the lock and going through the lock queue.
+        uint8_t relations;
+        err = monitor_domcap_remote_relations(cap.croot, cap.cptr, cap.level,
+                                              0, 0, &relations);
+        if (err_is_ok(err) && !(relations & RRELS_COPY_BIT)) {
+            DEBUG_CAPOPS("%s: no remote copies, deleting last copy\n",
+                         __FUNCTION__);
+            capops_stats.delete_local++;
+            delete_last(del_st, false);
+            return;
+        }
+    }
+
+    capops_stats.delete_distributed++;
     delete_trylock_cont(del_st);
     return;
 
@@ -14,6 +14,9 @@
 #include <barrelfish/waitset.h>
 #include <barrelfish/event_queue.h>
 
+/// Maximum number of delete or clear steps the kernel performs per invocation
+#define DELETE_STEPS_BATCH 32
+
 struct waitset *delete_steps_get_waitset(void);
 void delete_steps_trigger(void);
 void delete_steps_pause(void);
@@ -44,4 +47,6 @@ void capops_delete_int(struct delete_st *del_st);
 
 void send_new_ram_cap(struct capref cap);
 
+bool revoke_defer_last_owned(struct capref cap);
+
 #endif
@@ -123,13 +123,27 @@ delete_steps_cont(void *st)
         return;
     }
 
-    err = monitor_delete_step(delcap);
+    err = monitor_delete_step(delcap, DELETE_STEPS_BATCH);
     if (err_no(err) == SYS_ERR_CAP_LOCKED) {
         // XXX
         DEBUG_CAPOPS("%s: cap locked\n", __FUNCTION__);
         caplock_wait(get_cap_domref(NULL_CAP), &caplock_qn, step_closure);
     }
-    if (err_no(err) == SYS_ERR_DELETE_LAST_OWNED) {
+    if (err_no(err) == SYS_ERR_DELETE_LAST_OWNED &&
+        revoke_defer_last_owned(delcap))
+    {
+        // a revoke in progress deletes all remote copies of the cap, and
+        // takes care of it once they are gone; carry on with a fresh slot
+        DEBUG_CAPOPS("%s: deferring last owned to revoke\n", __FUNCTION__);
+        err = slot_alloc(&delcap);
+        PANIC_IF_ERR(err, "allocating delete_steps slot");
+        delete_step_st.capref = get_cap_domref(delcap);
+        if (!enqueued) {
+            event_queue_add(&trigger_queue, &trigger_qn, step_closure);
+            enqueued = true;
+        }
+    }
+    else if (err_no(err) == SYS_ERR_DELETE_LAST_OWNED) {
         DEBUG_CAPOPS("%s: deleting last owned\n", __FUNCTION__);
         assert(!delete_step_st.result_handler);
         delete_step_st.result_handler = delete_steps_delete_result;
@@ -163,7 +177,7 @@ delete_steps_clear(void *st)
     DEBUG_CAPOPS("%s\n", __FUNCTION__);
     errval_t err;
     while (true) {
-        err = monitor_clear_step(delcap);
+        err = monitor_clear_step(delcap, DELETE_STEPS_BATCH);
         if (err_no(err) == SYS_ERR_CAP_NOT_FOUND) {
             break;
         }
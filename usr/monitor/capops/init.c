@@ -4,6 +4,8 @@
 #include "internal.h"
 #include "delete_int.h"
 
+struct capops_stats capops_stats;
+
 errval_t capops_init(struct waitset *ws, struct intermon_binding *b)
 {
     DEBUG_CAPOPS("%s\n", __FUNCTION__);
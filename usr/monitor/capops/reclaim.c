@@ -1,6 +1,6 @@
 /**
  * \file
- * \brief Monitor RAM reclaiming
+ * \brief Monitor RAM reclaiming, and RAM for the kernel's mapping database
  */
 
 /*
@@ -73,3 +73,66 @@ errval_t reclaim_ram_init(void)
     return deferred_event_register(&reclaim_ev, get_default_waitset(), one_sec,
                                    MKCLOSURE(reclaim_ram, NULL));
 }
+
+/*
+ * The kernel's mapping database may need memory for its nodes, which the
+ * monitor gives it before it runs out.
+ */
+
+/// Free mdb nodes below which the monitor gives the kernel more memory
+#define MDB_NODES_LOW   1024
+/// Size of the RAM given to the kernel at a time (2MB)
+#define MDB_MEMORY_BITS 21
+
+static struct deferred_event mdb_memory_ev;
+static struct capref mdb_ram;
+static bool have_mdb_ram;
+
+static void mdb_memory_check(void *arg)
+{
+    errval_t err;
+    size_t free_nodes;
+
+    err = invoke_monitor_mdb_free_nodes(&free_nodes);
+    if (err_is_fail(err) || free_nodes == SIZE_MAX) {
+        // the mapping database does not need memory
+        return;
+    }
+
+    if (free_nodes < MDB_NODES_LOW && !have_mdb_ram) {
+        err = ram_alloc(&mdb_ram, MDB_MEMORY_BITS);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "allocating RAM for the mapping database");
+        } else {
+            have_mdb_ram = true;
+        }
+    }
+
+    if (free_nodes < MDB_NODES_LOW && have_mdb_ram) {
+        err = invoke_monitor_mdb_add_memory(mdb_ram);
+        if (err_is_ok(err)) {
+            // the kernel moved the cap, reuse the slot
+            slot_free(mdb_ram);
+            have_mdb_ram = false;
+        } else if (err_no(err) != SYS_ERR_REVOKE_FIRST) {
+            DEBUG_ERR(err, "giving RAM to the mapping database");
+            cap_destroy(mdb_ram);
+            have_mdb_ram = false;
+        }
+        // else the memory server has not deleted its copy yet, try again
+    }
+
+    delayus_t hundred_ms = 100ULL*1000;
+    err = deferred_event_register(&mdb_memory_ev, get_default_waitset(),
+                                  hundred_ms, MKCLOSURE(mdb_memory_check, NULL));
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "%s: registering deferred event", __FUNCTION__);
+    }
+}
+
+void mdb_memory_init(void)
+{
+    deferred_event_init(&mdb_memory_ev);
+    // check right away, the kernel's initial nodes may be almost used up
+    mdb_memory_check(NULL);
+}
@@ -31,6 +31,9 @@ struct revoke_master_st {
     size_t pending_agreements;
     void *st;
     bool local_fin, remote_fin;
+    struct revoke_master_st *next_deleting;
+    struct capref *deferred;    ///< Last owned copies deleted at the end
+    size_t deferred_count, deferred_capacity;
 };
 
 struct revoke_slave_st {
@@ -51,7 +54,7 @@ static void revoke_result__rx(errval_t result,
                               bool locked);
 static void revoke_retrieve__rx(errval_t result, void *st_);
 static void revoke_local(struct revoke_master_st *st);
-static void revoke_no_remote(struct revoke_master_st *st);
+static errval_t revoke_no_remote(struct revoke_master_st *st, bool local_only);
 static errval_t revoke_mark__send(struct intermon_binding *b,
                                   intermon_caprep_t *caprep,
                                   struct capsend_mc_st *mc_st);
@@ -64,10 +67,14 @@ static void revoke_slave_steps__fin(void *st);
 static void revoke_done__send(struct intermon_binding *b,
                               struct intermon_msg_queue_elem *e);
 static void revoke_master_steps__fin(void *st);
+static void revoke_commit(struct revoke_master_st *st);
 //static errval_t capops_revoke_subscribe()
 
 static uint64_t revoke_seqnum = 0;
 
+/// Revokes in their commit phase, whose remote cores delete their copies
+static struct revoke_master_st *revokes_deleting = NULL;
+
 
 struct revoke_register_st
 {
@@ -204,7 +211,6 @@ revoke_agreement_request_cont(struct monitor_binding *b,
 
 static void revoke_master_cont(void *arg)
 {
-    errval_t err;
     struct revoke_register_st *st = arg;
     struct revoke_master_st *rvk_st = st->cont.arg;
 
@@ -216,17 +222,7 @@ static void revoke_master_cont(void *arg)
     }
 
     /* continue with the protocol */
-    DEBUG_CAPOPS("%s ## revocation: commit phase\n", __FUNCTION__);
-    err = capsend_relations(&rvk_st->rawcap, revoke_commit__send,
-                            &rvk_st->revoke_mc_st, &rvk_st->dests);
-    PANIC_IF_ERR(err, "enqueing revoke_commit multicast");
-
-    delete_steps_resume();
-
-    struct event_closure steps_fin_cont
-            = MKCLOSURE(revoke_master_steps__fin, rvk_st);
-    delete_queue_wait(&rvk_st->del_qn, steps_fin_cont);
-
+    revoke_commit(rvk_st);
 }
 
 static void revoke_slave_cont(void *arg)
@@ -385,10 +381,21 @@ capops_revoke(struct domcapref cap,
             DEBUG_CAPOPS("%s: only one monitor: do simpler revoke\n",
                     __FUNCTION__);
             // no remote monitors exist; do simplified revocation process
-            revoke_no_remote(rst);
+            err = revoke_no_remote(rst, false);
+            assert(err_is_ok(err));
+            capops_stats.revoke_local++;
             // return here
             return;
         }
+        // if nothing below the cap has left this core, the other monitors
+        // have nothing to agree on
+        err = revoke_no_remote(rst, true);
+        if (err_is_ok(err)) {
+            DEBUG_CAPOPS("%s: no remote relations: do simpler revoke\n",
+                    __FUNCTION__);
+            capops_stats.revoke_local++;
+            return;
+        }
         // have ownership, initiate revoke
         revoke_local(rst);
     }
@@ -465,11 +472,13 @@ revoke_local(struct revoke_master_st *st)
             __builtin_return_address(0));
     errval_t err;
 
+    capops_stats.revoke_distributed++;
+
     delete_steps_pause();
 
     err = monitor_revoke_mark_target(st->cap.croot,
                                      st->cap.cptr,
-                                     st->cap.level);
+                                     st->cap.level, false);
     PANIC_IF_ERR(err, "marking revoke");
 
     TRACE(CAPOPS, REVOKE_DO_MARK, 0);
@@ -480,11 +489,19 @@ revoke_local(struct revoke_master_st *st)
     PANIC_IF_ERR(err, "initiating revoke mark multicast");
 }
 
-static void
-revoke_no_remote(struct revoke_master_st *st)
+/**
+ * \brief Revoke without involving other monitors
+ *
+ * \param local_only If set, other monitors exist, and the revoke only goes
+ *        ahead if none of the cap's copies and descendants has ever been
+ *        shared with another core. Returns SYS_ERR_REVOKE_NOT_LOCAL without
+ *        marking anything otherwise.
+ */
+static errval_t
+revoke_no_remote(struct revoke_master_st *st, bool local_only)
 {
     TRACE(CAPOPS, REVOKE_NO_REMOTE, 0);
-    assert(num_monitors_ready_for_capops() == 1);
+    assert(local_only || num_monitors_ready_for_capops() == 1);
 
     if (!delete_steps_get_waitset()) {
         delete_steps_init(get_default_waitset());
@@ -501,10 +518,14 @@ revoke_no_remote(struct revoke_master_st *st)
     DEBUG_CAPOPS("%s: mon_revoke_mark_tgt()\n", __FUNCTION__);
     err = monitor_revoke_mark_target(st->cap.croot,
                                      st->cap.cptr,
-                                     st->cap.level);
+                                     st->cap.level, local_only);
+    if (err_no(err) == SYS_ERR_REVOKE_NOT_LOCAL) {
+        DEBUG_CAPOPS("%s: cap has remote relations\n", __FUNCTION__);
+        delete_steps_resume();
+        return err;
+    }
     PANIC_IF_ERR(err, "marking revoke");
 
-
     // resume delete steps
     DEBUG_CAPOPS("%s: delete_steps_resume()\n", __FUNCTION__);
     delete_steps_resume();
@@ -515,6 +536,8 @@ revoke_no_remote(struct revoke_master_st *st)
     struct event_closure steps_fin_cont
         = MKCLOSURE(revoke_master_steps__fin, st);
     delete_queue_wait(&st->del_qn, steps_fin_cont);
+
+    return SYS_ERR_OK;
 }
 
 static errval_t
@@ -614,7 +637,6 @@ revoke_ready__rx(struct intermon_binding *b, genvaddr_t st)
     struct intermon_state *ist = b->st;
     TRACE(CAPOPS, REVOKE_READY_RX, ist->core_id);
     DEBUG_CAPOPS("%s\n", __FUNCTION__);
-    errval_t err;
 
     struct revoke_master_st *rvk_st = (struct revoke_master_st*)(lvaddr_t)st;
     if (!capsend_handle_mc_reply(&rvk_st->revoke_mc_st)) {
@@ -628,16 +650,145 @@ revoke_ready__rx(struct intermon_binding *b, genvaddr_t st)
         return;
     }
 
+    revoke_commit(rvk_st);
+}
+
+static void
+revoke_commit(struct revoke_master_st *st)
+{
+    errval_t err;
+
     DEBUG_CAPOPS("%s ## revocation: commit phase\n", __FUNCTION__);
-    err = capsend_relations(&rvk_st->rawcap, revoke_commit__send,
-            &rvk_st->revoke_mc_st, &rvk_st->dests);
+    err = capsend_relations(&st->rawcap, revoke_commit__send,
+            &st->revoke_mc_st, &st->dests);
     PANIC_IF_ERR(err, "enqueing revoke_commit multicast");
 
+    // every core now deletes its copies and descendants, so locally owned
+    // caps with remote copies need not be negotiated one by one, see
+    // revoke_defer_last_owned()
+    st->next_deleting = revokes_deleting;
+    revokes_deleting = st;
+
     delete_steps_resume();
 
     struct event_closure steps_fin_cont
-        = MKCLOSURE(revoke_master_steps__fin, rvk_st);
-    delete_queue_wait(&rvk_st->del_qn, steps_fin_cont);
+        = MKCLOSURE(revoke_master_steps__fin, st);
+    delete_queue_wait(&st->del_qn, steps_fin_cont);
+}
+
+/**
+ * \brief Hand a last owned copy found by the delete steps to a revoke
+ *
+ * If the cap is a copy or descendant of a cap being revoked, its remote copies
+ * are deleted by the remote cores' part of the revoke. Instead of a
+ * distributed delete per cap, the revoke deletes it as the last copy once all
+ * remote cores are done.
+ *
+ * \returns true if the revoke took over the cap and its slot
+ */
+bool
+revoke_defer_last_owned(struct capref cap)
+{
+    errval_t err;
+
+    if (revokes_deleting == NULL) {
+        return false;
+    }
+
+    struct capability rawcap;
+    err = monitor_cap_identify(cap, &rawcap);
+    if (err_is_fail(err)) {
+        return false;
+    }
+
+    struct revoke_master_st *st;
+    for (st = revokes_deleting; st; st = st->next_deleting) {
+        if (is_copy(&rawcap, &st->rawcap) || is_ancestor(&rawcap, &st->rawcap)) {
+            break;
+        }
+    }
+    if (st == NULL) {
+        return false;
+    }
+
+    if (st->deferred_count == st->deferred_capacity) {
+        size_t capacity = st->deferred_capacity ? st->deferred_capacity * 2 : 16;
+        struct capref *deferred = realloc(st->deferred,
+                                          capacity * sizeof(struct capref));
+        if (deferred == NULL) {
+            return false;
+        }
+        st->deferred = deferred;
+        st->deferred_capacity = capacity;
+    }
+    st->deferred[st->deferred_count++] = cap;
+
+    return true;
+}
+
+static void
+revoke_delete_deferred(struct revoke_master_st *st)
+{
+    errval_t err;
+    struct capref ramcap;
+
+    DEBUG_CAPOPS("%s: deleting %zu deferred caps\n", __FUNCTION__,
+                 st->deferred_count);
+
+    err = slot_alloc(&ramcap);
+    PANIC_IF_ERR(err, "allocating slot for reclaimed RAM");
+
+    for (size_t i = 0; i < st->deferred_count; i++) {
+        struct domcapref cap = get_cap_domref(st->deferred[i]);
+
+        // the remote copies are gone with the remote part of the revoke
+        err = monitor_domcap_remote_relations(cap.croot, cap.cptr, cap.level,
+                                              0, RRELS_COPY_BIT, NULL);
+        PANIC_IF_ERR(err, "resetting remote copies bit of deferred cap");
+
+        err = monitor_delete_last(cap.croot, cap.cptr, cap.level, ramcap);
+        PANIC_IF_ERR(err, "deleting deferred cap");
+        if (err_no(err) == SYS_ERR_RAM_CAP_CREATED) {
+            send_new_ram_cap(ramcap);
+        }
+
+        err = slot_free(st->deferred[i]);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "freeing deferred cap slot, will leak");
+        }
+    }
+    st->deferred_count = 0;
+
+    err = slot_free(ramcap);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "freeing reclamation slot, will leak");
+    }
+}
+
+static void
+revoke_master_fin(struct revoke_master_st *st)
+{
+    if (st->deferred_count > 0) {
+        // deleting the deferred caps may have put CNodes on the clear list;
+        // wait for the delete steps once more
+        revoke_delete_deferred(st);
+        st->local_fin = false;
+        struct event_closure steps_fin_cont
+            = MKCLOSURE(revoke_master_steps__fin, st);
+        delete_queue_wait(&st->del_qn, steps_fin_cont);
+        return;
+    }
+
+    struct revoke_master_st **p = &revokes_deleting;
+    while (*p && *p != st) {
+        p = &(*p)->next_deleting;
+    }
+    if (*p) {
+        *p = st->next_deleting;
+    }
+    free(st->deferred);
+
+    revoke_result__rx(SYS_ERR_OK, st, true);
 }
 
 static errval_t
@@ -762,7 +913,7 @@ revoke_done__rx(struct intermon_binding *b,
     DEBUG_CAPOPS("%s ## revocation: fin phase\n", __FUNCTION__);
     rvk_st->remote_fin = true;
     if (rvk_st->local_fin) {
-        revoke_result__rx(SYS_ERR_OK, rvk_st, true);
+        revoke_master_fin(rvk_st);
     }
 }
 
@@ -773,6 +924,6 @@ revoke_master_steps__fin(void *st)
     struct revoke_master_st *rvk_st = (struct revoke_master_st*)st;
     rvk_st->local_fin = true;
     if (rvk_st->remote_fin) {
-        revoke_result__rx(SYS_ERR_OK, rvk_st, true);
+        revoke_master_fin(rvk_st);
     }
 }
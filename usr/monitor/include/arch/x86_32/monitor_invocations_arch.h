@@ -306,10 +306,10 @@ invoke_monitor_delete_foreigns(capaddr_t cap, int bits)
 
 static inline errval_t
 invoke_monitor_revoke_mark_target(capaddr_t root, int rbits,
-                                  capaddr_t cap, int cbits)
+                                  capaddr_t cap, int cbits, bool local_only)
 {
-    return cap_invoke5(cap_kernel, KernelCmd_Revoke_mark_target,
-                       root, rbits, cap, cbits).error;
+    return cap_invoke6(cap_kernel, KernelCmd_Revoke_mark_target,
+                       root, rbits, cap, cbits, local_only).error;
 }
 
 static inline errval_t
@@ -322,17 +322,19 @@ invoke_monitor_revoke_mark_relations(uint64_t *raw_base)
 }
 
 static inline errval_t
-invoke_monitor_delete_step(capaddr_t retcn, int retcnbits, cslot_t retslot)
+invoke_monitor_delete_step(capaddr_t retcn, int retcnbits, cslot_t retslot,
+                           size_t max_steps)
 {
-    return cap_invoke4(cap_kernel, KernelCmd_Delete_step,
-                       retcn, retcnbits, retslot).error;
+    return cap_invoke5(cap_kernel, KernelCmd_Delete_step,
+                       retcn, retcnbits, retslot, max_steps).error;
 }
 
 static inline errval_t
-invoke_monitor_clear_step(capaddr_t retcn, int retcnbits, cslot_t retslot)
+invoke_monitor_clear_step(capaddr_t retcn, int retcnbits, cslot_t retslot,
+                          size_t max_steps)
 {
-    return cap_invoke4(cap_kernel, KernelCmd_Clear_step,
-                       retcn, retcnbits, retslot).error;
+    return cap_invoke5(cap_kernel, KernelCmd_Clear_step,
+                       retcn, retcnbits, retslot, max_steps).error;
 }
 
 static inline errval_t
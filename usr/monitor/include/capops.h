@@ -48,8 +48,19 @@ void capops_retype(enum objtype type, size_t objsize, size_t count, struct capre
                    gensize_t offset, retype_result_handler_t result_handler, void *st);
 
 
+/// Counts of the cap operations the monitor completed without (local) and
+/// with (distributed) a cross core agreement protocol
+struct capops_stats {
+    uint64_t revoke_local;
+    uint64_t revoke_distributed;
+    uint64_t delete_local;
+    uint64_t delete_distributed;
+};
+extern struct capops_stats capops_stats;
+
 /* capops subsystem init */
 errval_t reclaim_ram_init(void);
+void mdb_memory_init(void);
 void delete_steps_init(struct waitset *ws);
 
 /* capops init */
@@ -119,24 +119,26 @@ invoke_monitor_delete_foreigns(capaddr_t cap, int level)
 
 static inline errval_t
 invoke_monitor_revoke_mark_target(capaddr_t root, int rlevel,
-                                  capaddr_t cap, int clevel)
+                                  capaddr_t cap, int clevel, bool local_only)
 {
-    return cap_invoke5(cap_kernel, KernelCmd_Revoke_mark_target,
-                       root, rlevel, cap, clevel).error;
+    return cap_invoke6(cap_kernel, KernelCmd_Revoke_mark_target,
+                       root, rlevel, cap, clevel, local_only).error;
 }
 
 static inline errval_t
-invoke_monitor_delete_step(capaddr_t retcn, int retcnlevel, cslot_t retslot)
+invoke_monitor_delete_step(capaddr_t retcn, int retcnlevel, cslot_t retslot,
+                           size_t max_steps)
 {
-    return cap_invoke4(cap_kernel, KernelCmd_Delete_step,
-                       retcn, retcnlevel, retslot).error;
+    return cap_invoke5(cap_kernel, KernelCmd_Delete_step,
+                       retcn, retcnlevel, retslot, max_steps).error;
 }
 
 static inline errval_t
-invoke_monitor_clear_step(capaddr_t retcn, int retcnlevel, cslot_t retslot)
+invoke_monitor_clear_step(capaddr_t retcn, int retcnlevel, cslot_t retslot,
+                          size_t max_steps)
 {
-    return cap_invoke4(cap_kernel, KernelCmd_Clear_step,
-                       retcn, retcnlevel, retslot).error;
+    return cap_invoke5(cap_kernel, KernelCmd_Clear_step,
+                       retcn, retcnlevel, retslot, max_steps).error;
 }
 
 static inline errval_t
@@ -146,6 +148,24 @@ invoke_monitor_reclaim_ram(capaddr_t retcn, int retcnlevel, cslot_t retslot)
                        retcn, retcnlevel, retslot).error;
 }
 
+//{{{1 Mapping database memory
+static inline errval_t
+invoke_monitor_mdb_add_memory(struct capref ram)
+{
+    return cap_invoke3(cap_kernel, KernelCmd_Mdb_add_memory,
+                       get_cap_addr(ram), get_cap_level(ram)).error;
+}
+
+static inline errval_t
+invoke_monitor_mdb_free_nodes(size_t *ret_count)
+{
+    struct sysret sysret = cap_invoke1(cap_kernel, KernelCmd_Mdb_free_nodes);
+    if (err_is_ok(sysret.error)) {
+        *ret_count = sysret.value;
+    }
+    return sysret.error;
+}
+
 //{{{1 Register EP
 static inline errval_t
 invoke_monitor_register(struct capref ep)
@@ -267,10 +287,10 @@ errval_t monitor_delete_last(struct capref croot, capaddr_t cptr, int level,
 errval_t monitor_delete_foreigns(struct capref cap);
 errval_t monitor_revoke_mark_target(struct capref croot,
                                     capaddr_t cptr,
-                                    int level);
+                                    int level, bool local_only);
 errval_t monitor_revoke_mark_relations(struct capability *cap);
-errval_t monitor_delete_step(struct capref ret_cap);
-errval_t monitor_clear_step(struct capref ret_cap);
+errval_t monitor_delete_step(struct capref ret_cap, size_t max_steps);
+errval_t monitor_clear_step(struct capref ret_cap, size_t max_steps);
 errval_t monitor_reclaim_ram(struct capref ret_cap);
 
 #endif
@@ -254,11 +254,12 @@ errval_t monitor_delete_foreigns(struct capref cap)
 }
 
 errval_t monitor_revoke_mark_target(struct capref croot, capaddr_t cptr,
-                                    int level)
+                                    int level, bool local_only)
 {
     capaddr_t root_addr = get_cap_addr(croot);
     uint8_t root_level = get_cap_level(croot);
-    return invoke_monitor_revoke_mark_target(root_addr, root_level, cptr, level);
+    return invoke_monitor_revoke_mark_target(root_addr, root_level, cptr, level,
+                                             local_only);
 }
 
 errval_t monitor_revoke_mark_relations(struct capability *cap)
@@ -266,18 +267,18 @@ errval_t monitor_revoke_mark_relations(struct capability *cap)
     return invoke_monitor_revoke_mark_relations((uint64_t*)cap);
 }
 
-errval_t monitor_delete_step(struct capref ret_cap)
+errval_t monitor_delete_step(struct capref ret_cap, size_t max_steps)
 {
     return invoke_monitor_delete_step(get_cnode_addr(ret_cap),
                                       get_cnode_level(ret_cap),
-                                      ret_cap.slot);
+                                      ret_cap.slot, max_steps);
 }
 
-errval_t monitor_clear_step(struct capref ret_cap)
+errval_t monitor_clear_step(struct capref ret_cap, size_t max_steps)
 {
     return invoke_monitor_clear_step(get_cnode_addr(ret_cap),
                                      get_cnode_level(ret_cap),
-                                     ret_cap.slot);
+                                     ret_cap.slot, max_steps);
 }
 
 errval_t monitor_reclaim_ram(struct capref ret_cap)
@@ -377,18 +377,14 @@ int main(int argc, char *argv[])
     }
 
 #if defined(TRACING_EXISTS) && defined(CONFIG_TRACE)
-    err = trace_my_setup();
-    if (err_no(err) == TRACE_ERR_UNAVAIL) {
-        debug_printf("Tracing not available for core %d, consider increasing TRACE_COREID_LIMIT\n",
-                my_core_id);
-        goto tracing_not_available;
-    }
-    assert(err_is_ok(err));
-    trace_reset_buffer();
-
+    // Also maps the buffer and gives the monitor its ring
     struct capref tracecap;
-    err = trace_setup_on_core(&tracecap);
-    if (err_is_fail(err)) {
+    err = trace_setup_on_core(&tracecap, TRACE_DEFAULT_RING_EVENTS,
+                              TRACE_OVERFLOW_STOP);
+    if (err_no(err) == TRACE_ERR_BUF_FULL) {
+        debug_printf("Tracing not available for core %d, the trace buffer is full\n",
+                my_core_id);
+    } else if (err_is_fail(err)) {
         if(err_no(err) != TRACE_ERR_NO_BUFFER) {
             DEBUG_ERR(err, "trace_setup_on_core failed");
             printf("Warning: tracing not available on core %d\n", my_core_id);
@@ -400,7 +396,6 @@ int main(int argc, char *argv[])
             printf("Warning: tracing not available on core %d\n", my_core_id);
         }
     }
-tracing_not_available:
 #endif // tracing
 
     domain_mgmt_init();
@@ -415,6 +410,8 @@ tracing_not_available:
         DEBUG_ERR(err, "unable to start RAM reclaiming sweep timer, expect RAM to be dropped!");
     }
 
+    mdb_memory_init();
+
     for(;;) {
         err = event_dispatch(get_default_waitset());
         if(err_is_fail(err)) {
@@ -641,6 +641,18 @@ static void get_platform_arch(struct monitor_blocking_binding *b)
     }
 }
 
+static void get_capops_stats(struct monitor_blocking_binding *b)
+{
+    errval_t err;
+    err = b->tx_vtbl.get_capops_stats_response(b, NOP_CONT,
+                                               capops_stats.revoke_local,
+                                               capops_stats.revoke_distributed,
+                                               capops_stats.delete_local,
+                                               capops_stats.delete_distributed);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "sending capops stats failed.");
+    }
+}
 
 static void new_monitor_binding(struct monitor_blocking_binding *b,
                                 struct capref ep, bool export,
@@ -773,6 +785,60 @@ static void cap_needs_revoke_agreement_request(struct monitor_blocking_binding *
     assert(err_is_ok(err));
 }
 
+static void first_related_cap(struct monitor_blocking_binding *b,
+                              struct capref cnode, uint32_t count)
+{
+    errval_t err, reterr = SYS_ERR_OK;
+    uint32_t i = 0;
+
+    if (count > L2_CNODE_SLOTS) {
+        reterr = SYS_ERR_SLOTS_INVALID;
+        goto send_reply;
+    }
+
+    // make the CNode addressable in our cspace
+    struct capref cnode_root;
+    reterr = slot_alloc_root(&cnode_root);
+    if (err_is_fail(reterr)) {
+        goto send_reply;
+    }
+    reterr = cap_copy(cnode_root, cnode);
+    if (err_is_fail(reterr)) {
+        slot_free(cnode_root);
+        goto send_reply;
+    }
+    struct cnoderef cnoder = build_cnoderef(cnode_root, CNODE_TYPE_OTHER);
+
+    const uint8_t mask = RRELS_COPY_BIT | RRELS_ANCS_BIT;
+    for (i = 0; i < count; i++) {
+        struct capref cap = {
+            .cnode = cnoder,
+            .slot  = i,
+        };
+        uint8_t local, remote;
+        reterr = monitor_cap_has_relations(cap, mask, &local);
+        if (err_is_fail(reterr)) {
+            break;
+        }
+        reterr = monitor_remote_relations(cap, 0, 0, &remote);
+        if (err_is_fail(reterr)) {
+            break;
+        }
+        if ((local | remote) & mask) {
+            break;
+        }
+    }
+
+    cap_destroy(cnode_root);
+
+send_reply:
+    cap_destroy(cnode);
+    err = b->tx_vtbl.first_related_cap_response(b, NOP_CONT, reterr, i);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "sending first_related_cap response failed.");
+    }
+}
+
 
 /*------------------------- Initialization functions -------------------------*/
 
@@ -809,8 +875,11 @@ static struct monitor_blocking_rx_vtbl rx_vtbl = {
     .get_platform_call = get_platform,
     .get_platform_arch_call = get_platform_arch,
 
+    .get_capops_stats_call = get_capops_stats,
+
     .new_monitor_binding_call = new_monitor_binding,
-    .cap_needs_revoke_agreement_call = cap_needs_revoke_agreement_request
+    .cap_needs_revoke_agreement_call = cap_needs_revoke_agreement_request,
+    .first_related_cap_call = first_related_cap,
 };
 
 
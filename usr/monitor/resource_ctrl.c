@@ -17,6 +17,10 @@
 #define MAX_RSRC_DOMAINS        8
 #define MAX_PHASES              8
 
+/// Share of a core that hard real-time phases may use, in percent. The
+/// kernel scheduler keeps the rest for best-effort tasks.
+#define MAX_HRT_UTIL            90
+
 struct rsrc_phase {
     bool                active;
     bool                gang_scheduling;
@@ -32,6 +36,8 @@ struct rsrc_domain {
     struct capref disp;
     struct rsrc_phase phase[MAX_PHASES];
     int active_phase;
+    bool phase_set;             ///< A phase has been activated on this core
+    uint64_t release;           ///< Local release time of the active phase
     bool joined[MAX_CPUS];
 };
 
@@ -200,6 +206,7 @@ errval_t rsrc_join(rsrcid_t id, struct capref dispcap,
     d->active = true;
     d->disp = dispcap;
     d->b = mb;
+    d->phase_set = false;
 
     // Join as a satellite
     coreid_t coreid = get_rsrc_coreid(id);
@@ -265,11 +272,24 @@ errval_t rsrc_submit_manifest(rsrcid_t id, char *manifest)
                    "deadline = %lu, release = %lu\n", phase,
                    type == 'G' ? "gang scheduled" : "hard real-time",
                    wcet, period, deadline, release);
+            if(wcet == 0 || wcet > period ||
+               wcet * 100 > period * MAX_HRT_UTIL) {
+                // could never be scheduled
+                return MON_ERR_RSRC_ILL_MANIFEST;
+            }
+            if(rd >= 4 && type == 'H' && deadline < wcet) {
+                return MON_ERR_RSRC_ILL_MANIFEST;
+            }
+
             rp->gang_scheduling = (type == 'G') ? true : false;
             rp->task_type = TASK_TYPE_HARD_REALTIME;
             rp->wcet = wcet;
             rp->period = period;
-            if(rd >= 4) {
+            if(rp->gang_scheduling) {
+                // No laxity: the slice has to start on release, which the
+                // kernel scheduler guarantees for such tasks
+                rp->deadline = wcet;
+            } else if(rd >= 4) {
                 rp->deadline = deadline;
             } else {
                 rp->deadline = period;
@@ -307,22 +327,110 @@ errval_t rsrc_submit_manifest(rsrcid_t id, char *manifest)
     return SYS_ERR_OK;
 }
 
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while(b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * \brief Returns the local release time of a gang scheduled phase
+ *
+ * All members of a gang release their slices on a common grid of period
+ * boundaries, starting at 'start' (the system time is synchronized across
+ * cores). A member that activates the phase after 'start' has passed, e.g.
+ * because the phase change message was delayed, joins at the next slice on
+ * the grid, so that its slices stay aligned with those on the other cores.
+ *
+ * Gang slices run as soon as they are released, so the phase is refused if
+ * its slices would overlap those of another gang on this core, or if the
+ * hard real-time phases active here would use more than #MAX_HRT_UTIL.
+ */
+static errval_t gang_release(struct rsrc_domain *d, struct rsrc_phase *p,
+                             uint64_t start, uint64_t *ret_release)
+{
+    uint64_t now;
+#if defined(__x86_64__) || defined(__i386__)
+    errval_t err = sys_debug_timeslice_counter_read(&now);
+    assert(err_is_ok(err));
+#else
+    now = 0;
+#endif
+
+    uint64_t release = start;
+    if(start <= now) {
+        release = start + ((now - start) / p->period + 1) * p->period;
+    }
+
+    uint64_t util = p->wcet * 100 / p->period;
+    for(coreid_t c = 0; c < MAX_CPUS; c++) {
+        for(int i = 0; i < MAX_RSRC_DOMAINS; i++) {
+            struct rsrc_domain *o = &domain[c][i];
+            if(o == d || !o->active || !o->phase_set) {
+                continue;
+            }
+            struct rsrc_phase *op = &o->phase[o->active_phase];
+            if(op->task_type != TASK_TYPE_HARD_REALTIME) {
+                continue;
+            }
+            util += op->wcet * 100 / op->period;
+
+            if(op->gang_scheduling) {
+                // slices start at o->release + k * op->period and release +
+                // j * p->period, so their offsets are multiples of the gcd
+                uint64_t g = gcd(op->period, p->period);
+                uint64_t off = release >= o->release
+                    ? (release - o->release) % g
+                    : (g - (o->release - release) % g) % g;
+                if(off < op->wcet || g - off < p->wcet) {
+                    return MON_ERR_RSRC_NOT_ADMISSIBLE;
+                }
+            }
+        }
+    }
+    if(util > MAX_HRT_UTIL) {
+        return MON_ERR_RSRC_NOT_ADMISSIBLE;
+    }
+
+    *ret_release = release;
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief Activates a resource phase locally
  */
-static void activate_phase(rsrcid_t id, struct rsrc_domain *d, uintptr_t phase,
-                           uint64_t timestamp)
+static errval_t activate_phase(rsrcid_t id, struct rsrc_domain *d,
+                               uintptr_t phase, uint64_t timestamp)
 {
     errval_t err;
     struct rsrc_phase *p = &d->phase[phase];
 
-    d->active_phase = phase;
     assert(p->active);
 
+    uint64_t release = p->release + timestamp;
+    if(p->gang_scheduling) {
+        err = gang_release(d, p, release, &release);
+        if(err_is_fail(err)) {
+            return err;
+        }
+    }
+
     // Set phase parameters
     err = invoke_dispatcher_properties(d->disp, p->task_type, p->deadline, p->wcet,
-                                       p->period, p->release + timestamp, p->weight);
-    assert(err_is_ok(err));
+                                       p->period, release, p->weight,
+                                       p->gang_scheduling);
+    if(err_is_fail(err)) {
+        return err;
+    }
+
+    d->active_phase = phase;
+    d->phase_set = true;
+    d->release = release;
+    return SYS_ERR_OK;
 }
 
 struct rsrc_phase_state {
@@ -378,7 +486,10 @@ errval_t rsrc_set_phase_inter(rsrcid_t id, uintptr_t phase, uint64_t timestamp)
         return MON_ERR_RSRC_NOT_FOUND;
     }
 
-    activate_phase(id, d, phase, timestamp);
+    errval_t err = activate_phase(id, d, phase, timestamp);
+    if(err_is_fail(err)) {
+        return err;
+    }
 
     // Done if satellite
     if(!coordinator(id)) {
@@ -412,7 +523,7 @@ errval_t rsrc_set_phase(rsrcid_t id, uintptr_t phase)
 #endif
 
         // Coordinator: Change the phase globally
-        rsrc_set_phase_inter(id, phase, now);
+        return rsrc_set_phase_inter(id, phase, now);
     } else {
         assert(!"no");
 #if 0
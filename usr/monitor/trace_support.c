@@ -53,11 +53,10 @@ static void trace_monitor_measure_time(coreid_t origin_core)
 
 	if(my_core_id == 0) {
 
-	    dispatcher_handle_t handle = curdispatcher();
-	    struct dispatcher_generic *disp = get_dispatcher_generic(handle);
-	    struct trace_buffer *trace_buf = disp->trace_buf;
+	    struct trace_core *core = trace_get_core(
+	            (struct trace_buffer *)trace_buffer_master, my_core_id);
 
-	    trace_buf->t_offset = 0;
+	    core->t_offset = 0;
 
 	    // Notify next core
 	    trace_intermon_notify_next_core(origin_core);
@@ -163,11 +162,10 @@ static void trace_intermon_measure_ack_recv(struct intermon_binding* ib, coreid_
     // Network Time Protocol formula
     int64_t offset = (((t1-t0)+(t2-t3))/2);
 
-	dispatcher_handle_t handle = curdispatcher();
-	struct dispatcher_generic *disp = get_dispatcher_generic(handle);
-	struct trace_buffer *trace_buf = disp->trace_buf;
+	struct trace_core *core = trace_get_core(
+	        (struct trace_buffer *)trace_buffer_master, my_core_id);
 
-	trace_buf->t_offset = offset;
+	core->t_offset = offset;
 
 	// Notify next core
 	trace_intermon_notify_next_core(origin_core);
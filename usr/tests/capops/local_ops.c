@@ -0,0 +1,150 @@
+/**
+ * \file
+ * \brief Test that revokes and deletes of caps that never left this core
+ *        complete without a cross core agreement
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <barrelfish/barrelfish.h>
+#include <if/monitor_blocking_defs.h>
+
+#define NDESCS 4
+
+// adapted from usr/monitor/capops/internal.h
+#define GOTO_IF_ERR(err, label) do { \
+    if (err_is_fail(err)) { \
+        printf("...fail: %s\n", err_getstring(err)); \
+        result = 1; \
+        goto label; \
+    } \
+} while (0)
+
+struct capops_stats {
+    uint64_t revoke_local, revoke_distributed;
+    uint64_t delete_local, delete_distributed;
+};
+
+static errval_t get_stats(struct capops_stats *s)
+{
+    struct monitor_blocking_binding *mb = get_monitor_blocking_binding();
+    assert(mb != NULL);
+    return mb->rpc_tx_vtbl.get_capops_stats(mb, &s->revoke_local,
+                                            &s->revoke_distributed,
+                                            &s->delete_local,
+                                            &s->delete_distributed);
+}
+
+static void print_stats(const char *prefix, struct capops_stats *s)
+{
+    printf("%s: revoke local %"PRIu64" distributed %"PRIu64
+           ", delete local %"PRIu64" distributed %"PRIu64"\n", prefix,
+           s->revoke_local, s->revoke_distributed,
+           s->delete_local, s->delete_distributed);
+}
+
+//{{{1 revoke of a cap with local descendants
+static int test_revoke_local(void)
+{
+    int result = 0;
+    errval_t err;
+    struct capops_stats before, after;
+    struct capref ram, descs[NDESCS];
+
+    err = ram_alloc(&ram, BASE_PAGE_BITS + 2);
+    assert(err_is_ok(err));
+    for (int i = 0; i < NDESCS; i++) {
+        err = slot_alloc(&descs[i]);
+        assert(err_is_ok(err));
+        err = cap_retype(descs[i], ram, i * BASE_PAGE_SIZE, ObjType_RAM,
+                         BASE_PAGE_SIZE, 1);
+        GOTO_IF_ERR(err, out);
+    }
+
+    err = get_stats(&before);
+    GOTO_IF_ERR(err, out);
+    err = cap_revoke(ram);
+    GOTO_IF_ERR(err, out);
+    err = get_stats(&after);
+    GOTO_IF_ERR(err, out);
+    print_stats("before", &before);
+    print_stats("after", &after);
+
+    if (after.revoke_local == before.revoke_local) {
+        printf("...fail: revoke was not handled locally\n");
+        result = 1;
+        goto out;
+    }
+    // revoke must have deleted the descendants
+    struct capability cap;
+    for (int i = 0; i < NDESCS; i++) {
+        err = cap_direct_identify(descs[i], &cap);
+        if (err_is_ok(err) && cap.type != ObjType_Null) {
+            printf("...fail: descendant %d survived revoke\n", i);
+            result = 1;
+            goto out;
+        }
+    }
+    printf("...ok: revoke handled locally\n");
+
+out:
+    for (int i = 0; i < NDESCS; i++) {
+        slot_free(descs[i]);
+    }
+    cap_destroy(ram);
+    return result;
+}
+
+//{{{1 delete of the last copy of a cnode
+static int test_delete_local(void)
+{
+    int result = 0;
+    errval_t err;
+    struct capops_stats before, after;
+    struct capref cn;
+
+    err = cnode_create_l2(&cn, NULL);
+    assert(err_is_ok(err));
+
+    err = get_stats(&before);
+    GOTO_IF_ERR(err, out);
+    // a cnode's last copy is always deleted through the monitor
+    err = cap_destroy(cn);
+    GOTO_IF_ERR(err, out);
+    err = get_stats(&after);
+    GOTO_IF_ERR(err, out);
+    print_stats("before", &before);
+    print_stats("after", &after);
+
+    if (after.delete_local == before.delete_local) {
+        printf("...fail: delete was not handled locally\n");
+        result = 1;
+        goto out;
+    }
+    printf("...ok: delete handled locally\n");
+
+out:
+    return result;
+}
+
+//{{{1 main
+int main(int argc, char *argv[])
+{
+    int result = 0;
+    printf("0: Revoke of cap with local descendants\n");
+    result |= test_revoke_local() << 0;
+    printf("1: Delete of last copy of cnode\n");
+    result |= test_delete_local() << 1;
+
+    printf("capops_local: result: %x\n", result);
+
+    return result;
+}
@@ -382,6 +382,96 @@ out:
     return result;
 }
 
+//{{{1 test_retype_slots
+static int test_retype_slots(void)
+{
+    errval_t err;
+    int result = 0;
+    struct frame_identity fi;
+    struct capref caps[40], copies[40];
+    const size_t ncaps = sizeof(caps) / sizeof(caps[0]);
+    bool have_caps = false;
+
+    for (size_t i = 0; i < ncaps; i++) {
+        err = slot_alloc(&copies[i]);
+        assert(err_is_ok(err));
+    }
+
+    setup(LARGE_PAGE_SIZE);
+
+    /* slots from the default allocator may span several CNodes */
+    OUT("  retype 40 4kB frames at offset 8kB into allocated slots: ");
+    err = cap_retype_alloc(caps, ncaps, bunch_o_ram, 2*BASE_PAGE_SIZE,
+            ObjType_Frame, BASE_PAGE_SIZE);
+    GOTO_IF_ERR(err, out);
+    have_caps = true;
+    for (size_t i = 0; i < ncaps; i++) {
+        err = frame_ram_identify(caps[i], &fi);
+        assert(err_is_ok(err));
+        if (bor_id.base + (2+i)*BASE_PAGE_SIZE != fi.base ||
+            fi.bytes != BASE_PAGE_SIZE)
+        {
+            char buf[16];
+            snprintf(buf, 16, "cap %zu: ", i);
+            print_unexpected(buf, bor_id.base + (2+i)*BASE_PAGE_SIZE,
+                    "4kB", fi.base, fi.bytes);
+            result = 1;
+            goto out;
+        }
+    }
+    OUT("...ok\n");
+
+    OUT("  copy all 40 frames: ");
+    err = cap_copy_slots(copies, caps, ncaps);
+    GOTO_IF_ERR(err, out);
+    for (size_t i = 0; i < ncaps; i++) {
+        err = frame_ram_identify(copies[i], &fi);
+        assert(err_is_ok(err));
+        if (bor_id.base + (2+i)*BASE_PAGE_SIZE != fi.base) {
+            print_unexpected("", bor_id.base + (2+i)*BASE_PAGE_SIZE,
+                    "4kB", fi.base, fi.bytes);
+            result = 1;
+            goto out;
+        }
+    }
+    for (size_t i = 0; i < ncaps; i++) {
+        err = cap_delete(copies[i]);
+        assert(err_is_ok(err));
+    }
+    OUT("...ok\n");
+
+    /* the first two pages are free, the next two overlap the frames above */
+    OUT("  partially overlapping retype creates nothing: ");
+    err = cap_retype_slots(copies, 4, bunch_o_ram, 0, ObjType_Frame,
+            BASE_PAGE_SIZE);
+    if (err_no(err) != SYS_ERR_REVOKE_FIRST) {
+        OUT("...fail: %s\n", err_getstring(err));
+        result = 1;
+        goto out;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        struct capability thecap;
+        err = cap_direct_identify(copies[i], &thecap);
+        if (err_is_ok(err) && thecap.type != ObjType_Null) {
+            OUT("...fail: slot %zu not empty\n", i);
+            result = 1;
+            goto out;
+        }
+    }
+    OUT("...ok: retype fails with '%s'\n", err_getstring(SYS_ERR_REVOKE_FIRST));
+
+out:
+    /* this also cleans up any descendants of bunch_o_ram */
+    cleanup();
+    for (size_t i = 0; i < ncaps; i++) {
+        if (have_caps) {
+            slot_free(caps[i]);
+        }
+        slot_free(copies[i]);
+    }
+    return result;
+}
+
 //{{{1 main
 int main(int argc, char *argv[])
 {
@@ -397,6 +487,8 @@ int main(int argc, char *argv[])
     result |= test_retype_overlap() << 2;
     OUT("3: Non-aligned retype test\n");
     result |= test_non_aligned() << 3;
+    OUT("4: Retype and copy into many slots\n");
+    result |= test_retype_slots() << 4;
 
     printf("retype: result: %x\n", result);
 
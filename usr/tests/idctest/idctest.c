@@ -20,8 +20,38 @@
 #include <barrelfish/deferred.h>
 #include <if/test_defs.h>
 
+#ifdef CONFIG_FLOUNDER_STATS
+#include <flounder/flounder_stats.h>
+#endif
+
 static const char *my_service_name = "idctest";
 
+#ifdef CONFIG_FLOUNDER_STATS
+/// Latency within which the messages of this test are sent and handled
+#define MAX_LATENCY_NS  (100UL * 1000 * 1000)
+
+/// Messages of the test, in the order the client sends them
+static const int test_msgnums[] = {
+    test_basic__msgnum, test_str__msgnum, test_one_cap__msgnum,
+    test_caps__msgnum, test_buf__msgnum,
+};
+
+/// Check that the latencies of count messages were recorded and are sane
+static void check_latencies(uint64_t count, systime_t time,
+                            const uint32_t *hist)
+{
+    uint64_t recorded = 0;
+    for (int i = 0; i < FLOUNDER_STATS_BUCKETS; i++) {
+        recorded += hist[i];
+    }
+    assert(recorded == count);
+    assert(count == 0 || time > 0);
+    assert(count == 0 || time / count <= ns_to_systime(MAX_LATENCY_NS));
+    assert(flounder_stats_percentile(hist, 100) <=
+           ns_to_systime(MAX_LATENCY_NS));
+}
+#endif
+
 static const char *longstr = ""
   "Far out in the uncharted backwaters of the unfashionable end of the\n"
   "western spiral arm of the Galaxy lies a small unregarded yellow sun.\n"
@@ -60,6 +90,10 @@ static const char *longstr = ""
 
 static const char *shortstr = "Hello, world!";
 
+/// Test adaptive polling: the server's receive endpoint parks while idle
+static bool adaptive = false;
+static struct test_binding *server_binding;
+
 /* ------------------------ COMMON MESSAGE HANDLERS ------------------------ */
 
 static void rx_basic(struct test_binding *b, uint32_t arg)
@@ -107,6 +141,21 @@ static void rx_caps(struct test_binding *b, uint32_t arg,
 static void rx_buf(struct test_binding *b, const uint8_t *buf, size_t buflen)
 {
     debug_printf("rx_buf (%zu bytes)\n", buflen);
+    assert(buflen == strlen(longstr));
+    assert(memcmp(buf, longstr, buflen) == 0);
+
+#ifdef CONFIG_FLOUNDER_STATS
+    // The server received every message type as often as the client sends
+    // it. This message is only recorded once its handler returns.
+    assert(b->stats != NULL);
+    const uint64_t expect[] = { 1, 3, 1, 1, 0 };
+    for (int i = 0; i < sizeof(test_msgnums) / sizeof(test_msgnums[0]);
+         i++) {
+        struct flounder_msg_stats *m = &b->stats->msgs[test_msgnums[i]];
+        assert(m->rx_count == expect[i]);
+        check_latencies(m->rx_count, m->rx_time, m->rx_hist);
+    }
+#endif
 }
 
 static struct test_rx_vtbl rx_vtbl = {
@@ -193,6 +242,23 @@ static void send_cont(void *arg)
         break;
 
     case 7:
+#ifdef CONFIG_FLOUNDER_STATS
+        // every message type was sent exactly as often as above
+        assert(b->stats != NULL);
+        assert(b->stats->msgs[test_basic__msgnum].tx_count == 1);
+        assert(b->stats->msgs[test_str__msgnum].tx_count == 3);
+        assert(b->stats->msgs[test_one_cap__msgnum].tx_count == 1);
+        assert(b->stats->msgs[test_caps__msgnum].tx_count == 1);
+        assert(b->stats->msgs[test_buf__msgnum].tx_count == 1);
+        // internal messages, e.g. of binding, have no send latency
+        for (int i = 0; i < sizeof(test_msgnums) / sizeof(test_msgnums[0]);
+             i++) {
+            struct flounder_msg_stats *m = &b->stats->msgs[test_msgnums[i]];
+            check_latencies(m->tx_count, m->tx_time, m->tx_hist);
+        }
+        flounder_stats_dump();
+#endif
+
         // here is where we would deallocate the buffer, if it wasn't static
         // client all done is the message determined to terminate the test,
         // wait a bit to give the server time to print the message.
@@ -248,6 +314,11 @@ static void bind_cb(void *st, errval_t err, struct test_binding *b)
     myst->binding = b;
     b->st = myst;
 
+    if (adaptive) {
+        // stay quiet long enough for the server's endpoint to park
+        barrelfish_usleep(1000000);
+    }
+
     // start sending stuff to the service
     send_cont(myst);
 }
@@ -264,6 +335,7 @@ static void start_client(void)
     }
 
     debug_printf("client binding to %"PRIuIREF"...\n", iref);
+    // the default UMP ring gets a side channel, so rx_buf sees a bulk transfer
     err = test_bind(iref, bind_cb, NULL /* state pointer for bind_cb */,
                     get_default_waitset(), IDC_BIND_FLAGS_DEFAULT);
     if (err_is_fail(err)) {
@@ -295,10 +367,31 @@ static errval_t connect_cb(void *st, struct test_binding *b)
     // copy my message receive handler vtable to the binding
     b->rx_vtbl = rx_vtbl;
 
+    if (adaptive) {
+        errval_t err = b->control(b, IDC_CONTROL_SET_ADAPTIVE);
+        assert(err_is_ok(err));
+        server_binding = b;
+    }
+
     // accept the connection (we could return an error to refuse it)
     return SYS_ERR_OK;
 }
 
+/**
+ * Do other work, without waiting on the waitset, until the idle endpoint of
+ * the client's binding parks or a message arrives. The messages the client
+ * sends afterwards must still be received.
+ */
+static void server_wait_parked(struct waitset *ws)
+{
+    while (ws->nparked == 0 && ws->pending == NULL) {
+        thread_yield();
+    }
+    if (ws->nparked > 0) {
+        debug_printf("server endpoint parked\n");
+    }
+}
+
 static void start_server(void)
 {
     errval_t err;
@@ -317,16 +410,33 @@ int main(int argc, char *argv[])
 {
     errval_t err;
 
-    if (argc == 2 && strcmp(argv[1], "client") == 0) {
+    if (argc == 3 && strcmp(argv[2], "adaptive") == 0) {
+        adaptive = true;
+    } else if (argc != 2) {
+        debug_printf("Usage: %s client|server [adaptive]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "client") == 0) {
         start_client();
-    } else if (argc == 2 && strcmp(argv[1], "server") == 0) {
+    } else if (strcmp(argv[1], "server") == 0) {
         start_server();
     } else {
-        debug_printf("Usage: %s client|server\n", argv[0]);
+        debug_printf("Usage: %s client|server [adaptive]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
     struct waitset *ws = get_default_waitset();
+    if (adaptive && strcmp(argv[1], "server") == 0) {
+        while (server_binding == NULL) {
+            err = event_dispatch(ws);
+            if (err_is_fail(err)) {
+                USER_PANIC_ERR(err, "in event_dispatch");
+            }
+        }
+        server_wait_parked(ws);
+    }
+
     while (1) {
         err = event_dispatch(ws);
         if (err_is_fail(err)) {
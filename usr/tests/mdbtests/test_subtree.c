@@ -0,0 +1,114 @@
+/**
+ * \file
+ * \brief Test mdb_traverse_subtree() and node memory of the B-tree mdb.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/types.h>
+#include <barrelfish/cap_predicates.h>
+#include <mdb/mdb.h>
+#include <mdb/mdb_tree.h>
+
+#define FRAME_COUNT 64
+#define FRAME_BITS  12
+#define RAM_BASE    0x100000UL
+#define RAM_BYTES   (FRAME_COUNT << FRAME_BITS)
+
+static struct cte before, ram, after;
+static struct cte frames[FRAME_COUNT];
+static struct cte *visited[FRAME_COUNT + 1];
+static size_t nvisited;
+
+static char node_memory[64 * 1024];
+
+static void init_cap(struct cte *cte, enum objtype type, genpaddr_t base,
+                     gensize_t bytes)
+{
+    memset(cte, 0, sizeof(*cte));
+    cte->cap.type = type;
+    cte->cap.rights = CAPRIGHTS_ALLRIGHTS;
+    if (type == ObjType_RAM) {
+        cte->cap.u.ram.base = base;
+        cte->cap.u.ram.bytes = bytes;
+    } else {
+        cte->cap.u.frame.base = base;
+        cte->cap.u.frame.bytes = bytes;
+    }
+    errval_t err = mdb_insert(cte);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "mdb_insert");
+    }
+}
+
+static errval_t visit(struct cte *cte, void *data)
+{
+    if (nvisited == FRAME_COUNT + 1) {
+        return SYS_ERR_SLOTS_INVALID;
+    }
+    visited[nvisited++] = cte;
+    return SYS_ERR_OK;
+}
+
+static bool check(enum mdb_tree_traversal_order order)
+{
+    nvisited = 0;
+    errval_t err = mdb_traverse_subtree(&ram, order, visit, NULL);
+    if (err_is_fail(err)) {
+        printf("traversal failed: %s\n", err_getstring(err));
+        return false;
+    }
+    if (nvisited != FRAME_COUNT + 1) {
+        printf("visited %zu ctes instead of %d\n", nvisited, FRAME_COUNT + 1);
+        return false;
+    }
+
+    // the ram cap first, then the frames by address
+    bool asc = order == MDB_TRAVERSAL_ORDER_ASCENDING;
+    for (size_t i = 0; i < nvisited; i++) {
+        struct cte *expected = i == 0 ? &ram : &frames[i - 1];
+        if (visited[asc ? i : nvisited - 1 - i] != expected) {
+            printf("%s traversal: wrong cte at %zu\n",
+                   asc ? "ascending" : "descending", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    // the test builds the tree from this memory only
+    errval_t err = mdb_add_memory((lvaddr_t)node_memory, sizeof(node_memory));
+    assert(err_is_ok(err));
+
+    init_cap(&before, ObjType_RAM, 0, RAM_BASE);
+    init_cap(&after, ObjType_RAM, RAM_BASE + RAM_BYTES, RAM_BASE);
+    init_cap(&ram, ObjType_RAM, RAM_BASE, RAM_BYTES);
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        init_cap(&frames[i], ObjType_Frame, RAM_BASE + (i << FRAME_BITS),
+                 1UL << FRAME_BITS);
+    }
+
+    if (!check(MDB_TRAVERSAL_ORDER_ASCENDING) ||
+        !check(MDB_TRAVERSAL_ORDER_DESCENDING)) {
+        mdb_dump_all_the_things();
+        printf("mdbtest_subtree failed\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("mdbtest_subtree passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/**
+ * \file
+ * \brief Tests for returning RAM caps to the memory server in batches
+ *
+ * The memory server must only take back RAM that the client cannot reach
+ * any more: copies of a returned cap are revoked, and a cap that was
+ * retyped from a larger cap the client kept is refused.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+
+#define NPAGES      16
+#define PARENT_BITS 16      ///< 64K
+
+static int failures;
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("memtest_ram_batch: %s:%d: check failed: %s\n",          \
+                   __FILE__, __LINE__, #cond);                              \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+/// Allocate pages in one batch and give them all back
+static void test_batch(void)
+{
+    struct capref caps[NPAGES];
+    uint8_t bits[NPAGES];
+    errval_t err;
+
+    memset(bits, BASE_PAGE_BITS, sizeof(bits));
+    err = ram_alloc_batch(caps, bits, NPAGES);
+    CHECK(err_is_ok(err));
+    if (err_is_fail(err)) {
+        return;
+    }
+
+    for (int i = 0; i < NPAGES; i++) {
+        struct capability info;
+        err = debug_cap_identify(caps[i], &info);
+        CHECK(err_is_ok(err));
+        CHECK(info.type == ObjType_RAM);
+        CHECK(info.u.ram.bytes == BASE_PAGE_SIZE);
+    }
+
+    err = ram_free_batch(caps, NPAGES);
+    CHECK(err_is_ok(err));
+}
+
+/// A copy of a returned cap must be gone afterwards
+static void test_copy_revoked(void)
+{
+    struct capref ram, copy;
+    errval_t err;
+
+    err = ram_alloc(&ram, BASE_PAGE_BITS);
+    CHECK(err_is_ok(err));
+    err = slot_alloc(&copy);
+    CHECK(err_is_ok(err));
+    err = cap_copy(copy, ram);
+    CHECK(err_is_ok(err));
+
+    err = ram_free_batch(&ram, 1);
+    CHECK(err_is_ok(err));
+
+    struct capability info;
+    err = debug_cap_identify(copy, &info);
+    CHECK(err_is_fail(err) || info.type == ObjType_Null);
+    cap_destroy(copy);
+}
+
+/// RAM retyped from a cap the client keeps must not be taken back
+static void test_retyped_refused(void)
+{
+    struct capref parent, child;
+    errval_t err;
+
+    err = ram_alloc(&parent, PARENT_BITS);
+    CHECK(err_is_ok(err));
+    if (err_is_fail(err)) {
+        return;
+    }
+
+    struct capability pinfo;
+    err = debug_cap_identify(parent, &pinfo);
+    CHECK(err_is_ok(err));
+
+    err = slot_alloc(&child);
+    CHECK(err_is_ok(err));
+    err = cap_retype(child, parent, 0, ObjType_RAM, pinfo.u.ram.bytes, 1);
+    CHECK(err_is_ok(err));
+
+    err = ram_free_batch(&child, 1);
+    CHECK(err_no(err) == LIB_ERR_RAM_FREE_SHARED);
+
+    // the parent itself has no ancestors and is taken back
+    err = ram_free_batch(&parent, 1);
+    CHECK(err_is_ok(err));
+}
+
+int main(int argc, char *argv[])
+{
+    test_batch();
+    test_copy_revoked();
+    test_retyped_refused();
+
+    if (failures == 0) {
+        printf("memtest_ram_batch: passed\n");
+    } else {
+        printf("memtest_ram_batch: failed, %d errors\n", failures);
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
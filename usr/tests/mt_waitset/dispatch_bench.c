@@ -0,0 +1,136 @@
+/**
+ * \file
+ * \brief Waitset event dispatch cost vs. number of registered channels
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/waitset.h>
+#include <barrelfish/ump_endpoint.h>
+#include <bench/bench.h>
+
+#define MAX_CHANNELS    1024
+#define READY_CHANNELS  16
+#define ROUNDS          100
+#define RING_MSGS       2
+
+/*
+ * Every channel is a polled UMP endpoint on a local ring, so each poll of
+ * the waitset walks all registered channels, as with real UMP bindings.
+ */
+static struct waitset ws;
+static struct ump_endpoint eps[MAX_CHANNELS];
+static struct ump_chan_state senders[MAX_CHANNELS];
+static struct ump_message bufs[MAX_CHANNELS][RING_MSGS];
+static uint64_t handled;
+
+static void event_handler(void *arg)
+{
+    struct ump_endpoint *ep = arg;
+    volatile struct ump_message *msg;
+
+    errval_t err = ump_endpoint_recv(ep, &msg);
+    assert(err_is_ok(err));
+    ump_impl_free_message(msg);
+    handled++;
+
+    // events are one-shot; re-register for the next round
+    err = ump_endpoint_register(ep, &ws, MKCLOSURE(event_handler, ep));
+    assert(err_is_ok(err));
+}
+
+static void send_ready(int nchans)
+{
+    // spread the ready channels over the whole set
+    for (int i = 0; i < READY_CHANNELS; i++) {
+        struct ump_control ctrl;
+        volatile struct ump_message *msg;
+
+        msg = ump_impl_get_next(&senders[(i * nchans) / READY_CHANNELS], &ctrl);
+        assert(msg != NULL);
+        ump_impl_release_barrier();
+        msg->header.control = ctrl;
+    }
+}
+
+static void poll_channels(void)
+{
+    dispatcher_handle_t handle = disp_disable();
+    poll_channels_disabled(handle);
+    disp_enable(handle);
+}
+
+static void run(int nchans)
+{
+    errval_t err;
+    cycles_t single = 0, bulk = 0;
+
+    waitset_init(&ws);
+    for (int i = 0; i < nchans; i++) {
+        err = ump_endpoint_init(&eps[i], bufs[i], sizeof(bufs[i]));
+        assert(err_is_ok(err));
+        err = ump_chan_state_init(&senders[i], bufs[i], sizeof(bufs[i]),
+                                  UMP_OUTGOING);
+        assert(err_is_ok(err));
+        err = ump_endpoint_register(&eps[i], &ws,
+                                    MKCLOSURE(event_handler, &eps[i]));
+        assert(err_is_ok(err));
+    }
+
+    for (int r = 0; r < ROUNDS; r++) {
+        // one poll of all channels per event
+        send_ready(nchans);
+        cycles_t t0 = bench_tsc();
+        for (int i = 0; i < READY_CHANNELS; i++) {
+            err = event_dispatch_non_block(&ws);
+            assert(err_is_ok(err));
+        }
+        single += bench_tsc() - t0 - bench_tscoverhead();
+
+        // one poll for the first event, one more for the rest of the run
+        send_ready(nchans);
+        t0 = bench_tsc();
+        size_t count = 0;
+        while (count < READY_CHANNELS) {
+            size_t n;
+            poll_channels();
+            err = event_dispatch_bulk(&ws, READY_CHANNELS - count, &n);
+            assert(err_is_ok(err));
+            count += n;
+        }
+        bulk += bench_tsc() - t0 - bench_tscoverhead();
+    }
+
+    printf("channels %4d: event_dispatch_non_block %"PRIuCYCLES" cycles/event, "
+           "event_dispatch_bulk %"PRIuCYCLES" cycles/event\n", nchans,
+           single / (ROUNDS * READY_CHANNELS), bulk / (ROUNDS * READY_CHANNELS));
+
+    for (int i = 0; i < nchans; i++) {
+        ump_endpoint_destroy(&eps[i]);
+    }
+    err = waitset_destroy(&ws);
+    assert(err_is_ok(err));
+}
+
+int main(int argc, char *argv[])
+{
+    bench_init();
+
+    for (int n = READY_CHANNELS; n <= MAX_CHANNELS; n *= 2) {
+        run(n);
+    }
+
+    printf("dispatch_bench done, %"PRIu64" events handled\n", handled);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/**
+ * \file
+ * \brief Waitset priority classes: starvation bound and priority changes
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/waitset.h>
+#include <barrelfish/waitset_chan.h>
+
+#define CHANS_PER_CLASS 4
+#define WEIGHT          4
+#define DISPATCHES      10000
+
+/// Longest run of higher-class events a pending class may see
+#define BYPASS_BOUND    (WEIGHT + WS_PRIO_COUNT - 2)
+
+static struct waitset ws;
+static struct waitset_chanstate chans[WS_PRIO_COUNT][CHANS_PER_CLASS];
+
+static uint64_t dispatched[WS_PRIO_COUNT];
+static uint32_t run[WS_PRIO_COUNT];     ///< Higher-class events since last own
+static uint32_t maxrun[WS_PRIO_COUNT];
+static bool retrigger;
+static int order[3], norder;
+static bool failed;
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);  \
+            failed = true;                                                  \
+        }                                                                   \
+    } while (0)
+
+static void handler(void *arg)
+{
+    struct waitset_chanstate *chan = arg;
+    enum ws_priority prio = chan->priority;
+
+    dispatched[prio]++;
+    run[prio] = 0;
+    for (int c = 0; c < prio; c++) {
+        if (++run[c] > maxrun[c]) {
+            maxrun[c] = run[c];
+        }
+    }
+
+    if (retrigger) {
+        // every class stays backlogged
+        errval_t err = waitset_chan_trigger_closure(&ws, chan,
+                                        MKCLOSURE(handler, chan));
+        assert(err_is_ok(err));
+    } else if (norder < 3) {
+        order[norder++] = (chan - &chans[0][0]);
+    }
+}
+
+static void trigger(struct waitset_chanstate *chan, enum ws_priority prio)
+{
+    waitset_chanstate_set_priority(chan, prio);
+    errval_t err = waitset_chan_trigger_closure(&ws, chan,
+                                                MKCLOSURE(handler, chan));
+    assert(err_is_ok(err));
+}
+
+/// All classes backlogged: lower classes are bypassed at most BYPASS_BOUND times
+static void test_starvation(void)
+{
+    waitset_init(&ws);
+    waitset_set_policy(&ws, WS_POLICY_WEIGHTED, WEIGHT);
+    retrigger = true;
+
+    for (int p = 0; p < WS_PRIO_COUNT; p++) {
+        for (int i = 0; i < CHANS_PER_CLASS; i++) {
+            waitset_chanstate_init(&chans[p][i], CHANTYPE_OTHER);
+            trigger(&chans[p][i], p);
+        }
+    }
+
+    for (int i = 0; i < DISPATCHES; i++) {
+        errval_t err = event_dispatch_non_block(&ws);
+        assert(err_is_ok(err));
+    }
+
+    for (int p = 0; p < WS_PRIO_COUNT; p++) {
+        printf("class %d: %" PRIu64 " events, longest bypass %" PRIu32
+               ", starved %" PRIu64 "\n", p, dispatched[p], maxrun[p],
+               waitset_get_starved(&ws, p));
+        CHECK(dispatched[p] > 0);
+        CHECK(maxrun[p] <= BYPASS_BOUND);
+    }
+
+    // each class is always pending, so every higher-class event starves it
+    CHECK(waitset_get_starved(&ws, WS_PRIO_HIGH) == 0);
+    CHECK(waitset_get_starved(&ws, WS_PRIO_NORMAL)
+          == dispatched[WS_PRIO_HIGH]);
+    CHECK(waitset_get_starved(&ws, WS_PRIO_LOW)
+          == dispatched[WS_PRIO_HIGH] + dispatched[WS_PRIO_NORMAL]);
+
+    // drain the waitset
+    retrigger = false;
+    norder = 3;
+    while (event_dispatch_non_block(&ws) == SYS_ERR_OK);
+    errval_t err = waitset_destroy(&ws);
+    assert(err_is_ok(err));
+}
+
+/// A priority change of a pending channel keeps the pending queue sorted
+static void test_reprioritise(void)
+{
+    struct waitset_chanstate *a = &chans[0][0], *b = &chans[0][1],
+                             *c = &chans[0][2];
+
+    waitset_init(&ws);
+    retrigger = false;
+    norder = 0;
+
+    for (int i = 0; i < 3; i++) {
+        waitset_chanstate_init(&chans[0][i], CHANTYPE_OTHER);
+    }
+    trigger(a, WS_PRIO_LOW);
+    trigger(b, WS_PRIO_LOW);
+    trigger(c, WS_PRIO_NORMAL);
+
+    // b overtakes c, a stays last
+    waitset_chanstate_set_priority(b, WS_PRIO_HIGH);
+
+    while (event_dispatch_non_block(&ws) == SYS_ERR_OK);
+
+    printf("dispatch order: %d %d %d\n", order[0], order[1], order[2]);
+    CHECK(norder == 3);
+    CHECK(order[0] == 1 && order[1] == 2 && order[2] == 0);
+
+    errval_t err = waitset_destroy(&ws);
+    assert(err_is_ok(err));
+}
+
+int main(int argc, char *argv[])
+{
+    test_starvation();
+    test_reprioritise();
+
+    printf("Test %s\n", failed ? "FAILED" : "PASSED");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+/**
+ * \file
+ * \brief test that a batched unmap may unmap the page holding the batch
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/except.h>
+#include <barrelfish_kpi/vnode_batch.h>
+
+// Defined in lib/barrelfish/arch/x86_64/pmap.c
+errval_t get_ptable(struct pmap_x86 *pmap, genvaddr_t base,
+                    struct vnode **ptable);
+
+#define EX_STACK_SIZE 16384
+static char ex_stack[EX_STACK_SIZE];
+static char *ex_stack_top = ex_stack + EX_STACK_SIZE;
+
+static volatile uint8_t *other_page;
+
+static void exhandler(enum exception_type type, int subtype, void *vaddr,
+        arch_registers_state_t *regs)
+{
+    if (vaddr == other_page) {
+        printf("nkmtest_batch_unmap: SUCCESS\n");
+        exit(0);
+    }
+    printf("nkmtest_batch_unmap: FAILURE: unexpected fault on %p\n", vaddr);
+    exit(1);
+}
+
+/// Map a fresh page and fill in an unmap batch entry for it
+static void *map_page(struct pmap_x86 *x86, struct vnode_unmap_batch_entry *e)
+{
+    errval_t err;
+
+    struct capref frame;
+    size_t rb;
+    err = frame_alloc(&frame, BASE_PAGE_SIZE, &rb);
+    assert(err_is_ok(err));
+
+    void *va;
+    err = vspace_map_one_frame(&va, BASE_PAGE_SIZE, frame, NULL, NULL);
+    assert(err_is_ok(err));
+
+    struct vnode *ptable = NULL;
+    err = get_ptable(x86, (genvaddr_t)va, &ptable);
+    assert(err_is_ok(err));
+
+    struct pmap_mapping_info info;
+    err = x86->p.f.lookup(&x86->p, (genvaddr_t)va, &info);
+    assert(err_is_ok(err));
+
+    struct capref pt = ptable->v.u.vnode.invokable;
+    e->ptable        = get_cap_addr(pt);
+    e->ptable_level  = get_cap_level(pt);
+    e->mapping       = get_cap_addr(info.mapping);
+    e->mapping_level = get_cap_level(info.mapping);
+
+    return va;
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+    struct pmap_x86 *x86 = (struct pmap_x86 *)get_current_pmap();
+
+    /* the batch lives in a page that its first entry unmaps */
+    struct vnode_unmap_batch_entry entries[2];
+    struct vnode_unmap_batch_entry *batch = map_page(x86, &entries[0]);
+    other_page = map_page(x86, &entries[1]);
+    *other_page = 1;
+    batch[0] = entries[0];
+    batch[1] = entries[1];
+
+    size_t done = 0;
+    err = invoke_vnode_unmap_batch(x86->root.v.u.vnode.invokable, batch, 2,
+                                   &done);
+    if (err_is_fail(err) || done != 2) {
+        printf("nkmtest_batch_unmap: FAILURE: got %s, %zu entries done\n",
+               err_getcode(err), done);
+        return 1;
+    }
+
+    /* both pages are gone now, touching the second one must fault */
+    err = thread_set_exception_handler(exhandler, NULL, ex_stack, ex_stack_top,
+                                       NULL, NULL);
+    assert(err_is_ok(err));
+    *other_page = 2;
+
+    printf("nkmtest_batch_unmap: FAILURE: second page still mapped\n");
+    return 1;
+}
@@ -15,6 +15,17 @@
 
 #include <numa.h>
 
+/// Node whose memory contains an address, or NUMA_NODE_INVALID
+static nodeid_t node_of(lpaddr_t addr)
+{
+    for (nodeid_t node = 0; node <= numa_max_node(); node++) {
+        lpaddr_t base = numa_node_base(node);
+        if (addr >= base && addr < base + numa_node_size(node, NULL)) {
+            return node;
+        }
+    }
+    return (nodeid_t)NUMA_NODE_INVALID;
+}
 
 int main (void)
 {
@@ -33,6 +44,64 @@ int main (void)
         debug_printf("normal alloc test\n");
         buf = numa_alloc(1024*1024, 4096);
 
+        debug_printf("per-node RAM test\n");
+        int nodes_with_memory = 0;
+        for (nodeid_t node = 0; node <= numa_max_node(); node++) {
+            uintptr_t free_before, free_after;
+            size_t size = numa_node_size(node, &free_before);
+            if (free_before < LARGE_PAGE_SIZE) {
+                debug_printf("node %u: not enough free memory, skipped\n", node);
+                continue;
+            }
+            nodes_with_memory++;
+
+            struct capref frame;
+            size_t ret_size;
+            errval_t err = numa_frame_alloc_on_node(&frame, LARGE_PAGE_SIZE,
+                                                    node, &ret_size);
+            assert(err_is_ok(err));
+            assert(ret_size >= LARGE_PAGE_SIZE);
+
+            struct frame_identity id;
+            err = frame_identify(frame, &id);
+            assert(err_is_ok(err));
+            assert(node_of(id.base) == node);
+            assert(node_of(id.base + id.bytes - 1) == node);
+
+            numa_node_size(node, &free_after);
+            debug_printf("node %u: %zu MB, %" PRIuPTR " MB free, %" PRIuPTR
+                         " MB after alloc\n", node, size >> 20,
+                         free_before >> 20, free_after >> 20);
+            assert(free_after < free_before);
+
+            numa_frame_free(frame);
+        }
+
+        debug_printf("interleaved RAM test\n");
+        struct capref caps[4];
+        errval_t err = ram_alloc_interleaved(caps, LARGE_PAGE_BITS + 2,
+                                             LARGE_PAGE_BITS, ~0ULL);
+        assert(err_is_ok(err));
+        nodeid_t nodes[4];
+        for (int i = 0; i < 4; i++) {
+            struct capability info;
+            err = debug_cap_identify(caps[i], &info);
+            assert(err_is_ok(err));
+            assert(info.type == ObjType_RAM);
+            assert(info.u.ram.bytes == LARGE_PAGE_SIZE);
+            nodes[i] = node_of(info.u.ram.base);
+            debug_printf("chunk %d at 0x%" PRIxGENPADDR ", node %u\n", i,
+                         info.u.ram.base, nodes[i]);
+            cap_destroy(caps[i]);
+        }
+        if (nodes_with_memory > 1) {
+            // consecutive chunks come from different nodes
+            for (int i = 1; i < 4; i++) {
+                assert(nodes[i] != nodes[i - 1]);
+            }
+        }
+
+        debug_printf("numa test passed\n");
     } else {
         debug_printf("numa not available\n");
     }
@@ -71,6 +71,44 @@ static void get_names(void)
     printf("get_names() done!\n");
 }
 
+static void get_many_records(void)
+{
+    errval_t err = SYS_ERR_OK;
+    char** names = NULL;
+    size_t size = 0;
+
+    err = oct_get_names(&names, &size, "r'^object.*'");
+    ASSERT_ERR_OK(err);
+    assert(size == 4);
+
+    // the same records as with one oct_get() each
+    char* records[4];
+    err = oct_get_records(records, names, size);
+    ASSERT_ERR_OK(err);
+    for (size_t i = 0; i < size; i++) {
+        char* data = NULL;
+        err = oct_get(&data, names[i]);
+        ASSERT_ERR_OK(err);
+        ASSERT_STRING(records[i], data);
+        free(data);
+        free(records[i]);
+    }
+
+    // a missing record fails, the others are still returned
+    char* queries[] = { names[0], "recordDoesNotExist", names[1] };
+    err = oct_get_records(records, queries, 3);
+    ASSERT_ERR(err, OCT_ERR_NO_RECORD);
+    assert(records[0] != NULL);
+    assert(records[1] == NULL);
+    assert(records[2] != NULL);
+    free(records[0]);
+    free(records[2]);
+
+    oct_free_names(names, size);
+
+    printf("get_many_records() done!\n");
+}
+
 static void get_records(void)
 {
     errval_t err = SYS_ERR_OK;
@@ -253,6 +291,7 @@ int main(int argc, char *argv[])
     exist_records();
     get_records();
     get_names();
+    get_many_records();
     regex_name();
 
     printf("d2getset SUCCESS!\n");
@@ -1,8 +1,13 @@
 #include <stdio.h>
 #include <barrelfish/barrelfish.h>
+#include <barrelfish/systime.h>
 
 #define DEBUG_TEST 0
 
+// Number and size of the mappings used to measure footprint and latency
+#define BENCH_MAPPINGS 512
+#define BENCH_MAPPING_SIZE (16 * BASE_PAGE_SIZE)
+
 static void test_lookup(struct capref expected_cap, genvaddr_t addr, size_t offset){
     addr += offset;
     errval_t err;
@@ -29,6 +34,81 @@ static void test_lookup(struct capref expected_cap, genvaddr_t addr, size_t offs
     assert(mi.offset + (addr - mi.vaddr) == offset);
 }
 
+static size_t pmap_footprint(struct pmap *pmap)
+{
+    struct pmap_res_info res;
+    if (pmap->f.measure_res == NULL) {
+        return 0;
+    }
+    errval_t err = pmap->f.measure_res(pmap, &res);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "pmap measure_res");
+    }
+    return res.vnode_used;
+}
+
+/**
+ * \brief Map a number of small frames, and report the pmap metadata they use
+ * and the average lookup latency over all their pages. This is used to
+ * compare the different pmap datastructures.
+ */
+static void bench_lookup(void)
+{
+    errval_t err;
+    struct pmap *my_pmap = get_current_pmap();
+    static struct capref frames[BENCH_MAPPINGS];
+    static void *vas[BENCH_MAPPINGS];
+
+    size_t before = pmap_footprint(my_pmap);
+
+    for (int i = 0; i < BENCH_MAPPINGS; i++) {
+        size_t retsize;
+        err = frame_alloc(&frames[i], BENCH_MAPPING_SIZE, &retsize);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "frame_alloc");
+        }
+        err = vspace_map_one_frame(&vas[i], BENCH_MAPPING_SIZE, frames[i],
+                                   NULL, NULL);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "vspace_map_one_frame");
+        }
+    }
+
+    size_t after = pmap_footprint(my_pmap);
+
+    size_t lookups = 0;
+    systime_t start = systime_now();
+    for (int i = 0; i < BENCH_MAPPINGS; i++) {
+        for (size_t off = 0; off < BENCH_MAPPING_SIZE; off += BASE_PAGE_SIZE) {
+            struct pmap_mapping_info mi;
+            err = my_pmap->f.lookup(my_pmap, (genvaddr_t)vas[i] + off, &mi);
+            if (err_is_fail(err)) {
+                USER_PANIC_ERR(err, "pmap lookup");
+            }
+            assert(capcmp(mi.cap, frames[i]));
+            lookups++;
+        }
+    }
+    systime_t end = systime_now();
+
+    printf("pmaplookup: %d mappings of %zu bytes use %zu bytes of pmap "
+           "metadata\n", BENCH_MAPPINGS, (size_t)BENCH_MAPPING_SIZE,
+           after - before);
+    printf("pmaplookup: %zu lookups, %"PRIu64" ns per lookup\n", lookups,
+           systime_to_ns(end - start) / lookups);
+
+    for (int i = 0; i < BENCH_MAPPINGS; i++) {
+        err = vspace_unmap(vas[i]);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "vspace_unmap");
+        }
+        err = cap_destroy(frames[i]);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "cap_destroy");
+        }
+    }
+}
+
 int main(void){
     printf("Hello world from pmap_test\n");
     
@@ -73,6 +153,8 @@ int main(void){
         test_lookup(frame, (uintptr_t)va, off);
     }
 
+    bench_lookup();
+
     printf("pmaplookuptest passed successfully!\n");
     return 0;
 }
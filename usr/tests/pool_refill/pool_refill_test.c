@@ -0,0 +1,286 @@
+/**
+ * \file
+ * \brief Tests for the watermark-driven refill of allocator pools
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/pool_refill.h>
+#include <barrelfish/frame_cache.h>
+
+#define LOW         4
+#define HIGH        16
+#define MAP_PAGES   2048
+#define ROOT_SLOTS  (2 * L2_CNODE_SLOTS)
+#define CACHE_FRAMES (4 * HIGH)
+
+static int failures;
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("pool_refill_test: %s:%d: check failed: %s\n",           \
+                   __FILE__, __LINE__, #cond);                              \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+/// A pool of plain counters
+struct test_pool {
+    struct pool_refill refill;
+    size_t free;
+    size_t calls;               ///< Calls of the refill function
+    bool reenter;               ///< Refill function checks the pool again
+    struct thread_sem *started; ///< Posted when a refill starts, if set
+    struct thread_sem *resume;  ///< Waited on before a refill ends, if set
+};
+
+static size_t test_level(void *st)
+{
+    struct test_pool *tp = st;
+    return tp->free;
+}
+
+static errval_t test_refill(void *st, size_t target)
+{
+    struct test_pool *tp = st;
+    tp->calls++;
+    if (tp->reenter) {
+        // a refill that allocates from its own pool must not recurse
+        tp->free = 0;
+        pool_refill_check(&tp->refill);
+    }
+    if (tp->started != NULL) {
+        thread_sem_post(tp->started);
+        thread_sem_wait(tp->resume);
+    }
+    tp->free = target;
+    return SYS_ERR_OK;
+}
+
+static void test_pool_init(struct test_pool *tp)
+{
+    memset(tp, 0, sizeof(*tp));
+    pool_refill_init(&tp->refill, "test", test_level, test_refill, tp,
+                     LOW, HIGH);
+}
+
+/// Without a waitset, the check refills right away, up to the high watermark
+static void test_watermarks(void)
+{
+    struct test_pool tp;
+    test_pool_init(&tp);
+
+    tp.free = LOW;
+    pool_refill_check(&tp.refill);
+    CHECK(tp.calls == 0);
+
+    tp.free = LOW - 1;
+    pool_refill_check(&tp.refill);
+    CHECK(tp.calls == 1);
+    CHECK(tp.free == HIGH);
+    CHECK(tp.refill.refills == 1);
+
+    tp.reenter = true;
+    tp.free = 0;
+    pool_refill_check(&tp.refill);
+    CHECK(tp.calls == 2);
+    CHECK(tp.free == HIGH);
+}
+
+static int refill_thread(void *arg)
+{
+    struct test_pool *tp = arg;
+    return err_is_ok(pool_refill_now(&tp->refill)) ? 0 : 1;
+}
+
+/// With a waitset, the check only queues the refill, and the event runs it
+static void test_deferred(void)
+{
+    struct test_pool tp;
+    struct waitset ws;
+    test_pool_init(&tp);
+    waitset_init(&ws);
+    pool_refill_set_waitset(&tp.refill, &ws);
+
+    tp.free = LOW - 1;
+    pool_refill_check(&tp.refill);
+    pool_refill_check(&tp.refill);
+    CHECK(tp.calls == 0);
+    CHECK(tp.refill.kicks == 1);
+
+    errval_t err = event_dispatch_non_block(&ws);
+    CHECK(err_is_ok(err));
+    CHECK(tp.calls == 1);
+    CHECK(tp.free == HIGH);
+
+    // a pool refilled by other means before the event runs is left alone
+    tp.free = LOW - 1;
+    pool_refill_check(&tp.refill);
+    tp.free = LOW;
+    err = event_dispatch_non_block(&ws);
+    CHECK(err_is_ok(err));
+    CHECK(tp.calls == 1);
+    CHECK(tp.refill.kicks == 2);
+
+    err = waitset_destroy(&ws);
+    CHECK(err_is_ok(err));
+}
+
+/// Run the deferred pmap and root cnode refills queued on the default waitset
+static void run_deferred_refills(void)
+{
+    while (err_is_ok(event_dispatch_non_block(get_default_waitset()))) {
+    }
+}
+
+/// Only one thread refills a pool at a time
+static void test_concurrent(void)
+{
+    struct test_pool tp;
+    struct thread_sem started, resume;
+    test_pool_init(&tp);
+    thread_sem_init(&started, 0);
+    thread_sem_init(&resume, 0);
+    tp.started = &started;
+    tp.resume = &resume;
+
+    struct thread *t = thread_create(refill_thread, &tp);
+    assert(t != NULL);
+    thread_sem_wait(&started);
+
+    // the other thread is in the middle of its refill
+    tp.free = 0;
+    pool_refill_check(&tp.refill);
+    CHECK(tp.calls == 1);
+
+    thread_sem_post(&resume);
+    int retval;
+    errval_t err = thread_join(t, &retval);
+    CHECK(err_is_ok(err) && retval == 0);
+    CHECK(tp.free == HIGH);
+    CHECK(tp.refill.refills == 1);
+}
+
+/// Enough mappings to run the pmap's slabs through several deferred refills
+static void test_pmap_slabs(void)
+{
+    for (int i = 0; i < MAP_PAGES; i++) {
+        struct capref frame;
+        errval_t err = frame_alloc(&frame, BASE_PAGE_SIZE, NULL);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "frame_alloc");
+            failures++;
+            return;
+        }
+        volatile uint64_t *p;
+        err = vspace_map_one_frame((void **)&p, BASE_PAGE_SIZE, frame,
+                                   NULL, NULL);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "vspace_map_one_frame");
+            failures++;
+            return;
+        }
+        *p = i;
+        CHECK(*p == i);
+        run_deferred_refills();
+    }
+}
+
+/// Enough root cnode slots to resize the root cnode
+static void test_root_slots(void)
+{
+    for (int i = 0; i < ROOT_SLOTS; i++) {
+        struct capref slot;
+        errval_t err = slot_alloc_root(&slot);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "slot_alloc_root");
+            failures++;
+            return;
+        }
+        err = cap_copy(slot, cap_vroot);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "cap_copy");
+            failures++;
+            return;
+        }
+        run_deferred_refills();
+    }
+}
+
+/// Frames come out of the cache zeroed and of the right size
+static void test_frame_cache(void)
+{
+    struct frame_cache fc;
+    errval_t err = frame_cache_init(&fc, BASE_PAGE_SIZE, LOW, HIGH);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "frame_cache_init");
+        failures++;
+        return;
+    }
+    frame_cache_set_waitset(&fc, get_default_waitset());
+    run_deferred_refills();
+    CHECK(fc.count == HIGH);
+
+    for (int i = 0; i < CACHE_FRAMES; i++) {
+        struct capref frame;
+        err = frame_cache_alloc(&fc, &frame);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "frame_cache_alloc");
+            failures++;
+            break;
+        }
+
+        struct frame_identity id;
+        err = frame_identify(frame, &id);
+        CHECK(err_is_ok(err) && id.bytes == BASE_PAGE_SIZE);
+
+        uint64_t *p;
+        err = vspace_map_one_frame((void **)&p, BASE_PAGE_SIZE, frame,
+                                   NULL, NULL);
+        if (err_is_ok(err)) {
+            CHECK(p[0] == 0 && p[BASE_PAGE_SIZE / sizeof(*p) - 1] == 0);
+            vspace_unmap(p);
+        } else {
+            DEBUG_ERR(err, "vspace_map_one_frame");
+            failures++;
+        }
+        cap_destroy(frame);
+
+        run_deferred_refills();
+    }
+
+    // with the refills run between allocations, the ring never ran dry
+    CHECK(fc.hits == CACHE_FRAMES);
+    CHECK(fc.refill.failures == 0);
+
+    err = frame_cache_destroy(&fc);
+    CHECK(err_is_ok(err));
+}
+
+int main(int argc, char *argv[])
+{
+    test_watermarks();
+    test_deferred();
+    test_concurrent();
+    test_pmap_slabs();
+    test_root_slots();
+    test_frame_cache();
+
+    if (failures == 0) {
+        printf("pool_refill_test: passed\n");
+    } else {
+        printf("pool_refill_test: %d failures\n", failures);
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
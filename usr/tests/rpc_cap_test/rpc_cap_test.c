@@ -23,6 +23,7 @@
 static const char *my_service_name = "rpc_cap_test";
 uint8_t is_server = 0x0;
 int client_id = 0;
+static idc_bind_flags_t bind_flags = IDC_BIND_FLAGS_DEFAULT;
 
 __attribute__((format(printf, 1, 2)))
 static void my_debug_printf(const char *fmt, ...)
@@ -55,16 +56,109 @@ static void my_debug_printf(const char *fmt, ...)
 
 
 
-struct echo_response {
-    struct test_rpc_cap_binding *b;
-    uint32_t response;
+/// Echo calls with this bit set are answered late, newest first
+#define ECHO_DEFER      (1U << 31)
+/// Number of deferred echo calls the server collects before answering
+#define DEFER_CALLS     8
+
+/// A response that could not be sent yet, as the binding was busy
+struct pending_response {
+    struct pending_response *next;
+    enum { RESP_ECHO, RESP_SEND_CAP_ONE, RESP_SEND_CAP_TWO } type;
+    uint32_t token;     ///< Token of the call
+    uint32_t arg;
+    errval_t err;
+};
+
+/// Per-client state of the server
+struct server_state {
+    struct pending_response *head;  ///< Oldest response not sent yet
+    struct pending_response *tail;  ///< Newest response not sent yet
+    struct pending_response *deferred;  ///< Deferred echo calls, newest first
+    int ndeferred;                      ///< Number of deferred echo calls
 };
 
-static void send_echo_response(void *arg){
-    struct echo_response * resp = arg;
+static errval_t tx_response(struct test_rpc_cap_binding *b,
+                            struct pending_response *resp)
+{
+    switch (resp->type) {
+    case RESP_ECHO:
+        return test_rpc_cap_echo__reply(b, resp->token, NOP_CONT, resp->arg);
+    case RESP_SEND_CAP_ONE:
+        return test_rpc_cap_send_cap_one__reply(b, resp->token, NOP_CONT,
+                                                resp->err);
+    case RESP_SEND_CAP_TWO:
+        return test_rpc_cap_send_cap_two__reply(b, resp->token, NOP_CONT,
+                                                resp->err);
+    }
+    return SYS_ERR_OK;
+}
+
+static void send_pending_responses(void *arg)
+{
+    struct test_rpc_cap_binding *b = arg;
+    struct server_state *ss = b->st;
     errval_t err;
-    err = test_rpc_cap_echo_response__tx(resp->b, NOP_CONT, resp->response);
-    assert(err_is_ok(err));
+
+    while (ss->head != NULL) {
+        err = tx_response(b, ss->head);
+        if (err_no(err) == FLOUNDER_ERR_TX_BUSY) {
+            err = b->register_send(b, get_default_waitset(),
+                                   MKCONT(send_pending_responses, b));
+            assert(err_is_ok(err));
+            return;
+        }
+        assert(err_is_ok(err));
+
+        struct pending_response *resp = ss->head;
+        ss->head = resp->next;
+        if (ss->head == NULL) {
+            ss->tail = NULL;
+        }
+        free(resp);
+    }
+}
+
+/// Make the response of the call being handled
+static struct pending_response *new_response(struct test_rpc_cap_binding *b,
+                                             int type, uint32_t arg,
+                                             errval_t msgerr)
+{
+    struct pending_response *resp = malloc(sizeof(*resp));
+    assert(resp != NULL);
+    resp->next = NULL;
+    resp->type = type;
+    // only valid while the call handler runs
+    resp->token = test_rpc_cap_rpc_call_token(b);
+    resp->arg = arg;
+    resp->err = msgerr;
+    return resp;
+}
+
+/// Send a response, or queue it behind earlier ones if the binding is busy
+static void queue_response(struct test_rpc_cap_binding *b,
+                           struct pending_response *resp)
+{
+    struct server_state *ss = b->st;
+    resp->next = NULL;
+
+    bool idle = (ss->head == NULL);
+    if (ss->tail == NULL) {
+        ss->head = resp;
+    } else {
+        ss->tail->next = resp;
+    }
+    ss->tail = resp;
+
+    if (idle) {
+        send_pending_responses(b);
+    }
+}
+
+static void send_response(struct test_rpc_cap_binding *b, int type,
+                          uint32_t arg, errval_t msgerr)
+{
+    queue_response(b, new_response(b, type, arg, msgerr));
 }
 
 
@@ -72,10 +166,26 @@ static void handle_echo_call(struct test_rpc_cap_binding *b,
         uint32_t arg_in)
 {
     my_debug_printf("handle_echo_call (bind=%p) arg=%"PRIu32"\n", b, arg_in);
-    struct echo_response * resp = malloc(sizeof(*resp));
-    resp->b = b;
-    resp->response = arg_in;
-    send_echo_response(resp);
+    struct pending_response *resp = new_response(b, RESP_ECHO, arg_in,
+                                                 SYS_ERR_OK);
+    if (!(arg_in & ECHO_DEFER)) {
+        queue_response(b, resp);
+        return;
+    }
+
+    // hold the call until enough are collected, then answer newest first
+    struct server_state *ss = b->st;
+    resp->next = ss->deferred;
+    ss->deferred = resp;
+    if (++ss->ndeferred < DEFER_CALLS) {
+        return;
+    }
+    while (ss->deferred != NULL) {
+        resp = ss->deferred;
+        ss->deferred = resp->next;
+        queue_response(b, resp);
+    }
+    ss->ndeferred = 0;
 }
 
 
@@ -87,7 +197,7 @@ static void handle_send_cap_one_call(struct test_rpc_cap_binding *b,
     struct capability cap;
     err = debug_cap_identify(incap, &cap );
 
-    test_rpc_cap_send_cap_one_response__tx(b, NOP_CONT, err);
+    send_response(b, RESP_SEND_CAP_ONE, 0, err);
 }
 
 static void handle_send_cap_two_call(struct test_rpc_cap_binding *b,
@@ -102,7 +212,7 @@ static void handle_send_cap_two_call(struct test_rpc_cap_binding *b,
     err = debug_cap_identify(incap2, &cap);
     assert(err_is_ok(err));
 
-    test_rpc_cap_send_cap_two_response__tx(b, NOP_CONT, err);
+    send_response(b, RESP_SEND_CAP_TWO, 0, err);
 }
 
 static struct test_rpc_cap_rx_vtbl rx_vtbl = {
@@ -176,6 +286,145 @@ static void client_call_test_3(int i){
     }
 }
 
+#define PIPELINE_DEPTH  16
+#define PIPELINE_CALLS  100
+
+static int pipeline_done;
+
+static void client_echo_done(struct test_rpc_cap_binding *b, void *st,
+                             uint32_t arg_out)
+{
+    uint32_t expected = (uintptr_t)st;
+    if (arg_out != expected) {
+        USER_PANIC("Wrong result of pipelined call %"PRIu32": %"PRIu32"\n",
+                   expected, arg_out);
+    }
+    // the server answers in order
+    assert(expected == pipeline_done);
+    pipeline_done++;
+}
+
+static void client_call_test_4(void){
+    errval_t err;
+
+    err = test_rpc_cap_rpc_pipeline_init(test_rpc_binding, PIPELINE_DEPTH);
+    assert(err_is_ok(err));
+
+    for (uint32_t i = 0; i < PIPELINE_CALLS; i++) {
+        // keep the pipeline full, but no fuller
+        err = flounder_rpc_pipeline_wait(test_rpc_binding->waitset,
+                                         test_rpc_binding->rpc_pipeline,
+                                         PIPELINE_DEPTH - 1);
+        assert(err_is_ok(err));
+
+        err = test_rpc_cap_echo__rpc_async(test_rpc_binding, client_echo_done,
+                                           (void *)(uintptr_t)i, i);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "Error in pipelined rpc call (4)\n");
+        }
+    }
+
+    err = flounder_rpc_pipeline_wait(test_rpc_binding->waitset,
+                                     test_rpc_binding->rpc_pipeline, 0);
+    assert(err_is_ok(err));
+    assert(pipeline_done == PIPELINE_CALLS);
+    my_debug_printf("client_call_test_4 successful!\n");
+}
+
+static int caps_done;
+
+static void client_cap_done(struct test_rpc_cap_binding *b, void *st,
+                            errval_t error_code)
+{
+    if (err_is_fail(error_code)) {
+        USER_PANIC_ERR(error_code, "Server msg (5)\n");
+    }
+    caps_done++;
+}
+
+/*
+ * Keep more calls in flight than a small message ring holds, with caps among
+ * them, so that the server receives caps while its replies fill the ring.
+ */
+static void client_call_test_5(void){
+    errval_t err;
+    int pipeline_sent = 0;
+    int caps_sent = 0;
+
+    pipeline_done = 0;
+    for (uint32_t i = 0; i < PIPELINE_CALLS; i++) {
+        err = flounder_rpc_pipeline_wait(test_rpc_binding->waitset,
+                                         test_rpc_binding->rpc_pipeline,
+                                         PIPELINE_DEPTH - 1);
+        assert(err_is_ok(err));
+
+        if (i % 4 == 3) {
+            struct capref frame;
+            err = frame_alloc(&frame, BASE_PAGE_SIZE, NULL);
+            assert(err_is_ok(err));
+            err = test_rpc_cap_send_cap_one__rpc_async(test_rpc_binding,
+                                                       client_cap_done, NULL,
+                                                       frame);
+            caps_sent++;
+        } else {
+            err = test_rpc_cap_echo__rpc_async(test_rpc_binding,
+                                               client_echo_done,
+                                               (void *)(uintptr_t)pipeline_sent,
+                                               pipeline_sent);
+            pipeline_sent++;
+        }
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "Error in pipelined rpc call (5)\n");
+        }
+    }
+
+    err = flounder_rpc_pipeline_wait(test_rpc_binding->waitset,
+                                     test_rpc_binding->rpc_pipeline, 0);
+    assert(err_is_ok(err));
+    assert(pipeline_done == pipeline_sent);
+    assert(caps_done == caps_sent);
+    my_debug_printf("client_call_test_5 successful!\n");
+}
+
+static int deferred_done;
+
+static void client_deferred_done(struct test_rpc_cap_binding *b, void *st,
+                                 uint32_t arg_out)
+{
+    uint32_t i = (uintptr_t)st;
+    if (arg_out != (i | ECHO_DEFER)) {
+        USER_PANIC("Wrong result of deferred call %"PRIu32": %"PRIu32"\n",
+                   i, arg_out);
+    }
+    // the server answers deferred calls newest first
+    assert(i == DEFER_CALLS - 1 - deferred_done);
+    deferred_done++;
+}
+
+/*
+ * Have the server answer calls after their handlers returned, and out of
+ * order, so that only the tokens it saved match the responses to the calls.
+ */
+static void client_call_test_6(void){
+    errval_t err;
+
+    for (uint32_t i = 0; i < DEFER_CALLS; i++) {
+        err = test_rpc_cap_echo__rpc_async(test_rpc_binding,
+                                           client_deferred_done,
+                                           (void *)(uintptr_t)i,
+                                           i | ECHO_DEFER);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "Error in pipelined rpc call (6)\n");
+        }
+    }
+
+    err = flounder_rpc_pipeline_wait(test_rpc_binding->waitset,
+                                     test_rpc_binding->rpc_pipeline, 0);
+    assert(err_is_ok(err));
+    assert(deferred_done == DEFER_CALLS);
+    my_debug_printf("client_call_test_6 successful!\n");
+}
+
 static void bind_cb(void *st,
                     errval_t err,
                     struct test_rpc_cap_binding *b)
@@ -194,6 +443,10 @@ static void bind_cb(void *st,
     for(int i=0; i<100;i++){
         client_call_test_3(i);
     }
+    // this takes over the response handlers, so it comes last
+    client_call_test_4();
+    client_call_test_5();
+    client_call_test_6();
     printf("TEST PASSED\n");
 }
 
@@ -211,7 +464,7 @@ static void start_client(void)
     my_debug_printf("client: binding to %"PRIuIREF"...\n", iref);
     err = test_rpc_cap_bind(iref, bind_cb, NULL ,
                                  get_default_waitset(),
-                                 IDC_BIND_FLAGS_DEFAULT);
+                                 bind_flags);
     if (err_is_fail(err)) {
         USER_PANIC_ERR(err, "bind failed");
     }
@@ -245,6 +498,9 @@ static errval_t connect_cb(void *st,
     // copy my message receive handler vtable to the binding
     b->rx_vtbl = rx_vtbl;
 
+    b->st = calloc(1, sizeof(struct server_state));
+    assert(b->st != NULL);
+
     // accept the connection (we could return an error to refuse it)
     return SYS_ERR_OK;
 }
@@ -270,7 +526,7 @@ static void start_server(void)
 /* ------------------------------ MAIN ------------------------------ */
 
 static int usage(char * argv[]){
-    printf("Usage: %s client|server [id=INT]\n", argv[0]);
+    printf("Usage: %s client|server [id=INT] [smallbuf]\n", argv[0]);
     return EXIT_FAILURE;
 }
 
@@ -283,6 +539,8 @@ int main(int argc,
         for(int i = 2; i < argc; i++){
             if(strncmp(argv[i], "id=", strlen("id=")) == 0){
                 client_id = atoi(argv[i] + 3);
+            } else if (strcmp(argv[i], "smallbuf") == 0) {
+                bind_flags |= IDC_BIND_FLAG_UMP_SMALL_BUF;
             } else {
                 printf("Unknonw argument: %s\n", argv[i]);
                 return usage(argv);
@@ -0,0 +1,223 @@
+/**
+ * \file
+ * \brief Test that an idle core sleeps without its periodic tick
+ *
+ * Sleeps repeatedly for several timeslices, and checks with the kernel
+ * wakeup statistics that the core went idle without a tick, skipped ticks,
+ * and woke us up on time.
+ *
+ * Given the kernel's wakeup_slack in microseconds as argument, it then runs
+ * three sleepers on this core whose deadlines lie within the slack of each
+ * other, and checks that coalescing never delays a wakeup by more than the
+ * slack, and that the sleepers wake up in the order of their deadlines.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/deferred.h>
+#include <barrelfish/sys_debug.h>
+#include <barrelfish/spawn_client.h>
+#include <bench/bench.h>
+
+#define ITERATIONS  10
+#define SLEEP_US    (500 * 1000)
+
+/// Time for the other sleepers to start before the first deadline
+#define START_US    (1000 * 1000)
+/// Timer and scheduling latency tolerated on top of the slack
+#define LATENCY_US  (10 * 1000)
+
+/// Sleep until the TSC reaches deadline, returns the TSC on wakeup
+static cycles_t sleep_until(cycles_t deadline)
+{
+    cycles_t now = bench_tsc();
+    if (now < deadline) {
+        errval_t err = barrelfish_usleep(bench_tsc_to_us(deadline - now));
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "barrelfish_usleep");
+        }
+    }
+    return bench_tsc();
+}
+
+/// Check that a sleeper woke up no earlier than its deadline and no later
+/// than the slack allows
+static int check_wakeup(const char *name, cycles_t deadline, cycles_t woke,
+                        uint64_t slack_us)
+{
+    if (woke < deadline) {
+        printf("...fail: %s woken up %"PRIu64" us early\n", name,
+               bench_tsc_to_us(deadline - woke));
+        return 1;
+    }
+    uint64_t late_us = bench_tsc_to_us(woke - deadline);
+    printf("tickless: %s woke up %"PRIu64" us late\n", name, late_us);
+    if (late_us > slack_us + LATENCY_US) {
+        printf("...fail: %s delayed beyond the slack of %"PRIu64" us\n",
+               name, slack_us);
+        return 1;
+    }
+    return 0;
+}
+
+/// A sleeper started by coalesce_test()
+static int sleeper(cycles_t deadline, uint64_t slack_us)
+{
+    bench_init();
+    cycles_t woke = sleep_until(deadline);
+    return check_wakeup("sleeper", deadline, woke, slack_us);
+}
+
+static errval_t spawn_sleeper(const char *path, cycles_t deadline,
+                              uint64_t slack_us, struct capref *ret_domain)
+{
+    char deadline_str[32], slack_str[32];
+    snprintf(deadline_str, sizeof(deadline_str), "%"PRIu64, (uint64_t)deadline);
+    snprintf(slack_str, sizeof(slack_str), "%"PRIu64, slack_us);
+    char *argv[] = { (char *)path, "sleeper", deadline_str, slack_str, NULL };
+
+    return spawn_program(disp_get_core_id(), path, argv, NULL, 0, ret_domain);
+}
+
+/**
+ * Sleepers A, B and C with deadlines at 0, 3/4 and 3/2 of the slack. B and C
+ * are queued first, and too far apart to be coalesced. A is then close
+ * enough to B to fire with it, but must not be pushed on to C, which is
+ * further than the slack from A's deadline.
+ */
+static int coalesce_test(const char *path, uint64_t slack_us)
+{
+    errval_t err;
+    struct wakeup_stats before, after;
+    struct capref domain_b, domain_c;
+    int result = 0;
+
+    uint64_t tsc_per_us = bench_tsc_per_us();
+    cycles_t deadline_a = bench_tsc() + START_US * tsc_per_us;
+    cycles_t deadline_b = deadline_a + slack_us * 3 / 4 * tsc_per_us;
+    cycles_t deadline_c = deadline_a + slack_us * 3 / 2 * tsc_per_us;
+
+    // Queue B before C, so that they are not coalesced
+    err = spawn_sleeper(path, deadline_b, slack_us, &domain_b);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "spawning sleeper B");
+    }
+    sleep_until(deadline_a - START_US / 2 * tsc_per_us);
+    err = spawn_sleeper(path, deadline_c, slack_us, &domain_c);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "spawning sleeper C");
+    }
+    sleep_until(deadline_a - slack_us / 2 * tsc_per_us);
+
+    err = sys_debug_get_wakeup_stats(&before);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "sys_debug_get_wakeup_stats");
+    }
+    cycles_t woke_a = sleep_until(deadline_a);
+    err = sys_debug_get_wakeup_stats(&after);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "sys_debug_get_wakeup_stats");
+    }
+
+    result |= check_wakeup("sleeper A", deadline_a, woke_a, slack_us);
+    if (woke_a >= deadline_c) {
+        printf("...fail: sleeper A woken up after sleeper C was due\n");
+        result = 1;
+    }
+    if (after.coalesced == before.coalesced) {
+        printf("...fail: wakeup of sleeper A not coalesced\n");
+        result = 1;
+    }
+
+    struct capref domains[] = { domain_b, domain_c };
+    for (int i = 0; i < 2; i++) {
+        uint8_t exitcode;
+        err = spawn_wait(domains[i], &exitcode, false);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "spawn_wait");
+        }
+        if (exitcode != 0) {
+            printf("...fail: sleeper %c failed\n", 'B' + i);
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+    struct wakeup_stats before, after;
+    int result = 0;
+
+    if (argc == 4 && strcmp(argv[1], "sleeper") == 0) {
+        return sleeper(strtoull(argv[2], NULL, 10),
+                       strtoull(argv[3], NULL, 10));
+    }
+
+    bench_init();
+
+    err = sys_debug_get_wakeup_stats(&before);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "sys_debug_get_wakeup_stats");
+    }
+
+    uint64_t max_late_ms = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        cycles_t start = bench_tsc();
+        err = barrelfish_usleep(SLEEP_US);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "barrelfish_usleep");
+        }
+        uint64_t slept_ms = bench_tsc_to_ms(bench_tsc() - start);
+        if (slept_ms < SLEEP_US / 1000) {
+            printf("...fail: woken up early after %"PRIu64" ms\n", slept_ms);
+            result = 1;
+        } else {
+            max_late_ms = MAX(max_late_ms, slept_ms - SLEEP_US / 1000);
+        }
+    }
+
+    err = sys_debug_get_wakeup_stats(&after);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "sys_debug_get_wakeup_stats");
+    }
+
+    printf("tickless: set %"PRIu64" coalesced %"PRIu64" fired %"PRIu64
+           " checks %"PRIu64" idle %"PRIu64" skipped %"PRIu64
+           " max late %"PRIu64" ms\n",
+           after.set - before.set, after.coalesced - before.coalesced,
+           after.fired - before.fired, after.checks - before.checks,
+           after.idle_entries - before.idle_entries,
+           after.ticks_skipped - before.ticks_skipped, max_late_ms);
+
+    if (after.fired - before.fired < ITERATIONS) {
+        printf("...fail: not woken up by the kernel\n");
+        result = 1;
+    }
+    if (after.idle_entries == before.idle_entries ||
+        after.ticks_skipped == before.ticks_skipped) {
+        printf("...fail: core did not idle without a tick\n");
+        result = 1;
+    }
+
+    if (argc > 1) {
+        result |= coalesce_test(argv[0], strtoull(argv[1], NULL, 10));
+    }
+
+    printf("tickless: result: %x\n", result);
+    return result;
+}
@@ -0,0 +1,179 @@
+/**
+ * \file
+ * \brief Stream the trace to the host while the system runs
+ *
+ * Periodically drains the trace rings of all cores, and writes the binary
+ * trace stream either to a file, or base64 encoded to the console. Decode
+ * the stream on the host with tools/tracing/trace2json.py.
+ */
+
+/*
+ * Copyright (c) 2018, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <barrelfish/barrelfish.h>
+#include <barrelfish/deferred.h>
+#include <trace/trace.h>
+#include <vfs/vfs.h>
+
+/// Prefix of console lines carrying the stream
+#define CONSOLE_PREFIX      "TRACESTREAM "
+
+/// Stream bytes per console line, 76 characters once encoded
+#define CONSOLE_LINE_BYTES  57
+
+/// Default time between two drains
+#define DEFAULT_INTERVAL_MS 100
+
+static const char base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static errval_t write_console(void *arg, const uint8_t *buf, size_t len)
+{
+    char line[sizeof(CONSOLE_PREFIX) + CONSOLE_LINE_BYTES / 3 * 4 + 2];
+
+    while (len > 0) {
+        size_t n = len < CONSOLE_LINE_BYTES ? len : CONSOLE_LINE_BYTES;
+        char *p = line + strlen(CONSOLE_PREFIX);
+        memcpy(line, CONSOLE_PREFIX, strlen(CONSOLE_PREFIX));
+
+        for (size_t i = 0; i < n; i += 3) {
+            uint32_t v = buf[i] << 16;
+            if (i + 1 < n) v |= buf[i + 1] << 8;
+            if (i + 2 < n) v |= buf[i + 2];
+            *p++ = base64[(v >> 18) & 0x3f];
+            *p++ = base64[(v >> 12) & 0x3f];
+            *p++ = i + 1 < n ? base64[(v >> 6) & 0x3f] : '=';
+            *p++ = i + 2 < n ? base64[v & 0x3f] : '=';
+        }
+        *p++ = '\n';
+        *p = '\0';
+        printf("%s", line);
+
+        buf += n;
+        len -= n;
+    }
+    fflush(stdout);
+
+    return SYS_ERR_OK;
+}
+
+static errval_t write_file(void *arg, const uint8_t *buf, size_t len)
+{
+    vfs_handle_t vh = arg;
+
+    while (len > 0) {
+        size_t written = 0;
+        errval_t err = vfs_write(vh, buf, len, &written);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        buf += written;
+        len -= written;
+    }
+
+    return SYS_ERR_OK;
+}
+
+static void usage(const char *progname)
+{
+    printf("Usage: %s [-s] [-i interval_ms] [file]\n"
+           "  Streams the trace to file, or to the console if no file is given.\n"
+           "  -s  start tracing now, instead of waiting for a start trigger\n"
+           "  -i  time between two drains of the trace rings (default %d ms)\n",
+           progname, DEFAULT_INTERVAL_MS);
+}
+
+int main(int argc, char *argv[])
+{
+#ifndef CONFIG_TRACE
+    // bail - no tracing support
+    printf("%.*s: Error, no tracing support, cannot start tracestream\n",
+           DISP_NAME_LEN, disp_name());
+    printf("%.*s: recompile with trace = TRUE in build/hake/Config.hs\n",
+           DISP_NAME_LEN, disp_name());
+    return -1;
+#endif
+
+    errval_t err;
+    bool start = false;
+    unsigned long interval_ms = DEFAULT_INTERVAL_MS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "si:")) != -1) {
+        switch (opt) {
+        case 's':
+            start = true;
+            break;
+        case 'i':
+            interval_ms = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    trace_stream_write_fn_t write = write_console;
+    void *arg = NULL;
+    if (optind < argc) {
+        vfs_init();
+
+        vfs_handle_t vh;
+        err = vfs_create(argv[optind], &vh);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "creating %s", argv[optind]);
+            return EXIT_FAILURE;
+        }
+        write = write_file;
+        arg = vh;
+    }
+
+    // Don't trace ourselves
+    trace_disable_domain();
+
+    struct trace_stream *stream;
+    err = trace_stream_create(write, arg, &stream);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "trace_stream_create");
+        return EXIT_FAILURE;
+    }
+
+    if (start) {
+        err = trace_start();
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "trace_start");
+            return EXIT_FAILURE;
+        }
+    }
+
+    debug_printf("streaming the trace every %lu ms\n", interval_ms);
+
+    while (true) {
+        size_t events;
+        err = trace_stream_drain(stream, &events);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "trace_stream_drain");
+            break;
+        }
+
+        err = barrelfish_usleep(interval_ms * 1000);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "barrelfish_usleep");
+            break;
+        }
+    }
+
+    trace_stream_destroy(stream);
+    return EXIT_FAILURE;
+}